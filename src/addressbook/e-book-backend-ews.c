@@ -2088,74 +2088,6 @@ ebb_ews_fetch_items_sync (EBookBackendEws *bbews,
 	return ret;
 }
 
-static void
-ebb_ews_server_notification_cb (EBookBackendEws *bbews,
-				const GSList *events,
-				EEwsConnection *cnc)
-{
-	GSList *link;
-	gboolean update_folder = FALSE;
-
-	g_return_if_fail (E_IS_BOOK_BACKEND_EWS (bbews));
-
-	for (link = (GSList *) events; link && !update_folder; link = g_slist_next (link)) {
-		EEwsNotificationEvent *event = link->data;
-
-		switch (event->type) {
-			case E_EWS_NOTIFICATION_EVENT_CREATED:
-			case E_EWS_NOTIFICATION_EVENT_DELETED:
-			case E_EWS_NOTIFICATION_EVENT_MODIFIED:
-				g_rec_mutex_lock (&bbews->priv->cnc_lock);
-
-				if (g_strcmp0 (event->folder_id, bbews->priv->folder_id) == 0)
-					update_folder = TRUE;
-
-				g_rec_mutex_unlock (&bbews->priv->cnc_lock);
-				break;
-			case E_EWS_NOTIFICATION_EVENT_MOVED:
-			case E_EWS_NOTIFICATION_EVENT_COPIED:
-				g_rec_mutex_lock (&bbews->priv->cnc_lock);
-
-				if (g_strcmp0 (event->folder_id, bbews->priv->folder_id) == 0 ||
-				    g_strcmp0 (event->old_folder_id, bbews->priv->folder_id) == 0)
-					update_folder = TRUE;
-
-				g_rec_mutex_unlock (&bbews->priv->cnc_lock);
-				break;
-			default:
-				return;
-		}
-	}
-
-	if (update_folder)
-		e_book_meta_backend_schedule_refresh (E_BOOK_META_BACKEND (bbews));
-}
-
-static void
-ebb_ews_unset_connection (EBookBackendEws *bbews)
-{
-	g_return_if_fail (E_IS_BOOK_BACKEND_EWS (bbews));
-
-	g_rec_mutex_lock (&bbews->priv->cnc_lock);
-
-	if (bbews->priv->cnc) {
-		e_ews_connection_set_disconnected_flag (bbews->priv->cnc, TRUE);
-
-		g_signal_handlers_disconnect_by_func (bbews->priv->cnc, ebb_ews_server_notification_cb, bbews);
-
-		if (bbews->priv->subscription_key != 0) {
-			e_ews_connection_disable_notifications_sync (
-				bbews->priv->cnc,
-				bbews->priv->subscription_key);
-			bbews->priv->subscription_key = 0;
-		}
-	}
-
-	g_clear_object (&bbews->priv->cnc);
-
-	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
-}
-
 static gint
 det_sort_func (gconstpointer _a,
 	       gconstpointer _b)
@@ -3092,6 +3024,243 @@ ebb_ews_contacts_to_infos (const GSList *contacts) /* EContact * */
 	return nfos;
 }
 
+/* The item changes of the folder, as received through the notifications */
+typedef struct _EbbEwsNotifiedItems {
+	GSList *created_ids; /* gchar * */
+	GSList *modified_ids; /* gchar * */
+	GSList *deleted_ids; /* gchar * */
+} EbbEwsNotifiedItems;
+
+static void
+ebb_ews_notified_items_free (gpointer ptr)
+{
+	EbbEwsNotifiedItems *ni = ptr;
+
+	if (ni) {
+		g_slist_free_full (ni->created_ids, g_free);
+		g_slist_free_full (ni->modified_ids, g_free);
+		g_slist_free_full (ni->deleted_ids, g_free);
+		g_free (ni);
+	}
+}
+
+static gboolean
+ebb_ews_fetch_notified_items_sync (EBookBackendEws *bbews,
+				   EBookCache *book_cache,
+				   const GSList *item_ids, /* gchar * */
+				   GSList **out_infos, /* EBookMetaBackendInfo * */
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	GSList *items = NULL, *contacts = NULL, *batch_ids = NULL;
+	const GSList *link;
+	guint batch_size, n_in_batch = 0;
+	gboolean success = TRUE;
+
+	if (!item_ids)
+		return TRUE;
+
+	batch_size = e_ews_connection_get_batch_size (bbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES);
+
+	/* The notifications do not carry the item types, which are
+	   needed to tell the contacts from the distribution lists;
+	   the contacts are read by the same batches, the reading
+	   of them is not split otherwise */
+	for (link = item_ids; link && success; link = g_slist_next (link)) {
+		batch_ids = g_slist_prepend (batch_ids, link->data);
+		n_in_batch++;
+
+		if (n_in_batch >= batch_size || !g_slist_next (link)) {
+			batch_ids = g_slist_reverse (batch_ids);
+
+			success = e_ews_connection_get_items_sync (bbews->priv->cnc, EWS_PRIORITY_MEDIUM, batch_ids, "IdOnly",
+				NULL, FALSE, NULL, E_EWS_BODY_TYPE_TEXT, &items, NULL, NULL, cancellable, error);
+
+			if (success) {
+				/* Skip the changes done by this backend */
+				items = ebb_ews_verify_changes (book_cache, items, cancellable);
+
+				if (items)
+					success = ebb_ews_fetch_items_sync (bbews, items, &contacts, cancellable, error);
+			}
+
+			g_slist_free_full (items, g_object_unref);
+			items = NULL;
+
+			g_slist_free (batch_ids);
+			batch_ids = NULL;
+			n_in_batch = 0;
+		}
+	}
+
+	if (success)
+		*out_infos = ebb_ews_contacts_to_infos (contacts);
+
+	g_slist_free_full (contacts, g_object_unref);
+
+	return success;
+}
+
+/* Puts the notified items into the cache, without asking for all
+   the changes in the folder; falls back to the refresh on failure */
+static void
+ebb_ews_apply_notified_items_cb (EBookBackend *book_backend,
+				 gpointer user_data,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	EBookBackendEws *bbews = E_BOOK_BACKEND_EWS (book_backend);
+	EBookMetaBackend *meta_backend = E_BOOK_META_BACKEND (book_backend);
+	EbbEwsNotifiedItems *ni = user_data;
+	EBookCache *book_cache;
+	GSList *created_objects = NULL, *modified_objects = NULL, *removed_objects = NULL, *link;
+	gboolean success;
+	GError *local_error = NULL;
+
+	book_cache = e_book_meta_backend_ref_cache (meta_backend);
+	g_return_if_fail (E_IS_BOOK_CACHE (book_cache));
+
+	g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
+	/* Not connected; the changes are picked on connect */
+	if (!bbews->priv->cnc) {
+		g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+		g_object_unref (book_cache);
+		return;
+	}
+
+	success = ebb_ews_fetch_notified_items_sync (bbews, book_cache, ni->created_ids, &created_objects, cancellable, &local_error) &&
+		  ebb_ews_fetch_notified_items_sync (bbews, book_cache, ni->modified_ids, &modified_objects, cancellable, &local_error);
+
+	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+
+	for (link = ni->deleted_ids; link && success; link = g_slist_next (link)) {
+		const gchar *uid = link->data;
+
+		removed_objects = g_slist_prepend (removed_objects,
+			e_book_meta_backend_info_new (uid, NULL, NULL, NULL));
+	}
+
+	if (success && (created_objects || modified_objects || removed_objects))
+		success = e_book_meta_backend_process_changes_sync (meta_backend, created_objects, modified_objects, removed_objects, cancellable, &local_error);
+
+	if (!success && !g_cancellable_is_cancelled (cancellable)) {
+		ebb_ews_convert_error_to_edb_error (&local_error);
+		ebb_ews_maybe_disconnect_sync (bbews, &local_error, cancellable);
+
+		e_book_meta_backend_schedule_refresh (meta_backend);
+	}
+
+	g_slist_free_full (created_objects, e_book_meta_backend_info_free);
+	g_slist_free_full (modified_objects, e_book_meta_backend_info_free);
+	g_slist_free_full (removed_objects, e_book_meta_backend_info_free);
+	g_clear_error (&local_error);
+	g_object_unref (book_cache);
+}
+
+static void
+ebb_ews_server_notification_cb (EBookBackendEws *bbews,
+				const GSList *events,
+				EEwsConnection *cnc)
+{
+	EbbEwsNotifiedItems *ni;
+	GSList *link;
+	gboolean update_folder = FALSE;
+
+	g_return_if_fail (E_IS_BOOK_BACKEND_EWS (bbews));
+
+	ni = g_new0 (EbbEwsNotifiedItems, 1);
+
+	/* The events with the item IDs are applied directly; the others,
+	   like those sent after a lost subscription, refresh the folder */
+	g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
+	for (link = (GSList *) events; link && !update_folder; link = g_slist_next (link)) {
+		EEwsNotificationEvent *event = link->data;
+		gboolean in_folder, in_old_folder;
+
+		in_folder = g_strcmp0 (event->folder_id, bbews->priv->folder_id) == 0;
+		in_old_folder = g_strcmp0 (event->old_folder_id, bbews->priv->folder_id) == 0;
+
+		switch (event->type) {
+			case E_EWS_NOTIFICATION_EVENT_CREATED:
+			case E_EWS_NOTIFICATION_EVENT_DELETED:
+			case E_EWS_NOTIFICATION_EVENT_MODIFIED:
+				if (!in_folder)
+					break;
+
+				if (!event->item_id)
+					update_folder = TRUE;
+				else if (event->type == E_EWS_NOTIFICATION_EVENT_CREATED)
+					ni->created_ids = g_slist_prepend (ni->created_ids, g_strdup (event->item_id));
+				else if (event->type == E_EWS_NOTIFICATION_EVENT_MODIFIED)
+					ni->modified_ids = g_slist_prepend (ni->modified_ids, g_strdup (event->item_id));
+				else
+					ni->deleted_ids = g_slist_prepend (ni->deleted_ids, g_strdup (event->item_id));
+				break;
+			case E_EWS_NOTIFICATION_EVENT_MOVED:
+			case E_EWS_NOTIFICATION_EVENT_COPIED:
+				if (in_old_folder && event->type == E_EWS_NOTIFICATION_EVENT_MOVED) {
+					if (event->old_item_id)
+						ni->deleted_ids = g_slist_prepend (ni->deleted_ids, g_strdup (event->old_item_id));
+					else
+						update_folder = TRUE;
+				}
+
+				if (in_folder) {
+					if (event->item_id)
+						ni->created_ids = g_slist_prepend (ni->created_ids, g_strdup (event->item_id));
+					else
+						update_folder = TRUE;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+
+	if (update_folder) {
+		ebb_ews_notified_items_free (ni);
+		e_book_meta_backend_schedule_refresh (E_BOOK_META_BACKEND (bbews));
+	} else if (ni->created_ids || ni->modified_ids || ni->deleted_ids) {
+		ni->created_ids = g_slist_reverse (ni->created_ids);
+		ni->modified_ids = g_slist_reverse (ni->modified_ids);
+		ni->deleted_ids = g_slist_reverse (ni->deleted_ids);
+
+		e_book_backend_schedule_custom_operation (E_BOOK_BACKEND (bbews), NULL,
+			ebb_ews_apply_notified_items_cb, ni, ebb_ews_notified_items_free);
+	} else {
+		ebb_ews_notified_items_free (ni);
+	}
+}
+
+static void
+ebb_ews_unset_connection (EBookBackendEws *bbews)
+{
+	g_return_if_fail (E_IS_BOOK_BACKEND_EWS (bbews));
+
+	g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
+	if (bbews->priv->cnc) {
+		e_ews_connection_set_disconnected_flag (bbews->priv->cnc, TRUE);
+
+		g_signal_handlers_disconnect_by_func (bbews->priv->cnc, ebb_ews_server_notification_cb, bbews);
+
+		if (bbews->priv->subscription_key != 0) {
+			e_ews_connection_disable_notifications_sync (
+				bbews->priv->cnc,
+				bbews->priv->subscription_key);
+			bbews->priv->subscription_key = 0;
+		}
+	}
+
+	g_clear_object (&bbews->priv->cnc);
+
+	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+}
+
 static gboolean
 ebb_ews_connect_sync (EBookMetaBackend *meta_backend,
 		      const ENamedParameters *credentials,
@@ -3357,7 +3526,8 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 		gboolean includes_last_item = TRUE;
 
 		success = e_ews_connection_sync_folder_items_sync (bbews->priv->cnc, EWS_PRIORITY_MEDIUM,
-			last_sync_tag, bbews->priv->folder_id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
+			last_sync_tag, bbews->priv->folder_id, "IdOnly", NULL,
+			e_ews_connection_get_batch_size (bbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES),
 			out_new_sync_tag, &includes_last_item, &items_created, &items_modified, &items_deleted,
 			cancellable, &local_error);
 
@@ -3368,7 +3538,8 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 			e_book_meta_backend_empty_cache_sync (meta_backend, cancellable, NULL);
 
 			success = e_ews_connection_sync_folder_items_sync (bbews->priv->cnc, EWS_PRIORITY_MEDIUM,
-				NULL, bbews->priv->folder_id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
+				NULL, bbews->priv->folder_id, "IdOnly", NULL,
+				e_ews_connection_get_batch_size (bbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES),
 				out_new_sync_tag, &includes_last_item, &items_created, &items_modified, &items_deleted,
 				cancellable, &local_error);
 		}
@@ -198,71 +198,6 @@ ecb_ews_maybe_disconnect_sync (ECalBackendEws *cbews,
 	}
 }
 
-static void
-ecb_ews_server_notification_cb (ECalBackendEws *cbews,
-				GSList *events,
-				EEwsConnection *cnc)
-{
-	GSList *link;
-	gboolean update_folder = FALSE;
-
-	g_return_if_fail (cbews != NULL);
-	g_return_if_fail (cbews->priv != NULL);
-
-	for (link = events; link && !update_folder; link = g_slist_next (link)) {
-		EEwsNotificationEvent *event = link->data;
-
-		switch (event->type) {
-			case E_EWS_NOTIFICATION_EVENT_CREATED:
-			case E_EWS_NOTIFICATION_EVENT_DELETED:
-			case E_EWS_NOTIFICATION_EVENT_MODIFIED:
-				g_rec_mutex_lock (&cbews->priv->cnc_lock);
-				if (g_strcmp0 (event->folder_id, cbews->priv->folder_id) == 0)
-					update_folder = TRUE;
-				g_rec_mutex_unlock (&cbews->priv->cnc_lock);
-				break;
-			case E_EWS_NOTIFICATION_EVENT_MOVED:
-			case E_EWS_NOTIFICATION_EVENT_COPIED:
-				g_rec_mutex_lock (&cbews->priv->cnc_lock);
-				if (g_strcmp0 (event->folder_id, cbews->priv->folder_id) == 0 ||
-				    g_strcmp0 (event->old_folder_id, cbews->priv->folder_id) == 0)
-					update_folder = TRUE;
-				g_rec_mutex_unlock (&cbews->priv->cnc_lock);
-				break;
-			default:
-				return;
-		}
-	}
-
-	if (update_folder)
-		e_cal_meta_backend_schedule_refresh (E_CAL_META_BACKEND (cbews));
-}
-
-static void
-ecb_ews_unset_connection (ECalBackendEws *cbews)
-{
-	g_return_if_fail (E_IS_CAL_BACKEND_EWS (cbews));
-
-	g_rec_mutex_lock (&cbews->priv->cnc_lock);
-
-	if (cbews->priv->cnc) {
-		e_ews_connection_set_disconnected_flag (cbews->priv->cnc, TRUE);
-
-		g_signal_handlers_disconnect_by_func (cbews->priv->cnc, ecb_ews_server_notification_cb, cbews);
-
-		if (cbews->priv->subscription_key != 0) {
-			e_ews_connection_disable_notifications_sync (
-				cbews->priv->cnc,
-				cbews->priv->subscription_key);
-			cbews->priv->subscription_key = 0;
-		}
-	}
-
-	g_clear_object (&cbews->priv->cnc);
-
-	g_rec_mutex_unlock (&cbews->priv->cnc_lock);
-}
-
 static icaltimezone *
 ecb_ews_get_timezone (ETimezoneCache *timezone_cache,
 		      const gchar *msdn_tzid,
@@ -1032,6 +967,35 @@ ecb_ews_restore_original_comp (ECalComponent *from_comp)
 	return comp;
 }
 
+static EEwsAdditionalProps *
+ecb_ews_new_event_props (ECalBackendEws *cbews)
+{
+	EEwsAdditionalProps *add_props;
+
+	add_props = e_ews_additional_props_new ();
+	if (e_ews_connection_satisfies_server_version (cbews->priv->cnc, E_EWS_EXCHANGE_2010)) {
+		EEwsExtendedFieldURI *ext_uri;
+
+		add_props->field_uri = g_strdup (GET_ITEMS_SYNC_PROPERTIES_2010);
+
+		ext_uri = e_ews_extended_field_uri_new ();
+		ext_uri->distinguished_prop_set_id = g_strdup ("PublicStrings");
+		ext_uri->prop_name = g_strdup ("EvolutionEWSStartTimeZone");
+		ext_uri->prop_type = g_strdup ("String");
+		add_props->extended_furis = g_slist_append (add_props->extended_furis, ext_uri);
+
+		ext_uri = e_ews_extended_field_uri_new ();
+		ext_uri->distinguished_prop_set_id = g_strdup ("PublicStrings");
+		ext_uri->prop_name = g_strdup ("EvolutionEWSEndTimeZone");
+		ext_uri->prop_type = g_strdup ("String");
+		add_props->extended_furis = g_slist_append (add_props->extended_furis, ext_uri);
+	} else {
+		add_props->field_uri = g_strdup (GET_ITEMS_SYNC_PROPERTIES_2007);
+	}
+
+	return add_props;
+}
+
 static gboolean
 ecb_ews_get_items_sync (ECalBackendEws *cbews,
 			const GSList *item_ids, /* gchar * */
@@ -1041,7 +1005,7 @@ ecb_ews_get_items_sync (ECalBackendEws *cbews,
 			GCancellable *cancellable,
 			GError **error)
 {
-	GSList *items = NULL, *link;
+	GSList *items = NULL, *occurrence_ids = NULL, *link;
 	gboolean success;
 
 	g_return_val_if_fail (E_IS_CAL_BACKEND_EWS (cbews), FALSE);
@@ -1064,46 +1028,53 @@ ecb_ews_get_items_sync (ECalBackendEws *cbews,
 	if (!success)
 		return FALSE;
 
-	/* fetch modified occurrences */
+	/* fetch modified occurrences of all the items, in as few requests as possible */
 	for (link = items; link; link = g_slist_next (link)) {
 		EEwsItem *item = link->data;
-		const GSList *modified_occurrences;
+		const GSList *modified_occurrences, *mlink;
 
 		if (!item || e_ews_item_get_item_type (item) == E_EWS_ITEM_TYPE_ERROR)
 			continue;
 
 		modified_occurrences = e_ews_item_get_modified_occurrences (item);
-		if (modified_occurrences) {
-			EEwsAdditionalProps *modified_add_props;
-
-			modified_add_props = e_ews_additional_props_new ();
-			if (e_ews_connection_satisfies_server_version (cbews->priv->cnc, E_EWS_EXCHANGE_2010)) {
-				EEwsExtendedFieldURI *ext_uri;
-
-				modified_add_props->field_uri = g_strdup (GET_ITEMS_SYNC_PROPERTIES_2010);
-
-				ext_uri = e_ews_extended_field_uri_new ();
-				ext_uri->distinguished_prop_set_id = g_strdup ("PublicStrings");
-				ext_uri->prop_name = g_strdup ("EvolutionEWSStartTimeZone");
-				ext_uri->prop_type = g_strdup ("String");
-				modified_add_props->extended_furis = g_slist_append (modified_add_props->extended_furis, ext_uri);
-
-				ext_uri = e_ews_extended_field_uri_new ();
-				ext_uri->distinguished_prop_set_id = g_strdup ("PublicStrings");
-				ext_uri->prop_name = g_strdup ("EvolutionEWSEndTimeZone");
-				ext_uri->prop_type = g_strdup ("String");
-				modified_add_props->extended_furis = g_slist_append (modified_add_props->extended_furis, ext_uri);
-			} else {
-				modified_add_props->field_uri = g_strdup (GET_ITEMS_SYNC_PROPERTIES_2007);
-			}
+		for (mlink = modified_occurrences; mlink; mlink = g_slist_next (mlink)) {
+			occurrence_ids = g_slist_prepend (occurrence_ids, mlink->data);
+		}
+	}
+
+	if (occurrence_ids) {
+		EEwsAdditionalProps *modified_add_props;
+		GSList *batch_ids = NULL;
+		guint batch_size, n_in_batch = 0;
+
+		occurrence_ids = g_slist_reverse (occurrence_ids);
+		modified_add_props = ecb_ews_new_event_props (cbews);
 
-			success = ecb_ews_get_items_sync (cbews, modified_occurrences, "IdOnly", modified_add_props, out_components, cancellable, error);
+		/* The same limit as for the items themselves; a series can have
+		   many modified occurrences, which would make the request too large */
+		batch_size = e_ews_connection_get_batch_size (cbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES);
 
-			e_ews_additional_props_free (modified_add_props);
+		for (link = occurrence_ids; link && success; link = g_slist_next (link)) {
+			batch_ids = g_slist_prepend (batch_ids, link->data);
+			n_in_batch++;
 
-			if (!success)
-				goto exit;
+			if (n_in_batch >= batch_size || !g_slist_next (link)) {
+				batch_ids = g_slist_reverse (batch_ids);
+
+				success = ecb_ews_get_items_sync (cbews, batch_ids, "IdOnly", modified_add_props, out_components, cancellable, error);
+
+				g_slist_free (batch_ids);
+				batch_ids = NULL;
+				n_in_batch = 0;
+			}
 		}
+
+		g_slist_free (batch_ids);
+		e_ews_additional_props_free (modified_add_props);
+		g_slist_free (occurrence_ids);
+
+		if (!success)
+			goto exit;
 	}
 
 	for (link = items; link; link = g_slist_next (link)) {
@@ -1135,6 +1106,131 @@ ecb_ews_get_items_sync (ECalBackendEws *cbews,
 	return success;
 }
 
+typedef struct _EcbEwsFetchData {
+	ECalBackendEws *cbews;
+	const gchar *default_props;
+	const EEwsAdditionalProps *add_props;
+	GCancellable *cancellable;
+	volatile gint failed;
+} EcbEwsFetchData;
+
+typedef struct _EcbEwsFetchBatch {
+	GSList *item_ids; /* gchar *, borrowed */
+	GSList *components; /* ECalComponent * */
+	GError *error;
+} EcbEwsFetchBatch;
+
+static void
+ecb_ews_fetch_batch_thread (gpointer data,
+			    gpointer user_data)
+{
+	EcbEwsFetchBatch *batch = data;
+	EcbEwsFetchData *fd = user_data;
+
+	/* Do not start new batches when one failed already */
+	if (g_atomic_int_get (&fd->failed) ||
+	    g_cancellable_set_error_if_cancelled (fd->cancellable, &batch->error))
+		return;
+
+	if (!ecb_ews_get_items_sync (fd->cbews, batch->item_ids, fd->default_props, fd->add_props,
+		&batch->components, fd->cancellable, &batch->error))
+		g_atomic_int_set (&fd->failed, 1);
+}
+
+/* Reads the items in batches, as many batches at once as many requests
+   the connection can have in flight, each with its modified occurrences
+   and attachments. The components are added into the out_components
+   in the same order as if read by a single ecb_ews_get_items_sync() call. */
+static gboolean
+ecb_ews_get_items_concurrent_sync (ECalBackendEws *cbews,
+				   const GSList *item_ids, /* gchar * */
+				   const gchar *default_props,
+				   const EEwsAdditionalProps *add_props,
+				   GSList **out_components, /* ECalComponent * */
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	EcbEwsFetchData fd;
+	GPtrArray *batches;
+	GThreadPool *pool;
+	GSList *link;
+	guint batch_size, n_in_batch = 0, max_threads, ii;
+	gboolean success = TRUE;
+
+	batch_size = e_ews_connection_get_batch_size (cbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES);
+
+	if (g_slist_length ((GSList *) item_ids) <= batch_size)
+		return ecb_ews_get_items_sync (cbews, item_ids, default_props, add_props, out_components, cancellable, error);
+
+	batches = g_ptr_array_new ();
+
+	for (link = (GSList *) item_ids; link; link = g_slist_next (link)) {
+		EcbEwsFetchBatch *batch;
+
+		if (!n_in_batch) {
+			batch = g_new0 (EcbEwsFetchBatch, 1);
+			g_ptr_array_add (batches, batch);
+		} else {
+			batch = g_ptr_array_index (batches, batches->len - 1);
+		}
+
+		batch->item_ids = g_slist_prepend (batch->item_ids, link->data);
+
+		n_in_batch++;
+		if (n_in_batch >= batch_size)
+			n_in_batch = 0;
+	}
+
+	memset (&fd, 0, sizeof (EcbEwsFetchData));
+	fd.cbews = cbews;
+	fd.default_props = default_props;
+	fd.add_props = add_props;
+	fd.cancellable = cancellable;
+
+	/* The caller holds the cnc_lock, thus the connection stays
+	   the same while the threads use it */
+	max_threads = MAX (1, e_ews_connection_get_concurrent_connections (cbews->priv->cnc));
+
+	pool = g_thread_pool_new (ecb_ews_fetch_batch_thread, &fd, MIN (max_threads, batches->len), FALSE, NULL);
+
+	for (ii = 0; ii < batches->len; ii++) {
+		EcbEwsFetchBatch *batch = g_ptr_array_index (batches, ii);
+
+		batch->item_ids = g_slist_reverse (batch->item_ids);
+
+		if (pool)
+			g_thread_pool_push (pool, batch, NULL);
+		else
+			ecb_ews_fetch_batch_thread (batch, &fd);
+	}
+
+	if (pool)
+		g_thread_pool_free (pool, FALSE, TRUE);
+
+	/* Merge in order; the components of a batch are in the reverse order */
+	for (ii = 0; ii < batches->len; ii++) {
+		EcbEwsFetchBatch *batch = g_ptr_array_index (batches, ii);
+
+		*out_components = g_slist_concat (batch->components, *out_components);
+
+		if (batch->error) {
+			if (success)
+				g_propagate_error (error, batch->error);
+			else
+				g_error_free (batch->error);
+
+			success = FALSE;
+		}
+
+		g_slist_free (batch->item_ids);
+		g_free (batch);
+	}
+
+	g_ptr_array_free (batches, TRUE);
+
+	return success;
+}
+
 static gboolean
 ecb_ews_fetch_items_sync (ECalBackendEws *cbews,
 			  const GSList *items, /* EEwsItem * */
@@ -1160,34 +1256,19 @@ ecb_ews_fetch_items_sync (ECalBackendEws *cbews,
 	if (event_ids) {
 		EEwsAdditionalProps *add_props;
 
-		add_props = e_ews_additional_props_new ();
-		if (e_ews_connection_satisfies_server_version (cbews->priv->cnc, E_EWS_EXCHANGE_2010)) {
-			EEwsExtendedFieldURI *ext_uri;
-
-			add_props->field_uri = g_strdup (GET_ITEMS_SYNC_PROPERTIES_2010);
-
-			ext_uri = e_ews_extended_field_uri_new ();
-			ext_uri->distinguished_prop_set_id = g_strdup ("PublicStrings");
-			ext_uri->prop_name = g_strdup ("EvolutionEWSStartTimeZone");
-			ext_uri->prop_type = g_strdup ("String");
-			add_props->extended_furis = g_slist_append (add_props->extended_furis, ext_uri);
-
-			ext_uri = e_ews_extended_field_uri_new ();
-			ext_uri->distinguished_prop_set_id = g_strdup ("PublicStrings");
-			ext_uri->prop_name = g_strdup ("EvolutionEWSEndTimeZone");
-			ext_uri->prop_type = g_strdup ("String");
-			add_props->extended_furis = g_slist_append (add_props->extended_furis, ext_uri);
-		} else {
-			add_props->field_uri = g_strdup (GET_ITEMS_SYNC_PROPERTIES_2007);
-		}
+		event_ids = g_slist_reverse (event_ids);
+		add_props = ecb_ews_new_event_props (cbews);
 
-		success = ecb_ews_get_items_sync (cbews, event_ids, "IdOnly", add_props, out_components, cancellable, error);
+		success = ecb_ews_get_items_concurrent_sync (cbews, event_ids, "IdOnly", add_props, out_components, cancellable, error);
 
 		e_ews_additional_props_free (add_props);
 	}
 
-	if (task_memo_ids && success)
-		success = ecb_ews_get_items_sync (cbews, task_memo_ids, "AllProperties", NULL, out_components, cancellable, error);
+	if (task_memo_ids && success) {
+		task_memo_ids = g_slist_reverse (task_memo_ids);
+
+		success = ecb_ews_get_items_concurrent_sync (cbews, task_memo_ids, "AllProperties", NULL, out_components, cancellable, error);
+	}
 
 	g_slist_free_full (event_ids, g_free);
 	g_slist_free_full (task_memo_ids, g_free);
@@ -1414,6 +1495,260 @@ ecb_ews_is_organizer (ECalBackendEws *cbews,
 	return is_organizer;
 }
 
+/* The item changes of the folder, as received through the notifications */
+typedef struct _EcbEwsNotifiedItems {
+	GSList *created_ids; /* gchar * */
+	GSList *modified_ids; /* gchar * */
+	GSList *deleted_ids; /* gchar * */
+} EcbEwsNotifiedItems;
+
+static void
+ecb_ews_notified_items_free (gpointer ptr)
+{
+	EcbEwsNotifiedItems *ni = ptr;
+
+	if (ni) {
+		g_slist_free_full (ni->created_ids, g_free);
+		g_slist_free_full (ni->modified_ids, g_free);
+		g_slist_free_full (ni->deleted_ids, g_free);
+		g_free (ni);
+	}
+}
+
+static gboolean
+ecb_ews_fetch_notified_items_sync (ECalBackendEws *cbews,
+				   ECalCache *cal_cache,
+				   const GSList *item_ids, /* gchar * */
+				   GSList **out_infos, /* ECalMetaBackendInfo * */
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	GSList *items = NULL, *components = NULL, *batch_ids = NULL;
+	const GSList *link;
+	icalcomponent_kind kind;
+	guint batch_size, n_in_batch = 0;
+	gboolean success = TRUE;
+
+	if (!item_ids)
+		return TRUE;
+
+	kind = e_cal_backend_get_kind (E_CAL_BACKEND (cbews));
+	batch_size = e_ews_connection_get_batch_size (cbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES);
+
+	/* The notifications do not carry the item types, which are
+	   needed to read the right properties of the items */
+	for (link = item_ids; link && success; link = g_slist_next (link)) {
+		batch_ids = g_slist_prepend (batch_ids, link->data);
+		n_in_batch++;
+
+		if (n_in_batch >= batch_size || !g_slist_next (link)) {
+			GSList *batch_items = NULL;
+
+			batch_ids = g_slist_reverse (batch_ids);
+
+			success = e_ews_connection_get_items_sync (cbews->priv->cnc, EWS_PRIORITY_MEDIUM, batch_ids, "IdOnly",
+				NULL, FALSE, NULL, E_EWS_BODY_TYPE_ANY, &batch_items, NULL, NULL, cancellable, error);
+
+			items = g_slist_concat (items, batch_items);
+
+			g_slist_free (batch_ids);
+			batch_ids = NULL;
+			n_in_batch = 0;
+		}
+	}
+
+	if (success) {
+		/* Skip the changes done by this backend */
+		items = ecb_ews_verify_changes (cal_cache, kind, items, cancellable);
+
+		if (items) {
+			success = ecb_ews_fetch_items_sync (cbews, items, &components, cancellable, error);
+			if (success)
+				*out_infos = ecb_ews_components_to_infos (E_CAL_META_BACKEND (cbews), components, kind);
+		}
+	}
+
+	g_slist_free_full (components, g_object_unref);
+	g_slist_free_full (items, g_object_unref);
+
+	return success;
+}
+
+/* Puts the notified items into the cache, without asking for all
+   the changes in the folder; falls back to the refresh on failure */
+static void
+ecb_ews_apply_notified_items_cb (ECalBackend *cal_backend,
+				 gpointer user_data,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	ECalBackendEws *cbews = E_CAL_BACKEND_EWS (cal_backend);
+	ECalMetaBackend *meta_backend = E_CAL_META_BACKEND (cal_backend);
+	EcbEwsNotifiedItems *ni = user_data;
+	ECalCache *cal_cache;
+	GSList *created_objects = NULL, *modified_objects = NULL, *removed_objects = NULL, *link;
+	gboolean success;
+	GError *local_error = NULL;
+
+	cal_cache = e_cal_meta_backend_ref_cache (meta_backend);
+	g_return_if_fail (E_IS_CAL_CACHE (cal_cache));
+
+	g_rec_mutex_lock (&cbews->priv->cnc_lock);
+
+	/* Not connected; the changes are picked on connect */
+	if (!cbews->priv->cnc) {
+		g_rec_mutex_unlock (&cbews->priv->cnc_lock);
+		g_object_unref (cal_cache);
+		return;
+	}
+
+	success = ecb_ews_fetch_notified_items_sync (cbews, cal_cache, ni->created_ids, &created_objects, cancellable, &local_error) &&
+		  ecb_ews_fetch_notified_items_sync (cbews, cal_cache, ni->modified_ids, &modified_objects, cancellable, &local_error);
+
+	g_rec_mutex_unlock (&cbews->priv->cnc_lock);
+
+	for (link = ni->deleted_ids; link && success; link = g_slist_next (link)) {
+		const gchar *item_id = link->data;
+		GSList *ids = NULL, *ilink;
+
+		if (!e_cal_cache_get_ids_with_extra (cal_cache, item_id, &ids, cancellable, NULL))
+			continue;
+
+		for (ilink = ids; ilink; ilink = g_slist_next (ilink)) {
+			ECalComponentId *id = ilink->data;
+
+			/* Use the master object */
+			if (id && id->uid && *id->uid && (!id->rid || !*id->rid)) {
+				removed_objects = g_slist_prepend (removed_objects,
+					e_cal_meta_backend_info_new (id->uid, NULL, NULL, NULL));
+				break;
+			}
+		}
+
+		g_slist_free_full (ids, (GDestroyNotify) e_cal_component_free_id);
+	}
+
+	if (success && (created_objects || modified_objects || removed_objects))
+		success = e_cal_meta_backend_process_changes_sync (meta_backend, created_objects, modified_objects, removed_objects, cancellable, &local_error);
+
+	if (!success && !g_cancellable_is_cancelled (cancellable)) {
+		ecb_ews_convert_error_to_edc_error (&local_error);
+		ecb_ews_maybe_disconnect_sync (cbews, &local_error, cancellable);
+
+		e_cal_meta_backend_schedule_refresh (meta_backend);
+	}
+
+	g_slist_free_full (created_objects, e_cal_meta_backend_info_free);
+	g_slist_free_full (modified_objects, e_cal_meta_backend_info_free);
+	g_slist_free_full (removed_objects, e_cal_meta_backend_info_free);
+	g_clear_error (&local_error);
+	g_object_unref (cal_cache);
+}
+
+static void
+ecb_ews_server_notification_cb (ECalBackendEws *cbews,
+				GSList *events,
+				EEwsConnection *cnc)
+{
+	EcbEwsNotifiedItems *ni;
+	GSList *link;
+	gboolean update_folder = FALSE;
+
+	g_return_if_fail (cbews != NULL);
+	g_return_if_fail (cbews->priv != NULL);
+
+	ni = g_new0 (EcbEwsNotifiedItems, 1);
+
+	/* The events with the item IDs are applied directly; the others,
+	   like those sent after a lost subscription, refresh the folder */
+	g_rec_mutex_lock (&cbews->priv->cnc_lock);
+
+	for (link = events; link && !update_folder; link = g_slist_next (link)) {
+		EEwsNotificationEvent *event = link->data;
+		gboolean in_folder, in_old_folder;
+
+		in_folder = g_strcmp0 (event->folder_id, cbews->priv->folder_id) == 0;
+		in_old_folder = g_strcmp0 (event->old_folder_id, cbews->priv->folder_id) == 0;
+
+		switch (event->type) {
+			case E_EWS_NOTIFICATION_EVENT_CREATED:
+			case E_EWS_NOTIFICATION_EVENT_DELETED:
+			case E_EWS_NOTIFICATION_EVENT_MODIFIED:
+				if (!in_folder)
+					break;
+
+				if (!event->item_id)
+					update_folder = TRUE;
+				else if (event->type == E_EWS_NOTIFICATION_EVENT_CREATED)
+					ni->created_ids = g_slist_prepend (ni->created_ids, g_strdup (event->item_id));
+				else if (event->type == E_EWS_NOTIFICATION_EVENT_MODIFIED)
+					ni->modified_ids = g_slist_prepend (ni->modified_ids, g_strdup (event->item_id));
+				else
+					ni->deleted_ids = g_slist_prepend (ni->deleted_ids, g_strdup (event->item_id));
+				break;
+			case E_EWS_NOTIFICATION_EVENT_MOVED:
+			case E_EWS_NOTIFICATION_EVENT_COPIED:
+				if (in_old_folder && event->type == E_EWS_NOTIFICATION_EVENT_MOVED) {
+					if (event->old_item_id)
+						ni->deleted_ids = g_slist_prepend (ni->deleted_ids, g_strdup (event->old_item_id));
+					else
+						update_folder = TRUE;
+				}
+
+				if (in_folder) {
+					if (event->item_id)
+						ni->created_ids = g_slist_prepend (ni->created_ids, g_strdup (event->item_id));
+					else
+						update_folder = TRUE;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	g_rec_mutex_unlock (&cbews->priv->cnc_lock);
+
+	if (update_folder) {
+		ecb_ews_notified_items_free (ni);
+		e_cal_meta_backend_schedule_refresh (E_CAL_META_BACKEND (cbews));
+	} else if (ni->created_ids || ni->modified_ids || ni->deleted_ids) {
+		ni->created_ids = g_slist_reverse (ni->created_ids);
+		ni->modified_ids = g_slist_reverse (ni->modified_ids);
+		ni->deleted_ids = g_slist_reverse (ni->deleted_ids);
+
+		e_cal_backend_schedule_custom_operation (E_CAL_BACKEND (cbews), NULL,
+			ecb_ews_apply_notified_items_cb, ni, ecb_ews_notified_items_free);
+	} else {
+		ecb_ews_notified_items_free (ni);
+	}
+}
+
+static void
+ecb_ews_unset_connection (ECalBackendEws *cbews)
+{
+	g_return_if_fail (E_IS_CAL_BACKEND_EWS (cbews));
+
+	g_rec_mutex_lock (&cbews->priv->cnc_lock);
+
+	if (cbews->priv->cnc) {
+		e_ews_connection_set_disconnected_flag (cbews->priv->cnc, TRUE);
+
+		g_signal_handlers_disconnect_by_func (cbews->priv->cnc, ecb_ews_server_notification_cb, cbews);
+
+		if (cbews->priv->subscription_key != 0) {
+			e_ews_connection_disable_notifications_sync (
+				cbews->priv->cnc,
+				cbews->priv->subscription_key);
+			cbews->priv->subscription_key = 0;
+		}
+	}
+
+	g_clear_object (&cbews->priv->cnc);
+
+	g_rec_mutex_unlock (&cbews->priv->cnc_lock);
+}
+
 static gboolean
 ecb_ews_connect_sync (ECalMetaBackend *meta_backend,
 		      const ENamedParameters *credentials,
@@ -1739,7 +2074,8 @@ ecb_ews_get_changes_sync (ECalMetaBackend *meta_backend,
 		add_props->field_uri = g_strdup ("item:ItemClass");
 
 		success = e_ews_connection_sync_folder_items_sync (cbews->priv->cnc, EWS_PRIORITY_MEDIUM,
-			last_sync_tag, cbews->priv->folder_id, "IdOnly", add_props, EWS_MAX_FETCH_COUNT,
+			last_sync_tag, cbews->priv->folder_id, "IdOnly", add_props,
+			e_ews_connection_get_batch_size (cbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES),
 			out_new_sync_tag, &includes_last_item, &items_created, &items_modified, &items_deleted,
 			cancellable, &local_error);
 
@@ -1750,7 +2086,8 @@ ecb_ews_get_changes_sync (ECalMetaBackend *meta_backend,
 			e_cal_meta_backend_empty_cache_sync (meta_backend, cancellable, NULL);
 
 			success = e_ews_connection_sync_folder_items_sync (cbews->priv->cnc, EWS_PRIORITY_MEDIUM,
-				NULL, cbews->priv->folder_id, "IdOnly", add_props, EWS_MAX_FETCH_COUNT,
+				NULL, cbews->priv->folder_id, "IdOnly", add_props,
+				e_ews_connection_get_batch_size (cbews->priv->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES),
 				out_new_sync_tag, &includes_last_item, &items_created, &items_modified, &items_deleted,
 				cancellable, &local_error);
 		}
@@ -31,6 +31,7 @@ which needs to be better organized via functions */
 #include "evolution-ews-config.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -42,6 +43,8 @@ which needs to be better organized via functions */
 #include <libical/icalcomponent.h>
 #include <libical/icalparser.h>
 
+#include <camel/camel-search-private.h>
+
 #include "server/camel-ews-settings.h"
 #include "server/e-ews-camel-common.h"
 #include "server/e-ews-connection.h"
@@ -84,10 +87,32 @@ struct _CamelEwsFolderPrivate {
 
 	/* For syncronizing refresh_info/sync_changes */
 	gboolean refreshing;
+	gboolean applying_notified; /* refresh_info waits on fetch_cond for it */
 	gboolean fetch_pending;
 	GMutex state_lock;
 	GCond fetch_cond;
 	GHashTable *fetching_uids;
+
+	/* Write-behind of the summaries, see ews_folder_save_summaries() */
+	GMutex save_lock;
+	gint64 save_last_time;
+	guint save_pending_changes;
+	guint save_avoided;
+
+	/* Full-text index of the cached message bodies, for offline body search */
+	GMutex index_lock;
+	CamelIndex *index;
+	gchar *index_path;
+	gboolean index_body;
+
+	/* The index words containing the searched words, kept for the run of
+	   one search and dropped when a message is indexed; guarded by the index_lock */
+	GHashTable *index_words; /* gchar *word ~> GPtrArray { gchar *index_word } */
+};
+
+enum {
+	PROP_0,
+	PROP_INDEX_BODY
 };
 
 static gboolean ews_delete_messages (CamelFolder *folder, const GSList *deleted_items, gboolean expunge, GCancellable *cancellable, GError **error);
@@ -95,6 +120,11 @@ static gboolean ews_refresh_info_sync (CamelFolder *folder, GCancellable *cancel
 
 #define d(x)
 
+/* The folder and store summaries are saved at most once per this many
+   seconds, or after this many changes, while synchronizing with the server */
+#define EWS_SUMMARY_SAVE_INTERVAL 5
+#define EWS_SUMMARY_SAVE_CHANGES 1000
+
 G_DEFINE_TYPE (CamelEwsFolder, camel_ews_folder, CAMEL_TYPE_OFFLINE_FOLDER)
 
 static GSList *
@@ -206,10 +236,10 @@ ews_data_cache_add (CamelDataCache *cdc,
 		cdc, path, g_checksum_get_string (sha), error);
 	g_checksum_free (sha);
 
-	if (base_stream != NULL)
+	if (base_stream != NULL) {
 		stream = camel_stream_new (base_stream);
-
-	g_object_unref (base_stream);
+		g_object_unref (base_stream);
+	}
 
 	return stream;
 }
@@ -354,145 +384,98 @@ ews_get_calendar_mime_part (CamelMimePart *mimepart)
 	return NULL;
 }
 
-static gchar *
-ews_update_mgtrequest_mime_calendar_itemid (const gchar *mime_fname,
+static gboolean
+ews_update_mgtrequest_mime_calendar_itemid (CamelMimeMessage *msg,
                                             const EwsId *calendar_item_id,
                                             gboolean is_calendar_UID,
 					    const EwsId *mail_item_id,
+                                            GCancellable *cancellable,
                                             GError **error)
 {
-	CamelMimeParser *mimeparser;
-	CamelMimeMessage *msg;
-	CamelMimePart *mimepart = NULL;
-	gint fd_old;
-	gchar *mime_fname_new = NULL;
+	CamelMimePart *mimepart;
+	CamelDataWrapper *dw;
+	CamelStream *tmpstream;
+	GByteArray *ba;
+	icalcomponent *icalcomp = NULL;
+	gboolean changed = FALSE;
 
-	// original mime file
-	fd_old = open (mime_fname, O_RDONLY);
-	if (fd_old == -1) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			_("Unable to open mimecontent temporary file!"));
-		return NULL;
-	}
+	mimepart = ews_get_calendar_mime_part (CAMEL_MIME_PART (msg));
+	if (!mimepart)
+		return FALSE;
 
-	mimeparser = camel_mime_parser_new ();
-	if (camel_mime_parser_init_with_fd (mimeparser, fd_old) == -1) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			_("Unable to generate parser from mimecontent!"));
-		goto exit_parser;
+	dw = camel_medium_get_content (CAMEL_MEDIUM (mimepart));
+	tmpstream = camel_stream_mem_new ();
+	if (camel_data_wrapper_decode_to_stream_sync (
+		dw, tmpstream, cancellable, error) == -1) {
+		g_object_unref (tmpstream);
+		return FALSE;
+	}
+	ba = camel_stream_mem_get_byte_array (CAMEL_STREAM_MEM (tmpstream));
+	if (ba && ba->len) {
+		g_byte_array_append (ba, (guint8 *) "\0", 1);
+		icalcomp = icalparser_parse_string ((gchar *) ba->data);
 	}
+	if (icalcomp) {
+		icalcomponent *subcomp;
+		icalproperty *icalprop;
+		gchar *calstring_new;
+
+		subcomp = icalcomponent_get_first_component (icalcomp, ICAL_VEVENT_COMPONENT);
+		icalprop = icalproperty_new_x (calendar_item_id->change_key);
+		icalproperty_set_x_name (icalprop, "X-EVOLUTION-CHANGEKEY");
+
+		/* In order to accept items we have to store AssociatedCalendarItemId (X-EVOLUTION-ITEMID)
+		 * or mail id (X-EVOLUTION-ACCEPT-ID) when we do not have AssociatedCalendarItemId */
+		icalcomponent_add_property (subcomp, icalprop);
+		if (is_calendar_UID) {
+			icalprop = icalproperty_new_x (calendar_item_id->id);
+			icalproperty_set_x_name (icalprop, "X-EVOLUTION-ITEMID");
+			icalcomponent_add_property (subcomp, icalprop);
+		}
 
-	msg = camel_mime_message_new ();
-	if (camel_mime_part_construct_from_parser_sync (
-		CAMEL_MIME_PART (msg), mimeparser, NULL, error) == -1) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			_("Unable to parse meeting request mimecontent!"));
-		goto exit_msg;
+		icalprop = icalproperty_new_x (mail_item_id->id);
+		icalproperty_set_x_name (icalprop, "X-EVOLUTION-ACCEPT-ID");
+		icalcomponent_add_property (subcomp, icalprop);
+
+		calstring_new = icalcomponent_as_ical_string_r (icalcomp);
+		if (calstring_new) {
+			camel_mime_part_set_content (
+				mimepart,
+				(const gchar *) calstring_new,
+				strlen (calstring_new),
+				"text/calendar");
+			g_free (calstring_new);
+			changed = TRUE;
+		}
+		icalcomponent_free (icalcomp);
 	}
+	g_object_unref (tmpstream);
 
-	mimepart = ews_get_calendar_mime_part (CAMEL_MIME_PART (msg));
-	if (mimepart) {
-		CamelDataWrapper *dw;
-		CamelStream *tmpstream = NULL, *newstream = NULL;
-		GByteArray *ba;
-		icalcomponent *icalcomp = NULL;
-		gchar *dir;
-		gint fd;
-		gboolean success = FALSE;
-
-		dw = camel_medium_get_content (CAMEL_MEDIUM (mimepart));
-		tmpstream = camel_stream_mem_new ();
-		if (camel_data_wrapper_decode_to_stream_sync (
-			dw, tmpstream, NULL, error) == -1) {
-			g_object_unref (tmpstream);
-			goto exit_msg;
-		}
-		ba = camel_stream_mem_get_byte_array (CAMEL_STREAM_MEM (tmpstream));
-		if (ba && ba->len) {
-			g_byte_array_append (ba, (guint8 *) "\0", 1);
-			icalcomp = icalparser_parse_string ((gchar *) ba->data);
-		}
-		if (icalcomp) {
-			icalcomponent *subcomp;
-			icalproperty *icalprop;
-			gchar *calstring_new;
-
-			subcomp = icalcomponent_get_first_component (icalcomp, ICAL_VEVENT_COMPONENT);
-			icalprop = icalproperty_new_x (calendar_item_id->change_key);
-			icalproperty_set_x_name (icalprop, "X-EVOLUTION-CHANGEKEY");
-
-			/* In order to accept items we have to store AssociatedCalendarItemId (X-EVOLUTION-ITEMID)
-			 * or mail id (X-EVOLUTION-ACCEPT-ID) when we do not have AssociatedCalendarItemId */
-			icalcomponent_add_property (subcomp, icalprop);
-			if (is_calendar_UID) {
-				icalprop = icalproperty_new_x (calendar_item_id->id);
-				icalproperty_set_x_name (icalprop, "X-EVOLUTION-ITEMID");
-				icalcomponent_add_property (subcomp, icalprop);
-			}
+	return changed;
+}
 
-			icalprop = icalproperty_new_x (mail_item_id->id);
-			icalproperty_set_x_name (icalprop, "X-EVOLUTION-ACCEPT-ID");
-			icalcomponent_add_property (subcomp, icalprop);
+/* Rewinds the cache stream and drops its content, thus it can be rewritten */
+static gboolean
+ews_cache_stream_rewind (CamelStream *cache_stream,
+			 gboolean truncate,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	GIOStream *iostream;
+	gboolean success = TRUE;
 
-			calstring_new = icalcomponent_as_ical_string_r (icalcomp);
-			if (calstring_new) {
-				camel_mime_part_set_content (
-					mimepart,
-					(const gchar *) calstring_new,
-					strlen (calstring_new),
-					"text/calendar");
-				g_free (calstring_new);
-			}
-			icalcomponent_free (icalcomp);
-		}
-		g_object_unref (tmpstream);
+	iostream = camel_stream_ref_base_stream (cache_stream);
+	if (iostream && G_IS_SEEKABLE (iostream)) {
+		GSeekable *seekable = G_SEEKABLE (iostream);
+
+		success = g_seekable_seek (seekable, 0, G_SEEK_SET, cancellable, error);
+		if (success && truncate && g_seekable_can_truncate (seekable))
+			success = g_seekable_truncate (seekable, 0, cancellable, error);
+	}
+
+	g_clear_object (&iostream);
 
-		/* Create a new file to store updated mimecontent */
-		dir = g_path_get_dirname (mime_fname);
-		mime_fname_new = g_build_filename ((const gchar *) dir, "XXXXXX", NULL);
-		fd = g_mkstemp (mime_fname_new);
-		if (fd == -1) {
-			g_set_error (
-				error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-				_("Unable to create cache file"));
-			goto exit_save;
-		}
-		newstream = camel_stream_fs_new_with_fd (fd);
-		if (camel_data_wrapper_write_to_stream_sync (
-			CAMEL_DATA_WRAPPER (msg),
-			newstream, NULL, error) == -1)
-			goto exit_save;
-		if (camel_stream_flush (newstream, NULL, error) == -1)
-			goto exit_save;
-		if (camel_stream_close (newstream, NULL, error) == -1)
-			goto exit_save;
-		if (g_remove (mime_fname) == -1) {
-			g_warning ("%s: Failed to remove file '%s': %s",
-				   G_STRFUNC, mime_fname, g_strerror (errno));
-		}
-		success = TRUE;
- exit_save:
-		if (fd != -1)
-			close (fd);
-		g_free (dir);
-		if (newstream)
-			g_object_unref (newstream);
-		if (!success) {
-			g_free (mime_fname_new);
-			mime_fname_new = NULL;
-		}
-	}
- exit_msg:
-	g_object_unref (msg);
- exit_parser:
-	g_object_unref (mimeparser);
-	close (fd_old);
-
-	// must be freed in the caller
-	return mime_fname_new;
+	return success;
 }
 
 static void
@@ -509,7 +492,7 @@ ews_message_from_properties_sync (CamelEwsFolder *ews_folder,
 				  EEwsConnection *cnc,
 				  gint pri,
 				  GSList *ids,
-				  const gchar *mime_dir,
+				  CamelStream *cache_stream,
 				  GSList **out_items, /* EEwsItem * */
 				  GCancellable *cancellable,
 				  GError **error)
@@ -518,17 +501,14 @@ ews_message_from_properties_sync (CamelEwsFolder *ews_folder,
 	const CamelNameValueArray *headers;
 	CamelMessageInfo *mi;
 	CamelMimeMessage *msg;
-	CamelStream *new_stream;
 	EEwsItem *item;
 	gboolean bval = FALSE;
-	gchar *mime_fname_new;
-	gint fd;
 	GSList *items = NULL;
 
 	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder), FALSE);
 	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), FALSE);
 	g_return_val_if_fail (ids != NULL, FALSE);
-	g_return_val_if_fail (mime_dir != NULL, FALSE);
+	g_return_val_if_fail (CAMEL_IS_STREAM (cache_stream), FALSE);
 	g_return_val_if_fail (out_items != NULL, FALSE);
 
 	add_props = e_ews_additional_props_new ();
@@ -604,7 +584,7 @@ ews_message_from_properties_sync (CamelEwsFolder *ews_folder,
 		g_object_unref (part);
 
 		attach_ids = e_ews_item_get_attachments_ids (item);
-		if (e_ews_connection_get_attachments_sync (cnc, EWS_PRIORITY_MEDIUM, NULL, attach_ids, NULL, FALSE, &attachments,
+		if (e_ews_connection_get_attachments_sync (cnc, pri, NULL, attach_ids, NULL, FALSE, &attachments,
 		    NULL, NULL, cancellable, error)) {
 			for (link = attachments; link; link = g_slist_next (link)) {
 				EEwsAttachmentInfo *ainfo = link->data;
@@ -658,37 +638,16 @@ ews_message_from_properties_sync (CamelEwsFolder *ews_folder,
 		camel_mime_part_set_content (CAMEL_MIME_PART (msg), body, strlen (body), "text/plain");
 	}
 
-	mime_fname_new = g_build_filename (mime_dir, "XXXXXX", NULL);
-	fd = g_mkstemp (mime_fname_new);
-	if (fd != -1)
-		e_ews_item_set_mime_content (item, mime_fname_new);
-	g_free (mime_fname_new);
-
-	if (fd == -1) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			_("Unable to create cache file"));
-
-		g_slist_free_full (items, g_object_unref);
-		g_clear_object (&msg);
-		g_clear_object (&mi);
-
-		return FALSE;
-	}
-
-	new_stream = camel_stream_fs_new_with_fd (fd);
-	if (camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (msg), new_stream, cancellable, error) == -1 ||
-	   camel_stream_flush (new_stream, cancellable, error) == -1 ||
-	   camel_stream_close (new_stream, cancellable, error) == -1) {
+	if (!ews_cache_stream_rewind (cache_stream, TRUE, cancellable, error) ||
+	    camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (msg), cache_stream, cancellable, error) == -1 ||
+	    camel_stream_flush (cache_stream, cancellable, error) == -1) {
 		g_slist_free_full (items, g_object_unref);
-		g_clear_object (&new_stream);
 		g_clear_object (&msg);
 		g_clear_object (&mi);
 
 		return FALSE;
 	}
 
-	g_clear_object (&new_stream);
 	g_clear_object (&msg);
 	g_clear_object (&mi);
 
@@ -697,6 +656,249 @@ ews_message_from_properties_sync (CamelEwsFolder *ews_folder,
 	return TRUE;
 }
 
+/* Sets the From and Date headers from the item properties;
+   returns whether the message had been changed */
+static gboolean
+ews_folder_apply_item_headers (CamelMimeMessage *message,
+			       EEwsItem *item)
+{
+	CamelInternetAddress *from;
+	const gchar *email = NULL, *date_header;
+	gboolean changed = FALSE;
+
+	from = camel_mime_message_get_from (message);
+
+	if (!from || !camel_internet_address_get (from, 0, NULL, &email) || !email || !*email) {
+		const EwsMailbox *mailbox;
+
+		mailbox = e_ews_item_get_from (item);
+		if (!mailbox)
+			mailbox = e_ews_item_get_sender (item);
+		if (mailbox) {
+			email = NULL;
+
+			if (g_strcmp0 (mailbox->routing_type, "EX") == 0)
+				email = e_ews_item_util_strip_ex_address (mailbox->email);
+
+			from = camel_internet_address_new ();
+			camel_internet_address_add (from, mailbox->name, email ? email : mailbox->email);
+			camel_mime_message_set_from (message, from);
+			g_object_unref (from);
+
+			changed = TRUE;
+		}
+	}
+
+	date_header = e_ews_item_get_date_header (item);
+	if (date_header && *date_header) {
+		time_t tt;
+		gint tz_offset;
+
+		tt = camel_header_decode_date (date_header, &tz_offset);
+		if (tt > 0) {
+			camel_mime_message_set_date (message, tt, tz_offset);
+			changed = TRUE;
+		}
+	}
+
+	return changed;
+}
+
+/* Moves a complete message file into the "cur" cache path */
+static gboolean
+ews_folder_commit_cache_file (CamelEwsFolder *ews_folder,
+			      const gchar *uid,
+			      const gchar *tmp_file,
+			      GError **error)
+{
+	gchar *cache_file;
+	gchar *dir;
+	gboolean success = TRUE;
+
+	g_rec_mutex_lock (&ews_folder->priv->cache_lock);
+
+	cache_file = ews_data_cache_get_filename (
+		ews_folder->cache, "cur", uid, error);
+	dir = g_path_get_dirname (cache_file);
+
+	if (g_mkdir_with_parents (dir, 0700) == -1) {
+		g_set_error (
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			_("Unable to create cache path “%s”: %s"),
+			dir, g_strerror (errno));
+		success = FALSE;
+	} else if (g_rename (tmp_file, cache_file) != 0) {
+		g_set_error (
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			/* Translators: The first %s consists of the source file name,
+			   the second %s of the destination file name and
+			   the third %s of the error message. */
+			_("Failed to move message cache file from “%s” to “%s”: %s"),
+			tmp_file, cache_file, g_strerror (errno));
+		success = FALSE;
+	}
+
+	g_rec_mutex_unlock (&ews_folder->priv->cache_lock);
+
+	g_free (dir);
+	g_free (cache_file);
+
+	return success;
+}
+
+/* Opens the body index, or creates it, when the folder is set to have one */
+static void
+ews_folder_open_index (CamelEwsFolder *ews_folder)
+{
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+
+	g_mutex_lock (&priv->index_lock);
+
+	if (!priv->index && priv->index_body && priv->index_path) {
+		priv->index = (CamelIndex *) camel_text_index_new (priv->index_path, O_CREAT | O_RDWR);
+
+		/* Likely corrupted, start from scratch */
+		if (!priv->index) {
+			camel_text_index_remove (priv->index_path);
+			priv->index = (CamelIndex *) camel_text_index_new (priv->index_path, O_CREAT | O_RDWR | O_TRUNC);
+		}
+
+		if (!priv->index)
+			g_warning ("%s: Failed to open body index '%s'", G_STRFUNC, priv->index_path);
+	}
+
+	g_mutex_unlock (&priv->index_lock);
+}
+
+static void
+ews_folder_index_content (CamelIndexName *idn,
+			  CamelDataWrapper *dw,
+			  GCancellable *cancellable)
+{
+	CamelContentType *ct;
+
+	if (CAMEL_IS_MULTIPART (dw)) {
+		guint ii, n_parts;
+
+		n_parts = camel_multipart_get_number (CAMEL_MULTIPART (dw));
+		for (ii = 0; ii < n_parts; ii++) {
+			CamelMimePart *part = camel_multipart_get_part (CAMEL_MULTIPART (dw), ii);
+
+			ews_folder_index_content (idn, camel_medium_get_content (CAMEL_MEDIUM (part)), cancellable);
+		}
+
+		return;
+	}
+
+	if (CAMEL_IS_MIME_MESSAGE (dw)) {
+		ews_folder_index_content (idn, camel_medium_get_content (CAMEL_MEDIUM (dw)), cancellable);
+		return;
+	}
+
+	ct = dw ? camel_data_wrapper_get_mime_type_field (dw) : NULL;
+
+	if (ct && camel_content_type_is (ct, "text", "*")) {
+		CamelStream *mem, *filtered;
+		CamelMimeFilter *filter;
+		GByteArray *bytes;
+		const gchar *charset;
+
+		bytes = g_byte_array_new ();
+		mem = camel_stream_mem_new_with_byte_array (bytes);
+		filtered = camel_stream_filter_new (mem);
+
+		charset = camel_content_type_param (ct, "charset");
+		if (charset && g_ascii_strcasecmp (charset, "utf-8") != 0 && g_ascii_strcasecmp (charset, "us-ascii") != 0) {
+			filter = camel_mime_filter_charset_new (charset, "UTF-8");
+			if (filter) {
+				camel_stream_filter_add (CAMEL_STREAM_FILTER (filtered), filter);
+				g_object_unref (filter);
+			}
+		}
+
+		if (camel_content_type_is (ct, "text", "html")) {
+			filter = camel_mime_filter_html_new ();
+			camel_stream_filter_add (CAMEL_STREAM_FILTER (filtered), filter);
+			g_object_unref (filter);
+		}
+
+		if (camel_data_wrapper_decode_to_stream_sync (dw, filtered, cancellable, NULL) != -1 &&
+		    camel_stream_flush (filtered, cancellable, NULL) != -1 &&
+		    bytes->len > 0)
+			camel_index_name_add_buffer (idn, (const gchar *) bytes->data, bytes->len);
+
+		g_object_unref (filtered);
+		g_object_unref (mem);
+	}
+}
+
+/* Adds the message text to the body index, replacing any previous content */
+static void
+ews_folder_index_message (CamelEwsFolder *ews_folder,
+			  const gchar *uid,
+			  CamelMimeMessage *message,
+			  GCancellable *cancellable)
+{
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+	CamelIndexName *idn;
+
+	g_mutex_lock (&priv->index_lock);
+
+	if (priv->index) {
+		if (camel_index_has_name (priv->index, uid))
+			camel_index_delete_name (priv->index, uid);
+
+		/* The message can add new words */
+		g_hash_table_remove_all (priv->index_words);
+
+		idn = camel_index_add_name (priv->index, uid);
+		if (idn) {
+			ews_folder_index_content (idn, CAMEL_DATA_WRAPPER (message), cancellable);
+
+			/* Flush the last word */
+			camel_index_name_add_buffer (idn, NULL, 0);
+			camel_index_write_name (priv->index, idn);
+			g_object_unref (idn);
+		}
+	}
+
+	g_mutex_unlock (&priv->index_lock);
+}
+
+/* Called when a search is finished */
+static void
+ews_folder_forget_index_words (CamelEwsFolder *ews_folder)
+{
+	g_mutex_lock (&ews_folder->priv->index_lock);
+	g_hash_table_remove_all (ews_folder->priv->index_words);
+	g_mutex_unlock (&ews_folder->priv->index_lock);
+}
+
+static void
+ews_folder_unindex_message (CamelEwsFolder *ews_folder,
+			    const gchar *uid)
+{
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+
+	g_mutex_lock (&priv->index_lock);
+
+	if (priv->index && camel_index_has_name (priv->index, uid))
+		camel_index_delete_name (priv->index, uid);
+
+	g_mutex_unlock (&priv->index_lock);
+}
+
+static void
+ews_folder_sync_index (CamelEwsFolder *ews_folder)
+{
+	g_mutex_lock (&ews_folder->priv->index_lock);
+
+	if (ews_folder->priv->index)
+		camel_index_sync (ews_folder->priv->index);
+
+	g_mutex_unlock (&ews_folder->priv->index_lock);
+}
+
 static CamelMimeMessage *
 camel_ews_folder_get_message (CamelFolder *folder,
                               const gchar *uid,
@@ -709,14 +911,12 @@ camel_ews_folder_get_message (CamelFolder *folder,
 	EEwsConnection *cnc = NULL;
 	EEwsAdditionalProps *add_props = NULL;
 	CamelEwsStore *ews_store;
-	const gchar *mime_content;
 	CamelMimeMessage *message = NULL;
+	CamelStream *cache_stream = NULL;
+	GIOStream *base_stream;
 	GSList *ids = NULL, *items = NULL;
-	gchar *mime_dir;
-	gchar *cache_file;
-	gchar *dir;
-	gboolean res;
-	gchar *mime_fname_new = NULL;
+	gchar *tmp_file = NULL;
+	gboolean res, resave = FALSE;
 	GError *local_error = NULL;
 
 	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (folder), NULL);
@@ -776,37 +976,34 @@ camel_ews_folder_get_message (CamelFolder *folder,
 	cnc = camel_ews_store_ref_connection (ews_store);
 	ids = g_slist_append (ids, (gchar *) uid);
 
-	mime_dir = g_build_filename (
-		camel_data_cache_get_path (ews_folder->cache),
-		"mimecontent", NULL);
-
-	if (g_access (mime_dir, F_OK) == -1 &&
-	    g_mkdir_with_parents (mime_dir, 0700) == -1) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			_("Unable to create cache path “%s”: %s"),
-			mime_dir, g_strerror (errno));
-		g_free (mime_dir);
+	/* The MIME content is decoded directly into a cache file, which is
+	 * moved into the "cur" cache path only when it is complete, thus
+	 * no partially downloaded message can be read from the cache. */
+	cache_stream = ews_data_cache_add (ews_folder->cache, "tmp", uid, error);
+	if (!cache_stream)
 		goto exit;
-	}
+
+	tmp_file = ews_data_cache_get_filename (ews_folder->cache, "tmp", uid, NULL);
 
 	add_props = e_ews_additional_props_new ();
 	add_props->field_uri = g_strdup ("item:MimeContent message:From message:Sender");
 	add_props->indexed_furis = g_slist_prepend (NULL, e_ews_indexed_field_uri_new ("item:InternetMessageHeader", "Date"));
 
-	res = e_ews_connection_get_items_sync (
+	base_stream = camel_stream_ref_base_stream (cache_stream);
+	res = e_ews_connection_get_items_to_stream_sync (
 		cnc, pri, ids, "IdOnly", add_props,
-		TRUE, mime_dir, E_EWS_BODY_TYPE_ANY,
+		g_io_stream_get_output_stream (base_stream),
+		E_EWS_BODY_TYPE_ANY,
 		&items,
 		(ESoapProgressFn) camel_operation_progress,
 		(gpointer) cancellable,
 		cancellable, &local_error);
+	g_object_unref (base_stream);
 	e_ews_additional_props_free (add_props);
 
 	if (!res || !items) {
 		camel_ews_store_maybe_disconnect (ews_store, local_error);
 		g_propagate_error (error, local_error);
-		g_free (mime_dir);
 		goto exit;
 	}
 
@@ -816,10 +1013,9 @@ camel_ews_folder_get_message (CamelFolder *folder,
 			items = NULL;
 			/* The server failed to convert message into the MimeContent;
 			   construct it from the properties. */
-			if (!ews_message_from_properties_sync (ews_folder, cnc, pri, ids, mime_dir, &items, cancellable, &local_error) || !items) {
+			if (!ews_message_from_properties_sync (ews_folder, cnc, pri, ids, cache_stream, &items, cancellable, &local_error) || !items) {
 				camel_ews_store_maybe_disconnect (ews_store, local_error);
 				g_propagate_error (error, local_error);
-				g_free (mime_dir);
 				goto exit;
 			}
 		}
@@ -829,23 +1025,31 @@ camel_ews_folder_get_message (CamelFolder *folder,
 			camel_ews_store_maybe_disconnect (ews_store, local_error);
 			if (local_error)
 				g_propagate_error (error, local_error);
-			g_free (mime_dir);
 			goto exit;
 		}
 	}
 
-	g_free (mime_dir);
+	/* Nothing received */
+	base_stream = camel_stream_ref_base_stream (cache_stream);
+	res = !G_IS_SEEKABLE (base_stream) || g_seekable_tell (G_SEEKABLE (base_stream)) > 0;
+	g_object_unref (base_stream);
+
+	if (!res)
+		goto exit;
+
+	/* Parse what had been just written, without reopening the file */
+	if (!ews_cache_stream_rewind (cache_stream, FALSE, cancellable, error))
+		goto exit;
 
-	/* The mime_content actually contains the *filename*, due to the
-	 * streaming hack in ESoapMessage */
-	mime_content = e_ews_item_get_mime_content (items->data);
-	if (!mime_content)
+	message = camel_mime_message_new ();
+	if (!camel_data_wrapper_construct_from_stream_sync (CAMEL_DATA_WRAPPER (message), cache_stream, cancellable, error)) {
+		g_clear_object (&message);
 		goto exit;
+	}
 
 	/* Exchange returns random UID for associated calendar item, which has no way
 	 * to match with calendar components saved in calendar cache. So manually get
-	 * AssociatedCalendarItemId, replace the random UID with this ItemId,
-	 * And save updated message data to a new temp file */
+	 * AssociatedCalendarItemId and replace the random UID with this ItemId */
 	if (e_ews_item_get_item_type (items->data) == E_EWS_ITEM_TYPE_MEETING_REQUEST ||
 		e_ews_item_get_item_type (items->data) == E_EWS_ITEM_TYPE_MEETING_CANCELLATION ||
 		e_ews_item_get_item_type (items->data) == E_EWS_ITEM_TYPE_MEETING_MESSAGE ||
@@ -877,6 +1081,7 @@ camel_ews_folder_get_message (CamelFolder *folder,
 				camel_ews_store_maybe_disconnect (ews_store, local_error);
 				g_propagate_error (error, local_error);
 			}
+			g_clear_object (&message);
 			goto exit;
 		}
 
@@ -888,9 +1093,10 @@ camel_ews_folder_get_message (CamelFolder *folder,
 			calendar_item_accept_id = e_ews_item_get_id (items->data);
 			is_calendar_UID = FALSE;
 		}
-		mime_fname_new = ews_update_mgtrequest_mime_calendar_itemid (mime_content, calendar_item_accept_id, is_calendar_UID, e_ews_item_get_id (items->data), error);
-		if (mime_fname_new)
-			mime_content = (const gchar *) mime_fname_new;
+
+		if (ews_update_mgtrequest_mime_calendar_itemid (message, calendar_item_accept_id, is_calendar_UID,
+		    e_ews_item_get_id (items->data), cancellable, NULL))
+			resave = TRUE;
 
 		if (items_req != NULL) {
 			g_object_unref (items_req->data);
@@ -898,108 +1104,30 @@ camel_ews_folder_get_message (CamelFolder *folder,
 		}
 	}
 
-	cache_file = ews_data_cache_get_filename (
-		ews_folder->cache, "cur", uid, error);
-	dir = g_path_get_dirname (cache_file);
+	if (ews_folder_apply_item_headers (message, items->data))
+		resave = TRUE;
 
-	if (g_mkdir_with_parents (dir, 0700) == -1) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			_("Unable to create cache path “%s”: %s"),
-			dir, g_strerror (errno));
-		g_free (dir);
-		g_free (cache_file);
+	/* All the changes are written at once; the stream is truncated first,
+	   in case the message will be shorter than the one received from the server */
+	if (resave && (
+	    !ews_cache_stream_rewind (cache_stream, TRUE, cancellable, error) ||
+	    camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (message), cache_stream, cancellable, error) == -1)) {
+		g_clear_object (&message);
 		goto exit;
 	}
-	g_free (dir);
 
-	if (g_rename (mime_content, cache_file) != 0) {
-		g_set_error (
-			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			/* Translators: The first %s consists of the source file name,
-			   the second %s of the destination file name and
-			   the third %s of the error message. */
-			_("Failed to move message cache file from “%s” to “%s”: %s"),
-			mime_content, cache_file, g_strerror (errno));
-		g_free (cache_file);
+	if (camel_stream_flush (cache_stream, cancellable, error) == -1 ||
+	    camel_stream_close (cache_stream, cancellable, error) == -1) {
+		g_clear_object (&message);
 		goto exit;
 	}
-	g_free (cache_file);
-
-	message = camel_ews_folder_get_message_from_cache (ews_folder, uid, cancellable, error);
-	if (message) {
-		CamelInternetAddress *from;
-		const gchar *email = NULL, *date_header;
-		gboolean resave = FALSE;
-
-		from = camel_mime_message_get_from (message);
-
-		if (!from || !camel_internet_address_get (from, 0, NULL, &email) || !email || !*email) {
-			const EwsMailbox *mailbox;
-
-			mailbox = e_ews_item_get_from (items->data);
-			if (!mailbox)
-				mailbox = e_ews_item_get_sender (items->data);
-			if (mailbox) {
-				email = NULL;
-
-				if (g_strcmp0 (mailbox->routing_type, "EX") == 0)
-					email = e_ews_item_util_strip_ex_address (mailbox->email);
-
-				from = camel_internet_address_new ();
-				camel_internet_address_add (from, mailbox->name, email ? email : mailbox->email);
-				camel_mime_message_set_from (message, from);
-				g_object_unref (from);
-
-				resave = TRUE;
-			}
-		}
-
-		date_header = e_ews_item_get_date_header (items->data);
-		if (date_header && *date_header) {
-			time_t tt;
-			gint tz_offset;
-
-			tt = camel_header_decode_date (date_header, &tz_offset);
-			if (tt > 0) {
-				camel_mime_message_set_date (message, tt, tz_offset);
-				resave = TRUE;
-			}
-		}
-
-		if (resave) {
-			CamelStream *cache_stream;
-
-			g_rec_mutex_lock (&priv->cache_lock);
-			/* Ignore errors here, it's nothing fatal in this case */
-			cache_stream = ews_data_cache_get (ews_folder->cache, "cur", uid, NULL);
-			if (cache_stream) {
-				GIOStream *iostream;
-
-				/* Truncate the stream first, in case the message will be shorter
-				   than the one received from the server */
-				iostream = camel_stream_ref_base_stream (cache_stream);
-				if (iostream) {
-					GOutputStream *output_stream;
-
-					output_stream = g_io_stream_get_output_stream (iostream);
-					if (G_IS_SEEKABLE (output_stream)) {
-						GSeekable *seekable = G_SEEKABLE (output_stream);
-
-						if (g_seekable_can_truncate (seekable)) {
-							g_seekable_truncate (seekable, 0, NULL, NULL);
-						}
-					}
 
-					g_object_unref (iostream);
-				}
+	g_clear_object (&cache_stream);
 
-				camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (message), cache_stream, cancellable, NULL);
-				g_object_unref (cache_stream);
-			}
-			g_rec_mutex_unlock (&priv->cache_lock);
-		}
-	}
+	/* Not indexed here, to not delay the message; that's done by the prefetch
+	   or by an offline search, see camel_ews_folder_search_body_index() */
+	if (!ews_folder_commit_cache_file (ews_folder, uid, tmp_file, error))
+		g_clear_object (&message);
 
 exit:
 	g_mutex_lock (&priv->state_lock);
@@ -1018,9 +1146,14 @@ exit:
 		g_slist_free (items);
 	}
 
-	if (mime_fname_new)
-		g_free (mime_fname_new);
-	g_object_unref (cnc);
+	if (cache_stream) {
+		camel_stream_close (cache_stream, NULL, NULL);
+		g_object_unref (cache_stream);
+	}
+	if (!message && tmp_file)
+		ews_data_cache_remove (ews_folder->cache, "tmp", uid, NULL);
+	g_free (tmp_file);
+	g_clear_object (&cnc);
 
 	return message;
 }
@@ -1066,34 +1199,484 @@ ews_folder_maybe_update_mlist (CamelFolder *folder,
 	g_clear_object (&mi);
 }
 
-static guint32
-ews_folder_get_permanent_flags (CamelFolder *folder)
-{
-	return CAMEL_MESSAGE_ANSWERED |
-		CAMEL_MESSAGE_DELETED |
-		CAMEL_MESSAGE_DRAFT |
-		CAMEL_MESSAGE_FLAGGED |
-		CAMEL_MESSAGE_SEEN |
-		CAMEL_MESSAGE_FORWARDED |
-		CAMEL_MESSAGE_USER;
-}
+/* Limits of one GetItem request of the offline prefetch */
+#define EWS_PREFETCH_BATCH_COUNT 25
+#define EWS_PREFETCH_BATCH_SIZE (4 * 1024 * 1024) /* In bytes, as reported by the summary */
 
-/* Get the message from cache if available otherwise get it from server */
-static CamelMimeMessage *
-ews_folder_get_message_sync (CamelFolder *folder,
-                             const gchar *uid,
-                             GCancellable *cancellable,
-                             GError **error)
+typedef struct _EwsPrefetchData {
+	CamelEwsFolder *ews_folder;
+	EEwsConnection *cnc;
+	GSList *batches; /* GSList * { gchar *uid }, not started yet */
+	guint max_count; /* items in a full batch */
+	guint n_running;
+	guint n_done;
+	guint n_total;
+	GCancellable *cancellable;
+	GError *error;
+} EwsPrefetchData;
+
+typedef struct _EwsPrefetchBatch {
+	EwsPrefetchData *pd;
+	GSList *uids; /* gchar *, also in the fetching_uids */
+	GHashTable *streams; /* gchar *uid ~> GMemoryOutputStream *, the received MimeContent */
+} EwsPrefetchBatch;
+
+/* Called from the thread, which processes the response; the batch is
+   not touched by the prefetch itself until the request is finished.
+   The content is kept in memory, bound by EWS_PREFETCH_BATCH_SIZE, and
+   written into the cache by the prefetching thread, not by this one */
+static GOutputStream *
+ews_folder_prefetch_stream_cb (const gchar *item_id,
+			       gpointer user_data)
 {
-	CamelMimeMessage *message;
+	EwsPrefetchBatch *batch = user_data;
+	GOutputStream *stream;
 
-	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (folder), NULL);
+	if (!g_slist_find_custom (batch->uids, item_id, (GCompareFunc) g_strcmp0))
+		return NULL;
 
-	message = camel_ews_folder_get_message (folder, uid, EWS_ITEM_HIGH, cancellable, error);
-	if (message)
-		ews_folder_maybe_update_mlist (folder, uid, message);
+	/* When the request is restarted, the previous content is dropped */
+	stream = g_memory_output_stream_new_resizable ();
 
-	return message;
+	g_hash_table_insert (batch->streams, g_strdup (item_id), stream);
+
+	return g_object_ref (stream);
+}
+
+static gboolean
+ews_folder_prefetch_store_item (EwsPrefetchBatch *batch,
+				EEwsItem *item,
+				GError **error)
+{
+	EwsPrefetchData *pd = batch->pd;
+	CamelEwsFolder *ews_folder = pd->ews_folder;
+	CamelMimeMessage *message;
+	CamelStream *mem_stream, *cache_stream;
+	GOutputStream *stream;
+	GByteArray *content;
+	const EwsId *id;
+	gchar *tmp_file;
+	gboolean success;
+
+	id = e_ews_item_get_id (item);
+	if (!id || !id->id)
+		return TRUE;
+
+	stream = g_hash_table_lookup (batch->streams, id->id);
+	if (!stream)
+		return TRUE;
+
+	/* Nothing received */
+	if (!g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)))
+		return TRUE;
+
+	if (!g_output_stream_close (stream, pd->cancellable, error))
+		return FALSE;
+
+	content = g_bytes_unref_to_array (g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream)));
+	g_hash_table_remove (batch->streams, id->id);
+
+	mem_stream = camel_stream_mem_new_with_byte_array (content);
+
+	message = camel_mime_message_new ();
+	success = camel_data_wrapper_construct_from_stream_sync (CAMEL_DATA_WRAPPER (message), mem_stream, pd->cancellable, error);
+
+	cache_stream = success ? ews_data_cache_add (ews_folder->cache, "tmp", id->id, error) : NULL;
+	success = cache_stream != NULL;
+
+	if (success && ews_folder_apply_item_headers (message, item)) {
+		success = camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (message), cache_stream, pd->cancellable, error) != -1;
+	} else if (success) {
+		/* Store the content as received */
+		success = camel_stream_write (cache_stream, (const gchar *) content->data, content->len, pd->cancellable, error) != -1;
+	}
+
+	if (cache_stream) {
+		success = success &&
+			camel_stream_flush (cache_stream, pd->cancellable, error) != -1 &&
+			camel_stream_close (cache_stream, pd->cancellable, error) != -1;
+
+		g_object_unref (cache_stream);
+
+		if (success) {
+			tmp_file = ews_data_cache_get_filename (ews_folder->cache, "tmp", id->id, NULL);
+			success = ews_folder_commit_cache_file (ews_folder, id->id, tmp_file, error);
+			g_free (tmp_file);
+		}
+
+		if (!success)
+			ews_data_cache_remove (ews_folder->cache, "tmp", id->id, NULL);
+	}
+
+	if (success)
+		ews_folder_index_message (ews_folder, id->id, message, pd->cancellable);
+
+	g_object_unref (message);
+	g_object_unref (mem_stream);
+
+	return success;
+}
+
+static void
+ews_folder_prefetch_batch_done (EwsPrefetchBatch *batch)
+{
+	CamelEwsFolderPrivate *priv = batch->pd->ews_folder->priv;
+	GSList *link;
+
+	/* Drop what had not been stored, like items with errors */
+	g_hash_table_destroy (batch->streams);
+
+	g_mutex_lock (&priv->state_lock);
+	for (link = batch->uids; link; link = g_slist_next (link)) {
+		g_hash_table_remove (priv->fetching_uids, link->data);
+	}
+	g_cond_broadcast (&priv->fetch_cond);
+	g_mutex_unlock (&priv->state_lock);
+
+	batch->pd->n_done += g_slist_length (batch->uids);
+	batch->pd->n_running--;
+
+	camel_operation_progress (batch->pd->cancellable, batch->pd->n_done * 100 / MAX (batch->pd->n_total, 1));
+
+	g_slist_free (batch->uids);
+	g_free (batch);
+}
+
+static void
+ews_folder_prefetch_items_cb (GObject *source_object,
+			      GAsyncResult *result,
+			      gpointer user_data)
+{
+	EwsPrefetchBatch *batch = user_data;
+	EwsPrefetchData *pd = batch->pd;
+	GSList *items = NULL, *link;
+	GError *local_error = NULL;
+
+	if (e_ews_connection_get_items_finish (E_EWS_CONNECTION (source_object), result, &items, &local_error)) {
+		for (link = items; link; link = g_slist_next (link)) {
+			EEwsItem *item = link->data;
+
+			GError *item_error = NULL;
+
+			/* Errors of single items are not fatal; such messages will be
+			   downloaded one by one, when being asked for */
+			if (!item || e_ews_item_get_item_type (item) == E_EWS_ITEM_TYPE_ERROR)
+				continue;
+
+			if (local_error)
+				continue;
+
+			if (!ews_folder_prefetch_store_item (batch, item, &item_error)) {
+				if (g_error_matches (item_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+					g_propagate_error (&local_error, item_error);
+				} else {
+					const EwsId *id = e_ews_item_get_id (item);
+
+					g_warning ("%s: Failed to store message '%s': %s", G_STRFUNC,
+						id ? id->id : "[null]", item_error ? item_error->message : "Unknown error");
+					g_clear_error (&item_error);
+				}
+			}
+		}
+	} else if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_ITEMNOTFOUND)) {
+		g_clear_error (&local_error);
+	}
+
+	g_slist_free_full (items, g_object_unref);
+
+	if (local_error && !pd->error)
+		g_propagate_error (&pd->error, local_error);
+	else
+		g_clear_error (&local_error);
+
+	ews_folder_prefetch_batch_done (batch);
+}
+
+static void
+ews_folder_prefetch_start_batch (EwsPrefetchData *pd)
+{
+	CamelEwsFolderPrivate *priv = pd->ews_folder->priv;
+	EwsPrefetchBatch *batch;
+	EEwsAdditionalProps *add_props;
+	GSList *uids, *link;
+
+	uids = pd->batches->data;
+	pd->batches = g_slist_remove (pd->batches, uids);
+
+	batch = g_new0 (EwsPrefetchBatch, 1);
+	batch->pd = pd;
+
+	/* Skip messages being downloaded by camel_ews_folder_get_message() */
+	g_mutex_lock (&priv->state_lock);
+	for (link = uids; link; link = g_slist_next (link)) {
+		gchar *uid = link->data;
+
+		if (!g_hash_table_lookup (priv->fetching_uids, uid)) {
+			g_hash_table_insert (priv->fetching_uids, uid, uid);
+			batch->uids = g_slist_prepend (batch->uids, uid);
+		} else {
+			pd->n_done++;
+		}
+	}
+	g_mutex_unlock (&priv->state_lock);
+
+	g_slist_free (uids);
+
+	if (!batch->uids) {
+		g_free (batch);
+		return;
+	}
+
+	batch->uids = g_slist_reverse (batch->uids);
+	batch->streams = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+	pd->n_running++;
+
+	add_props = e_ews_additional_props_new ();
+	add_props->field_uri = g_strdup ("item:MimeContent message:From message:Sender");
+	add_props->indexed_furis = g_slist_prepend (NULL, e_ews_indexed_field_uri_new ("item:InternetMessageHeader", "Date"));
+
+	e_ews_connection_get_items_to_streams (
+		pd->cnc, EWS_PRIORITY_LOW, batch->uids, "IdOnly", add_props,
+		ews_folder_prefetch_stream_cb, batch, pd->max_count, E_EWS_BODY_TYPE_ANY, NULL, NULL,
+		pd->cancellable, ews_folder_prefetch_items_cb, batch);
+
+	e_ews_additional_props_free (add_props);
+}
+
+/* Downloads messages of the given @uids into the cache. Several GetItem
+ * requests, each with multiple item IDs, are kept in flight; the MimeContent
+ * is decoded into memory and stored into the cache as each request finishes.
+ * Messages, which fail to be stored, are skipped. */
+static gboolean
+ews_folder_prefetch_messages_sync (CamelEwsFolder *ews_folder,
+				   EEwsConnection *cnc,
+				   GPtrArray *uids,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (ews_folder);
+	EwsPrefetchData pd;
+	GMainContext *main_context;
+	GSList *batch = NULL;
+	guint ii, batch_count = 0, max_running;
+	guint32 batch_size = 0;
+
+	memset (&pd, 0, sizeof (EwsPrefetchData));
+
+	pd.ews_folder = ews_folder;
+	pd.cnc = cnc;
+	pd.cancellable = cancellable;
+	pd.n_total = uids->len;
+
+	pd.max_count = e_ews_connection_get_batch_size (cnc, EWS_PREFETCH_BATCH_COUNT, EWS_PREFETCH_BATCH_COUNT * 4);
+
+	for (ii = 0; ii < uids->len; ii++) {
+		const gchar *uid = g_ptr_array_index (uids, ii);
+		CamelMessageInfo *mi;
+		guint32 size = 0;
+
+		mi = camel_folder_summary_get (camel_folder_get_folder_summary (folder), uid);
+		if (mi) {
+			gint32 item_type = camel_ews_message_info_get_item_type (CAMEL_EWS_MESSAGE_INFO (mi));
+
+			size = camel_message_info_get_size (mi);
+			g_object_unref (mi);
+
+			/* Meeting items need also their associated calendar item ID, thus
+			 * leave them to camel_ews_folder_get_message(), when being asked for */
+			if (item_type == E_EWS_ITEM_TYPE_MEETING_REQUEST ||
+			    item_type == E_EWS_ITEM_TYPE_MEETING_CANCELLATION ||
+			    item_type == E_EWS_ITEM_TYPE_MEETING_MESSAGE ||
+			    item_type == E_EWS_ITEM_TYPE_MEETING_RESPONSE) {
+				pd.n_total--;
+				continue;
+			}
+		}
+
+		if (batch && (batch_count >= pd.max_count ||
+		    batch_size + size > EWS_PREFETCH_BATCH_SIZE)) {
+			pd.batches = g_slist_prepend (pd.batches, g_slist_reverse (batch));
+			batch = NULL;
+			batch_count = 0;
+			batch_size = 0;
+		}
+
+		batch = g_slist_prepend (batch, (gpointer) uid);
+		batch_count++;
+		batch_size += size;
+	}
+
+	if (batch)
+		pd.batches = g_slist_prepend (pd.batches, g_slist_reverse (batch));
+
+	pd.batches = g_slist_reverse (pd.batches);
+
+	/* One more than the connection can run at once, thus its free
+	   slot is reused immediately after a response is received */
+	max_running = e_ews_connection_get_concurrent_connections (cnc) + 1;
+
+	/* The callbacks are called in this thread */
+	main_context = g_main_context_new ();
+	g_main_context_push_thread_default (main_context);
+
+	while (pd.batches || pd.n_running) {
+		while (pd.batches && pd.n_running < max_running &&
+		       !pd.error && !g_cancellable_is_cancelled (cancellable)) {
+			ews_folder_prefetch_start_batch (&pd);
+		}
+
+		if (pd.n_running) {
+			g_main_context_iteration (main_context, TRUE);
+		} else if (pd.error || g_cancellable_is_cancelled (cancellable)) {
+			g_slist_free_full (pd.batches, (GDestroyNotify) g_slist_free);
+			pd.batches = NULL;
+		}
+	}
+
+	g_main_context_pop_thread_default (main_context);
+	g_main_context_unref (main_context);
+
+	if (pd.error) {
+		g_propagate_error (error, pd.error);
+		return FALSE;
+	}
+
+	return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
+static gboolean
+ews_folder_downsync_sync (CamelOfflineFolder *offline_folder,
+			  const gchar *expression,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (offline_folder);
+	CamelEwsFolder *ews_folder = CAMEL_EWS_FOLDER (offline_folder);
+	CamelEwsStore *ews_store;
+	CamelSettings *settings;
+	EEwsConnection *cnc;
+	GPtrArray *uids, *uncached_uids;
+	gboolean limit_by_age = FALSE;
+	CamelTimeUnit limit_unit;
+	gint limit_value = 0;
+	time_t limit_time = 0;
+	gboolean success;
+	GError *local_error = NULL;
+
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (folder));
+
+	if (!camel_ews_store_connected (ews_store, cancellable, error))
+		return FALSE;
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (ews_store));
+
+	g_object_get (
+		settings,
+		"limit-by-age", &limit_by_age,
+		"limit-unit", &limit_unit,
+		"limit-value", &limit_value,
+		NULL);
+
+	g_clear_object (&settings);
+
+	if (limit_by_age)
+		limit_time = time (NULL) - camel_time_value_apply (0, limit_unit, limit_value);
+
+	if (expression)
+		uids = camel_folder_search_by_expression (folder, expression, cancellable, NULL);
+	else
+		uids = camel_folder_get_uids (folder);
+
+	if (!uids)
+		return TRUE;
+
+	uncached_uids = camel_folder_get_uncached_uids (folder, uids, NULL);
+
+	if (expression)
+		camel_folder_search_free (folder, uids);
+	else
+		camel_folder_free_uids (folder, uids);
+
+	if (!uncached_uids)
+		return TRUE;
+
+	if (limit_time > 0) {
+		CamelFolderSummary *summary = camel_folder_get_folder_summary (folder);
+		guint ii;
+
+		for (ii = uncached_uids->len; ii > 0; ii--) {
+			CamelMessageInfo *mi;
+			gboolean download = FALSE;
+
+			mi = camel_folder_summary_get (summary, g_ptr_array_index (uncached_uids, ii - 1));
+			if (mi) {
+				download = camel_message_info_get_date_sent (mi) > limit_time;
+				g_object_unref (mi);
+			}
+
+			if (!download) {
+				camel_pstring_free (g_ptr_array_index (uncached_uids, ii - 1));
+				g_ptr_array_remove_index (uncached_uids, ii - 1);
+			}
+		}
+	}
+
+	if (!uncached_uids->len) {
+		camel_folder_free_uids (folder, uncached_uids);
+		return TRUE;
+	}
+
+	camel_operation_push_message (cancellable, _("Downloading messages for offline use"));
+
+	cnc = camel_ews_store_ref_connection (ews_store);
+
+	success = ews_folder_prefetch_messages_sync (ews_folder, cnc, uncached_uids, cancellable, &local_error);
+
+	camel_operation_pop_message (cancellable);
+
+	if (!success) {
+		camel_ews_store_maybe_disconnect (ews_store, local_error);
+		g_propagate_error (error, local_error);
+	}
+
+	camel_folder_free_uids (folder, uncached_uids);
+	g_object_unref (cnc);
+
+	return success;
+}
+
+static guint32
+ews_folder_get_permanent_flags (CamelFolder *folder)
+{
+	return CAMEL_MESSAGE_ANSWERED |
+		CAMEL_MESSAGE_DELETED |
+		CAMEL_MESSAGE_DRAFT |
+		CAMEL_MESSAGE_FLAGGED |
+		CAMEL_MESSAGE_SEEN |
+		CAMEL_MESSAGE_FORWARDED |
+		CAMEL_MESSAGE_USER;
+}
+
+/* Get the message from cache if available otherwise get it from server */
+static CamelMimeMessage *
+ews_folder_get_message_sync (CamelFolder *folder,
+                             const gchar *uid,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	CamelMimeMessage *message;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (folder), NULL);
+
+	message = camel_ews_folder_get_message (folder, uid, EWS_PRIORITY_HIGH, cancellable, error);
+	if (message)
+		ews_folder_maybe_update_mlist (folder, uid, message);
+
+	camel_ews_store_note_folder_used (
+		CAMEL_EWS_STORE (camel_folder_get_parent_store (folder)),
+		camel_folder_get_full_name (folder));
+
+	return message;
 }
 
 static CamelMimeMessage *
@@ -1128,6 +1711,7 @@ ews_folder_search_by_expression (CamelFolder *folder,
 	matches = camel_folder_search_search (ews_folder->search, expression, NULL, cancellable, error);
 
 	camel_ews_search_set_cancellable_and_error (ews_search, NULL, NULL);
+	ews_folder_forget_index_words (ews_folder);
 
 	g_mutex_unlock (&priv->search_lock);
 
@@ -1158,6 +1742,7 @@ ews_folder_count_by_expression (CamelFolder *folder,
 	matches = camel_folder_search_count (ews_folder->search, expression, cancellable, error);
 
 	camel_ews_search_set_cancellable_and_error (ews_search, NULL, NULL);
+	ews_folder_forget_index_words (ews_folder);
 
 	g_mutex_unlock (&priv->search_lock);
 
@@ -1192,6 +1777,7 @@ ews_folder_search_by_uids (CamelFolder *folder,
 	matches = camel_folder_search_search (ews_folder->search, expression, uids, cancellable, error);
 
 	camel_ews_search_set_cancellable_and_error (ews_search, NULL, NULL);
+	ews_folder_forget_index_words (ews_folder);
 
 	g_mutex_unlock (&priv->search_lock);
 
@@ -1233,7 +1819,7 @@ msg_update_flags (ESoapMessage *msg,
 
 	for (iter = mi_list; iter; iter = g_slist_next (iter)) {
 		CamelFolderSummary *summary;
-		guint32 flags_changed, mi_flags;
+		guint32 flags_changed, mi_flags, categories_hash, followup_hash;
 		GSList *user_flags;
 
 		mi = iter->data;
@@ -1302,8 +1888,13 @@ msg_update_flags (ESoapMessage *msg,
 			e_ews_message_add_set_item_field_extended_tag_int (msg, NULL, "Message", 0x1080, icon);
 		}
 
-		/* now update the Categories */
-		user_flags = ews_utils_gather_server_user_flags (msg, mi);
+		/* now update the Categories, when they differ from the server */
+		categories_hash = ews_utils_hash_server_user_flags (mi);
+		if (categories_hash == camel_ews_message_info_get_server_categories_hash (emi))
+			user_flags = NULL;
+		else
+			user_flags = ews_utils_gather_server_user_flags (msg, mi);
+
 		if (user_flags) {
 			GSList *link;
 
@@ -1325,16 +1916,21 @@ msg_update_flags (ESoapMessage *msg,
 			e_soap_message_end_element (msg); /* Categories */
 			e_soap_message_end_element (msg); /* Message */
 			e_soap_message_end_element (msg); /* SetItemField */
-		} else {
+		} else if (categories_hash != camel_ews_message_info_get_server_categories_hash (emi)) {
 			e_ews_message_add_delete_item_field (msg, "Categories", "item");
 		}
 
 		g_slist_free_full (user_flags, g_free);
 
-		ews_utils_update_followup_flags (msg, mi);
+		followup_hash = ews_utils_hash_followup_flags (mi);
+		if (followup_hash != camel_ews_message_info_get_server_follow_up_hash (emi))
+			ews_utils_update_followup_flags (msg, mi);
 
 		e_ews_message_end_item_change (msg);
 
+		/* Reset by ews_flags_mark_unsaved() when the item fails to be saved */
+		camel_ews_message_info_set_server_categories_hash (emi, categories_hash);
+		camel_ews_message_info_set_server_follow_up_hash (emi, followup_hash);
 		camel_message_info_set_folder_flagged (mi, FALSE);
 
 		camel_message_info_property_unlock (mi);
@@ -1377,21 +1973,388 @@ ews_suppress_read_receipt (ESoapMessage *msg,
 		e_soap_message_end_element (msg); /* "ReferenceItemId" */
 		e_soap_message_end_element (msg); /* SuppressReadReceipt */
 
-		camel_message_info_set_flags (mi, CAMEL_EWS_MESSAGE_MSGFLAG_RN_PENDING, 0);
+		camel_message_info_set_flags (mi, CAMEL_EWS_MESSAGE_MSGFLAG_RN_PENDING, 0);
+
+		if (!camel_message_info_get_user_flag (mi, "receipt-handled"))
+			camel_message_info_set_user_flag (mi, "receipt-handled", TRUE);
+
+		camel_message_info_thaw_notifications (mi);
+		camel_message_info_property_unlock (mi);
+		if (summary)
+			camel_folder_summary_unlock (summary);
+		g_clear_object (&summary);
+	}
+
+	return TRUE;
+}
+
+/* Saves the folder summary and the store summary, with the given number of
+   changes since the last call. Unless forced, the save is skipped when
+   the last one was recently and not many changes were made since then;
+   the pending changes are saved by a later call, which should be forced
+   at the end of the operation, even when it failed or was cancelled. */
+static void
+ews_folder_save_summaries (CamelEwsFolder *ews_folder,
+			   guint n_changes,
+			   gboolean force)
+{
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+	CamelEwsStore *ews_store;
+	gint64 now = g_get_monotonic_time ();
+	gboolean save;
+
+	g_mutex_lock (&priv->save_lock);
+
+	priv->save_pending_changes += n_changes;
+
+	save = force ||
+		priv->save_pending_changes >= EWS_SUMMARY_SAVE_CHANGES ||
+		now - priv->save_last_time >= EWS_SUMMARY_SAVE_INTERVAL * G_USEC_PER_SEC;
+
+	if (save) {
+		priv->save_last_time = now;
+		priv->save_pending_changes = 0;
+	} else {
+		priv->save_avoided++;
+	}
+
+	g_mutex_unlock (&priv->save_lock);
+
+	if (!save)
+		return;
+
+	camel_folder_summary_save (camel_folder_get_folder_summary (CAMEL_FOLDER (ews_folder)), NULL);
+	ews_folder_sync_index (ews_folder);
+
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (CAMEL_FOLDER (ews_folder)));
+	if (ews_store && ews_store->summary)
+		camel_ews_store_summary_save (ews_store->summary, NULL);
+
+	d (printf ("%s: Saved summaries of '%s', %u saves avoided so far\n", G_STRFUNC,
+		camel_folder_get_full_name (CAMEL_FOLDER (ews_folder)), camel_ews_folder_get_summary_saves_avoided (ews_folder)));
+}
+
+/* Returns how many summary saves were skipped, being coalesced with later saves */
+guint
+camel_ews_folder_get_summary_saves_avoided (CamelEwsFolder *ews_folder)
+{
+	guint avoided;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder), 0);
+
+	g_mutex_lock (&ews_folder->priv->save_lock);
+	avoided = ews_folder->priv->save_avoided;
+	g_mutex_unlock (&ews_folder->priv->save_lock);
+
+	return avoided;
+}
+
+gboolean
+camel_ews_folder_get_index_body (CamelEwsFolder *ews_folder)
+{
+	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder), FALSE);
+
+	return ews_folder->priv->index_body;
+}
+
+void
+camel_ews_folder_set_index_body (CamelEwsFolder *ews_folder,
+				 gboolean index_body)
+{
+	CamelEwsFolderPrivate *priv;
+
+	g_return_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder));
+
+	priv = ews_folder->priv;
+
+	if (!priv->index_body == !index_body)
+		return;
+
+	priv->index_body = index_body;
+
+	if (index_body) {
+		ews_folder_open_index (ews_folder);
+	} else {
+		g_mutex_lock (&priv->index_lock);
+		if (priv->index) {
+			g_clear_object (&priv->index);
+			camel_text_index_remove (priv->index_path);
+		}
+		g_hash_table_remove_all (priv->index_words);
+		g_mutex_unlock (&priv->index_lock);
+	}
+
+	g_object_notify (G_OBJECT (ews_folder), "index-body");
+}
+
+/* The most items sent in one UpdateItem request, when the server is fast */
+#define EWS_UPDATE_FLAGS_MAX_BATCH 500
+
+typedef struct _EwsFlagsData {
+	CamelEwsFolder *ews_folder;
+	EEwsConnection *cnc;
+	GCancellable *cancellable;
+
+	GSList *batches; /* GPtrArray * of CamelMessageInfo *, not sent yet */
+	guint n_running;
+	GPtrArray *conflicts; /* CamelMessageInfo *, changed on the server meanwhile */
+	GError *error;
+} EwsFlagsData;
+
+typedef struct _EwsFlagsBatch {
+	EwsFlagsData *fd;
+	GPtrArray *mis; /* CamelMessageInfo *, referenced */
+} EwsFlagsBatch;
+
+static gboolean
+ews_flags_is_conflict_error (const GError *error)
+{
+	return g_error_matches (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_IRRESOLVABLECONFLICT) ||
+		g_error_matches (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_STALEOBJECT) ||
+		g_error_matches (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_INVALIDCHANGEKEY);
+}
+
+/* Whether msg_update_flags() would write anything for the @mi */
+static gboolean
+ews_flags_has_changes (CamelMessageInfo *mi)
+{
+	CamelEwsMessageInfo *emi = CAMEL_EWS_MESSAGE_INFO (mi);
+	guint32 flags_changed;
+
+	flags_changed = camel_ews_message_info_get_server_flags (emi) ^ camel_message_info_get_flags (mi);
+
+	return (flags_changed & (CAMEL_MESSAGE_FLAGGED | CAMEL_MESSAGE_SEEN | CAMEL_MESSAGE_ANSWERED | CAMEL_MESSAGE_FORWARDED)) != 0 ||
+		ews_utils_hash_server_user_flags (mi) != camel_ews_message_info_get_server_categories_hash (emi) ||
+		ews_utils_hash_followup_flags (mi) != camel_ews_message_info_get_server_follow_up_hash (emi);
+}
+
+/* The item was not saved, thus write all of it with the next synchronization */
+static void
+ews_flags_mark_unsaved (CamelMessageInfo *mi)
+{
+	camel_ews_message_info_set_server_categories_hash (CAMEL_EWS_MESSAGE_INFO (mi), 0);
+	camel_ews_message_info_set_server_follow_up_hash (CAMEL_EWS_MESSAGE_INFO (mi), 0);
+	camel_message_info_set_folder_flagged (mi, TRUE);
+}
+
+/* Stores the change keys of the items returned by UpdateItem, or marks
+   the failed items as changed again and collects those which conflict
+   with changes on the server. The @items correspond to the @mis in the order. */
+static void
+ews_flags_process_update_result (GPtrArray *mis,
+				 GSList *items,
+				 GPtrArray *conflicts)
+{
+	GSList *link;
+	guint ii;
+
+	for (ii = 0, link = items; ii < mis->len && link; ii++, link = g_slist_next (link)) {
+		CamelMessageInfo *mi = g_ptr_array_index (mis, ii);
+		EEwsItem *item = link->data;
+
+		if (!item)
+			continue;
+
+		if (e_ews_item_get_item_type (item) == E_EWS_ITEM_TYPE_ERROR) {
+			/* Not saved, try again later */
+			ews_flags_mark_unsaved (mi);
+
+			if (conflicts && ews_flags_is_conflict_error (e_ews_item_get_error (item)))
+				g_ptr_array_add (conflicts, g_object_ref (mi));
+		} else {
+			const EwsId *id = e_ews_item_get_id (item);
+
+			if (id && id->change_key)
+				camel_ews_message_info_set_change_key (CAMEL_EWS_MESSAGE_INFO (mi), id->change_key);
+		}
+	}
+}
+
+/* The callback writes the whole list, thus pass it as a GSList */
+static GSList *
+ews_flags_mis_to_slist (GPtrArray *mis)
+{
+	GSList *mi_list = NULL;
+	guint ii;
+
+	for (ii = mis->len; ii > 0; ii--) {
+		mi_list = g_slist_prepend (mi_list, g_ptr_array_index (mis, ii - 1));
+	}
+
+	return mi_list;
+}
+
+static void
+ews_flags_batch_updated_cb (GObject *source_object,
+			    GAsyncResult *result,
+			    gpointer user_data)
+{
+	EwsFlagsBatch *batch = user_data;
+	EwsFlagsData *fd = batch->fd;
+	GSList *items = NULL;
+	GError *local_error = NULL;
+
+	if (e_ews_connection_update_items_finish (fd->cnc, result, &items, &local_error)) {
+		ews_flags_process_update_result (batch->mis, items, fd->conflicts);
+	} else {
+		guint ii;
+
+		for (ii = 0; ii < batch->mis->len; ii++) {
+			ews_flags_mark_unsaved (g_ptr_array_index (batch->mis, ii));
+		}
+
+		if (batch->mis->len == 1 && ews_flags_is_conflict_error (local_error)) {
+			/* A single item error is returned as the operation error */
+			g_ptr_array_add (fd->conflicts, g_object_ref (g_ptr_array_index (batch->mis, 0)));
+			g_clear_error (&local_error);
+		}
+	}
+
+	if (local_error) {
+		if (!fd->error)
+			fd->error = local_error;
+		else
+			g_clear_error (&local_error);
+	}
+
+	ews_folder_save_summaries (fd->ews_folder, batch->mis->len, FALSE);
+
+	g_slist_free_full (items, g_object_unref);
+	g_ptr_array_unref (batch->mis);
+	g_free (batch);
+
+	fd->n_running--;
+}
+
+static void
+ews_flags_start_batch (EwsFlagsData *fd)
+{
+	EwsFlagsBatch *batch;
+	GSList *mi_list;
+
+	batch = g_new0 (EwsFlagsBatch, 1);
+	batch->fd = fd;
+	batch->mis = fd->batches->data;
+
+	fd->batches = g_slist_delete_link (fd->batches, fd->batches);
+	fd->n_running++;
+
+	/* The request is composed before the function returns */
+	mi_list = ews_flags_mis_to_slist (batch->mis);
+
+	e_ews_connection_update_items (
+		fd->cnc, EWS_PRIORITY_LOW,
+		"AlwaysOverwrite", "SaveOnly",
+		NULL, NULL,
+		msg_update_flags, mi_list,
+		fd->cancellable,
+		ews_flags_batch_updated_cb, batch);
+
+	g_slist_free (mi_list);
+}
+
+/* Reads current change keys of the conflicting items in bulk and saves
+   their flags once more; those which still fail are left for the next
+   synchronization. */
+static gboolean
+ews_flags_resolve_conflicts_sync (EwsFlagsData *fd,
+				  guint batch_size,
+				  GError **error)
+{
+	GPtrArray *conflicts = fd->conflicts;
+	GHashTable *by_uid;
+	guint ii, from;
+	gboolean success = TRUE;
+
+	by_uid = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (from = 0; success && from < conflicts->len; from += batch_size) {
+		GSList *ids = NULL, *items = NULL, *link;
+		GPtrArray *mis;
+
+		g_hash_table_remove_all (by_uid);
+
+		for (ii = from; ii < conflicts->len && ii < from + batch_size; ii++) {
+			CamelMessageInfo *mi = g_ptr_array_index (conflicts, ii);
+
+			g_hash_table_insert (by_uid, (gpointer) camel_message_info_get_uid (mi), mi);
+			ids = g_slist_prepend (ids, (gpointer) camel_message_info_get_uid (mi));
+		}
+
+		success = e_ews_connection_get_items_sync (
+			fd->cnc, EWS_PRIORITY_LOW, ids, "IdOnly", NULL,
+			FALSE, NULL, E_EWS_BODY_TYPE_ANY, &items, NULL, NULL,
+			fd->cancellable, error);
+
+		g_slist_free (ids);
+
+		if (!success)
+			break;
+
+		mis = g_ptr_array_new_with_free_func (g_object_unref);
+
+		for (link = items; link; link = g_slist_next (link)) {
+			EEwsItem *item = link->data;
+			const EwsId *id;
+			CamelMessageInfo *mi;
+
+			if (!item || e_ews_item_get_item_type (item) == E_EWS_ITEM_TYPE_ERROR)
+				continue;
+
+			id = e_ews_item_get_id (item);
+			mi = id ? g_hash_table_lookup (by_uid, id->id) : NULL;
+			if (!mi)
+				continue;
+
+			camel_ews_message_info_set_change_key (CAMEL_EWS_MESSAGE_INFO (mi), id->change_key);
+			g_ptr_array_add (mis, g_object_ref (mi));
+		}
+
+		g_slist_free_full (items, g_object_unref);
+
+		if (mis->len) {
+			GSList *mi_list;
+
+			mi_list = ews_flags_mis_to_slist (mis);
+			items = NULL;
+
+			success = e_ews_connection_update_items_sync (
+				fd->cnc, EWS_PRIORITY_LOW,
+				"AlwaysOverwrite", "SaveOnly",
+				NULL, NULL,
+				msg_update_flags, mi_list, &items,
+				fd->cancellable, error);
+
+			if (success) {
+				ews_flags_process_update_result (mis, items, NULL);
+			} else {
+				/* Left for the next synchronization */
+				for (ii = 0; ii < mis->len; ii++) {
+					ews_flags_mark_unsaved (g_ptr_array_index (mis, ii));
+				}
+
+				if (mis->len == 1 && error && ews_flags_is_conflict_error (*error)) {
+					g_clear_error (error);
+					success = TRUE;
+				}
+			}
 
-		if (!camel_message_info_get_user_flag (mi, "receipt-handled"))
-			camel_message_info_set_user_flag (mi, "receipt-handled", TRUE);
+			g_slist_free_full (items, g_object_unref);
+			g_slist_free (mi_list);
+		}
 
-		camel_message_info_thaw_notifications (mi);
-		camel_message_info_property_unlock (mi);
-		if (summary)
-			camel_folder_summary_unlock (summary);
-		g_clear_object (&summary);
+		g_ptr_array_unref (mis);
 	}
 
-	return TRUE;
+	g_hash_table_destroy (by_uid);
+
+	return success;
 }
 
+/* Saves the flags, the categories and the follow-up flags of all the messages
+   in @mi_list to the server. Each message is written once, with only the changed
+   fields, and the requests run concurrently, in batches, which grow with
+   the responsiveness of the server. */
 static gboolean
 ews_sync_mi_flags (CamelFolder *folder,
                    const GSList *mi_list,
@@ -1400,8 +2363,12 @@ ews_sync_mi_flags (CamelFolder *folder,
 {
 	CamelEwsStore *ews_store;
 	EEwsConnection *cnc;
+	EwsFlagsData fd;
+	GMainContext *main_context;
+	GPtrArray *batch = NULL, *receipts;
 	const GSList *iter;
 	GError *local_error = NULL;
+	guint batch_size, max_running, ii;
 	gboolean res = TRUE;
 
 	ews_store = (CamelEwsStore *) camel_folder_get_parent_store (folder);
@@ -1412,24 +2379,33 @@ ews_sync_mi_flags (CamelFolder *folder,
 
 	cnc = camel_ews_store_ref_connection (ews_store);
 
+	batch_size = e_ews_connection_get_batch_size (cnc, EWS_MAX_FETCH_COUNT, EWS_UPDATE_FLAGS_MAX_BATCH);
+
+	receipts = g_ptr_array_new ();
+
 	for (iter = mi_list; iter; iter = g_slist_next (iter)) {
 		CamelMessageInfo *mi = iter->data;
 
 		if (mi && (camel_message_info_get_flags (mi) & CAMEL_EWS_MESSAGE_MSGFLAG_RN_PENDING) != 0)
-			break;
+			g_ptr_array_add (receipts, mi);
 	}
 
-	/* NULL means all had been checked and none has the flag set */
-	if (iter) {
-		GSList *ids = NULL;
+	for (ii = 0; res && ii < receipts->len; ii += batch_size) {
+		GSList *receipts_list = NULL, *ids = NULL;
+		guint jj;
+
+		for (jj = MIN (ii + batch_size, receipts->len); jj > ii; jj--) {
+			receipts_list = g_slist_prepend (receipts_list, g_ptr_array_index (receipts, jj - 1));
+		}
 
 		res = e_ews_connection_create_items_sync (
 			cnc, EWS_PRIORITY_LOW,
 			"SaveOnly", NULL, NULL,
-			ews_suppress_read_receipt, (gpointer) mi_list,
+			ews_suppress_read_receipt, receipts_list,
 			&ids, cancellable, &local_error);
 
 		g_slist_free_full (ids, g_object_unref);
+		g_slist_free (receipts_list);
 
 		/* ignore this error, it's not a big problem */
 		if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_READRECEIPTNOTPENDING)) {
@@ -1438,16 +2414,81 @@ ews_sync_mi_flags (CamelFolder *folder,
 		}
 	}
 
-	if (res) {
-		res = e_ews_connection_update_items_sync (
-			cnc, EWS_PRIORITY_LOW,
-			"AlwaysOverwrite", "SaveOnly",
-			NULL, NULL,
-			msg_update_flags, (gpointer) mi_list, NULL,
-			cancellable, &local_error);
+	g_ptr_array_free (receipts, TRUE);
+
+	memset (&fd, 0, sizeof (EwsFlagsData));
+	fd.ews_folder = CAMEL_EWS_FOLDER (folder);
+	fd.cnc = cnc;
+	fd.cancellable = cancellable;
+	fd.conflicts = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (iter = mi_list; res && iter; iter = g_slist_next (iter)) {
+		CamelMessageInfo *mi = iter->data;
+
+		if (!mi)
+			continue;
+
+		/* Like changed and changed back, or only the read receipt was pending */
+		if (!ews_flags_has_changes (mi)) {
+			camel_message_info_set_folder_flagged (mi, FALSE);
+			continue;
+		}
+
+		if (!batch)
+			batch = g_ptr_array_new_with_free_func (g_object_unref);
+
+		g_ptr_array_add (batch, g_object_ref (mi));
+
+		if (batch->len >= batch_size) {
+			fd.batches = g_slist_prepend (fd.batches, batch);
+			batch = NULL;
+		}
+	}
+
+	if (batch)
+		fd.batches = g_slist_prepend (fd.batches, batch);
+
+	fd.batches = g_slist_reverse (fd.batches);
+
+	/* One more than the connection can run at once, thus its free
+	   slot is reused immediately after a response is received */
+	max_running = e_ews_connection_get_concurrent_connections (cnc) + 1;
+
+	/* The callbacks are called in this thread */
+	main_context = g_main_context_new ();
+	g_main_context_push_thread_default (main_context);
+
+	while (fd.batches || fd.n_running) {
+		while (fd.batches && fd.n_running < max_running &&
+		       !fd.error && !g_cancellable_is_cancelled (cancellable)) {
+			ews_flags_start_batch (&fd);
+		}
+
+		if (fd.n_running) {
+			g_main_context_iteration (main_context, TRUE);
+		} else if (fd.error || g_cancellable_is_cancelled (cancellable)) {
+			g_slist_free_full (fd.batches, (GDestroyNotify) g_ptr_array_unref);
+			fd.batches = NULL;
+		}
+	}
+
+	g_main_context_pop_thread_default (main_context);
+	g_main_context_unref (main_context);
+
+	if (fd.error) {
+		res = FALSE;
+		if (!local_error)
+			local_error = fd.error;
+		else
+			g_clear_error (&fd.error);
 	}
 
-	camel_folder_summary_save (camel_folder_get_folder_summary (folder), NULL);
+	if (res && fd.conflicts->len > 0 && !g_cancellable_is_cancelled (cancellable))
+		res = ews_flags_resolve_conflicts_sync (&fd, batch_size, &local_error);
+
+	g_ptr_array_unref (fd.conflicts);
+
+	ews_folder_save_summaries (CAMEL_EWS_FOLDER (folder), 0, FALSE);
 
 	if (local_error) {
 		camel_ews_store_maybe_disconnect (ews_store, local_error);
@@ -1577,7 +2618,7 @@ ews_move_to_special_folder (CamelFolder *folder,
 
 				camel_folder_change_info_remove_uid (changes, uid);
 				camel_folder_summary_remove_uid (camel_folder_get_folder_summary (folder), uid);
-				ews_data_cache_remove (ews_folder->cache, "cur", uid, NULL);
+				camel_ews_folder_remove_cached_message (ews_folder, uid);
 
 				camel_folder_summary_unlock (camel_folder_get_folder_summary (folder));
 			}
@@ -1613,7 +2654,6 @@ ews_synchronize_sync (CamelFolder *folder,
 	CamelFolderSummary *folder_summary;
 	GPtrArray *uids;
 	GSList *mi_list = NULL, *deleted_uids = NULL, *junk_uids = NULL, *inbox_uids = NULL;
-	gint mi_list_len = 0;
 	gboolean is_junk_folder;
 	gboolean success = TRUE;
 	gint i;
@@ -1654,7 +2694,6 @@ ews_synchronize_sync (CamelFolder *folder,
 		if ((flags_set & CAMEL_MESSAGE_FOLDER_FLAGGED) != 0 &&
 		    (flags_changed & (CAMEL_MESSAGE_SEEN | CAMEL_MESSAGE_ANSWERED | CAMEL_MESSAGE_FORWARDED | CAMEL_MESSAGE_FLAGGED)) != 0) {
 			mi_list = g_slist_prepend (mi_list, mi);
-			mi_list_len++;
 
 			if (flags_set & CAMEL_MESSAGE_DELETED)
 				deleted_uids = g_slist_prepend (deleted_uids, (gpointer) camel_pstring_strdup (uids->pdata[i]));
@@ -1672,21 +2711,16 @@ ews_synchronize_sync (CamelFolder *folder,
 			inbox_uids = g_slist_prepend (inbox_uids, (gpointer) camel_pstring_strdup (uids->pdata[i]));
 			g_clear_object (&mi);
 		} else if ((flags_set & CAMEL_MESSAGE_FOLDER_FLAGGED) != 0) {
-			/* OK, the change must have been the labels */
+			/* OK, the change must have been the labels; those which
+			   match the server are skipped by ews_sync_mi_flags() */
 			mi_list = g_slist_prepend (mi_list, mi);
-			mi_list_len++;
 		} else {
 			g_clear_object (&mi);
 		}
-
-		if (mi_list_len == EWS_MAX_FETCH_COUNT) {
-			success = ews_save_flags (folder, mi_list, cancellable, &local_error);
-			g_slist_free_full (mi_list, g_object_unref);
-			mi_list = NULL;
-			mi_list_len = 0;
-		}
 	}
 
+	/* All at once, the function splits them into batches */
+	mi_list = g_slist_reverse (mi_list);
 	if (mi_list != NULL && success)
 		success = ews_save_flags (folder, mi_list, cancellable, &local_error);
 	g_slist_free_full (mi_list, g_object_unref);
@@ -1703,7 +2737,7 @@ ews_synchronize_sync (CamelFolder *folder,
 		success = ews_move_to_special_folder (folder, inbox_uids, CAMEL_FOLDER_TYPE_INBOX, cancellable, &local_error);
 	g_slist_free_full (inbox_uids, (GDestroyNotify) camel_pstring_free);
 
-	camel_folder_summary_save (folder_summary, NULL);
+	ews_folder_save_summaries (CAMEL_EWS_FOLDER (folder), 0, TRUE);
 	camel_folder_summary_free_array (uids);
 
 	if (local_error)
@@ -1843,6 +2877,10 @@ camel_ews_folder_new (CamelStore *store,
 		return NULL;
 	}
 
+	/* The index-body property is already read from the state file */
+	ews_folder->priv->index_path = g_build_filename (folder_dir, "body.ibex", NULL);
+	ews_folder_open_index (ews_folder);
+
 	if (camel_offline_folder_can_downsync (CAMEL_OFFLINE_FOLDER (folder))) {
 		time_t when = (time_t) 0;
 
@@ -2031,24 +3069,385 @@ camel_ews_folder_remove_cached_message (CamelEwsFolder *ews_folder,
 	g_return_if_fail (uid != NULL);
 
 	ews_data_cache_remove (ews_folder->cache, "cur", uid, NULL);
+	ews_folder_unindex_message (ews_folder, uid);
+}
+
+/* Makes sure the index_words contain all the words, walking the index words
+   only once for those not expanded yet; called with the index_lock held */
+static gboolean
+ews_folder_expand_index_words_locked (CamelEwsFolder *ews_folder,
+				      const GPtrArray *words,
+				      GCancellable *cancellable)
+{
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+	CamelIndexCursor *words_cursor;
+	GPtrArray *missing;
+	const gchar *index_word;
+	gboolean success;
+	guint ii;
+
+	missing = g_ptr_array_new ();
+
+	for (ii = 0; ii < words->len; ii++) {
+		const gchar *word = g_ptr_array_index (words, ii);
+
+		if (!g_hash_table_contains (priv->index_words, word)) {
+			g_hash_table_insert (priv->index_words, g_strdup (word), g_ptr_array_new_with_free_func (g_free));
+			g_ptr_array_add (missing, (gpointer) word);
+		}
+	}
+
+	if (!missing->len) {
+		g_ptr_array_unref (missing);
+		return TRUE;
+	}
+
+	words_cursor = camel_index_words (priv->index);
+
+	while (words_cursor && (index_word = camel_index_cursor_next (words_cursor)) != NULL &&
+	       !g_cancellable_is_cancelled (cancellable)) {
+		for (ii = 0; ii < missing->len; ii++) {
+			const gchar *word = g_ptr_array_index (missing, ii);
+
+			if (camel_ustrstrcase (index_word, word))
+				g_ptr_array_add (g_hash_table_lookup (priv->index_words, word), g_strdup (index_word));
+		}
+	}
+
+	g_clear_object (&words_cursor);
+
+	/* Do not keep incomplete expansions */
+	success = !g_cancellable_is_cancelled (cancellable);
+	if (!success) {
+		for (ii = 0; ii < missing->len; ii++) {
+			g_hash_table_remove (priv->index_words, g_ptr_array_index (missing, ii));
+		}
+	}
+
+	g_ptr_array_unref (missing);
+
+	return success;
+}
+
+/* Looks up the words in the body index for the given uids. Returns NULL
+   when the folder has no body index, otherwise an array of the matching
+   uids, as camel_pstring-s. The uids which cannot be answered from the index,
+   because their message is not cached or not indexed, are added to
+   the unindexed_uids. Cached messages, which are not indexed yet, are
+   indexed first, up to the max_to_index count, or all of them when it is
+   negative. Like in camel-folder-search, a word matches any indexed word
+   which contains it, case insensitively. The index words are expanded
+   only once per search, because the search can be run for each message. */
+GPtrArray *
+camel_ews_folder_search_body_index (CamelEwsFolder *ews_folder,
+				    const GPtrArray *words,
+				    const GPtrArray *uids,
+				    gint max_to_index,
+				    GPtrArray *unindexed_uids,
+				    GCancellable *cancellable)
+{
+	CamelEwsFolderPrivate *priv;
+	GHashTable *matches = NULL;
+	GPtrArray *result;
+	guint ii, jj;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder), NULL);
+	g_return_val_if_fail (words != NULL, NULL);
+	g_return_val_if_fail (uids != NULL, NULL);
+	g_return_val_if_fail (unindexed_uids != NULL, NULL);
+
+	priv = ews_folder->priv;
+
+	g_mutex_lock (&priv->index_lock);
+	if (!priv->index) {
+		g_mutex_unlock (&priv->index_lock);
+		return NULL;
+	}
+	g_mutex_unlock (&priv->index_lock);
+
+	result = g_ptr_array_new ();
+
+	/* Uids to be answered by the index */
+	matches = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (ii = 0; ii < uids->len; ii++) {
+		const gchar *uid = g_ptr_array_index (uids, ii);
+		gchar *cache_file;
+		gboolean indexed, cached;
+
+		g_mutex_lock (&priv->index_lock);
+		indexed = priv->index && camel_index_has_name (priv->index, uid);
+		g_mutex_unlock (&priv->index_lock);
+
+		g_rec_mutex_lock (&priv->cache_lock);
+		cache_file = ews_data_cache_get_filename (ews_folder->cache, "cur", uid, NULL);
+		cached = cache_file && g_file_test (cache_file, G_FILE_TEST_IS_REGULAR);
+		g_rec_mutex_unlock (&priv->cache_lock);
+		g_free (cache_file);
+
+		if (cached && !indexed && max_to_index != 0 &&
+		    !g_cancellable_is_cancelled (cancellable)) {
+			CamelMimeMessage *message;
+
+			message = camel_ews_folder_get_message_from_cache (ews_folder, uid, cancellable, NULL);
+			if (message) {
+				ews_folder_index_message (ews_folder, uid, message, cancellable);
+				g_object_unref (message);
+
+				indexed = TRUE;
+				if (max_to_index > 0)
+					max_to_index--;
+			}
+		}
+
+		if (cached && indexed)
+			g_hash_table_add (matches, (gpointer) uid);
+		else
+			g_ptr_array_add (unindexed_uids, (gpointer) uid);
+	}
+
+	g_mutex_lock (&priv->index_lock);
+
+	if (priv->index && g_hash_table_size (matches) > 0 &&
+	    ews_folder_expand_index_words_locked (ews_folder, words, cancellable)) {
+		GHashTable **found;
+		GHashTableIter iter;
+		gpointer key;
+		const gchar *name;
+
+		/* uids containing the respective word */
+		found = g_new0 (GHashTable *, words->len);
+		for (jj = 0; jj < words->len; jj++) {
+			GPtrArray *index_words;
+			guint kk;
+
+			found[jj] = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+			index_words = g_hash_table_lookup (priv->index_words, g_ptr_array_index (words, jj));
+
+			for (kk = 0; index_words && kk < index_words->len; kk++) {
+				CamelIndexCursor *cursor;
+
+				cursor = camel_index_find (priv->index, g_ptr_array_index (index_words, kk));
+
+				while (cursor && (name = camel_index_cursor_next (cursor)) != NULL) {
+					if (g_hash_table_contains (matches, name))
+						g_hash_table_add (found[jj], g_strdup (name));
+				}
+
+				g_clear_object (&cursor);
+			}
+		}
+
+		/* All words have to be found in the message */
+		for (jj = 0; jj < words->len; jj++) {
+			g_hash_table_iter_init (&iter, matches);
+			while (g_hash_table_iter_next (&iter, &key, NULL)) {
+				if (!g_hash_table_contains (found[jj], key))
+					g_hash_table_iter_remove (&iter);
+			}
+
+			g_hash_table_destroy (found[jj]);
+		}
+
+		g_free (found);
+	}
+
+	g_mutex_unlock (&priv->index_lock);
+
+	for (ii = 0; ii < uids->len; ii++) {
+		const gchar *uid = g_ptr_array_index (uids, ii);
+
+		if (g_hash_table_contains (matches, uid))
+			g_ptr_array_add (result, (gpointer) camel_pstring_strdup (uid));
+	}
+
+	g_hash_table_destroy (matches);
+
+	if (max_to_index != 0)
+		ews_folder_sync_index (ews_folder);
+
+	return result;
 }
 
 static void
-sync_created_items (CamelEwsFolder *ews_folder,
-                    EEwsConnection *cnc,
-		    gboolean is_drafts_folder,
-                    GSList *created_items,
-		    GHashTable *updating_summary_uids,
-		    CamelFolderChangeInfo *change_info,
-                    GCancellable *cancellable,
-                    GError **error)
+ews_folder_forget_all_mails (CamelEwsFolder *ews_folder)
 {
-	CamelEwsStore *ews_store;
-	GSList *items = NULL, *l;
-	GSList *generic_item_ids = NULL, *msg_ids = NULL, *post_item_ids = NULL;
-	GError *local_error = NULL;
+	CamelFolder *folder;
+	CamelFolderChangeInfo *changes;
+	CamelFolderSummary *folder_summary;
+	GPtrArray *known_uids;
+	gint ii;
 
-	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (CAMEL_FOLDER (ews_folder)));
+	g_return_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder));
+
+	folder = CAMEL_FOLDER (ews_folder);
+	g_return_if_fail (folder != NULL);
+
+	known_uids = camel_folder_summary_get_array (camel_folder_get_folder_summary (folder));
+	if (!known_uids)
+		return;
+
+	changes = camel_folder_change_info_new ();
+	folder_summary = camel_folder_get_folder_summary (folder);
+
+	camel_folder_summary_lock (folder_summary);
+	for (ii = 0; ii < known_uids->len; ii++) {
+		const gchar *uid = g_ptr_array_index (known_uids, ii);
+
+		camel_folder_change_info_remove_uid (changes, uid);
+		camel_folder_summary_remove_uid (folder_summary, uid);
+		camel_ews_folder_remove_cached_message (ews_folder, uid);
+	}
+	camel_folder_summary_unlock (folder_summary);
+
+	if (camel_folder_change_info_changed (changes)) {
+		camel_folder_summary_touch (folder_summary);
+		camel_folder_summary_save (folder_summary, NULL);
+		camel_folder_changed (folder, changes);
+	}
+
+	camel_folder_change_info_free (changes);
+	camel_folder_summary_free_array (known_uids);
+}
+
+/* Created items are fetched separately per kind, since the property sets vary */
+enum {
+	CREATED_MESSAGES,
+	CREATED_POST_ITEMS,
+	CREATED_GENERIC_ITEMS,
+	N_CREATED_KINDS
+};
+
+/* How many SyncFolderItems pages can be received ahead of those
+   being applied into the summary */
+#define EWS_REFRESH_MAX_PAGES 3
+
+static EEwsAdditionalProps *
+ews_folder_new_created_items_props (guint kind)
+{
+	EEwsAdditionalProps *add_props;
+
+	add_props = e_ews_additional_props_new ();
+
+	switch (kind) {
+	case CREATED_MESSAGES:
+		add_props->field_uri = g_strdup (SUMMARY_MESSAGE_PROPS);
+		add_props->extended_furis = ews_folder_get_summary_message_mapi_flags ();
+		break;
+	case CREATED_POST_ITEMS:
+		add_props->field_uri = g_strdup (SUMMARY_POSTITEM_PROPS);
+		add_props->extended_furis = ews_folder_get_summary_followup_mapi_flags ();
+		break;
+	case CREATED_GENERIC_ITEMS:
+		add_props->field_uri = g_strdup (SUMMARY_ITEM_PROPS);
+		add_props->extended_furis = ews_folder_get_summary_followup_mapi_flags ();
+		break;
+	default:
+		g_warn_if_reached ();
+		break;
+	}
+
+	return add_props;
+}
+
+typedef struct _EwsRefreshData EwsRefreshData;
+
+/* One page of the SyncFolderItems response with its fetched created items */
+typedef struct _EwsRefreshPage {
+	EwsRefreshData *rd;
+	gchar *sync_state;
+	gboolean includes_last_item;
+	GSList *items_deleted; /* gchar * */
+	GSList *items_updated; /* EEwsItem * */
+	GSList *items_created[N_CREATED_KINDS]; /* EEwsItem * */
+	GError *created_error[N_CREATED_KINDS];
+	guint n_pending; /* GetItem requests still running */
+} EwsRefreshPage;
+
+typedef struct _EwsRefreshFetch {
+	EwsRefreshPage *page;
+	guint kind;
+} EwsRefreshFetch;
+
+struct _EwsRefreshData {
+	CamelEwsFolder *ews_folder;
+	EEwsConnection *cnc;
+	const gchar *folder_id;
+	GHashTable *updating_summary_uids;
+	GCancellable *cancellable;
+
+	GQueue pages; /* EwsRefreshPage *, in the order as received */
+	gchar *last_sync_state;
+	guint n_received;
+	gboolean sync_running;
+	gboolean sync_done; /* received the last page or failed */
+	gboolean sync_state_reset;
+	GError *sync_error;
+};
+
+static void
+ews_refresh_page_free (gpointer ptr)
+{
+	EwsRefreshPage *page = ptr;
+	guint ii;
+
+	if (!page)
+		return;
+
+	g_free (page->sync_state);
+	g_slist_free_full (page->items_deleted, g_free);
+	g_slist_free_full (page->items_updated, g_object_unref);
+
+	for (ii = 0; ii < N_CREATED_KINDS; ii++) {
+		g_slist_free_full (page->items_created[ii], g_object_unref);
+		g_clear_error (&page->created_error[ii]);
+	}
+
+	g_free (page);
+}
+
+static gboolean
+ews_refresh_is_busy (EwsRefreshData *rd)
+{
+	GList *link;
+
+	if (rd->sync_running)
+		return TRUE;
+
+	for (link = g_queue_peek_head_link (&rd->pages); link; link = g_list_next (link)) {
+		EwsRefreshPage *page = link->data;
+
+		if (page->n_pending)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+ews_refresh_get_items_cb (GObject *source_object,
+			  GAsyncResult *result,
+			  gpointer user_data)
+{
+	EwsRefreshFetch *fetch = user_data;
+	EwsRefreshPage *page = fetch->page;
+
+	e_ews_connection_get_items_finish (E_EWS_CONNECTION (source_object), result,
+		&page->items_created[fetch->kind], &page->created_error[fetch->kind]);
+
+	page->n_pending--;
+
+	g_free (fetch);
+}
+
+static void
+ews_refresh_page_fetch_created (EwsRefreshPage *page,
+				GSList *created_items)
+{
+	EwsRefreshData *rd = page->rd;
+	GSList *ids[N_CREATED_KINDS] = { NULL, NULL, NULL };
+	GSList *l;
+	guint ii;
 
 	for (l = created_items; l != NULL; l = g_slist_next (l)) {
 		EEwsItem *item = (EEwsItem *) l->data;
@@ -2068,11 +3467,11 @@ sync_created_items (CamelEwsFolder *ews_folder,
 			continue;
 		}
 
-		if (updating_summary_uids) {
+		if (rd->updating_summary_uids) {
 			const gchar *pooled_uid = camel_pstring_strdup (id->id);
 			gboolean known;
 
-			known = g_hash_table_remove (updating_summary_uids, pooled_uid);
+			known = g_hash_table_remove (rd->updating_summary_uids, pooled_uid);
 
 			camel_pstring_free (pooled_uid);
 
@@ -2082,8 +3481,6 @@ sync_created_items (CamelEwsFolder *ews_folder,
 			}
 		}
 
-		/* created_msg_ids are items other than generic item. We fetch them
-		 * separately since the property sets vary */
 		/* FIXME: Do we need to handle any other item types
 		 * "specially"? */
 		if (item_type == E_EWS_ITEM_TYPE_MESSAGE ||
@@ -2091,147 +3488,179 @@ sync_created_items (CamelEwsFolder *ews_folder,
 			item_type == E_EWS_ITEM_TYPE_MEETING_MESSAGE ||
 			item_type == E_EWS_ITEM_TYPE_MEETING_RESPONSE ||
 			item_type == E_EWS_ITEM_TYPE_MEETING_CANCELLATION)
-			msg_ids = g_slist_append (msg_ids, g_strdup (id->id));
+			ids[CREATED_MESSAGES] = g_slist_prepend (ids[CREATED_MESSAGES], g_strdup (id->id));
 		else if (item_type == E_EWS_ITEM_TYPE_POST_ITEM)
-			post_item_ids = g_slist_append (post_item_ids, g_strdup (id->id));
+			ids[CREATED_POST_ITEMS] = g_slist_prepend (ids[CREATED_POST_ITEMS], g_strdup (id->id));
 		else if (item_type == E_EWS_ITEM_TYPE_GENERIC_ITEM)
-			generic_item_ids = g_slist_append (generic_item_ids, g_strdup (id->id));
+			ids[CREATED_GENERIC_ITEMS] = g_slist_prepend (ids[CREATED_GENERIC_ITEMS], g_strdup (id->id));
 
 		g_object_unref (item);
 	}
 	g_slist_free (created_items);
 
-
-	if (msg_ids) {
+	/* All kinds are fetched at once, while the next page can be already
+	   being received; they are applied in order in ews_refresh_apply_page() */
+	for (ii = 0; ii < N_CREATED_KINDS; ii++) {
 		EEwsAdditionalProps *add_props;
+		EwsRefreshFetch *fetch;
 
-		add_props = e_ews_additional_props_new ();
-		add_props->field_uri = g_strdup (SUMMARY_MESSAGE_PROPS);
-		add_props->extended_furis = ews_folder_get_summary_message_mapi_flags ();
+		if (!ids[ii])
+			continue;
 
-		e_ews_connection_get_items_sync (
-			cnc, EWS_PRIORITY_MEDIUM,
-			msg_ids, "IdOnly", add_props,
-			FALSE, NULL, E_EWS_BODY_TYPE_ANY, &items, NULL, NULL,
-			cancellable, &local_error);
+		ids[ii] = g_slist_reverse (ids[ii]);
+
+		fetch = g_new0 (EwsRefreshFetch, 1);
+		fetch->page = page;
+		fetch->kind = ii;
+
+		page->n_pending++;
+
+		add_props = ews_folder_new_created_items_props (ii);
+
+		e_ews_connection_get_items (
+			rd->cnc, EWS_PRIORITY_MEDIUM,
+			ids[ii], "IdOnly", add_props,
+			FALSE, NULL, E_EWS_BODY_TYPE_ANY, NULL, NULL,
+			rd->cancellable, ews_refresh_get_items_cb, fetch);
 
 		e_ews_additional_props_free (add_props);
+		g_slist_free_full (ids[ii], g_free);
 	}
+}
 
-	if (local_error) {
-		camel_ews_store_maybe_disconnect (ews_store, local_error);
-		g_propagate_error (error, local_error);
-		goto exit;
-	}
+static void ews_refresh_sync_folder_items_cb (GObject *source_object, GAsyncResult *result, gpointer user_data);
 
-	camel_ews_utils_sync_created_items (ews_folder, cnc, is_drafts_folder, items, change_info, cancellable);
-	items = NULL;
+static void
+ews_refresh_start_sync_folder_items (EwsRefreshData *rd,
+				     const gchar *sync_state)
+{
+	rd->sync_running = TRUE;
+
+	e_ews_connection_sync_folder_items (
+		rd->cnc, EWS_PRIORITY_MEDIUM, sync_state, rd->folder_id,
+		"IdOnly", NULL,
+		e_ews_connection_get_batch_size (rd->cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES),
+		rd->cancellable, ews_refresh_sync_folder_items_cb, rd);
+}
+
+/* Asks for the next page, unless too many are waiting to be applied */
+static void
+ews_refresh_maybe_continue (EwsRefreshData *rd)
+{
+	if (rd->sync_running || rd->sync_done)
+		return;
 
+	if (g_cancellable_is_cancelled (rd->cancellable)) {
+		rd->sync_done = TRUE;
+		return;
+	}
 
-	if (post_item_ids) {
-		EEwsAdditionalProps *add_props;
+	if (g_queue_get_length (&rd->pages) < EWS_REFRESH_MAX_PAGES)
+		ews_refresh_start_sync_folder_items (rd, rd->last_sync_state);
+}
 
-		add_props = e_ews_additional_props_new ();
-		add_props->field_uri = g_strdup (SUMMARY_POSTITEM_PROPS);
-		add_props->extended_furis = ews_folder_get_summary_followup_mapi_flags ();
+static void
+ews_refresh_sync_folder_items_cb (GObject *source_object,
+				  GAsyncResult *result,
+				  gpointer user_data)
+{
+	EwsRefreshData *rd = user_data;
+	EwsRefreshPage *page;
+	GSList *items_created = NULL;
+	GError *local_error = NULL;
 
-		e_ews_connection_get_items_sync (
-			cnc, EWS_PRIORITY_MEDIUM,
-			post_item_ids, "IdOnly", add_props,
-			FALSE, NULL, E_EWS_BODY_TYPE_ANY, &items, NULL, NULL,
-			cancellable, &local_error);
+	rd->sync_running = FALSE;
 
-		e_ews_additional_props_free (add_props);
-	}
+	page = g_new0 (EwsRefreshPage, 1);
+	page->rd = rd;
 
-	if (local_error) {
-		camel_ews_store_maybe_disconnect (ews_store, local_error);
-		g_propagate_error (error, local_error);
-		goto exit;
-	}
+	if (!e_ews_connection_sync_folder_items_finish (E_EWS_CONNECTION (source_object), result,
+		&page->sync_state, &page->includes_last_item, &items_created,
+		&page->items_updated, &page->items_deleted, &local_error)) {
+		ews_refresh_page_free (page);
 
-	camel_ews_utils_sync_created_items (ews_folder, cnc, is_drafts_folder, items, change_info, cancellable);
-	items = NULL;
+		if (!rd->n_received && !rd->sync_state_reset &&
+		    g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_INVALIDSYNCSTATEDATA)) {
+			CamelFolderSummary *folder_summary;
 
-	if (generic_item_ids) {
-		EEwsAdditionalProps *add_props;
+			g_clear_error (&local_error);
 
-		add_props = e_ews_additional_props_new ();
-		add_props->field_uri = g_strdup (SUMMARY_ITEM_PROPS);
-		add_props->extended_furis = ews_folder_get_summary_followup_mapi_flags ();
+			folder_summary = camel_folder_get_folder_summary (CAMEL_FOLDER (rd->ews_folder));
+			camel_ews_summary_set_sync_state (CAMEL_EWS_SUMMARY (folder_summary), NULL);
+			ews_folder_forget_all_mails (rd->ews_folder);
+			if (rd->updating_summary_uids) {
+				g_hash_table_destroy (rd->updating_summary_uids);
+				rd->updating_summary_uids = NULL;
+			}
 
-		e_ews_connection_get_items_sync (
-			cnc, EWS_PRIORITY_MEDIUM,
-			generic_item_ids, "IdOnly", add_props,
-			FALSE, NULL, E_EWS_BODY_TYPE_ANY, &items, NULL, NULL,
-			cancellable, &local_error);
+			rd->sync_state_reset = TRUE;
+			ews_refresh_start_sync_folder_items (rd, NULL);
+			return;
+		}
 
-		e_ews_additional_props_free (add_props);
+		rd->sync_done = TRUE;
+		g_propagate_error (&rd->sync_error, local_error);
+		return;
 	}
 
-	camel_ews_utils_sync_created_items (ews_folder, cnc, is_drafts_folder, items, change_info, cancellable);
+	rd->n_received++;
 
-	if (local_error) {
-		camel_ews_store_maybe_disconnect (ews_store, local_error);
-		g_propagate_error (error, local_error);
-	}
+	g_free (rd->last_sync_state);
+	rd->last_sync_state = g_strdup (page->sync_state);
 
-exit:
-	if (msg_ids) {
-		g_slist_foreach (msg_ids, (GFunc) g_free, NULL);
-		g_slist_free (msg_ids);
-	}
+	if (page->includes_last_item)
+		rd->sync_done = TRUE;
 
-	if (post_item_ids) {
-		g_slist_foreach (post_item_ids, (GFunc) g_free, NULL);
-		g_slist_free (post_item_ids);
-	}
+	g_queue_push_tail (&rd->pages, page);
 
-	if (generic_item_ids) {
-		g_slist_foreach (generic_item_ids, (GFunc) g_free, NULL);
-		g_slist_free (generic_item_ids);
-	}
+	ews_refresh_page_fetch_created (page, items_created);
+	ews_refresh_maybe_continue (rd);
 }
 
+/* Applies the page into the summary; the created items are applied
+   in the same order as they used to be fetched */
 static void
-ews_folder_forget_all_mails (CamelEwsFolder *ews_folder)
+ews_refresh_apply_page (EwsRefreshData *rd,
+			EwsRefreshPage *page,
+			gboolean is_drafts_folder,
+			CamelFolderChangeInfo *change_info,
+			GError **error)
 {
-	CamelFolder *folder;
-	CamelFolderChangeInfo *changes;
-	CamelFolderSummary *folder_summary;
-	GPtrArray *known_uids;
-	gint ii;
-
-	g_return_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder));
+	CamelEwsStore *ews_store;
+	GError *local_error = NULL;
+	guint ii;
 
-	folder = CAMEL_FOLDER (ews_folder);
-	g_return_if_fail (folder != NULL);
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (CAMEL_FOLDER (rd->ews_folder)));
 
-	known_uids = camel_folder_summary_get_array (camel_folder_get_folder_summary (folder));
-	if (!known_uids)
-		return;
+	if (page->items_deleted) {
+		camel_ews_utils_sync_deleted_items (rd->ews_folder, page->items_deleted, change_info);
+		page->items_deleted = NULL;
+	}
 
-	changes = camel_folder_change_info_new ();
-	folder_summary = camel_folder_get_folder_summary (folder);
+	for (ii = 0; ii < N_CREATED_KINDS && !local_error; ii++) {
+		local_error = page->created_error[ii];
+		page->created_error[ii] = NULL;
 
-	camel_folder_summary_lock (folder_summary);
-	for (ii = 0; ii < known_uids->len; ii++) {
-		const gchar *uid = g_ptr_array_index (known_uids, ii);
+		/* The generic items are applied even on failure */
+		if (local_error && ii != CREATED_GENERIC_ITEMS)
+			break;
 
-		camel_folder_change_info_remove_uid (changes, uid);
-		camel_folder_summary_remove_uid (folder_summary, uid);
-		ews_data_cache_remove (ews_folder->cache, "cur", uid, NULL);
+		camel_ews_utils_sync_created_items (rd->ews_folder, rd->cnc, is_drafts_folder,
+			page->items_created[ii], change_info, rd->cancellable);
+		page->items_created[ii] = NULL;
 	}
-	camel_folder_summary_unlock (folder_summary);
 
-	if (camel_folder_change_info_changed (changes)) {
-		camel_folder_summary_touch (folder_summary);
-		camel_folder_summary_save (folder_summary, NULL);
-		camel_folder_changed (folder, changes);
+	if (local_error) {
+		camel_ews_store_maybe_disconnect (ews_store, local_error);
+		g_propagate_error (error, local_error);
+		return;
 	}
 
-	camel_folder_change_info_free (changes);
-	camel_folder_summary_free_array (known_uids);
+	if (page->items_updated) {
+		sync_updated_items (rd->ews_folder, rd->cnc, is_drafts_folder, page->items_updated,
+			change_info, rd->cancellable, error);
+		page->items_updated = NULL;
+	}
 }
 
 static gboolean
@@ -2249,8 +3678,9 @@ ews_refresh_info_sync (CamelFolder *folder,
 	const gchar *full_name;
 	gchar *id;
 	gchar *sync_state;
-	gboolean includes_last_item = FALSE;
 	gboolean is_drafts_folder;
+	GMainContext *main_context;
+	EwsRefreshData rd;
 	gint64 last_folder_update_time;
 	GError *local_error = NULL;
 
@@ -2265,6 +3695,11 @@ ews_refresh_info_sync (CamelFolder *folder,
 
 	g_mutex_lock (&priv->state_lock);
 
+	/* The notified changes are being added into the summary, the refresh
+	   would add the same items at the same time */
+	while (priv->applying_notified)
+		g_cond_wait (&priv->fetch_cond, &priv->state_lock);
+
 	if (priv->refreshing) {
 		g_mutex_unlock (&priv->state_lock);
 		return TRUE;
@@ -2301,74 +3736,83 @@ ews_refresh_info_sync (CamelFolder *folder,
 		updating_summary_uids = camel_folder_summary_get_hash (folder_summary);
 	}
 
-	do {
-		GSList *items_created = NULL, *items_updated = NULL;
-		GSList *items_deleted = NULL;
-		gchar *new_sync_state = NULL;
-		guint32 total, unread;
-
-		e_ews_connection_sync_folder_items_sync (cnc, EWS_PRIORITY_MEDIUM, sync_state, id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
-			&new_sync_state, &includes_last_item, &items_created, &items_updated, &items_deleted,
-			cancellable, &local_error);
+	/* No need to ask for changes when the server reports the same
+	 * counts as the folder has and it did not notify about the folder;
+	 * the counts of all folders are read at once, thus this makes polling
+	 * of many folders cheap. */
+	if (!updating_summary_uids && id &&
+	    camel_ews_store_folder_counts_unchanged_sync (ews_store, id, cancellable))
+		goto exit;
 
-		g_free (sync_state);
-		sync_state = new_sync_state;
+	memset (&rd, 0, sizeof (EwsRefreshData));
+	rd.ews_folder = ews_folder;
+	rd.cnc = cnc;
+	rd.folder_id = id;
+	rd.updating_summary_uids = updating_summary_uids;
+	rd.cancellable = cancellable;
+	g_queue_init (&rd.pages);
+
+	/* The next SyncFolderItems page is requested as soon as the previous
+	 * is received, while its items are being fetched; the pages are
+	 * applied into the summary in order. The callbacks are called
+	 * in this thread. */
+	main_context = g_main_context_new ();
+	g_main_context_push_thread_default (main_context);
+
+	ews_refresh_start_sync_folder_items (&rd, sync_state);
+
+	while (!local_error) {
+		EwsRefreshPage *page = g_queue_peek_head (&rd.pages);
+		guint32 total, unread;
+		guint n_changes, kind;
 
-		if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_INVALIDSYNCSTATEDATA)) {
-			g_clear_error (&local_error);
-			camel_ews_summary_set_sync_state (CAMEL_EWS_SUMMARY (folder_summary), NULL);
-			g_free (sync_state);
-			sync_state = NULL;
-			ews_folder_forget_all_mails (ews_folder);
-			if (updating_summary_uids) {
-				g_hash_table_destroy (updating_summary_uids);
-				updating_summary_uids = NULL;
-			}
+		if (!page) {
+			if (!ews_refresh_is_busy (&rd))
+				break;
 
-			e_ews_connection_sync_folder_items_sync (cnc, EWS_PRIORITY_MEDIUM, NULL, id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
-				&sync_state, &includes_last_item, &items_created, &items_updated, &items_deleted,
-				cancellable, &local_error);
+			g_main_context_iteration (main_context, TRUE);
+			continue;
 		}
 
-		if (local_error) {
-			camel_ews_store_maybe_disconnect (ews_store, local_error);
-			break;
+		if (page->n_pending) {
+			g_main_context_iteration (main_context, TRUE);
+			continue;
 		}
 
-		if (items_deleted)
-			camel_ews_utils_sync_deleted_items (ews_folder, items_deleted, change_info);
+		g_queue_pop_head (&rd.pages);
 
-		if (items_created)
-			sync_created_items (ews_folder, cnc, is_drafts_folder, items_created, updating_summary_uids, change_info, cancellable, &local_error);
+		n_changes = g_slist_length (page->items_deleted) + g_slist_length (page->items_updated);
+		for (kind = 0; kind < N_CREATED_KINDS; kind++) {
+			n_changes += g_slist_length (page->items_created[kind]);
+		}
 
-		if (local_error) {
-			if (items_updated) {
-				g_slist_foreach (items_updated, (GFunc) g_object_unref, NULL);
-				g_slist_free (items_updated);
-			}
+		ews_refresh_apply_page (&rd, page, is_drafts_folder, change_info, &local_error);
 
+		if (local_error) {
+			ews_refresh_page_free (page);
 			break;
 		}
 
-		if (items_updated)
-			sync_updated_items (ews_folder, cnc, is_drafts_folder, items_updated, change_info, cancellable, &local_error);
+		g_free (sync_state);
+		sync_state = page->sync_state;
+		page->sync_state = NULL;
 
-		if (local_error)
-			break;
+		ews_refresh_page_free (page);
 
 		total = camel_folder_summary_count (folder_summary);
 		unread = camel_folder_summary_get_unread_count (folder_summary);
 
 		camel_ews_store_summary_set_folder_total (ews_store->summary, id, total);
 		camel_ews_store_summary_set_folder_unread (ews_store->summary, id, unread);
-		camel_ews_store_summary_save (ews_store->summary, NULL);
 
 		camel_ews_summary_set_sync_state (CAMEL_EWS_SUMMARY (folder_summary), sync_state);
 
 		camel_folder_summary_touch (folder_summary);
 
+		/* The sync state is saved together with the items it covers */
+		ews_folder_save_summaries (ews_folder, n_changes, FALSE);
+
 		if (camel_folder_change_info_changed (change_info)) {
-			camel_folder_summary_save (folder_summary, NULL);
 			/* Notify any listeners only once per 10 seconds, as such notify can cause UI update */
 			if (g_get_monotonic_time () - last_folder_update_time >= 10 * G_USEC_PER_SEC) {
 				last_folder_update_time = g_get_monotonic_time ();
@@ -2376,7 +3820,33 @@ ews_refresh_info_sync (CamelFolder *folder,
 				camel_folder_change_info_clear (change_info);
 			}
 		}
-	} while (!local_error && !includes_last_item && !g_cancellable_is_cancelled (cancellable));
+
+		ews_refresh_maybe_continue (&rd);
+	}
+
+	/* Stop asking for more and wait for what is already running */
+	rd.sync_done = TRUE;
+	while (ews_refresh_is_busy (&rd))
+		g_main_context_iteration (main_context, TRUE);
+
+	g_main_context_pop_thread_default (main_context);
+	g_main_context_unref (main_context);
+
+	while (!g_queue_is_empty (&rd.pages)) {
+		ews_refresh_page_free (g_queue_pop_head (&rd.pages));
+	}
+
+	g_free (rd.last_sync_state);
+	updating_summary_uids = rd.updating_summary_uids;
+
+	if (rd.sync_error) {
+		if (!local_error) {
+			camel_ews_store_maybe_disconnect (ews_store, rd.sync_error);
+			local_error = rd.sync_error;
+		} else {
+			g_clear_error (&rd.sync_error);
+		}
+	}
 
 	if (updating_summary_uids) {
 		if (!local_error && !g_cancellable_is_cancelled (cancellable) &&
@@ -2390,7 +3860,7 @@ ews_refresh_info_sync (CamelFolder *folder,
 				const gchar *uid = key;
 
 				camel_folder_change_info_remove_uid (change_info, uid);
-				ews_data_cache_remove (ews_folder->cache, "cur", uid, NULL);
+				camel_ews_folder_remove_cached_message (ews_folder, uid);
 
 				removed_uids = g_list_prepend (removed_uids, (gpointer) uid);
 			}
@@ -2404,15 +3874,17 @@ ews_refresh_info_sync (CamelFolder *folder,
 		updating_summary_uids = NULL;
 	}
 
+ exit:
 	camel_operation_pop_message (cancellable);
 
-	if (camel_folder_change_info_changed (change_info)) {
+	if (camel_folder_change_info_changed (change_info))
 		camel_folder_summary_touch (folder_summary);
-		camel_folder_summary_save (folder_summary, NULL);
+
+	/* Flush what was coalesced, also on failure and cancellation */
+	ews_folder_save_summaries (ews_folder, 0, TRUE);
+
+	if (camel_folder_change_info_changed (change_info))
 		camel_folder_changed (folder, change_info);
-	} else {
-		camel_folder_summary_save (folder_summary, NULL);
-	}
 
 	camel_folder_change_info_free (change_info);
 
@@ -2430,6 +3902,234 @@ ews_refresh_info_sync (CamelFolder *folder,
 	return !local_error;
 }
 
+/* Reads the items with the ids in more GetItem requests, of the size
+   the server currently copes with; the items are in the order of the ids */
+static gboolean
+ews_folder_get_items_in_batches_sync (EEwsConnection *cnc,
+				      const GSList *ids,
+				      const EEwsAdditionalProps *add_props,
+				      GSList **out_items,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	const GSList *link;
+	GSList *batch = NULL, *items = NULL;
+	guint batch_size, n_batch = 0;
+	gboolean success = TRUE;
+
+	batch_size = e_ews_connection_get_batch_size (cnc, EWS_MAX_FETCH_COUNT, EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES);
+
+	for (link = ids; link && success; link = g_slist_next (link)) {
+		batch = g_slist_prepend (batch, link->data);
+		n_batch++;
+
+		if (n_batch >= batch_size || !link->next) {
+			GSList *batch_items = NULL;
+
+			batch = g_slist_reverse (batch);
+
+			success = e_ews_connection_get_items_sync (
+				cnc, EWS_PRIORITY_MEDIUM,
+				batch, "IdOnly", add_props,
+				FALSE, NULL, E_EWS_BODY_TYPE_ANY, &batch_items, NULL, NULL,
+				cancellable, error);
+
+			if (success)
+				items = g_slist_concat (items, batch_items);
+			else
+				g_slist_free_full (batch_items, g_object_unref);
+
+			g_slist_free (batch);
+			batch = NULL;
+			n_batch = 0;
+		}
+	}
+
+	if (success)
+		*out_items = items;
+	else
+		g_slist_free_full (items, g_object_unref);
+
+	return success;
+}
+
+/* Applies the item changes received through the server notifications
+   directly into the summary: the created and modified items are read
+   with GetItem, in batches, the deleted items are removed locally.
+   The sync state is left untouched, the next SyncFolderItems reports
+   these changes again, which is harmless. Returns FALSE, without setting
+   the error, when the changes could not be applied this way, like when
+   the folder is being refreshed or an item of other than a message type
+   was created; the caller should refresh the whole folder then.
+   A refresh started meanwhile waits until the changes are applied,
+   thus the two do not add the same items into the summary. */
+gboolean
+camel_ews_folder_apply_notified_items_sync (CamelEwsFolder *ews_folder,
+					    const GSList *created_ids,
+					    const GSList *modified_ids,
+					    const GSList *deleted_ids,
+					    GCancellable *cancellable,
+					    GError **error)
+{
+	CamelFolder *folder;
+	CamelFolderSummary *folder_summary;
+	CamelFolderChangeInfo *change_info;
+	CamelEwsStore *ews_store;
+	EEwsConnection *cnc;
+	GSList *new_ids = NULL, *upd_ids = NULL, *del_ids = NULL, *items = NULL, *link;
+	gboolean is_drafts_folder, applied = TRUE;
+	guint n_changes = 0;
+	gchar *folder_id;
+	GError *local_error = NULL;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (ews_folder), FALSE);
+
+	folder = CAMEL_FOLDER (ews_folder);
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (folder));
+
+	cnc = camel_ews_store_ref_connection (ews_store);
+	if (!cnc)
+		return FALSE;
+
+	g_mutex_lock (&ews_folder->priv->state_lock);
+	applied = !ews_folder->priv->refreshing && !ews_folder->priv->applying_notified;
+	if (applied)
+		ews_folder->priv->applying_notified = TRUE;
+	g_mutex_unlock (&ews_folder->priv->state_lock);
+
+	if (!applied) {
+		g_object_unref (cnc);
+		return FALSE;
+	}
+
+	folder_summary = camel_folder_get_folder_summary (folder);
+	is_drafts_folder = camel_ews_utils_folder_is_drafts_folder (ews_folder);
+	change_info = camel_folder_change_info_new ();
+
+	for (link = (GSList *) deleted_ids; link; link = g_slist_next (link)) {
+		const gchar *uid = link->data;
+
+		if (camel_folder_summary_check_uid (folder_summary, uid)) {
+			camel_ews_folder_remove_cached_message (ews_folder, uid);
+			del_ids = g_slist_prepend (del_ids, g_strdup (uid));
+		}
+	}
+
+	/* A modification of an unknown item means it was not seen created */
+	for (link = (GSList *) modified_ids; link; link = g_slist_next (link)) {
+		const gchar *uid = link->data;
+
+		if (camel_folder_summary_check_uid (folder_summary, uid))
+			upd_ids = g_slist_prepend (upd_ids, g_strdup (uid));
+		else
+			new_ids = g_slist_prepend (new_ids, g_strdup (uid));
+	}
+
+	for (link = (GSList *) created_ids; link; link = g_slist_next (link)) {
+		new_ids = g_slist_prepend (new_ids, g_strdup (link->data));
+	}
+
+	if (del_ids) {
+		n_changes += g_slist_length (del_ids);
+		camel_ews_utils_sync_deleted_items (ews_folder, del_ids, change_info);
+		del_ids = NULL;
+	}
+
+	if (upd_ids) {
+		EEwsAdditionalProps *add_props;
+
+		upd_ids = g_slist_reverse (upd_ids);
+
+		add_props = e_ews_additional_props_new ();
+		add_props->field_uri = g_strdup (is_drafts_folder ? SUMMARY_MESSAGE_PROPS : SUMMARY_MESSAGE_FLAGS);
+		add_props->extended_furis = ews_folder_get_summary_message_mapi_flags ();
+
+		/* Items deleted meanwhile come back as errors, which are skipped */
+		if (ews_folder_get_items_in_batches_sync (cnc, upd_ids, add_props, &items, cancellable, &local_error)) {
+			n_changes += g_slist_length (items);
+			camel_ews_utils_sync_updated_items (ews_folder, cnc, is_drafts_folder, items, change_info, cancellable);
+		}
+
+		items = NULL;
+
+		e_ews_additional_props_free (add_props);
+	}
+
+	if (new_ids && !local_error) {
+		EEwsAdditionalProps *add_props;
+
+		new_ids = g_slist_reverse (new_ids);
+
+		add_props = ews_folder_new_created_items_props (CREATED_MESSAGES);
+
+		if (ews_folder_get_items_in_batches_sync (cnc, new_ids, add_props, &items, cancellable, &local_error)) {
+			GSList *messages = NULL;
+
+			/* Only messages are read with the right properties here */
+			for (link = items; link; link = g_slist_next (link)) {
+				EEwsItem *item = link->data;
+
+				switch (e_ews_item_get_item_type (item)) {
+				case E_EWS_ITEM_TYPE_MESSAGE:
+				case E_EWS_ITEM_TYPE_MEETING_REQUEST:
+				case E_EWS_ITEM_TYPE_MEETING_MESSAGE:
+				case E_EWS_ITEM_TYPE_MEETING_RESPONSE:
+				case E_EWS_ITEM_TYPE_MEETING_CANCELLATION:
+				case E_EWS_ITEM_TYPE_ERROR:
+					messages = g_slist_prepend (messages, item);
+					break;
+				default:
+					applied = FALSE;
+					g_object_unref (item);
+					break;
+				}
+			}
+
+			g_slist_free (items);
+
+			n_changes += g_slist_length (messages);
+			camel_ews_utils_sync_created_items (ews_folder, cnc, is_drafts_folder,
+				g_slist_reverse (messages), change_info, cancellable);
+		}
+
+		items = NULL;
+
+		e_ews_additional_props_free (add_props);
+	}
+
+	folder_id = camel_ews_store_summary_get_folder_id_from_name (ews_store->summary, camel_folder_get_full_name (folder));
+	if (folder_id) {
+		camel_ews_store_summary_set_folder_total (ews_store->summary, folder_id, camel_folder_summary_count (folder_summary));
+		camel_ews_store_summary_set_folder_unread (ews_store->summary, folder_id, camel_folder_summary_get_unread_count (folder_summary));
+		g_free (folder_id);
+	}
+
+	if (camel_folder_change_info_changed (change_info)) {
+		camel_folder_summary_touch (folder_summary);
+		ews_folder_save_summaries (ews_folder, n_changes, FALSE);
+		camel_folder_changed (folder, change_info);
+	}
+
+	camel_folder_change_info_free (change_info);
+
+	if (local_error) {
+		camel_ews_store_maybe_disconnect (ews_store, local_error);
+		g_propagate_error (error, local_error);
+		applied = FALSE;
+	}
+
+	g_slist_free_full (new_ids, g_free);
+	g_slist_free_full (upd_ids, g_free);
+	g_object_unref (cnc);
+
+	g_mutex_lock (&ews_folder->priv->state_lock);
+	ews_folder->priv->applying_notified = FALSE;
+	g_cond_broadcast (&ews_folder->priv->fetch_cond);
+	g_mutex_unlock (&ews_folder->priv->state_lock);
+
+	return applied;
+}
+
 static gboolean
 ews_append_message_sync (CamelFolder *folder,
                          CamelMimeMessage *message,
@@ -2527,7 +4227,7 @@ ews_transfer_messages_to_sync (CamelFolder *source,
 	gchar *dst_id;
 	GError *local_error = NULL;
 	GSList *ids = NULL, *ret_items = NULL, *mi_list = NULL;
-	gint i = 0, mi_list_len = 0;
+	gint i = 0;
 	gboolean success = TRUE;
 
 	dst_full_name = camel_folder_get_full_name (destination);
@@ -2556,17 +4256,9 @@ ews_transfer_messages_to_sync (CamelFolder *source,
 		 * for most flags — not even replied/forwarded. */
 		if ((flags_set & CAMEL_MESSAGE_FOLDER_FLAGGED) != 0) {
 			mi_list = g_slist_prepend (mi_list, mi);
-			mi_list_len++;
 		} else {
 			g_clear_object (&mi);
 		}
-
-		if (mi_list_len == EWS_MAX_FETCH_COUNT) {
-			success = ews_save_flags (source, mi_list, cancellable, &local_error);
-			g_slist_free_full (mi_list, g_object_unref);
-			mi_list = NULL;
-			mi_list_len = 0;
-		}
 	}
 
 	if (mi_list != NULL && success)
@@ -2652,7 +4344,7 @@ ews_transfer_messages_to_sync (CamelFolder *source,
 
 				camel_folder_summary_remove_uid (camel_folder_get_folder_summary (source), uid);
 				camel_folder_change_info_remove_uid (changes, uid);
-				ews_data_cache_remove (CAMEL_EWS_FOLDER (source)->cache, "cur", uid, NULL);
+				camel_ews_folder_remove_cached_message (CAMEL_EWS_FOLDER (source), uid);
 			}
 			if (camel_folder_change_info_changed (changes)) {
 				camel_folder_summary_touch (camel_folder_get_folder_summary (source));
@@ -2727,15 +4419,15 @@ ews_delete_messages_from_folder (CamelFolder *folder,
 	changes = camel_folder_change_info_new ();
 	folder_summary = camel_folder_get_folder_summary (folder);
 
+	camel_folder_summary_lock (folder_summary);
 	for (iter = deleted_items; iter != NULL; iter = iter->next) {
 		const gchar *uid = iter->data;
 
-		camel_folder_summary_lock (folder_summary);
 		camel_folder_change_info_remove_uid (changes, uid);
 		camel_folder_summary_remove_uid (folder_summary, uid);
-		ews_data_cache_remove (CAMEL_EWS_FOLDER (folder)->cache, "cur", uid, NULL);
-		camel_folder_summary_unlock (folder_summary);
+		camel_ews_folder_remove_cached_message (CAMEL_EWS_FOLDER (folder), uid);
 	}
+	camel_folder_summary_unlock (folder_summary);
 
 	if (camel_folder_change_info_changed (changes)) {
 		camel_folder_summary_touch (folder_summary);
@@ -2970,6 +4662,41 @@ ews_cmp_uids (CamelFolder *folder,
 	return strcmp (uid1, uid2);
 }
 
+static void
+ews_folder_set_property (GObject *object,
+			 guint property_id,
+			 const GValue *value,
+			 GParamSpec *pspec)
+{
+	switch (property_id) {
+		case PROP_INDEX_BODY:
+			camel_ews_folder_set_index_body (
+				CAMEL_EWS_FOLDER (object),
+				g_value_get_boolean (value));
+			return;
+	}
+
+	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+}
+
+static void
+ews_folder_get_property (GObject *object,
+			 guint property_id,
+			 GValue *value,
+			 GParamSpec *pspec)
+{
+	switch (property_id) {
+		case PROP_INDEX_BODY:
+			g_value_set_boolean (
+				value,
+				camel_ews_folder_get_index_body (
+				CAMEL_EWS_FOLDER (object)));
+			return;
+	}
+
+	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+}
+
 static void
 ews_folder_dispose (GObject *object)
 {
@@ -2994,6 +4721,13 @@ ews_folder_dispose (GObject *object)
 		ews_folder->search = NULL;
 	}
 
+	g_mutex_lock (&ews_folder->priv->index_lock);
+	if (ews_folder->priv->index) {
+		camel_index_sync (ews_folder->priv->index);
+		g_clear_object (&ews_folder->priv->index);
+	}
+	g_mutex_unlock (&ews_folder->priv->index_lock);
+
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (camel_ews_folder_parent_class)->dispose (object);
 }
@@ -3007,9 +4741,13 @@ ews_folder_finalize (GObject *object)
 
 	g_mutex_clear (&ews_folder->priv->search_lock);
 	g_mutex_clear (&ews_folder->priv->state_lock);
+	g_mutex_clear (&ews_folder->priv->save_lock);
+	g_mutex_clear (&ews_folder->priv->index_lock);
+	g_hash_table_destroy (ews_folder->priv->index_words);
 	g_rec_mutex_clear (&ews_folder->priv->cache_lock);
 	g_hash_table_destroy (ews_folder->priv->fetching_uids);
 	g_cond_clear (&ews_folder->priv->fetch_cond);
+	g_free (ews_folder->priv->index_path);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_ews_folder_parent_class)->finalize (object);
@@ -3059,10 +4797,13 @@ camel_ews_folder_class_init (CamelEwsFolderClass *class)
 {
 	GObjectClass *object_class;
 	CamelFolderClass *folder_class;
+	CamelOfflineFolderClass *offline_folder_class;
 
 	g_type_class_add_private (class, sizeof (CamelEwsFolderPrivate));
 
 	object_class = G_OBJECT_CLASS (class);
+	object_class->set_property = ews_folder_set_property;
+	object_class->get_property = ews_folder_get_property;
 	object_class->dispose = ews_folder_dispose;
 	object_class->finalize = ews_folder_finalize;
 	object_class->constructed = ews_folder_constructed;
@@ -3083,6 +4824,20 @@ camel_ews_folder_class_init (CamelEwsFolderClass *class)
 	folder_class->transfer_messages_to_sync = ews_transfer_messages_to_sync;
 	folder_class->prepare_content_refresh = ews_prepare_content_refresh;
 	folder_class->get_filename = ews_get_filename;
+
+	offline_folder_class = CAMEL_OFFLINE_FOLDER_CLASS (class);
+	offline_folder_class->downsync_sync = ews_folder_downsync_sync;
+
+	g_object_class_install_property (
+		object_class,
+		PROP_INDEX_BODY,
+		g_param_spec_boolean (
+			"index-body",
+			"Index Body",
+			_("_Index message body data"),
+			FALSE,
+			G_PARAM_READWRITE |
+			CAMEL_PARAM_PERSISTENT));
 }
 
 static void
@@ -3096,9 +4851,13 @@ camel_ews_folder_init (CamelEwsFolder *ews_folder)
 
 	g_mutex_init (&ews_folder->priv->search_lock);
 	g_mutex_init (&ews_folder->priv->state_lock);
+	g_mutex_init (&ews_folder->priv->save_lock);
+	g_mutex_init (&ews_folder->priv->index_lock);
+	ews_folder->priv->index_words = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 	g_rec_mutex_init (&ews_folder->priv->cache_lock);
 
 	ews_folder->priv->refreshing = FALSE;
+	ews_folder->priv->index_body = FALSE;
 
 	g_cond_init (&ews_folder->priv->fetch_cond);
 	ews_folder->priv->fetching_uids = g_hash_table_new (g_str_hash, g_str_equal);
@@ -75,6 +75,25 @@ CamelFolder * camel_ews_folder_new (CamelStore *store, const gchar *folder_dir,
 void ews_update_summary ( CamelFolder *folder, GList *item_list, GCancellable *cancellable, GError **error);
 void		camel_ews_folder_remove_cached_message	(CamelEwsFolder *ews_folder,
 							 const gchar *uid);
+guint		camel_ews_folder_get_summary_saves_avoided
+							(CamelEwsFolder *ews_folder);
+gboolean	camel_ews_folder_get_index_body	(CamelEwsFolder *ews_folder);
+void		camel_ews_folder_set_index_body	(CamelEwsFolder *ews_folder,
+							 gboolean index_body);
+gboolean	camel_ews_folder_apply_notified_items_sync
+							(CamelEwsFolder *ews_folder,
+							 const GSList *created_ids,
+							 const GSList *modified_ids,
+							 const GSList *deleted_ids,
+							 GCancellable *cancellable,
+							 GError **error);
+GPtrArray *	camel_ews_folder_search_body_index
+							(CamelEwsFolder *ews_folder,
+							 const GPtrArray *words,
+							 const GPtrArray *uids,
+							 gint max_to_index,
+							 GPtrArray *unindexed_uids,
+							 GCancellable *cancellable);
 
 G_END_DECLS
 
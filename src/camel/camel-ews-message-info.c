@@ -30,6 +30,8 @@ struct _CamelEwsMessageInfoPrivate {
 	guint32 server_flags;
 	gint32 item_type;
 	gchar *change_key;
+	guint32 server_categories_hash;
+	guint32 server_follow_up_hash;
 };
 
 enum {
@@ -37,6 +39,8 @@ enum {
 	PROP_SERVER_FLAGS,
 	PROP_ITEM_TYPE,
 	PROP_CHANGE_KEY,
+	PROP_SERVER_CATEGORIES_HASH,
+	PROP_SERVER_FOLLOW_UP_HASH
 };
 
 G_DEFINE_TYPE (CamelEwsMessageInfo, camel_ews_message_info, CAMEL_TYPE_MESSAGE_INFO_BASE)
@@ -62,6 +66,8 @@ ews_message_info_clone (const CamelMessageInfo *mi,
 		camel_ews_message_info_set_server_flags (emi_result, camel_ews_message_info_get_server_flags (emi));
 		camel_ews_message_info_set_item_type (emi_result, camel_ews_message_info_get_item_type (emi));
 		camel_ews_message_info_take_change_key (emi_result, camel_ews_message_info_dup_change_key (emi));
+		camel_ews_message_info_set_server_categories_hash (emi_result, camel_ews_message_info_get_server_categories_hash (emi));
+		camel_ews_message_info_set_server_follow_up_hash (emi_result, camel_ews_message_info_get_server_follow_up_hash (emi));
 	}
 
 	return result;
@@ -93,6 +99,12 @@ ews_message_info_load (CamelMessageInfo *mi,
 			camel_ews_message_info_set_server_flags (emi, g_ascii_strtoll (values[0], NULL, 10));
 			camel_ews_message_info_set_item_type (emi, g_ascii_strtoll (values[1], NULL, 10));
 			camel_ews_message_info_set_change_key (emi, values[2]);
+
+			/* Not stored by older versions */
+			if (values[3] && values[4]) {
+				camel_ews_message_info_set_server_categories_hash (emi, g_ascii_strtoull (values[3], NULL, 10));
+				camel_ews_message_info_set_server_follow_up_hash (emi, g_ascii_strtoull (values[4], NULL, 10));
+			}
 		}
 
 		g_strfreev (values);
@@ -118,10 +130,12 @@ ews_message_info_save (const CamelMessageInfo *mi,
 
 	emi = CAMEL_EWS_MESSAGE_INFO (mi);
 
-	g_string_append_printf (bdata_str, "%u %d %s",
+	g_string_append_printf (bdata_str, "%u %d %s %u %u",
 		camel_ews_message_info_get_server_flags (emi),
 		camel_ews_message_info_get_item_type (emi),
-		camel_ews_message_info_get_change_key (emi));
+		camel_ews_message_info_get_change_key (emi),
+		camel_ews_message_info_get_server_categories_hash (emi),
+		camel_ews_message_info_get_server_follow_up_hash (emi));
 
 	return TRUE;
 }
@@ -146,6 +160,14 @@ ews_message_info_set_property (GObject *object,
 	case PROP_CHANGE_KEY:
 		camel_ews_message_info_set_change_key (emi, g_value_get_string (value));
 		return;
+
+	case PROP_SERVER_CATEGORIES_HASH:
+		camel_ews_message_info_set_server_categories_hash (emi, g_value_get_uint (value));
+		return;
+
+	case PROP_SERVER_FOLLOW_UP_HASH:
+		camel_ews_message_info_set_server_follow_up_hash (emi, g_value_get_uint (value));
+		return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -172,6 +194,14 @@ ews_message_info_get_property (GObject *object,
 	case PROP_CHANGE_KEY:
 		g_value_take_string (value, camel_ews_message_info_dup_change_key (emi));
 		return;
+
+	case PROP_SERVER_CATEGORIES_HASH:
+		g_value_set_uint (value, camel_ews_message_info_get_server_categories_hash (emi));
+		return;
+
+	case PROP_SERVER_FOLLOW_UP_HASH:
+		g_value_set_uint (value, camel_ews_message_info_get_server_follow_up_hash (emi));
+		return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -257,6 +287,42 @@ camel_ews_message_info_class_init (CamelEwsMessageInfoClass *class)
 			NULL,
 			NULL,
 			G_PARAM_READWRITE));
+
+	/**
+	 * CamelEwsMessageInfo:server-categories-hash
+	 *
+	 * Hash of the categories last known to be stored on the server,
+	 * or 0 when not known.
+	 *
+	 * Since: 3.32
+	 **/
+	g_object_class_install_property (
+		object_class,
+		PROP_SERVER_CATEGORIES_HASH,
+		g_param_spec_uint (
+			"server-categories-hash",
+			"Server Categories Hash",
+			NULL,
+			0, G_MAXUINT32, 0,
+			G_PARAM_READWRITE));
+
+	/**
+	 * CamelEwsMessageInfo:server-follow-up-hash
+	 *
+	 * Hash of the follow-up flag last known to be stored on the server,
+	 * or 0 when not known.
+	 *
+	 * Since: 3.32
+	 **/
+	g_object_class_install_property (
+		object_class,
+		PROP_SERVER_FOLLOW_UP_HASH,
+		g_param_spec_uint (
+			"server-follow-up-hash",
+			"Server Follow Up Hash",
+			NULL,
+			0, G_MAXUINT32, 0,
+			G_PARAM_READWRITE));
 }
 
 static void
@@ -429,3 +495,93 @@ camel_ews_message_info_take_change_key (CamelEwsMessageInfo *emi,
 
 	return changed;
 }
+
+guint32
+camel_ews_message_info_get_server_categories_hash (const CamelEwsMessageInfo *emi)
+{
+	CamelMessageInfo *mi;
+	guint32 result;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_MESSAGE_INFO (emi), 0);
+
+	mi = CAMEL_MESSAGE_INFO (emi);
+
+	camel_message_info_property_lock (mi);
+	result = emi->priv->server_categories_hash;
+	camel_message_info_property_unlock (mi);
+
+	return result;
+}
+
+gboolean
+camel_ews_message_info_set_server_categories_hash (CamelEwsMessageInfo *emi,
+						   guint32 hash)
+{
+	CamelMessageInfo *mi;
+	gboolean changed;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_MESSAGE_INFO (emi), FALSE);
+
+	mi = CAMEL_MESSAGE_INFO (emi);
+
+	camel_message_info_property_lock (mi);
+
+	changed = emi->priv->server_categories_hash != hash;
+
+	if (changed)
+		emi->priv->server_categories_hash = hash;
+
+	camel_message_info_property_unlock (mi);
+
+	if (changed && !camel_message_info_get_abort_notifications (mi)) {
+		g_object_notify (G_OBJECT (emi), "server-categories-hash");
+		camel_message_info_set_dirty (mi, TRUE);
+	}
+
+	return changed;
+}
+
+guint32
+camel_ews_message_info_get_server_follow_up_hash (const CamelEwsMessageInfo *emi)
+{
+	CamelMessageInfo *mi;
+	guint32 result;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_MESSAGE_INFO (emi), 0);
+
+	mi = CAMEL_MESSAGE_INFO (emi);
+
+	camel_message_info_property_lock (mi);
+	result = emi->priv->server_follow_up_hash;
+	camel_message_info_property_unlock (mi);
+
+	return result;
+}
+
+gboolean
+camel_ews_message_info_set_server_follow_up_hash (CamelEwsMessageInfo *emi,
+						  guint32 hash)
+{
+	CamelMessageInfo *mi;
+	gboolean changed;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_MESSAGE_INFO (emi), FALSE);
+
+	mi = CAMEL_MESSAGE_INFO (emi);
+
+	camel_message_info_property_lock (mi);
+
+	changed = emi->priv->server_follow_up_hash != hash;
+
+	if (changed)
+		emi->priv->server_follow_up_hash = hash;
+
+	camel_message_info_property_unlock (mi);
+
+	if (changed && !camel_message_info_get_abort_notifications (mi)) {
+		g_object_notify (G_OBJECT (emi), "server-follow-up-hash");
+		camel_message_info_set_dirty (mi, TRUE);
+	}
+
+	return changed;
+}
@@ -75,6 +75,16 @@ gboolean	camel_ews_message_info_set_change_key	(CamelEwsMessageInfo *emi,
 							 const gchar *change_key);
 gboolean	camel_ews_message_info_take_change_key	(CamelEwsMessageInfo *emi,
 							 gchar *change_key);
+guint32		camel_ews_message_info_get_server_categories_hash
+							(const CamelEwsMessageInfo *emi);
+gboolean	camel_ews_message_info_set_server_categories_hash
+							(CamelEwsMessageInfo *emi,
+							 guint32 hash);
+guint32		camel_ews_message_info_get_server_follow_up_hash
+							(const CamelEwsMessageInfo *emi);
+gboolean	camel_ews_message_info_set_server_follow_up_hash
+							(CamelEwsMessageInfo *emi,
+							 guint32 hash);
 
 G_END_DECLS
 
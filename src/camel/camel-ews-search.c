@@ -157,10 +157,17 @@ ews_search_result_match_none (CamelSExp *sexp,
 	return result;
 }
 
-static GPtrArray *
-ews_search_items_to_ptr_array (const GSList *items)
+typedef struct _EwsSearchFoundData {
+	GPtrArray *uids;
+	GHashTable *only_uids; /* nullable */
+} EwsSearchFoundData;
+
+/* Adds the found items to the result as soon as each page is received */
+static gboolean
+ews_search_found_items_cb (const GSList *items,
+			   gpointer user_data)
 {
-	GPtrArray *matches = NULL;
+	EwsSearchFoundData *fd = user_data;
 	const GSList *link;
 
 	for (link = items; link; link = g_slist_next (link)) {
@@ -174,20 +181,40 @@ ews_search_items_to_ptr_array (const GSList *items)
 		if (!id || !id->id)
 			continue;
 
-		if (!matches)
-			matches = g_ptr_array_new ();
+		if (fd->only_uids && !g_hash_table_contains (fd->only_uids, id->id))
+			continue;
+
+		g_ptr_array_add (fd->uids, (gpointer) camel_pstring_strdup (id->id));
+	}
 
-		g_ptr_array_add (matches, (gpointer) camel_pstring_strdup (id->id));
+	return TRUE;
+}
+
+static CamelSExpResult *
+ews_search_result_from_uids (CamelSExp *sexp,
+			     CamelFolderSearch *search,
+			     GPtrArray *uids)
+{
+	CamelSExpResult *result;
+
+	if (camel_folder_search_get_current_message_info (search)) {
+		result = camel_sexp_result_new (sexp, CAMEL_SEXP_RES_BOOL);
+		result->value.boolean = (uids && uids->len > 0);
+	} else {
+		result = camel_sexp_result_new (sexp, CAMEL_SEXP_RES_ARRAY_PTR);
+		result->value.ptrarray = g_ptr_array_ref (uids);
 	}
 
-	return matches;
+	return result;
 }
 
 static CamelSExpResult *
 ews_search_process_criteria (CamelSExp *sexp,
 			     CamelFolderSearch *search,
 			     CamelEwsStore *ews_store,
-			     const GPtrArray *words)
+			     const GPtrArray *words,
+			     GPtrArray *indexed_matches,
+			     const GPtrArray *unindexed_uids)
 {
 	CamelSExpResult *result;
 	CamelEwsSearch *ews_search = CAMEL_EWS_SEARCH (search);
@@ -225,8 +252,7 @@ ews_search_process_criteria (CamelSExp *sexp,
 
 		if (can_search) {
 			EwsFolderId *fid;
-			GSList *found_items = NULL;
-			gboolean includes_last_item = FALSE;
+			EwsSearchFoundData fd;
 			GString *expression;
 			guint ii;
 
@@ -252,21 +278,34 @@ ews_search_process_criteria (CamelSExp *sexp,
 			if (words->len >= 2)
 				g_string_append (expression, ")");
 
-			if (e_ews_connection_find_folder_items_sync (
-				connection, EWS_PRIORITY_MEDIUM,
+			/* The server answers only for the messages not in the body index */
+			fd.uids = indexed_matches ? g_ptr_array_ref (indexed_matches) : g_ptr_array_new ();
+			fd.only_uids = NULL;
+
+			if (indexed_matches && unindexed_uids) {
+				fd.only_uids = g_hash_table_new (g_str_hash, g_str_equal);
+
+				for (ii = 0; ii < unindexed_uids->len; ii++)
+					g_hash_table_add (fd.only_uids, g_ptr_array_index (unindexed_uids, ii));
+			}
+
+			if (e_ews_connection_find_folder_items_paged_sync (
+				connection, EWS_PRIORITY_HIGH,
 				fid, "IdOnly", NULL, NULL, expression->str, NULL,
-				E_EWS_FOLDER_TYPE_MAILBOX, &includes_last_item, &found_items,
-				e_ews_query_to_restriction,
+				E_EWS_FOLDER_TYPE_MAILBOX, e_ews_query_to_restriction,
+				0, ews_search_found_items_cb, &fd,
 				ews_search->priv->cancellable, &local_error)) {
-
-				uids = ews_search_items_to_ptr_array (found_items);
+				uids = g_ptr_array_ref (fd.uids);
 			}
 
-			g_slist_free_full (found_items, g_object_unref);
+			if (fd.only_uids)
+				g_hash_table_destroy (fd.only_uids);
+			g_ptr_array_unref (fd.uids);
 			g_string_free (expression, TRUE);
 			e_ews_folder_id_free (fid);
 		}
 
+		g_clear_object (&connection);
 		g_free (folder_id);
 	}
 
@@ -280,16 +319,10 @@ ews_search_process_criteria (CamelSExp *sexp,
 
 	if (!uids) {
 		/* Make like we've got an empty result */
-		uids = g_ptr_array_new ();
+		uids = indexed_matches ? g_ptr_array_ref (indexed_matches) : g_ptr_array_new ();
 	}
 
-	if (camel_folder_search_get_current_message_info (search)) {
-		result = camel_sexp_result_new (sexp, CAMEL_SEXP_RES_BOOL);
-		result->value.boolean = (uids && uids->len > 0);
-	} else {
-		result = camel_sexp_result_new (sexp, CAMEL_SEXP_RES_ARRAY_PTR);
-		result->value.ptrarray = g_ptr_array_ref (uids);
-	}
+	result = ews_search_result_from_uids (sexp, search, uids);
 
 	g_ptr_array_unref (uids);
 
@@ -353,9 +386,10 @@ ews_search_body_contains (CamelSExp *sexp,
 			  CamelFolderSearch *search)
 {
 	CamelEwsSearch *ews_search = CAMEL_EWS_SEARCH (search);
+	CamelEwsFolder *ews_folder;
 	CamelEwsStore *ews_store;
 	CamelSExpResult *result;
-	GPtrArray *words;
+	GPtrArray *words, *uids, *unindexed_uids, *indexed_matches = NULL;
 
 	/* Always do body-search server-side */
 	if (ews_search->priv->local_data_search) {
@@ -372,19 +406,72 @@ ews_search_body_contains (CamelSExp *sexp,
 		return ews_search_result_match_none (sexp, search);
 
 	ews_store = camel_ews_search_ref_store (CAMEL_EWS_SEARCH (search));
+	ews_folder = CAMEL_EWS_FOLDER (camel_folder_search_get_folder (search));
+	words = ews_search_gather_words (argv, 0, argc);
+
+	/* Answer from the body index first, for the cached messages */
+	if (words && ews_folder) {
+		CamelMessageInfo *info;
+
+		uids = g_ptr_array_new ();
+		unindexed_uids = g_ptr_array_new ();
+
+		info = camel_folder_search_get_current_message_info (search);
+		if (info) {
+			g_ptr_array_add (uids, (gpointer) camel_message_info_get_uid (info));
+		} else {
+			GPtrArray *summary = camel_folder_search_get_summary (search);
+			guint ii;
+
+			for (ii = 0; summary && ii < summary->len; ii++)
+				g_ptr_array_add (uids, g_ptr_array_index (summary, ii));
+		}
+
+		/* Online searches ask the server about the messages not indexed yet;
+		   offline searches index them, because there is nothing else to ask
+		   and the messages would be read from the cache anyway */
+		indexed_matches = camel_ews_folder_search_body_index (ews_folder, words, uids,
+			ews_store ? 0 : -1, unindexed_uids,
+			ews_search->priv->cancellable);
+
+		if (indexed_matches && (!unindexed_uids->len || !ews_store)) {
+			/* Everything known is answered; with no store (offline) the messages
+			   not in the cache cannot be searched anyway */
+			result = ews_search_result_from_uids (sexp, search, indexed_matches);
+		} else if (ews_store) {
+			result = ews_search_process_criteria (sexp, search, ews_store, words,
+				indexed_matches, indexed_matches ? unindexed_uids : NULL);
+		} else {
+			result = NULL;
+		}
+
+		if (indexed_matches)
+			g_ptr_array_unref (indexed_matches);
+		g_ptr_array_unref (unindexed_uids);
+		g_ptr_array_unref (uids);
+
+		if (result) {
+			g_ptr_array_free (words, TRUE);
+			g_clear_object (&ews_store);
+
+			return result;
+		}
+	}
 
 	/* This will be NULL if we're offline. Search from cache. */
 	if (!ews_store) {
+		if (words)
+			g_ptr_array_free (words, TRUE);
+
 		/* Chain up to parent's method. */
 		return CAMEL_FOLDER_SEARCH_CLASS (camel_ews_search_parent_class)->
 			body_contains (sexp, argc, argv, search);
 	}
 
-	words = ews_search_gather_words (argv, 0, argc);
-
-	result = ews_search_process_criteria (sexp, search, ews_store, words);
+	result = ews_search_process_criteria (sexp, search, ews_store, words, NULL, NULL);
 
-	g_ptr_array_free (words, TRUE);
+	if (words)
+		g_ptr_array_free (words, TRUE);
 	g_object_unref (ews_store);
 
 	return result;
@@ -19,10 +19,14 @@
 
 #include "evolution-ews-config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
-#include <string.h>
 #include "camel-ews-store-summary.h"
 
 #include "server/e-ews-folder.h"
@@ -33,10 +37,40 @@
 #define STORE_GROUP_NAME "##storepriv"
 #define CURRENT_SUMMARY_VERSION 3
 
+/* The summary file is saved in a binary format:
+ *   magic, format version, generation, number of groups,
+ *   then for each group its name, the folder full name,
+ *   the number of keys and the key/value pairs.
+ * The integers are little endian guint32 (the generation a guint64),
+ * the strings are prefixed with their guint32 length. The values
+ * are in the same form as in a GKeyFile, which is the in-memory
+ * representation. Older summaries are key files, which are
+ * converted on the next save.
+ *
+ * Changes of the folder counts are appended into a journal file,
+ * instead of rewriting the whole summary after each folder refresh.
+ * The journal starts with the magic and the generation of the summary
+ * file it belongs to, followed by length-prefixed records of the folder
+ * id, the counter kind and its value. */
+#define SUMMARY_MAGIC "EWSSTSUM"
+#define SUMMARY_MAGIC_LEN 8
+#define SUMMARY_FORMAT_VERSION 1
+#define JOURNAL_SUFFIX ".journal"
+#define JOURNAL_MAX_SIZE (64 * 1024)
+
+enum {
+	JOURNAL_KEY_TOTAL = 1,
+	JOURNAL_KEY_UNREAD = 2
+};
+
 struct _CamelEwsStoreSummaryPrivate {
 	GKeyFile *key_file;
 	gboolean dirty;
 	gchar *path;
+	gchar *journal_path;
+	guint64 generation; /* of the saved summary file */
+	GByteArray *journal_pending; /* records not written into the journal yet */
+	gsize journal_size;
 	/* Note: We use the *same* strings in both of these hash tables, and
 	 * only id_fname_hash has g_free() hooked up as the destructor func.
 	 * So entries must always be removed from fname_id_hash *first*. */
@@ -57,6 +91,8 @@ ews_store_summary_finalize (GObject *object)
 
 	g_key_file_free (priv->key_file);
 	g_free (priv->path);
+	g_free (priv->journal_path);
+	g_byte_array_free (priv->journal_pending, TRUE);
 	g_hash_table_destroy (priv->fname_id_hash);
 	g_hash_table_destroy (priv->id_fname_hash);
 	g_rec_mutex_clear (&priv->s_lock);
@@ -85,6 +121,7 @@ camel_ews_store_summary_init (CamelEwsStoreSummary *ews_summary)
 
 	ews_summary->priv->key_file = g_key_file_new ();
 	ews_summary->priv->dirty = FALSE;
+	ews_summary->priv->journal_pending = g_byte_array_new ();
 	ews_summary->priv->fname_id_hash = g_hash_table_new (g_str_hash, g_str_equal);
 	ews_summary->priv->id_fname_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	g_rec_mutex_init (&ews_summary->priv->s_lock);
@@ -144,6 +181,380 @@ load_id_fname_hash (CamelEwsStoreSummary *ews_summary)
 	g_slist_free (folders);
 }
 
+static void
+ews_ss_append_uint32 (GByteArray *bytes,
+		      guint32 value)
+{
+	value = GUINT32_TO_LE (value);
+	g_byte_array_append (bytes, (const guint8 *) &value, sizeof (guint32));
+}
+
+static void
+ews_ss_append_uint64 (GByteArray *bytes,
+		      guint64 value)
+{
+	value = GUINT64_TO_LE (value);
+	g_byte_array_append (bytes, (const guint8 *) &value, sizeof (guint64));
+}
+
+static void
+ews_ss_append_string (GByteArray *bytes,
+		      const gchar *str)
+{
+	guint32 len = str ? strlen (str) : 0;
+
+	ews_ss_append_uint32 (bytes, len);
+	if (len)
+		g_byte_array_append (bytes, (const guint8 *) str, len);
+}
+
+typedef struct _SummaryReader {
+	const guint8 *data;
+	gsize len;
+	gsize pos;
+} SummaryReader;
+
+static gboolean
+ews_ss_read_uint32 (SummaryReader *reader,
+		    guint32 *value)
+{
+	guint32 tmp;
+
+	if (reader->len - reader->pos < sizeof (guint32))
+		return FALSE;
+
+	memcpy (&tmp, reader->data + reader->pos, sizeof (guint32));
+	reader->pos += sizeof (guint32);
+	*value = GUINT32_FROM_LE (tmp);
+
+	return TRUE;
+}
+
+static gboolean
+ews_ss_read_uint64 (SummaryReader *reader,
+		    guint64 *value)
+{
+	guint64 tmp;
+
+	if (reader->len - reader->pos < sizeof (guint64))
+		return FALSE;
+
+	memcpy (&tmp, reader->data + reader->pos, sizeof (guint64));
+	reader->pos += sizeof (guint64);
+	*value = GUINT64_FROM_LE (tmp);
+
+	return TRUE;
+}
+
+/* Returns a newly allocated string, in @str */
+static gboolean
+ews_ss_read_string (SummaryReader *reader,
+		    gchar **str)
+{
+	guint32 len;
+
+	if (!ews_ss_read_uint32 (reader, &len) ||
+	    reader->len - reader->pos < len)
+		return FALSE;
+
+	*str = g_strndup ((const gchar *) reader->data + reader->pos, len);
+	reader->pos += len;
+
+	return TRUE;
+}
+
+static gboolean
+ews_ss_has_magic (const gchar *contents,
+		  gsize length)
+{
+	return length >= SUMMARY_MAGIC_LEN && memcmp (contents, SUMMARY_MAGIC, SUMMARY_MAGIC_LEN) == 0;
+}
+
+/* Must be called with the summary lock held; the full names of the folders
+ * are read from the file too, thus they are not built from the parents */
+static gboolean
+ews_ss_load_binary (CamelEwsStoreSummary *ews_summary,
+		    const gchar *contents,
+		    gsize length)
+{
+	CamelEwsStoreSummaryPrivate *priv = ews_summary->priv;
+	SummaryReader reader;
+	GSList *without_full_name = NULL, *link;
+	guint32 version, n_groups, n_keys, ii, jj;
+	guint64 generation;
+
+	reader.data = (const guint8 *) contents;
+	reader.len = length;
+	reader.pos = SUMMARY_MAGIC_LEN;
+
+	if (!ews_ss_read_uint32 (&reader, &version) ||
+	    version != SUMMARY_FORMAT_VERSION ||
+	    !ews_ss_read_uint64 (&reader, &generation) ||
+	    !ews_ss_read_uint32 (&reader, &n_groups))
+		return FALSE;
+
+	g_hash_table_remove_all (priv->fname_id_hash);
+	g_hash_table_remove_all (priv->id_fname_hash);
+
+	for (ii = 0; ii < n_groups; ii++) {
+		gchar *group = NULL, *full_name = NULL;
+
+		if (!ews_ss_read_string (&reader, &group) ||
+		    !ews_ss_read_string (&reader, &full_name) ||
+		    !ews_ss_read_uint32 (&reader, &n_keys)) {
+			g_free (group);
+			g_free (full_name);
+			break;
+		}
+
+		for (jj = 0; jj < n_keys; jj++) {
+			gchar *key = NULL, *value = NULL;
+
+			if (!ews_ss_read_string (&reader, &key) ||
+			    !ews_ss_read_string (&reader, &value)) {
+				g_free (key);
+				g_free (value);
+				break;
+			}
+
+			g_key_file_set_value (priv->key_file, group, key, value);
+
+			g_free (key);
+			g_free (value);
+		}
+
+		if (jj < n_keys) {
+			g_free (group);
+			g_free (full_name);
+			break;
+		}
+
+		if (g_strcmp0 (group, STORE_GROUP_NAME) == 0) {
+			g_free (group);
+			g_free (full_name);
+		} else if (full_name && *full_name) {
+			/* Both take ownership */
+			g_hash_table_insert (priv->fname_id_hash, full_name, group);
+			g_hash_table_insert (priv->id_fname_hash, group, full_name);
+		} else {
+			without_full_name = g_slist_prepend (without_full_name, group);
+			g_free (full_name);
+		}
+	}
+
+	if (ii < n_groups) {
+		g_slist_free_full (without_full_name, g_free);
+		return FALSE;
+	}
+
+	for (link = without_full_name; link; link = g_slist_next (link)) {
+		gchar *fname;
+
+		fname = build_full_name (ews_summary, link->data);
+		if (fname) {
+			g_hash_table_insert (priv->fname_id_hash, fname, link->data);
+			g_hash_table_insert (priv->id_fname_hash, link->data, fname);
+		} else {
+			g_warning ("Cannot build full name for folder %s", (const gchar *) link->data);
+			g_free (link->data);
+		}
+	}
+
+	g_slist_free (without_full_name);
+
+	priv->generation = generation;
+
+	return TRUE;
+}
+
+/* Must be called with the summary lock held */
+static void
+ews_ss_replay_journal (CamelEwsStoreSummary *ews_summary)
+{
+	CamelEwsStoreSummaryPrivate *priv = ews_summary->priv;
+	GMappedFile *mapped;
+	SummaryReader reader;
+	guint64 generation;
+
+	priv->journal_size = 0;
+
+	mapped = g_mapped_file_new (priv->journal_path, FALSE, NULL);
+	if (!mapped)
+		return;
+
+	reader.data = (const guint8 *) g_mapped_file_get_contents (mapped);
+	reader.len = g_mapped_file_get_length (mapped);
+	reader.pos = SUMMARY_MAGIC_LEN;
+
+	/* A journal left from another summary file is ignored */
+	if (ews_ss_has_magic ((const gchar *) reader.data, reader.len) &&
+	    ews_ss_read_uint64 (&reader, &generation) &&
+	    generation == priv->generation) {
+		guint32 record_len;
+
+		while (ews_ss_read_uint32 (&reader, &record_len) &&
+		       reader.len - reader.pos >= record_len) {
+			SummaryReader record;
+			gchar *folder_id = NULL;
+			guint32 kind;
+			guint64 value;
+
+			record.data = reader.data + reader.pos;
+			record.len = record_len;
+			record.pos = 0;
+
+			reader.pos += record_len;
+
+			if (!ews_ss_read_string (&record, &folder_id) ||
+			    !ews_ss_read_uint32 (&record, &kind) ||
+			    !ews_ss_read_uint64 (&record, &value)) {
+				g_free (folder_id);
+				reader.pos -= record_len;
+				break;
+			}
+
+			if (g_key_file_has_group (priv->key_file, folder_id)) {
+				if (kind == JOURNAL_KEY_TOTAL)
+					g_key_file_set_uint64 (priv->key_file, folder_id, "Total", value);
+				else if (kind == JOURNAL_KEY_UNREAD)
+					g_key_file_set_uint64 (priv->key_file, folder_id, "UnRead", value);
+			}
+
+			g_free (folder_id);
+		}
+
+		priv->journal_size = reader.len;
+
+		/* Broken by an interrupted write; new records cannot follow it */
+		if (reader.pos != reader.len)
+			priv->dirty = TRUE;
+	}
+
+	g_mapped_file_unref (mapped);
+}
+
+/* Must be called with the summary lock held */
+static void
+ews_ss_journal_counter (CamelEwsStoreSummary *ews_summary,
+			const gchar *folder_id,
+			guint32 kind,
+			guint64 value)
+{
+	GByteArray *record;
+
+	record = g_byte_array_new ();
+	ews_ss_append_string (record, folder_id);
+	ews_ss_append_uint32 (record, kind);
+	ews_ss_append_uint64 (record, value);
+
+	ews_ss_append_uint32 (ews_summary->priv->journal_pending, record->len);
+	g_byte_array_append (ews_summary->priv->journal_pending, record->data, record->len);
+
+	g_byte_array_free (record, TRUE);
+}
+
+/* Must be called with the summary lock held */
+static GByteArray *
+ews_ss_to_binary (CamelEwsStoreSummary *ews_summary)
+{
+	CamelEwsStoreSummaryPrivate *priv = ews_summary->priv;
+	GByteArray *bytes;
+	gchar **groups;
+	gsize n_groups, ii;
+
+	groups = g_key_file_get_groups (priv->key_file, &n_groups);
+
+	bytes = g_byte_array_new ();
+	g_byte_array_append (bytes, (const guint8 *) SUMMARY_MAGIC, SUMMARY_MAGIC_LEN);
+	ews_ss_append_uint32 (bytes, SUMMARY_FORMAT_VERSION);
+	ews_ss_append_uint64 (bytes, priv->generation);
+	ews_ss_append_uint32 (bytes, n_groups);
+
+	for (ii = 0; ii < n_groups; ii++) {
+		gchar **keys;
+		gsize n_keys, jj;
+
+		keys = g_key_file_get_keys (priv->key_file, groups[ii], &n_keys, NULL);
+
+		ews_ss_append_string (bytes, groups[ii]);
+		ews_ss_append_string (bytes, g_hash_table_lookup (priv->id_fname_hash, groups[ii]));
+		ews_ss_append_uint32 (bytes, keys ? n_keys : 0);
+
+		for (jj = 0; keys && jj < n_keys; jj++) {
+			gchar *value;
+
+			value = g_key_file_get_value (priv->key_file, groups[ii], keys[jj], NULL);
+
+			ews_ss_append_string (bytes, keys[jj]);
+			ews_ss_append_string (bytes, value);
+
+			g_free (value);
+		}
+
+		g_strfreev (keys);
+	}
+
+	g_strfreev (groups);
+
+	return bytes;
+}
+
+/* Must be called with the summary lock held */
+static gboolean
+ews_ss_append_journal (CamelEwsStoreSummary *ews_summary,
+		       GError **error)
+{
+	CamelEwsStoreSummaryPrivate *priv = ews_summary->priv;
+	GByteArray *bytes = priv->journal_pending;
+	gboolean success;
+	gint fd;
+
+	fd = g_open (priv->journal_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (fd == -1) {
+		g_set_error (
+			error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"%s", g_strerror (errno));
+		return FALSE;
+	}
+
+	/* A new journal, or one left from another summary file */
+	if (!priv->journal_size) {
+		GByteArray *header = g_byte_array_new ();
+
+		g_byte_array_append (header, (const guint8 *) SUMMARY_MAGIC, SUMMARY_MAGIC_LEN);
+		ews_ss_append_uint64 (header, priv->generation);
+
+		success = ftruncate (fd, 0) == 0 &&
+			write (fd, header->data, header->len) == (gssize) header->len;
+
+		if (success)
+			priv->journal_size = header->len;
+
+		g_byte_array_free (header, TRUE);
+	} else {
+		success = TRUE;
+	}
+
+	success = success && write (fd, bytes->data, bytes->len) == (gssize) bytes->len;
+	if (!success) {
+		g_set_error (
+			error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"%s", g_strerror (errno));
+	}
+
+	close (fd);
+
+	if (success) {
+		priv->journal_size += bytes->len;
+		g_byte_array_set_size (bytes, 0);
+	} else {
+		/* Do not trust the journal, rewrite the whole summary instead */
+		priv->dirty = TRUE;
+	}
+
+	return success;
+}
+
 /* we only care about delete and ignore create */
 static void
 monitor_delete_cb (GFileMonitor *monitor,
@@ -174,6 +585,7 @@ camel_ews_store_summary_new (const gchar *path)
 	ews_summary = g_object_new (CAMEL_TYPE_EWS_STORE_SUMMARY, NULL);
 
 	ews_summary->priv->path = g_strdup (path);
+	ews_summary->priv->journal_path = g_strconcat (path, JOURNAL_SUFFIX, NULL);
 	file = g_file_new_for_path (path);
 	ews_summary->priv->monitor_delete = g_file_monitor_file (
 		file, G_FILE_MONITOR_SEND_MOVED, NULL, &error);
@@ -202,13 +614,43 @@ camel_ews_store_summary_load (CamelEwsStoreSummary *ews_summary,
                               GError **error)
 {
 	CamelEwsStoreSummaryPrivate *priv = ews_summary->priv;
-	gboolean ret;
+	GMappedFile *mapped;
+	gboolean ret, hashes_loaded = FALSE;
 	gint version;
 
 	S_LOCK (ews_summary);
 
-	ret = g_key_file_load_from_file (
-		priv->key_file, priv->path, 0, error);
+	mapped = g_mapped_file_new (priv->path, FALSE, error);
+	if (mapped) {
+		const gchar *contents = g_mapped_file_get_contents (mapped);
+		gsize length = g_mapped_file_get_length (mapped);
+
+		if (ews_ss_has_magic (contents, length)) {
+			ret = ews_ss_load_binary (ews_summary, contents, length);
+			if (ret) {
+				hashes_loaded = TRUE;
+				ews_ss_replay_journal (ews_summary);
+			} else {
+				g_set_error (
+					error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+					"Invalid summary file '%s'", priv->path);
+			}
+		} else {
+			/* A key file from an older version, converted on save */
+			ret = g_key_file_load_from_data (
+				priv->key_file, contents, length, 0, error);
+			priv->dirty = ret;
+		}
+
+		/* The groups read before the failure can include the version,
+		   thus drop them all, to get the folders again */
+		if (!ret)
+			camel_ews_store_summary_clear (ews_summary);
+
+		g_mapped_file_unref (mapped);
+	} else {
+		ret = FALSE;
+	}
 
 	version = g_key_file_get_integer (
 		priv->key_file, STORE_GROUP_NAME, "Version", NULL);
@@ -220,9 +662,12 @@ camel_ews_store_summary_load (CamelEwsStoreSummary *ews_summary,
 		g_key_file_set_integer (
 			priv->key_file, STORE_GROUP_NAME,
 			"Version", CURRENT_SUMMARY_VERSION);
+
+		hashes_loaded = FALSE;
 	}
 
-	load_id_fname_hash (ews_summary);
+	if (!hashes_loaded)
+		load_id_fname_hash (ews_summary);
 
 	S_UNLOCK (ews_summary);
 
@@ -236,27 +681,47 @@ camel_ews_store_summary_save (CamelEwsStoreSummary *ews_summary,
 	CamelEwsStoreSummaryPrivate *priv = ews_summary->priv;
 	gboolean ret = TRUE;
 	GFile *file;
-	gchar *contents = NULL;
+	GByteArray *contents;
 
 	S_LOCK (ews_summary);
 
-	if (!priv->dirty)
+	/* Only the counters changed, append them into the journal,
+	   unless it grew too large; then the summary is rewritten */
+	if (!priv->dirty && priv->journal_pending->len > 0 &&
+	    priv->journal_size + priv->journal_pending->len <= JOURNAL_MAX_SIZE &&
+	    ews_ss_append_journal (ews_summary, NULL))
+		goto exit;
+
+	if (!priv->dirty && !priv->journal_pending->len)
 		goto exit;
 
-	contents = g_key_file_to_data (
-		priv->key_file, NULL, NULL);
+	/* The journal of the previous generation is ignored when the removal
+	   below fails */
+	priv->generation++;
+
+	contents = ews_ss_to_binary (ews_summary);
 	file = g_file_new_for_path (priv->path);
 	ret = g_file_replace_contents (
-		file, contents, strlen (contents),
+		file, (const gchar *) contents->data, contents->len,
 		NULL, FALSE, G_FILE_CREATE_PRIVATE,
 		NULL, NULL, error);
 	g_object_unref (file);
-	priv->dirty = FALSE;
+	g_byte_array_free (contents, TRUE);
+
+	if (ret) {
+		g_unlink (priv->journal_path);
+		priv->journal_size = 0;
+		g_byte_array_set_size (priv->journal_pending, 0);
+		priv->dirty = FALSE;
+	} else {
+		/* The journal still belongs to the old file */
+		priv->generation--;
+		priv->dirty = TRUE;
+	}
 
 exit:
 	S_UNLOCK (ews_summary);
 
-	g_free (contents);
 	return ret;
 }
 
@@ -268,6 +733,7 @@ camel_ews_store_summary_clear (CamelEwsStoreSummary *ews_summary)
 
 	g_key_file_free (ews_summary->priv->key_file);
 	ews_summary->priv->key_file = g_key_file_new ();
+	g_byte_array_set_size (ews_summary->priv->journal_pending, 0);
 	ews_summary->priv->dirty = TRUE;
 
 	S_UNLOCK (ews_summary);
@@ -286,6 +752,8 @@ camel_ews_store_summary_remove (CamelEwsStoreSummary *ews_summary)
 		camel_ews_store_summary_clear (ews_summary);
 
 	ret = g_unlink (ews_summary->priv->path);
+	g_unlink (ews_summary->priv->journal_path);
+	ews_summary->priv->journal_size = 0;
 
 	S_UNLOCK (ews_summary);
 
@@ -518,10 +986,17 @@ camel_ews_store_summary_set_folder_unread (CamelEwsStoreSummary *ews_summary,
 {
 	S_LOCK (ews_summary);
 
-	g_key_file_set_uint64 (
-		ews_summary->priv->key_file,
-		folder_id, "UnRead", unread);
-	ews_summary->priv->dirty = TRUE;
+	if (!g_key_file_has_group (ews_summary->priv->key_file, folder_id)) {
+		g_key_file_set_uint64 (
+			ews_summary->priv->key_file,
+			folder_id, "UnRead", unread);
+		ews_summary->priv->dirty = TRUE;
+	} else if (g_key_file_get_uint64 (ews_summary->priv->key_file, folder_id, "UnRead", NULL) != unread) {
+		g_key_file_set_uint64 (
+			ews_summary->priv->key_file,
+			folder_id, "UnRead", unread);
+		ews_ss_journal_counter (ews_summary, folder_id, JOURNAL_KEY_UNREAD, unread);
+	}
 
 	S_UNLOCK (ews_summary);
 }
@@ -533,10 +1008,17 @@ camel_ews_store_summary_set_folder_total (CamelEwsStoreSummary *ews_summary,
 {
 	S_LOCK (ews_summary);
 
-	g_key_file_set_uint64 (
-		ews_summary->priv->key_file,
-		folder_id, "Total", total);
-	ews_summary->priv->dirty = TRUE;
+	if (!g_key_file_has_group (ews_summary->priv->key_file, folder_id)) {
+		g_key_file_set_uint64 (
+			ews_summary->priv->key_file,
+			folder_id, "Total", total);
+		ews_summary->priv->dirty = TRUE;
+	} else if (g_key_file_get_uint64 (ews_summary->priv->key_file, folder_id, "Total", NULL) != total) {
+		g_key_file_set_uint64 (
+			ews_summary->priv->key_file,
+			folder_id, "Total", total);
+		ews_ss_journal_counter (ews_summary, folder_id, JOURNAL_KEY_TOTAL, total);
+	}
 
 	S_UNLOCK (ews_summary);
 }
@@ -63,6 +63,14 @@
 
 #define FINFO_REFRESH_INTERVAL 60
 
+/* How long, in seconds, the folder counts read from the server are used */
+#define FOLDER_COUNTS_MAX_AGE 30
+/* The longest time, in seconds, a folder is not asked for changes,
+   even when its counts did not change, to get flag changes too */
+#define FOLDER_FULL_SYNC_INTERVAL (15 * 60)
+/* How many folders are asked for their counts in one GetFolder request */
+#define FOLDER_COUNTS_BATCH_SIZE 200
+
 #define UPDATE_LOCK(x) (g_rec_mutex_lock(&(x)->priv->update_lock))
 #define UPDATE_UNLOCK(x) (g_rec_mutex_unlock(&(x)->priv->update_lock))
 
@@ -75,17 +83,33 @@ struct _CamelEwsStorePrivate {
 	CamelEwsStoreOooAlertState ooo_alert_state;
 	gint password_expires_in_days;
 
-	gboolean listen_notifications;
-	guint subscription_key;
+	gboolean listen_notifications; /* guarded by connection_lock */
+	guint subscription_key; /* guarded by connection_lock */
 	guint update_folder_id;
 	guint update_folder_list_id;
 	GCancellable *updates_cancellable;
 	GSList *update_folder_names;
 	GRecMutex update_lock;
+	GHashTable *folder_last_used; /* gchar *full_name ~> gint64 *, g_get_real_time(); guarded by update_lock */
+	GHashTable *pending_item_events; /* gchar *folder_id ~> EwsItemEvents *; guarded by update_lock */
+	gboolean applying_item_events; /* the worker thread runs; guarded by update_lock */
+
+	GMutex folder_counts_lock;
+	GHashTable *folder_counts; /* gchar *folder_id ~> FolderCounts *, as read from the server */
+	gint64 folder_counts_time; /* g_get_monotonic_time() of the read */
+	gboolean folder_counts_reading; /* the lock is released while reading */
+	GCond folder_counts_cond; /* signaled when the reading is done */
+	GHashTable *folder_synced_time; /* gchar *folder_id ~> gint64 *, g_get_monotonic_time() of the last full sync */
+	GHashTable *notified_folder_ids; /* gchar *folder_id, changed as notified by the server */
 
 	GSList *public_folders; /* EEwsFolder * objects */
 };
 
+typedef struct _FolderCounts {
+	guint32 total;
+	guint32 unread;
+} FolderCounts;
+
 static gboolean	ews_store_construct	(CamelService *service, CamelSession *session,
 					 CamelProvider *provider, GError **error);
 
@@ -774,46 +798,329 @@ camel_ews_folder_list_update_thread (gpointer user_data)
 	return NULL;
 }
 
+typedef struct _UpdateFolderData {
+	gchar *folder_name;
+	gint64 last_used; /* G_MAXINT64 for the Inbox */
+} UpdateFolderData;
+
+static void
+update_folder_data_free (gpointer ptr)
+{
+	UpdateFolderData *ufd = ptr;
+
+	if (ufd) {
+		g_free (ufd->folder_name);
+		g_free (ufd);
+	}
+}
+
+/* The Inbox goes first, then the most recently used folders */
+static gint
+update_folder_data_compare (gconstpointer a,
+			    gconstpointer b)
+{
+	const UpdateFolderData *ufd1 = a, *ufd2 = b;
+
+	if (ufd1->last_used == ufd2->last_used)
+		return 0;
+
+	return ufd1->last_used > ufd2->last_used ? -1 : 1;
+}
+
+static void
+camel_ews_folder_update_worker (gpointer data,
+				gpointer user_data)
+{
+	UpdateFolderData *ufd = data;
+	struct ScheduleUpdateData *sud = user_data;
+	CamelFolder *folder;
+	GError *error = NULL;
+
+	if (!g_cancellable_is_cancelled (sud->cancellable)) {
+		folder = camel_store_get_folder_sync (CAMEL_STORE (sud->ews_store), ufd->folder_name, 0, sud->cancellable, NULL);
+		if (folder) {
+			camel_folder_refresh_info_sync (folder, sud->cancellable, &error);
+			g_object_unref (folder);
+		}
+
+		/* The failure of one folder does not stop the others */
+		if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: Failed to refresh '%s': %s\n", G_STRFUNC, ufd->folder_name, error->message);
+
+		g_clear_error (&error);
+	}
+
+	update_folder_data_free (ufd);
+}
+
 static gpointer
 camel_ews_folder_update_thread (gpointer user_data)
 {
 	struct ScheduleUpdateData *sud = user_data;
 	CamelEwsStore *ews_store = sud->ews_store;
-	GSList *update_folder_names, *l;
+	EEwsConnection *cnc;
+	GThreadPool *pool;
+	GSList *update_folder_names, *l, *to_update = NULL;
+	gchar *inbox_name = NULL;
+	gchar *inbox_id;
+	gint max_threads = 1;
 
 	g_return_val_if_fail (sud != NULL, NULL);
 
+	inbox_id = camel_ews_store_summary_get_folder_id_from_folder_type (ews_store->summary, CAMEL_FOLDER_TYPE_INBOX);
+	if (inbox_id) {
+		inbox_name = camel_ews_store_summary_get_folder_full_name (ews_store->summary, inbox_id, NULL);
+		g_free (inbox_id);
+	}
+
 	UPDATE_LOCK (ews_store);
 	update_folder_names = ews_store->priv->update_folder_names;
 	ews_store->priv->update_folder_names = NULL;
+
+	for (l = update_folder_names; l != NULL; l = l->next) {
+		UpdateFolderData *ufd;
+		gint64 *plast_used;
+
+		ufd = g_new0 (UpdateFolderData, 1);
+		ufd->folder_name = l->data; /* takes ownership */
+
+		if (g_strcmp0 (ufd->folder_name, inbox_name) == 0) {
+			ufd->last_used = G_MAXINT64;
+		} else if (ews_store->priv->folder_last_used) {
+			plast_used = g_hash_table_lookup (ews_store->priv->folder_last_used, ufd->folder_name);
+			if (plast_used)
+				ufd->last_used = *plast_used;
+		}
+
+		to_update = g_slist_prepend (to_update, ufd);
+	}
 	UPDATE_UNLOCK (ews_store);
 
-	for (l = update_folder_names; l != NULL && !g_cancellable_is_cancelled (sud->cancellable); l = l->next) {
-		const gchar *folder_name = l->data;
-		CamelFolder *folder;
-		GError *error = NULL;
+	g_slist_free (update_folder_names);
+	g_free (inbox_name);
 
-		folder = camel_store_get_folder_sync (CAMEL_STORE (ews_store), folder_name, 0, sud->cancellable, NULL);
-		if (folder == NULL)
-			continue;
+	to_update = g_slist_sort (to_update, update_folder_data_compare);
 
-		camel_folder_refresh_info_sync (folder, sud->cancellable, &error);
-		g_object_unref (folder);
+	/* Refresh as many folders at once as many requests the connection
+	   can have in flight; the rest wait in the pool, in the order */
+	cnc = camel_ews_store_ref_connection (ews_store);
+	if (cnc) {
+		max_threads = MAX (1, e_ews_connection_get_concurrent_connections (cnc));
+		g_object_unref (cnc);
+	}
 
-		if (error != NULL) {
-			g_warning ("%s: %s\n", G_STRFUNC, error->message);
-			g_clear_error (&error);
-			break;
-		}
+	pool = g_thread_pool_new (camel_ews_folder_update_worker, sud, CLAMP (g_slist_length (to_update), 1, max_threads), FALSE, NULL);
+
+	for (l = to_update; l != NULL; l = l->next) {
+		if (pool && !g_cancellable_is_cancelled (sud->cancellable))
+			g_thread_pool_push (pool, l->data, NULL);
+		else
+			update_folder_data_free (l->data);
 	}
 
-	g_slist_free_full (update_folder_names, g_free);
-	update_folder_names = NULL;
+	g_slist_free (to_update);
+
+	if (pool)
+		g_thread_pool_free (pool, FALSE, TRUE);
+
 	free_schedule_update_data (sud);
 
 	return NULL;
 }
 
+/* Notes that the user worked with the folder now, thus it gets
+   updated sooner than the other folders on server notifications */
+void
+camel_ews_store_note_folder_used (CamelEwsStore *ews_store,
+				  const gchar *folder_name)
+{
+	gint64 *plast_used;
+
+	g_return_if_fail (CAMEL_IS_EWS_STORE (ews_store));
+	g_return_if_fail (folder_name != NULL);
+
+	UPDATE_LOCK (ews_store);
+
+	if (!ews_store->priv->folder_last_used)
+		ews_store->priv->folder_last_used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	plast_used = g_new0 (gint64, 1);
+	*plast_used = g_get_real_time ();
+
+	g_hash_table_insert (ews_store->priv->folder_last_used, g_strdup (folder_name), plast_used);
+
+	UPDATE_UNLOCK (ews_store);
+}
+
+/* Reads the counts of all the mail folders of the mailbox, with as few
+   requests as possible, into a new gchar *folder_id ~> FolderCounts * hash
+   table; it's called without the folder_counts_lock held */
+static GHashTable *
+ews_store_read_folder_counts_sync (CamelEwsStore *ews_store,
+				   GCancellable *cancellable)
+{
+	EEwsConnection *cnc;
+	EEwsAdditionalProps *add_props;
+	GHashTable *folder_counts;
+	GSList *folder_ids, *link, *batch = NULL;
+	guint n_batch = 0;
+
+	folder_counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	cnc = camel_ews_store_ref_connection (ews_store);
+	if (!cnc)
+		return folder_counts;
+
+	add_props = e_ews_additional_props_new ();
+	add_props->field_uri = g_strdup ("folder:TotalCount folder:UnreadCount");
+
+	folder_ids = camel_ews_store_summary_get_folders (ews_store->summary, NULL);
+
+	for (link = folder_ids; link; link = g_slist_next (link)) {
+		const gchar *fid = link->data;
+
+		if (fid && camel_ews_store_summary_get_folder_type (ews_store->summary, fid, NULL) == E_EWS_FOLDER_TYPE_MAILBOX &&
+		    !g_str_equal (fid, EWS_PUBLIC_FOLDER_ROOT_ID) &&
+		    !g_str_equal (fid, EWS_FOREIGN_FOLDER_ROOT_ID) &&
+		    !camel_ews_store_summary_get_foreign (ews_store->summary, fid, NULL) &&
+		    !camel_ews_store_summary_get_public (ews_store->summary, fid, NULL)) {
+			batch = g_slist_prepend (batch, e_ews_folder_id_new (fid, NULL, FALSE));
+			n_batch++;
+		}
+
+		if (batch && (n_batch >= FOLDER_COUNTS_BATCH_SIZE || !g_slist_next (link))) {
+			GSList *folders = NULL, *flink;
+			GError *local_error = NULL;
+
+			if (e_ews_connection_get_folder_sync (cnc, EWS_PRIORITY_MEDIUM, "IdOnly", add_props,
+				batch, &folders, cancellable, &local_error)) {
+				for (flink = folders; flink; flink = g_slist_next (flink)) {
+					EEwsFolder *folder = flink->data;
+					const EwsFolderId *folder_id;
+					FolderCounts *counts;
+
+					if (!folder || e_ews_folder_is_error (folder))
+						continue;
+
+					folder_id = e_ews_folder_get_id (folder);
+					if (!folder_id || !folder_id->id)
+						continue;
+
+					counts = g_new0 (FolderCounts, 1);
+					counts->total = e_ews_folder_get_total_count (folder);
+					counts->unread = e_ews_folder_get_unread_count (folder);
+
+					g_hash_table_insert (folder_counts, g_strdup (folder_id->id), counts);
+				}
+
+				g_slist_free_full (folders, g_object_unref);
+			} else {
+				/* The folders without counts are synchronized fully */
+				g_clear_error (&local_error);
+			}
+
+			g_slist_free_full (batch, (GDestroyNotify) e_ews_folder_id_free);
+			batch = NULL;
+			n_batch = 0;
+
+			if (g_cancellable_is_cancelled (cancellable))
+				break;
+		}
+	}
+
+	g_slist_free_full (batch, (GDestroyNotify) e_ews_folder_id_free);
+	g_slist_free_full (folder_ids, g_free);
+	e_ews_additional_props_free (add_props);
+	g_object_unref (cnc);
+
+	return folder_counts;
+}
+
+/* Returns whether the folder's total and unread counts on the server match
+   those stored in the summary, with no server notification about the folder
+   since the last check, thus it is not needed to ask for its changes. The
+   counts of all folders are read at once and reused for a short time, thus
+   a check of many folders costs a single round trip, not one per folder.
+
+   Equal counts alone do not mean the folder is unchanged, flags can change
+   and a message can be replaced by another, thus the check is used only
+   while the server notifications are on, which tell about such changes,
+   and the folder is still fully synchronized once per FOLDER_FULL_SYNC_INTERVAL,
+   to cover changes made while the notification stream was reconnecting. */
+gboolean
+camel_ews_store_folder_counts_unchanged_sync (CamelEwsStore *ews_store,
+					      const gchar *folder_id,
+					      GCancellable *cancellable)
+{
+	FolderCounts *counts;
+	gint64 *psynced_time, now;
+	gboolean notifications_on;
+	gboolean unchanged = FALSE;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_STORE (ews_store), FALSE);
+	g_return_val_if_fail (folder_id != NULL, FALSE);
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&ews_store->priv->connection_lock);
+	notifications_on = ews_store->priv->listen_notifications && ews_store->priv->subscription_key != 0;
+	g_mutex_unlock (&ews_store->priv->connection_lock);
+
+	g_mutex_lock (&ews_store->priv->folder_counts_lock);
+
+	psynced_time = g_hash_table_lookup (ews_store->priv->folder_synced_time, folder_id);
+
+	if (!g_hash_table_remove (ews_store->priv->notified_folder_ids, folder_id) && notifications_on &&
+	    psynced_time && now - *psynced_time < FOLDER_FULL_SYNC_INTERVAL * G_USEC_PER_SEC) {
+		/* Only one thread reads the counts, the others wait for it */
+		while (ews_store->priv->folder_counts_reading) {
+			g_cond_wait (&ews_store->priv->folder_counts_cond, &ews_store->priv->folder_counts_lock);
+		}
+
+		if (now - ews_store->priv->folder_counts_time >= FOLDER_COUNTS_MAX_AGE * G_USEC_PER_SEC) {
+			GHashTable *folder_counts;
+
+			ews_store->priv->folder_counts_reading = TRUE;
+
+			/* Do not block the notifications with the I/O */
+			g_mutex_unlock (&ews_store->priv->folder_counts_lock);
+			folder_counts = ews_store_read_folder_counts_sync (ews_store, cancellable);
+			g_mutex_lock (&ews_store->priv->folder_counts_lock);
+
+			g_hash_table_destroy (ews_store->priv->folder_counts);
+			ews_store->priv->folder_counts = folder_counts;
+			ews_store->priv->folder_counts_time = g_get_monotonic_time ();
+			ews_store->priv->folder_counts_reading = FALSE;
+
+			g_cond_broadcast (&ews_store->priv->folder_counts_cond);
+		}
+
+		/* Notified while the counts were being read */
+		if (g_hash_table_remove (ews_store->priv->notified_folder_ids, folder_id))
+			g_hash_table_remove (ews_store->priv->folder_counts, folder_id);
+
+		counts = g_hash_table_lookup (ews_store->priv->folder_counts, folder_id);
+		unchanged = counts &&
+			counts->total == camel_ews_store_summary_get_folder_total (ews_store->summary, folder_id, NULL) &&
+			counts->unread == camel_ews_store_summary_get_folder_unread (ews_store->summary, folder_id, NULL);
+
+		/* Used only once, the next check reads them again */
+		g_hash_table_remove (ews_store->priv->folder_counts, folder_id);
+	}
+
+	if (!unchanged) {
+		/* The caller synchronizes the folder now */
+		psynced_time = g_new0 (gint64, 1);
+		*psynced_time = now;
+
+		g_hash_table_insert (ews_store->priv->folder_synced_time, g_strdup (folder_id), psynced_time);
+	}
+
+	g_mutex_unlock (&ews_store->priv->folder_counts_lock);
+
+	return unchanged;
+}
+
 static void
 run_update_thread (CamelEwsStore *ews_store,
 		   gboolean folder_list,
@@ -875,6 +1182,11 @@ get_folder_names_to_update (gpointer key,
 	folder_name = camel_ews_store_summary_get_folder_full_name (ews_store->summary, folder_id, NULL);
 	if (folder_name != NULL)
 		ews_store->priv->update_folder_names = g_slist_prepend (ews_store->priv->update_folder_names, folder_name);
+
+	/* Changes like flag updates do not change the folder counts */
+	g_mutex_lock (&ews_store->priv->folder_counts_lock);
+	g_hash_table_add (ews_store->priv->notified_folder_ids, g_strdup (folder_id));
+	g_mutex_unlock (&ews_store->priv->folder_counts_lock);
 }
 
 static void
@@ -980,6 +1292,213 @@ exit:
 	UPDATE_UNLOCK (ews_store);
 }
 
+/* The item changes of one folder, as received through the notifications;
+   the events of the same item are merged, like a created and then deleted
+   item is only deleted */
+typedef struct _EwsItemEvents {
+	gchar *folder_id;
+	GHashTable *created_ids; /* gchar * */
+	GHashTable *modified_ids; /* gchar * */
+	GHashTable *deleted_ids; /* gchar * */
+} EwsItemEvents;
+
+static void
+ews_item_events_free (gpointer ptr)
+{
+	EwsItemEvents *ie = ptr;
+
+	if (ie) {
+		g_free (ie->folder_id);
+		g_hash_table_destroy (ie->created_ids);
+		g_hash_table_destroy (ie->modified_ids);
+		g_hash_table_destroy (ie->deleted_ids);
+		g_free (ie);
+	}
+}
+
+static void
+ews_item_events_add (EwsItemEvents *ie,
+		     EEwsNotificationEventType type,
+		     const gchar *item_id)
+{
+	switch (type) {
+	case E_EWS_NOTIFICATION_EVENT_CREATED:
+		g_hash_table_add (ie->created_ids, g_strdup (item_id));
+		break;
+	case E_EWS_NOTIFICATION_EVENT_MODIFIED:
+		/* A created item is read as a whole anyway */
+		if (!g_hash_table_contains (ie->created_ids, item_id))
+			g_hash_table_add (ie->modified_ids, g_strdup (item_id));
+		break;
+	case E_EWS_NOTIFICATION_EVENT_DELETED:
+		g_hash_table_remove (ie->created_ids, item_id);
+		g_hash_table_remove (ie->modified_ids, item_id);
+		g_hash_table_add (ie->deleted_ids, g_strdup (item_id));
+		break;
+	default:
+		g_warn_if_reached ();
+		break;
+	}
+}
+
+static void
+ews_store_add_item_event (GHashTable *item_events,
+			  const gchar *folder_id,
+			  EEwsNotificationEventType type,
+			  const gchar *item_id)
+{
+	EwsItemEvents *ie;
+
+	ie = g_hash_table_lookup (item_events, folder_id);
+	if (!ie) {
+		ie = g_new0 (EwsItemEvents, 1);
+		ie->folder_id = g_strdup (folder_id);
+		ie->created_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		ie->modified_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		ie->deleted_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		g_hash_table_insert (item_events, ie->folder_id, ie);
+	}
+
+	ews_item_events_add (ie, type, item_id);
+}
+
+/* Merges the events of one folder into the item_events;
+   the deletions go last, thus they win over the other events */
+static void
+ews_store_merge_item_events (GHashTable *item_events,
+			     EwsItemEvents *ie)
+{
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init (&iter, ie->created_ids);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ews_store_add_item_event (item_events, ie->folder_id, E_EWS_NOTIFICATION_EVENT_CREATED, key);
+	}
+
+	g_hash_table_iter_init (&iter, ie->modified_ids);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ews_store_add_item_event (item_events, ie->folder_id, E_EWS_NOTIFICATION_EVENT_MODIFIED, key);
+	}
+
+	g_hash_table_iter_init (&iter, ie->deleted_ids);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ews_store_add_item_event (item_events, ie->folder_id, E_EWS_NOTIFICATION_EVENT_DELETED, key);
+	}
+}
+
+/* Applies the item events of all the folders; what cannot be applied
+   directly is left on the folder refresh */
+static void
+ews_store_apply_item_events_sync (CamelEwsStore *ews_store,
+				  GHashTable *item_events,
+				  GCancellable *cancellable)
+{
+	GHashTable *folder_ids;
+	GHashTableIter iter;
+	gpointer value;
+
+	folder_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_iter_init (&iter, item_events);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		EwsItemEvents *ie = value;
+		CamelFolder *folder = NULL;
+		gchar *folder_name;
+		gboolean applied = FALSE;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		folder_name = camel_ews_store_summary_get_folder_full_name (ews_store->summary, ie->folder_id, NULL);
+		if (folder_name)
+			folder = camel_store_get_folder_sync (CAMEL_STORE (ews_store), folder_name, 0, cancellable, NULL);
+
+		if (folder) {
+			GList *created_ids, *modified_ids, *deleted_ids;
+			GSList *created = NULL, *modified = NULL, *deleted = NULL;
+			GList *link;
+			GError *error = NULL;
+
+			created_ids = g_hash_table_get_keys (ie->created_ids);
+			modified_ids = g_hash_table_get_keys (ie->modified_ids);
+			deleted_ids = g_hash_table_get_keys (ie->deleted_ids);
+
+			for (link = created_ids; link; link = g_list_next (link))
+				created = g_slist_prepend (created, link->data);
+			for (link = modified_ids; link; link = g_list_next (link))
+				modified = g_slist_prepend (modified, link->data);
+			for (link = deleted_ids; link; link = g_list_next (link))
+				deleted = g_slist_prepend (deleted, link->data);
+
+			applied = camel_ews_folder_apply_notified_items_sync (CAMEL_EWS_FOLDER (folder),
+				created, modified, deleted, cancellable, &error);
+
+			if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+				g_warning ("%s: Failed to apply notified changes in '%s': %s\n", G_STRFUNC, folder_name, error->message);
+
+			g_slist_free (created);
+			g_slist_free (modified);
+			g_slist_free (deleted);
+			g_list_free (created_ids);
+			g_list_free (modified_ids);
+			g_list_free (deleted_ids);
+			g_clear_error (&error);
+			g_object_unref (folder);
+		}
+
+		if (!applied && folder_name)
+			g_hash_table_insert (folder_ids, g_strdup (ie->folder_id), GINT_TO_POINTER (1));
+
+		g_free (folder_name);
+	}
+
+	if (g_hash_table_size (folder_ids) > 0 && !g_cancellable_is_cancelled (cancellable))
+		schedule_folder_update (ews_store, folder_ids);
+
+	g_hash_table_destroy (folder_ids);
+}
+
+/* The only thread applying the notified item events of the store; the events
+   received meanwhile are merged per folder and applied in the next round */
+static gpointer
+camel_ews_store_apply_item_events_thread (gpointer user_data)
+{
+	CamelEwsStore *ews_store = user_data;
+	CamelEwsStorePrivate *priv = ews_store->priv;
+
+	while (TRUE) {
+		GHashTable *item_events;
+		GCancellable *cancellable;
+
+		UPDATE_LOCK (ews_store);
+
+		if (!priv->updates_cancellable ||
+		    g_cancellable_is_cancelled (priv->updates_cancellable) ||
+		    !g_hash_table_size (priv->pending_item_events)) {
+			g_hash_table_remove_all (priv->pending_item_events);
+			priv->applying_item_events = FALSE;
+			UPDATE_UNLOCK (ews_store);
+			break;
+		}
+
+		item_events = priv->pending_item_events;
+		priv->pending_item_events = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, ews_item_events_free);
+		cancellable = g_object_ref (priv->updates_cancellable);
+
+		UPDATE_UNLOCK (ews_store);
+
+		ews_store_apply_item_events_sync (ews_store, item_events, cancellable);
+
+		g_hash_table_destroy (item_events);
+		g_object_unref (cancellable);
+	}
+
+	g_object_unref (ews_store);
+
+	return NULL;
+}
+
 static void
 camel_ews_store_server_notification_cb (CamelEwsStore *ews_store,
 					GSList *events,
@@ -988,13 +1507,20 @@ camel_ews_store_server_notification_cb (CamelEwsStore *ews_store,
 	GSList *l;
 	gboolean update_folder = FALSE;
 	gboolean update_folder_list = FALSE;
-	GHashTable *folder_ids;
+	GHashTable *folder_ids, *item_events;
+	GHashTableIter iter;
+	gpointer key, value;
 
 	g_return_if_fail (ews_store != NULL);
 	g_return_if_fail (ews_store->priv != NULL);
 
 	folder_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	item_events = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, ews_item_events_free);
 
+	/* The item events carry the item IDs, thus those items are applied
+	   into the folder directly. Events without them, like those sent after
+	   a lost subscription, when some events could be missed, make
+	   the whole folder refresh. */
 	for (l = events; l != NULL; l = l->next) {
 		EEwsNotificationEvent *event = l->data;
 
@@ -1003,7 +1529,9 @@ camel_ews_store_server_notification_cb (CamelEwsStore *ews_store,
 			case E_EWS_NOTIFICATION_EVENT_DELETED:
 			case E_EWS_NOTIFICATION_EVENT_MODIFIED:
 				UPDATE_LOCK (ews_store);
-				if (event->is_item) {
+				if (event->is_item && event->item_id && event->folder_id) {
+					ews_store_add_item_event (item_events, event->folder_id, event->type, event->item_id);
+				} else if (event->is_item) {
 					update_folder = TRUE;
 					if (!g_hash_table_lookup (folder_ids, event->folder_id))
 						g_hash_table_insert (
@@ -1016,7 +1544,13 @@ camel_ews_store_server_notification_cb (CamelEwsStore *ews_store,
 			case E_EWS_NOTIFICATION_EVENT_MOVED:
 			case E_EWS_NOTIFICATION_EVENT_COPIED:
 				UPDATE_LOCK (ews_store);
-				if (event->is_item) {
+				if (event->is_item && event->item_id && event->folder_id && event->old_folder_id &&
+				    (event->type == E_EWS_NOTIFICATION_EVENT_COPIED || event->old_item_id)) {
+					/* A move is a removal from the old folder and a creation in the new */
+					if (event->type == E_EWS_NOTIFICATION_EVENT_MOVED)
+						ews_store_add_item_event (item_events, event->old_folder_id, E_EWS_NOTIFICATION_EVENT_DELETED, event->old_item_id);
+					ews_store_add_item_event (item_events, event->folder_id, E_EWS_NOTIFICATION_EVENT_CREATED, event->item_id);
+				} else if (event->is_item) {
 					update_folder = TRUE;
 					if (!g_hash_table_lookup (folder_ids, event->old_folder_id))
 						g_hash_table_insert (
@@ -1035,11 +1569,41 @@ camel_ews_store_server_notification_cb (CamelEwsStore *ews_store,
 		}
 	}
 
+	UPDATE_LOCK (ews_store);
+
+	/* The folders being refreshed as a whole do not need the item events,
+	   neither those pending from the previous notifications */
+	g_hash_table_iter_init (&iter, folder_ids);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		g_hash_table_remove (ews_store->priv->pending_item_events, key);
+	}
+
+	if (ews_store->priv->updates_cancellable) {
+		g_hash_table_iter_init (&iter, item_events);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			if (!g_hash_table_contains (folder_ids, key))
+				ews_store_merge_item_events (ews_store->priv->pending_item_events, value);
+		}
+
+		if (!ews_store->priv->applying_item_events &&
+		    g_hash_table_size (ews_store->priv->pending_item_events) > 0) {
+			GThread *thread;
+
+			ews_store->priv->applying_item_events = TRUE;
+
+			thread = g_thread_new (NULL, camel_ews_store_apply_item_events_thread, g_object_ref (ews_store));
+			g_thread_unref (thread);
+		}
+	}
+
+	UPDATE_UNLOCK (ews_store);
+
 	if (update_folder)
 		schedule_folder_update (ews_store, folder_ids);
 	if (update_folder_list)
 		schedule_folder_list_update (ews_store);
 
+	g_hash_table_destroy (item_events);
 	g_hash_table_destroy (folder_ids);
 }
 
@@ -1067,30 +1631,41 @@ start_notifications_thread (gpointer data)
 	struct HandleNotificationsData *hnd = data;
 	CamelEwsStore *ews_store = hnd->ews_store;
 	EEwsConnection *cnc;
+	gboolean listen_notifications;
+	guint subscription_key;
 
 	cnc = camel_ews_store_ref_connection (ews_store);
 	if (!cnc)
 		goto exit;
 
-	if (ews_store->priv->listen_notifications) {
-		if (ews_store->priv->subscription_key != 0)
+	g_mutex_lock (&ews_store->priv->connection_lock);
+	listen_notifications = ews_store->priv->listen_notifications;
+	subscription_key = ews_store->priv->subscription_key;
+	g_mutex_unlock (&ews_store->priv->connection_lock);
+
+	if (listen_notifications) {
+		if (subscription_key != 0)
 			goto exit;
 
 		e_ews_connection_enable_notifications_sync (
 			cnc,
 			hnd->folders,
-			&ews_store->priv->subscription_key);
+			&subscription_key);
 	} else {
-		if (ews_store->priv->subscription_key == 0)
+		if (subscription_key == 0)
 			goto exit;
 
 		e_ews_connection_disable_notifications_sync (
 			cnc,
-			ews_store->priv->subscription_key);
+			subscription_key);
 
-		ews_store->priv->subscription_key = 0;
+		subscription_key = 0;
 	}
 
+	g_mutex_lock (&ews_store->priv->connection_lock);
+	ews_store->priv->subscription_key = subscription_key;
+	g_mutex_unlock (&ews_store->priv->connection_lock);
+
 exit:
 	handle_notifications_data_free (hnd);
 	g_clear_object (&cnc);
@@ -1177,10 +1752,16 @@ camel_ews_store_listen_notifications_cb (CamelEwsStore *ews_store,
 					 GParamSpec *spec,
 					 CamelEwsSettings *ews_settings)
 {
-	if (ews_store->priv->listen_notifications == camel_ews_settings_get_listen_notifications (ews_settings))
+	gboolean listen_notifications = camel_ews_settings_get_listen_notifications (ews_settings);
+
+	g_mutex_lock (&ews_store->priv->connection_lock);
+	if (ews_store->priv->listen_notifications == listen_notifications) {
+		g_mutex_unlock (&ews_store->priv->connection_lock);
 		return;
+	}
 
-	ews_store->priv->listen_notifications = !ews_store->priv->listen_notifications;
+	ews_store->priv->listen_notifications = listen_notifications;
+	g_mutex_unlock (&ews_store->priv->connection_lock);
 
 	camel_ews_store_handle_notifications (ews_store, ews_settings);
 }
@@ -1190,7 +1771,13 @@ camel_ews_store_check_all_cb (CamelEwsStore *ews_store,
 			      GParamSpec *spec,
 			      CamelEwsSettings *ews_settings)
 {
-	if (!ews_store->priv->listen_notifications)
+	gboolean listen_notifications;
+
+	g_mutex_lock (&ews_store->priv->connection_lock);
+	listen_notifications = ews_store->priv->listen_notifications;
+	g_mutex_unlock (&ews_store->priv->connection_lock);
+
+	if (!listen_notifications)
 		return;
 
 	camel_ews_store_handle_notifications (ews_store, ews_settings);
@@ -1239,7 +1826,9 @@ ews_connect_sync (CamelService *service,
 
 	g_free (auth_mech);
 
+	g_mutex_lock (&priv->connection_lock);
 	priv->listen_notifications = FALSE;
+	g_mutex_unlock (&priv->connection_lock);
 
 	if (success) {
 		CamelEwsStoreOooAlertState state;
@@ -1356,6 +1945,7 @@ stop_pending_updates (CamelEwsStore *ews_store)
 
 	g_slist_free_full (priv->update_folder_names, g_free);
 	priv->update_folder_names = NULL;
+	g_hash_table_remove_all (priv->pending_item_events);
 	UPDATE_UNLOCK (ews_store);
 }
 
@@ -1417,6 +2007,10 @@ ews_disconnect_sync (CamelService *service,
 	ews_store_unset_connection_locked (ews_store);
 	g_mutex_unlock (&ews_store->priv->connection_lock);
 
+	/* Write what the folder refreshes left unsaved */
+	if (ews_store->summary)
+		camel_ews_store_summary_save (ews_store->summary, NULL);
+
 	service_class = CAMEL_SERVICE_CLASS (camel_ews_store_parent_class);
 	return service_class->disconnect_sync (service, clean, cancellable, error);
 }
@@ -3691,6 +4285,17 @@ ews_store_finalize (GObject *object)
 	g_mutex_clear (&ews_store->priv->connection_lock);
 	g_rec_mutex_clear (&ews_store->priv->update_lock);
 
+	if (ews_store->priv->folder_last_used)
+		g_hash_table_destroy (ews_store->priv->folder_last_used);
+
+	g_hash_table_destroy (ews_store->priv->pending_item_events);
+
+	g_mutex_clear (&ews_store->priv->folder_counts_lock);
+	g_cond_clear (&ews_store->priv->folder_counts_cond);
+	g_hash_table_destroy (ews_store->priv->folder_counts);
+	g_hash_table_destroy (ews_store->priv->folder_synced_time);
+	g_hash_table_destroy (ews_store->priv->notified_folder_ids);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_ews_store_parent_class)->finalize (object);
 }
@@ -3791,4 +4396,10 @@ camel_ews_store_init (CamelEwsStore *ews_store)
 	g_mutex_init (&ews_store->priv->get_finfo_lock);
 	g_mutex_init (&ews_store->priv->connection_lock);
 	g_rec_mutex_init (&ews_store->priv->update_lock);
+	g_mutex_init (&ews_store->priv->folder_counts_lock);
+	g_cond_init (&ews_store->priv->folder_counts_cond);
+	ews_store->priv->folder_counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	ews_store->priv->folder_synced_time = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	ews_store->priv->notified_folder_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	ews_store->priv->pending_item_events = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, ews_item_events_free);
 }
@@ -107,6 +107,13 @@ CamelEwsStoreOooAlertState
 						(const CamelEwsStore *ews_store);
 void		camel_ews_store_unset_oof_settings_state
 						(CamelEwsStore *ews_store);
+void		camel_ews_store_note_folder_used
+						(CamelEwsStore *ews_store,
+						 const gchar *folder_name);
+gboolean	camel_ews_store_folder_counts_unchanged_sync
+						(CamelEwsStore *ews_store,
+						 const gchar *folder_id,
+						 GCancellable *cancellable);
 
 
 G_END_DECLS
@@ -482,6 +482,59 @@ ews_utils_gather_server_user_flags (ESoapMessage *msg,
 	return g_slist_reverse (out_user_flags);
 }
 
+/* Returns a hash of the categories, which would be stored on the server
+   for the @mi; it's never 0, which stands for an unknown server state. */
+guint32
+ews_utils_hash_server_user_flags (CamelMessageInfo *mi)
+{
+	GSList *user_flags, *link;
+	guint32 hash = 0;
+
+	user_flags = ews_utils_gather_server_user_flags (NULL, mi);
+	user_flags = g_slist_sort (user_flags, (GCompareFunc) g_strcmp0);
+
+	for (link = user_flags; link; link = g_slist_next (link)) {
+		hash = (hash * 31) + g_str_hash (link->data);
+	}
+
+	g_slist_free_full (user_flags, g_free);
+
+	return hash ? hash : 1;
+}
+
+/* Returns a hash of the follow-up flag, as written by ews_utils_update_followup_flags();
+   it's never 0, which stands for an unknown server state. */
+guint32
+ews_utils_hash_followup_flags (CamelMessageInfo *mi)
+{
+	const gchar *tags[] = { "follow-up", "completed-on", "due-by" };
+	guint32 hash = 0;
+	guint ii;
+
+	camel_message_info_property_lock (mi);
+
+	for (ii = 0; ii < G_N_ELEMENTS (tags); ii++) {
+		const gchar *value = camel_message_info_get_user_tag (mi, tags[ii]);
+
+		hash = (hash * 31) + ((value && *value) ? g_str_hash (value) : 0);
+	}
+
+	camel_message_info_property_unlock (mi);
+
+	return hash ? hash : 1;
+}
+
+/* Remembers the current categories and follow-up flag of the @mi
+   as those stored on the server */
+void
+ews_utils_set_server_labels (CamelMessageInfo *mi)
+{
+	CamelEwsMessageInfo *emi = CAMEL_EWS_MESSAGE_INFO (mi);
+
+	camel_ews_message_info_set_server_categories_hash (emi, ews_utils_hash_server_user_flags (mi));
+	camel_ews_message_info_set_server_follow_up_hash (emi, ews_utils_hash_followup_flags (mi));
+}
+
 static void
 ews_utils_merge_server_user_flags (EEwsItem *item,
                                    CamelMessageInfo *mi)
@@ -592,39 +645,160 @@ ews_utils_get_server_flags (EEwsItem *item)
 	return server_flags;
 }
 
+/* The formatted mailboxes are cached, because the same addresses repeat
+   across many messages, like in mailing lists; the least recently used
+   entries are dropped when the cache is full, which is after
+   CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE entries */
+typedef struct _MailboxCacheEntry {
+	gchar *name;
+	gchar *email;
+	gchar *routing_type;
+	const gchar *formatted; /* camel_pstring */
+	GList *link; /* in mailbox_cache_lru */
+} MailboxCacheEntry;
+
+static GMutex mailbox_cache_lock;
+static GHashTable *mailbox_cache = NULL; /* MailboxCacheEntry * ~> itself */
+static GQueue mailbox_cache_lru = G_QUEUE_INIT; /* MailboxCacheEntry *, the most recently used first */
+
+static guint
+mailbox_cache_entry_hash (gconstpointer ptr)
+{
+	const MailboxCacheEntry *entry = ptr;
+	guint hash = 0;
+
+	if (entry->name)
+		hash = g_str_hash (entry->name);
+	if (entry->email)
+		hash = (hash * 31) + g_str_hash (entry->email);
+	if (entry->routing_type)
+		hash = (hash * 31) + g_str_hash (entry->routing_type);
+
+	return hash;
+}
+
+static gboolean
+mailbox_cache_entry_equal (gconstpointer ptr1,
+			   gconstpointer ptr2)
+{
+	const MailboxCacheEntry *entry1 = ptr1, *entry2 = ptr2;
+
+	return g_strcmp0 (entry1->name, entry2->name) == 0 &&
+		g_strcmp0 (entry1->email, entry2->email) == 0 &&
+		g_strcmp0 (entry1->routing_type, entry2->routing_type) == 0;
+}
+
+static void
+mailbox_cache_entry_free (gpointer ptr)
+{
+	MailboxCacheEntry *entry = ptr;
+
+	if (entry) {
+		g_free (entry->name);
+		g_free (entry->email);
+		g_free (entry->routing_type);
+		camel_pstring_free (entry->formatted);
+		g_free (entry);
+	}
+}
+
 static gchar *
-form_email_string_from_mb (EEwsConnection *cnc,
-                           const EwsMailbox *mb,
-                           GCancellable *cancellable)
+form_email_string_from_mb (const EwsMailbox *mb)
 {
-	if (mb) {
-		GString *str;
-		const gchar *email = NULL;
+	GString *str;
+	const gchar *email = NULL;
 
-		if (g_strcmp0 (mb->routing_type, "EX") == 0)
-			email = e_ews_item_util_strip_ex_address (mb->email);
+	if (g_strcmp0 (mb->routing_type, "EX") == 0)
+		email = e_ews_item_util_strip_ex_address (mb->email);
 
-		str = g_string_new ("");
-		if (mb->name && mb->name[0]) {
-			g_string_append (str, mb->name);
-			g_string_append (str, " ");
-		}
+	str = g_string_new ("");
+	if (mb->name && mb->name[0]) {
+		g_string_append (str, mb->name);
+		g_string_append (str, " ");
+	}
 
-		if (mb->email || email) {
-			g_string_append (str, "<");
-			g_string_append (str, email ? email : mb->email);
-			g_string_append (str, ">");
-		}
+	if (mb->email || email) {
+		g_string_append (str, "<");
+		g_string_append (str, email ? email : mb->email);
+		g_string_append (str, ">");
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+/* Returns the mailbox formatted as "Name <email>", as a camel_pstring,
+   which is freed with camel_pstring_free(), or NULL when @mb is NULL */
+const gchar *
+camel_ews_utils_ref_mailbox_string (const EwsMailbox *mb)
+{
+	MailboxCacheEntry key, *entry;
+	const gchar *formatted;
 
-		return g_string_free (str, FALSE);
-	} else
+	if (!mb)
 		return NULL;
+
+	key.name = mb->name;
+	key.email = mb->email;
+	key.routing_type = mb->routing_type;
+
+	g_mutex_lock (&mailbox_cache_lock);
+
+	if (!mailbox_cache)
+		mailbox_cache = g_hash_table_new_full (mailbox_cache_entry_hash, mailbox_cache_entry_equal, mailbox_cache_entry_free, NULL);
+
+	entry = g_hash_table_lookup (mailbox_cache, &key);
+	if (entry) {
+		g_queue_unlink (&mailbox_cache_lru, entry->link);
+		g_queue_push_head_link (&mailbox_cache_lru, entry->link);
+	} else {
+		if (g_queue_get_length (&mailbox_cache_lru) >= CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE) {
+			MailboxCacheEntry *oldest = g_queue_pop_tail (&mailbox_cache_lru);
+
+			g_hash_table_remove (mailbox_cache, oldest);
+		}
+
+		entry = g_new0 (MailboxCacheEntry, 1);
+		entry->name = g_strdup (mb->name);
+		entry->email = g_strdup (mb->email);
+		entry->routing_type = g_strdup (mb->routing_type);
+		entry->formatted = camel_pstring_add (form_email_string_from_mb (mb), TRUE);
+
+		g_queue_push_head (&mailbox_cache_lru, entry);
+		entry->link = g_queue_peek_head_link (&mailbox_cache_lru);
+
+		g_hash_table_add (mailbox_cache, entry);
+	}
+
+	formatted = camel_pstring_strdup (entry->formatted);
+
+	g_mutex_unlock (&mailbox_cache_lock);
+
+	return formatted;
+}
+
+/* Whether @mb is in the cache of the formatted mailboxes; it does not
+   change the order of the cached entries */
+gboolean
+camel_ews_utils_mailbox_string_is_cached (const EwsMailbox *mb)
+{
+	MailboxCacheEntry key;
+	gboolean is_cached;
+
+	g_return_val_if_fail (mb != NULL, FALSE);
+
+	key.name = mb->name;
+	key.email = mb->email;
+	key.routing_type = mb->routing_type;
+
+	g_mutex_lock (&mailbox_cache_lock);
+	is_cached = mailbox_cache && g_hash_table_contains (mailbox_cache, &key);
+	g_mutex_unlock (&mailbox_cache_lock);
+
+	return is_cached;
 }
 
 static gchar *
-form_recipient_list (EEwsConnection *cnc,
-                     const GSList *recipients,
-                     GCancellable *cancellable)
+form_recipient_list (const GSList *recipients)
 {
 	const GSList *l;
 	GString *str = NULL;
@@ -634,21 +808,109 @@ form_recipient_list (EEwsConnection *cnc,
 
 	for (l = recipients; l != NULL; l = g_slist_next (l)) {
 		EwsMailbox *mb = (EwsMailbox *) l->data;
-		gchar *mb_str = form_email_string_from_mb (cnc, mb, cancellable);
+		const gchar *mb_str = camel_ews_utils_ref_mailbox_string (mb);
 
 		if (!str)
 			str = g_string_new ("");
 		else
 			str = g_string_append (str, ", ");
 
-		str = g_string_append (str, mb_str);
+		if (mb_str)
+			str = g_string_append (str, mb_str);
 
-		g_free (mb_str);
+		camel_pstring_free (mb_str);
 	}
 
 	return g_string_free (str, FALSE);
 }
 
+static void
+ews_utils_headers_append (CamelNameValueArray *headers,
+			  GString *name,
+			  GString *value)
+{
+	/* Strip trailing white-space, including the folding */
+	while (value->len > 0 && g_ascii_isspace (value->str[value->len - 1])) {
+		g_string_truncate (value, value->len - 1);
+	}
+
+	camel_name_value_array_append (headers, name->str, value->str);
+
+	g_string_truncate (name, 0);
+	g_string_truncate (value, 0);
+}
+
+/* Parses RFC 822 headers, like those of the PidTagTransportMessageHeaders
+   property, into a CamelNameValueArray in one pass, without constructing
+   a stream, a parser and a MIME part for them. Like the MIME parser, it
+   keeps the folded lines as they are and it stops at the first empty line.
+   Returns NULL, when there are no headers. */
+CamelNameValueArray *
+camel_ews_utils_parse_headers (const gchar *str)
+{
+	CamelNameValueArray *headers;
+	GString *name, *value;
+	const gchar *line, *eol, *colon;
+
+	headers = camel_name_value_array_new ();
+	name = g_string_sized_new (32);
+	value = g_string_sized_new (256);
+
+	for (line = str; line && *line; line = eol ? eol + 1 : NULL) {
+		gsize line_len;
+
+		eol = strchr (line, '\n');
+		line_len = eol ? eol - line : strlen (line);
+
+		if (line_len > 0 && line[line_len - 1] == '\r')
+			line_len--;
+
+		/* The end of the headers */
+		if (!line_len)
+			break;
+
+		/* A continuation of the previous header */
+		if (*line == ' ' || *line == '\t') {
+			if (name->len) {
+				g_string_append_c (value, '\n');
+				g_string_append_len (value, line, line_len);
+			}
+			continue;
+		}
+
+		if (name->len)
+			ews_utils_headers_append (headers, name, value);
+
+		colon = memchr (line, ':', line_len);
+		if (!colon || colon == line)
+			continue;
+
+		g_string_append_len (name, line, colon - line);
+		while (name->len > 0 && g_ascii_isspace (name->str[name->len - 1])) {
+			g_string_truncate (name, name->len - 1);
+		}
+
+		for (colon++; colon < line + line_len && (*colon == ' ' || *colon == '\t'); colon++) {
+			;
+		}
+
+		g_string_append_len (value, colon, line + line_len - colon);
+	}
+
+	if (name->len)
+		ews_utils_headers_append (headers, name, value);
+
+	g_string_free (name, TRUE);
+	g_string_free (value, TRUE);
+
+	if (!camel_name_value_array_get_length (headers)) {
+		camel_name_value_array_free (headers);
+		headers = NULL;
+	}
+
+	return headers;
+}
+
 static guint8 *
 get_md5_digest (const guchar *str)
 {
@@ -945,6 +1207,7 @@ camel_ews_utils_sync_updated_items (CamelEwsFolder *ews_folder,
 				changed = camel_ews_update_message_info_flags (folder_summary, mi, server_flags, NULL);
 				changed = camel_ews_utils_update_follow_up_flags (item, mi) || changed;
 				changed = camel_ews_utils_update_read_receipt_flags (item, mi, server_flags, FALSE) || changed;
+				ews_utils_set_server_labels (mi);
 
 				if (changed)
 					camel_folder_change_info_change_uid (change_info, id->id);
@@ -976,6 +1239,7 @@ camel_ews_utils_item_to_message_info (CamelEwsFolder *ews_folder,
 	CamelMessageInfo *mi = NULL;
 	const EwsId *id;
 	const EwsMailbox *from;
+	const gchar *from_str;
 	gchar *tmp;
 	EEwsItemType item_type;
 	const gchar *msg_headers;
@@ -1000,24 +1264,16 @@ camel_ews_utils_item_to_message_info (CamelEwsFolder *ews_folder,
 		msg_headers = NULL;
 
 	if (msg_headers && *msg_headers) {
-		CamelMimePart *part = camel_mime_part_new ();
-		CamelStream *stream;
-		CamelMimeParser *parser;
-
-		stream = camel_stream_mem_new_with_buffer (msg_headers, strlen (msg_headers));
-		parser = camel_mime_parser_new ();
-		camel_mime_parser_init_with_stream (parser, stream, NULL);
-		camel_mime_parser_scan_from (parser, FALSE);
-		g_object_unref (stream);
-
-		if (camel_mime_part_construct_from_parser_sync (part, parser, NULL, NULL)) {
-			mi = camel_folder_summary_info_new_from_headers (folder_summary, camel_medium_get_headers (CAMEL_MEDIUM (part)));
-			if (camel_medium_get_header (CAMEL_MEDIUM (part), "Disposition-Notification-To"))
+		CamelNameValueArray *headers;
+
+		headers = camel_ews_utils_parse_headers (msg_headers);
+		if (headers) {
+			mi = camel_folder_summary_info_new_from_headers (folder_summary, headers);
+			if (camel_name_value_array_get_named (headers, CAMEL_COMPARE_CASE_INSENSITIVE, "Disposition-Notification-To"))
 				message_requests_read_receipt = TRUE;
-		}
 
-		g_object_unref (parser);
-		g_object_unref (part);
+			camel_name_value_array_free (headers);
+		}
 	}
 
 	if (!mi)
@@ -1045,15 +1301,15 @@ camel_ews_utils_item_to_message_info (CamelEwsFolder *ews_folder,
 	from = e_ews_item_get_from (item);
 	if (!from)
 		from = e_ews_item_get_sender (item);
-	tmp = form_email_string_from_mb (cnc, from, cancellable);
-	camel_message_info_set_from (mi, tmp);
-	g_free (tmp);
+	from_str = camel_ews_utils_ref_mailbox_string (from);
+	camel_message_info_set_from (mi, from_str);
+	camel_pstring_free (from_str);
 
-	tmp = form_recipient_list (cnc, e_ews_item_get_to_recipients (item), cancellable);
+	tmp = form_recipient_list (e_ews_item_get_to_recipients (item));
 	camel_message_info_set_to (mi, tmp);
 	g_free (tmp);
 
-	tmp = form_recipient_list (cnc, e_ews_item_get_cc_recipients (item), cancellable);
+	tmp = form_recipient_list (e_ews_item_get_cc_recipients (item));
 	camel_message_info_set_cc (mi, tmp);
 	g_free (tmp);
 
@@ -1070,6 +1326,7 @@ camel_ews_utils_item_to_message_info (CamelEwsFolder *ews_folder,
 
 	camel_ews_utils_update_follow_up_flags (item, mi);
 	camel_ews_utils_update_read_receipt_flags (item, mi, server_flags, message_requests_read_receipt);
+	ews_utils_set_server_labels (mi);
 
 	camel_message_info_set_abort_notifications (mi, FALSE);
 
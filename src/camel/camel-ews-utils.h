@@ -49,6 +49,9 @@
 #define DRAFT	  ""
 #define PERSONAL  "Cabinet"
 
+/* How many formatted mailboxes are cached */
+#define CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE 512
+
 G_BEGIN_DECLS
 
 void		ews_utils_sync_folders		(CamelEwsStore *ews_store,
@@ -81,8 +84,12 @@ void		camel_ews_utils_sync_updated_items
 GSList *	ews_utils_gather_server_user_flags
 						(ESoapMessage *msg,
 						 CamelMessageInfo *mi);
+guint32		ews_utils_hash_server_user_flags
+						(CamelMessageInfo *mi);
 void		ews_utils_update_followup_flags (ESoapMessage *msg,
 						 CamelMessageInfo *mi);
+guint32		ews_utils_hash_followup_flags	(CamelMessageInfo *mi);
+void		ews_utils_set_server_labels	(CamelMessageInfo *mi);
 gchar *		camel_ews_utils_get_host_name	(CamelSettings *settings);
 gboolean	camel_ews_utils_delete_folders_from_summary_recursive
 						(CamelEwsStore *ews_store,
@@ -100,6 +107,12 @@ CamelMessageInfo * /* (transfer full) */
 						 GCancellable *cancellable);
 gboolean	camel_ews_utils_folder_is_drafts_folder
 						(CamelEwsFolder *ews_folder);
+const gchar *	camel_ews_utils_ref_mailbox_string /* camel_pstring */
+						(const EwsMailbox *mb);
+gboolean	camel_ews_utils_mailbox_string_is_cached
+						(const EwsMailbox *mb);
+CamelNameValueArray *
+		camel_ews_utils_parse_headers	(const gchar *str);
 
 
 G_END_DECLS
@@ -242,7 +242,7 @@ search_thread (gpointer user_data)
 		GError *error = NULL;
 
 		if (e_ews_connection_resolve_names_sync (
-			sid->conn, EWS_PRIORITY_MEDIUM, sid->search_text,
+			sid->conn, EWS_PRIORITY_HIGH, sid->search_text,
 			EWS_SEARCH_AD, NULL, FALSE, &mailboxes, NULL,
 			&sid->includes_last_item, sid->cancellable, &error)) {
 			GSList *iter;
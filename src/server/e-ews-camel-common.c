@@ -364,7 +364,7 @@ camel_ews_utils_create_mime_message (EEwsConnection *cnc,
 	}
 
 	res = e_ews_connection_create_items_sync (
-		cnc, EWS_PRIORITY_MEDIUM,
+		cnc, EWS_PRIORITY_HIGH,
 		disposition, NULL, fid,
 		create_mime_message_cb, create_data,
 		&ids, cancellable, error);
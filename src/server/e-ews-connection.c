@@ -51,11 +51,30 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_EWS_CONNECTION, EEwsConnectionPrivate))
 
-/* For the number of connections */
-#define EWS_CONNECTION_MAX_REQUESTS 1
-
 /* A chunk size limit when moving items in chunks. */
 #define EWS_MOVE_ITEMS_CHUNK_SIZE 500
+#define EWS_MOVE_ITEMS_MAX_CHUNK_SIZE 1000
+
+/* A page size of the paged FindItem request. */
+#define EWS_FIND_ITEMS_PAGE_SIZE 500
+#define EWS_FIND_ITEMS_MAX_PAGE_SIZE 1000
+
+/* Limits of the adaptive batch sizes, in percents of the default sizes */
+#define EWS_BATCH_SCALE_MIN 25
+#define EWS_BATCH_SCALE_MAX 400
+#define EWS_BATCH_SCALE_STEP 25
+
+/* Responses faster than this let the batches grow, slower make them shrink;
+   it's the time of a full batch, estimated from the time of the request */
+#define EWS_BATCH_FAST_RESPONSE_MS 3000
+#define EWS_BATCH_SLOW_RESPONSE_MS 15000
+
+/* A batch size of the GetItem request with multiple item IDs, as used by the callers */
+#define EWS_GET_ITEMS_BATCH_SIZE 100
+#define EWS_GET_ITEMS_MAX_BATCH_SIZE 500
+
+#define EWS_BATCH_ITEMS_KEY "ews-batch-items"
+#define EWS_BATCH_SIZE_KEY "ews-batch-size"
 
 #define QUEUE_LOCK(x) (g_rec_mutex_lock(&(x)->priv->queue_lock))
 #define QUEUE_UNLOCK(x) (g_rec_mutex_unlock(&(x)->priv->queue_lock))
@@ -68,7 +87,12 @@ static GMutex connecting;
 static GHashTable *loaded_connections_permissions = NULL;
 static gint comp_func (gconstpointer a, gconstpointer b);
 
+typedef struct _EwsGovernor EwsGovernor;
+
 static void ews_response_cb (SoupSession *session, SoupMessage *msg, gpointer data);
+static void ews_connection_schedule_next_request (EEwsConnection *cnc);
+static gboolean ews_next_request (gpointer _cnc);
+static void ews_connection_backoff_locked (EEwsConnection *cnc, gint wait_ms);
 
 static void	ews_connection_authenticate	(SoupSession *sess,
 						 SoupMessage *msg,
@@ -94,22 +118,39 @@ struct _EEwsConnectionPrivate {
 	/* Hash key for the loaded_connections_permissions table. */
 	gchar *hash_key;
 
+	/* Shared with the connections of the same account in this process */
+	EwsGovernor *governor;
+	GSList *parked_messages; /* EwsScheduleData *, waiting for the account's back off;
+				    used only in the soup_thread */
+
 	gchar *uri;
 	gchar *password;
 	gchar *email;
 	gchar *impersonate_user;
 
-	GSList *jobs;
-	GSList *active_job_queue;
+	GSList *jobs; /* EwsJobBucket *, sorted by priority, the highest first */
+	GQueue active_job_queue; /* EwsNode * */
 	GRecMutex queue_lock;
 	GMutex notification_lock;
 
 	GHashTable *subscriptions;
-	GSList *subscribed_folders;
 
 	EEwsServerVersion version;
 	gboolean backoff_enabled;
 
+	/* No request is sent before this time, when the server asked
+	   to back off; guarded by the queue_lock */
+	gint64 backoff_until; /* g_get_monotonic_time() */
+	GSource *backoff_source;
+
+	/* How many requests can be sent to the server at once */
+	guint concurrent_connections;
+
+	/* Percents of the default batch sizes, see e_ews_connection_get_batch_size();
+	   modified only in the soup_thread */
+	volatile gint batch_scale;
+	gint64 batch_grow_after; /* g_get_monotonic_time() */
+
 	/* Set to TRUE when this connection had been disconnected and cannot be used anymore */
 	gboolean disconnected_flag;
 };
@@ -119,7 +160,9 @@ enum {
 	PROP_PASSWORD,
 	PROP_PROXY_RESOLVER,
 	PROP_SETTINGS,
-	PROP_SOURCE
+	PROP_SOURCE,
+	PROP_CONCURRENT_CONNECTIONS,
+	PROP_BATCH_SCALE
 };
 
 enum {
@@ -133,6 +176,7 @@ static guint signals[LAST_SIGNAL];
 static guint notification_key = 1;
 
 typedef struct _EwsNode EwsNode;
+typedef struct _EwsJobBucket EwsJobBucket;
 typedef struct _EwsAsyncData EwsAsyncData;
 typedef struct _EwsEventsAsyncData EwsEventsAsyncData;
 typedef struct _EwsUrls EwsUrls;
@@ -153,6 +197,10 @@ struct _EwsAsyncData {
 	EEwsFolderType folder_type;
 	EEwsConnection *cnc;
 	gchar *user_photo; /* base64-encoded, as GetUserPhoto result */
+
+	/* Frees the items received incrementally, which had not been
+	   taken by the finish function, like on failure or cancel */
+	ESoapNodeFn items_free_fn;
 };
 
 struct _EwsNode {
@@ -165,6 +213,39 @@ struct _EwsNode {
 
 	GCancellable *cancellable;
 	gulong cancel_handler_id;
+
+	/* Either a job bucket's 'nodes' or the active_job_queue,
+	   NULL when the node is not queued; guarded by the queue_lock */
+	GQueue *queue;
+	GList *queue_link;
+
+	gint64 sent_time; /* g_get_monotonic_time() */
+
+	/* Whether the "server is busy" message is pushed to the cancellable */
+	gboolean backoff_message;
+};
+
+/* The back off state of one account, shared by its connections living in
+   the same process, like those of the address book and its OAB downloads, or
+   of the calendars opened by one factory process. The mail, the calendars and
+   the address book usually run in different processes, each with its own
+   state. The concurrent requests are limited by each connection itself.
+   The key is the EWS URL and the user name. */
+struct _EwsGovernor {
+	gint ref_count;
+	gchar *key;
+	GMutex lock;
+
+	gint64 backoff_until; /* g_get_monotonic_time() */
+};
+
+static GMutex governors_lock;
+static GHashTable *governors = NULL; /* gchar *key ~> EwsGovernor * */
+
+/* All the waiting jobs of the same priority, in the order of arrival */
+struct _EwsJobBucket {
+	gint pri;
+	GQueue nodes; /* EwsNode * */
 };
 
 struct _EwsUrls {
@@ -197,6 +278,9 @@ ews_connection_error_quark (void)
 static void
 async_data_free (EwsAsyncData *async_data)
 {
+	if (async_data->items_free_fn)
+		async_data->items_free_fn (NULL, async_data);
+
 	g_free (async_data->user_photo);
 	g_free (async_data);
 }
@@ -213,6 +297,8 @@ e_ews_notification_event_free (EEwsNotificationEvent *event)
 	if (event != NULL) {
 		g_free (event->folder_id);
 		g_free (event->old_folder_id);
+		g_free (event->item_id);
+		g_free (event->old_item_id);
 		g_free (event);
 	}
 }
@@ -438,6 +524,102 @@ ews_node_new ()
 	return node;
 }
 
+static EwsGovernor *
+ews_governor_ref_for_account (CamelEwsSettings *settings,
+			      const gchar *uri)
+{
+	EwsGovernor *governor;
+	gchar *hosturl, *user, *key;
+
+	hosturl = camel_ews_settings_dup_hosturl (settings);
+	user = camel_network_settings_dup_user (CAMEL_NETWORK_SETTINGS (settings));
+	key = g_strdup_printf ("%s@%s", user, (hosturl && *hosturl) ? hosturl : uri);
+	g_free (hosturl);
+	g_free (user);
+
+	g_mutex_lock (&governors_lock);
+
+	if (!governors)
+		governors = g_hash_table_new (g_str_hash, g_str_equal);
+
+	governor = g_hash_table_lookup (governors, key);
+	if (governor) {
+		governor->ref_count++;
+		g_free (key);
+	} else {
+		governor = g_new0 (EwsGovernor, 1);
+		governor->ref_count = 1;
+		governor->key = key; /* takes ownership */
+		g_mutex_init (&governor->lock);
+
+		g_hash_table_insert (governors, governor->key, governor);
+	}
+
+	g_mutex_unlock (&governors_lock);
+
+	return governor;
+}
+
+static void
+ews_governor_unref (EwsGovernor *governor)
+{
+	g_mutex_lock (&governors_lock);
+
+	governor->ref_count--;
+
+	if (!governor->ref_count) {
+		g_hash_table_remove (governors, governor->key);
+		if (!g_hash_table_size (governors)) {
+			g_hash_table_destroy (governors);
+			governors = NULL;
+		}
+
+		g_mutex_clear (&governor->lock);
+		g_free (governor->key);
+		g_free (governor);
+	}
+
+	g_mutex_unlock (&governors_lock);
+}
+
+/* Requests of the highest priority can use one more slot than the others,
+   thus the interactive operations are not starved by the background ones */
+static guint
+ews_connection_get_slots_for_priority (EEwsConnection *cnc,
+				       gint pri)
+{
+	return e_ews_connection_get_concurrent_connections (cnc) + (pri >= EWS_PRIORITY_HIGH ? 1 : 0);
+}
+
+/* Returns the time, in milliseconds, to back off for, when any connection
+   of the account had been asked to, or 0 when the request can be sent */
+static gint
+ews_governor_get_backoff_ms (EwsGovernor *governor)
+{
+	gint64 now = g_get_monotonic_time ();
+	gint res = 0;
+
+	g_mutex_lock (&governor->lock);
+
+	if (governor->backoff_until > now) {
+		res = (governor->backoff_until - now) / G_TIME_SPAN_MILLISECOND;
+		res = MAX (res, 1);
+	}
+
+	g_mutex_unlock (&governor->lock);
+
+	return res;
+}
+
+static void
+ews_governor_backoff (EwsGovernor *governor,
+		      gint64 until)
+{
+	g_mutex_lock (&governor->lock);
+	governor->backoff_until = MAX (governor->backoff_until, until);
+	g_mutex_unlock (&governor->lock);
+}
+
 static gboolean
 autodiscover_parse_protocol (xmlNode *node,
                              EwsUrls *urls)
@@ -469,16 +651,98 @@ static gint
 comp_func (gconstpointer a,
            gconstpointer b)
 {
-	EwsNode *node1 = (EwsNode *) a;
-	EwsNode *node2 = (EwsNode *) b;
-	if (node1->pri > node2->pri)
+	const EwsJobBucket *bucket1 = a;
+	const EwsJobBucket *bucket2 = b;
+	if (bucket1->pri > bucket2->pri)
 		return -1;
-	else if (node1->pri < node2->pri)
+	else if (bucket1->pri < bucket2->pri)
 		return 1;
 	else
 		return 0;
 }
 
+static void
+ews_job_bucket_free (gpointer ptr)
+{
+	EwsJobBucket *bucket = ptr;
+
+	if (bucket) {
+		g_queue_clear (&bucket->nodes);
+		g_free (bucket);
+	}
+}
+
+/* Call with the queue_lock held. The @to_head puts the node before all the other
+   jobs of the same priority, otherwise it's queued after them. */
+static void
+ews_connection_push_job_locked (EEwsConnection *cnc,
+				EwsNode *node,
+				gboolean to_head)
+{
+	EwsJobBucket *bucket = NULL;
+	GSList *link;
+
+	g_return_if_fail (node->queue == NULL);
+
+	/* There are usually only few distinct priorities in use */
+	for (link = cnc->priv->jobs; link; link = g_slist_next (link)) {
+		EwsJobBucket *existing = link->data;
+
+		if (existing->pri == node->pri) {
+			bucket = existing;
+			break;
+		}
+	}
+
+	if (!bucket) {
+		bucket = g_new0 (EwsJobBucket, 1);
+		bucket->pri = node->pri;
+		g_queue_init (&bucket->nodes);
+
+		cnc->priv->jobs = g_slist_insert_sorted (cnc->priv->jobs, bucket, comp_func);
+	}
+
+	if (to_head) {
+		g_queue_push_head (&bucket->nodes, node);
+		node->queue_link = bucket->nodes.head;
+	} else {
+		g_queue_push_tail (&bucket->nodes, node);
+		node->queue_link = bucket->nodes.tail;
+	}
+
+	node->queue = &bucket->nodes;
+}
+
+/* Call with the queue_lock held */
+static EwsNode *
+ews_connection_peek_job_locked (EEwsConnection *cnc)
+{
+	GSList *link;
+
+	for (link = cnc->priv->jobs; link; link = g_slist_next (link)) {
+		EwsJobBucket *bucket = link->data;
+
+		if (!g_queue_is_empty (&bucket->nodes))
+			return g_queue_peek_head (&bucket->nodes);
+	}
+
+	return NULL;
+}
+
+/* Call with the queue_lock held; removes the node from the pending jobs
+   or from the active_job_queue, whichever it is in */
+static void
+ews_node_unlink_locked (EwsNode *node)
+{
+	if (!node->queue)
+		return;
+
+	g_queue_delete_link (node->queue, node->queue_link);
+
+	node->queue = NULL;
+	node->queue_link = NULL;
+}
+
 typedef enum _EwsScheduleOp {
 	EWS_SCHEDULE_OP_QUEUE_MESSAGE,
 	EWS_SCHEDULE_OP_CANCEL,
@@ -494,8 +758,55 @@ typedef struct _EwsScheduleData
 
 	SoupSessionCallback queue_callback;
 	gpointer queue_user_data;
+
+	/* Whether the message waits for the back off of the account's other connections */
+	gboolean governed;
 } EwsScheduleData;
 
+static void
+ews_schedule_data_free (EwsScheduleData *sd)
+{
+	if (sd->message)
+		g_object_unref (sd->message);
+	/* in case this is the last reference */
+	e_ews_connection_utils_unref_in_thread (sd->cnc);
+	g_free (sd);
+}
+
+static gint
+ews_schedule_data_compare_message (gconstpointer ptr_sd,
+				   gconstpointer ptr_message)
+{
+	const EwsScheduleData *sd = ptr_sd;
+
+	return sd->message == ptr_message ? 0 : 1;
+}
+
+/* Finishes the messages waiting for the back off as cancelled, all of them
+   when the @message is NULL; this is run in priv->soup_thread */
+static void
+ews_connection_cancel_parked_messages (EEwsConnection *cnc,
+				       SoupMessage *message)
+{
+	GSList *link = cnc->priv->parked_messages;
+
+	while (link) {
+		GSList *next = g_slist_next (link);
+		EwsScheduleData *sd = link->data;
+
+		if (!message || sd->message == message) {
+			cnc->priv->parked_messages = g_slist_delete_link (cnc->priv->parked_messages, link);
+
+			soup_message_set_status (sd->message, SOUP_STATUS_CANCELLED);
+			sd->queue_callback (cnc->priv->soup_session, sd->message, sd->queue_user_data);
+
+			ews_schedule_data_free (sd);
+		}
+
+		link = next;
+	}
+}
+
 /* this is run in priv->soup_thread */
 static gboolean
 ews_connection_scheduled_cb (gpointer user_data)
@@ -506,6 +817,22 @@ ews_connection_scheduled_cb (gpointer user_data)
 
 	switch (sd->op) {
 	case EWS_SCHEDULE_OP_QUEUE_MESSAGE:
+		if (sd->governed && sd->cnc->priv->governor && sd->queue_callback) {
+			gint wait_ms;
+
+			wait_ms = ews_governor_get_backoff_ms (sd->cnc->priv->governor);
+			if (wait_ms > 0) {
+				/* Queued again after the back off */
+				sd->cnc->priv->parked_messages = g_slist_append (sd->cnc->priv->parked_messages, sd);
+
+				QUEUE_LOCK (sd->cnc);
+				ews_connection_backoff_locked (sd->cnc, wait_ms);
+				QUEUE_UNLOCK (sd->cnc);
+
+				return FALSE;
+			}
+		}
+
 		if (!e_ews_connection_utils_prepare_message (sd->cnc, sd->message, NULL)) {
 			e_ews_debug_dump_raw_soup_request (sd->message);
 
@@ -529,27 +856,51 @@ ews_connection_scheduled_cb (gpointer user_data)
 		}
 		break;
 	case EWS_SCHEDULE_OP_CANCEL:
-		soup_session_cancel_message (sd->cnc->priv->soup_session, sd->message, SOUP_STATUS_CANCELLED);
+		if (g_slist_find_custom (sd->cnc->priv->parked_messages, sd->message, ews_schedule_data_compare_message))
+			ews_connection_cancel_parked_messages (sd->cnc, sd->message);
+		else
+			soup_session_cancel_message (sd->cnc->priv->soup_session, sd->message, SOUP_STATUS_CANCELLED);
 		break;
 	case EWS_SCHEDULE_OP_ABORT:
+		ews_connection_cancel_parked_messages (sd->cnc, NULL);
 		soup_session_abort (sd->cnc->priv->soup_session);
 		break;
 	}
 
-	if (sd->message)
-		g_object_unref (sd->message);
-	/* in case this is the last reference */
-	e_ews_connection_utils_unref_in_thread (sd->cnc);
-	g_free (sd);
+	ews_schedule_data_free (sd);
 
 	return FALSE;
 }
 
+/* Queues the messages waiting for the back off again;
+   this is run in priv->soup_thread */
 static void
-ews_connection_schedule_queue_message (EEwsConnection *cnc,
-                                       SoupMessage *message,
-                                       SoupSessionCallback callback,
-                                       gpointer user_data)
+ews_connection_unpark_messages (EEwsConnection *cnc)
+{
+	GSList *parked, *link;
+
+	parked = cnc->priv->parked_messages;
+	cnc->priv->parked_messages = NULL;
+
+	for (link = parked; link; link = g_slist_next (link)) {
+		GSource *source;
+
+		source = g_idle_source_new ();
+		g_source_set_priority (source, G_PRIORITY_DEFAULT);
+		g_source_set_callback (source, ews_connection_scheduled_cb, link->data, NULL);
+		g_source_attach (source, cnc->priv->soup_context);
+		g_source_unref (source);
+	}
+
+	g_slist_free (parked);
+}
+
+static void
+ews_connection_schedule_queue_message_full (EEwsConnection *cnc,
+					    SoupMessage *message,
+					    gboolean governed,
+					    SoupSessionCallback callback,
+					    gpointer user_data)
 {
 	EwsScheduleData *sd;
 	GSource *source;
@@ -563,6 +914,7 @@ ews_connection_schedule_queue_message (EEwsConnection *cnc,
 	sd->op = EWS_SCHEDULE_OP_QUEUE_MESSAGE;
 	sd->queue_callback = callback;
 	sd->queue_user_data = user_data;
+	sd->governed = governed;
 
 	source = g_idle_source_new ();
 	g_source_set_priority (source, G_PRIORITY_DEFAULT);
@@ -571,6 +923,15 @@ ews_connection_schedule_queue_message (EEwsConnection *cnc,
 	g_source_unref (source);
 }
 
+static void
+ews_connection_schedule_queue_message (EEwsConnection *cnc,
+                                       SoupMessage *message,
+                                       SoupSessionCallback callback,
+                                       gpointer user_data)
+{
+	ews_connection_schedule_queue_message_full (cnc, message, FALSE, callback, user_data);
+}
+
 static void
 ews_connection_schedule_cancel_message (EEwsConnection *cnc,
                                         SoupMessage *message)
@@ -643,25 +1004,58 @@ static gboolean
 ews_next_request (gpointer _cnc)
 {
 	EEwsConnection *cnc = _cnc;
-	GSList *l;
 	EwsNode *node;
+	gboolean has_more;
 
 	QUEUE_LOCK (cnc);
 
-	l = cnc->priv->jobs;
+	/* The server asked to back off; the backoff_source triggers
+	   the next request when the time comes */
+	if (cnc->priv->backoff_source) {
+		QUEUE_UNLOCK (cnc);
+		return FALSE;
+	}
+
+	node = ews_connection_peek_job_locked (cnc);
+	if (!node) {
+		QUEUE_UNLOCK (cnc);
+		return FALSE;
+	}
 
-	if (!l || g_slist_length (cnc->priv->active_job_queue) >= EWS_CONNECTION_MAX_REQUESTS) {
+	if (g_queue_get_length (&cnc->priv->active_job_queue) >= ews_connection_get_slots_for_priority (cnc, node->pri)) {
 		QUEUE_UNLOCK (cnc);
 		return FALSE;
 	}
 
-	node = (EwsNode *) l->data;
+	if (cnc->priv->governor && cnc->priv->soup_session) {
+		gint wait_ms;
+
+		wait_ms = ews_governor_get_backoff_ms (cnc->priv->governor);
+		if (wait_ms > 0) {
+			/* Another connection of the account was asked to back off */
+			ews_connection_backoff_locked (cnc, wait_ms);
+
+			QUEUE_UNLOCK (cnc);
+			return FALSE;
+		}
+	}
 
 	/* Remove the node from the priority queue */
-	cnc->priv->jobs = g_slist_remove (cnc->priv->jobs, (gconstpointer *) node);
+	ews_node_unlink_locked (node);
 
 	/* Add to active job queue */
-	cnc->priv->active_job_queue = g_slist_append (cnc->priv->active_job_queue, node);
+	g_queue_push_tail (&cnc->priv->active_job_queue, node);
+	node->queue = &cnc->priv->active_job_queue;
+	node->queue_link = cnc->priv->active_job_queue.tail;
+
+	/* Fill also other free slots, when more requests can run in parallel */
+	has_more = ews_connection_peek_job_locked (cnc) != NULL &&
+		g_queue_get_length (&cnc->priv->active_job_queue) < ews_connection_get_slots_for_priority (cnc, ews_connection_peek_job_locked (cnc)->pri);
+
+	if (node->backoff_message) {
+		node->backoff_message = FALSE;
+		camel_operation_pop_message (node->cancellable);
+	}
 
 	if (cnc->priv->soup_session) {
 		SoupMessage *msg = SOUP_MESSAGE (node->msg);
@@ -673,6 +1067,7 @@ ews_next_request (gpointer _cnc)
 			ews_response_cb (cnc->priv->soup_session, msg, node);
 		} else {
 			e_ews_debug_dump_raw_soup_request (msg);
+			node->sent_time = g_get_monotonic_time ();
 			soup_session_queue_message (cnc->priv->soup_session, msg, ews_response_cb, node);
 			QUEUE_UNLOCK (cnc);
 		}
@@ -680,24 +1075,34 @@ ews_next_request (gpointer _cnc)
 		QUEUE_UNLOCK (cnc);
 
 		ews_cancel_request (NULL, node);
+
+		/* Without a session all the pending requests are cancelled
+		   synchronously, by the caller, one after another. */
+		has_more = FALSE;
 	}
 
-	return FALSE;
+	return has_more;
 }
 
 static void
-ews_trigger_next_request (EEwsConnection *cnc)
+ews_connection_schedule_next_request (EEwsConnection *cnc)
 {
 	GSource *source;
 
+	source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_DEFAULT);
+	g_source_set_callback (source, ews_next_request, cnc, NULL);
+	g_source_attach (source, cnc->priv->soup_context);
+	g_source_unref (source);
+}
+
+static void
+ews_trigger_next_request (EEwsConnection *cnc)
+{
 	g_return_if_fail (cnc != NULL);
 
 	if (cnc->priv->soup_session) {
-		source = g_idle_source_new ();
-		g_source_set_priority (source, G_PRIORITY_DEFAULT);
-		g_source_set_callback (source, ews_next_request, cnc, NULL);
-		g_source_attach (source, cnc->priv->soup_context);
-		g_source_unref (source);
+		ews_connection_schedule_next_request (cnc);
 	} else {
 		ews_next_request (cnc);
 	}
@@ -720,12 +1125,15 @@ ews_active_job_done (EEwsConnection *cnc,
 
 	QUEUE_LOCK (cnc);
 
-	cnc->priv->active_job_queue = g_slist_remove (cnc->priv->active_job_queue, ews_node);
+	ews_node_unlink_locked (ews_node);
 	if (ews_node->cancellable && ews_node->cancel_handler_id)
 		g_signal_handler_disconnect (ews_node->cancellable, ews_node->cancel_handler_id);
 
 	QUEUE_UNLOCK (cnc);
 
+	if (ews_node->backoff_message)
+		camel_operation_pop_message (ews_node->cancellable);
+
 	ews_trigger_next_request (cnc);
 
 	if (ews_node->cancellable)
@@ -749,11 +1157,12 @@ ews_cancel_request (GCancellable *cancellable,
 	EEwsConnection *cnc = node->cnc;
 	GSimpleAsyncResult *simple = node->simple;
 	ESoapMessage *msg = node->msg;
-	GSList *found;
+	gboolean found;
 
 	QUEUE_LOCK (cnc);
-	found = g_slist_find (cnc->priv->active_job_queue, node);
-	cnc->priv->jobs = g_slist_remove (cnc->priv->jobs, node);
+	found = node->queue == &cnc->priv->active_job_queue;
+	if (!found)
+		ews_node_unlink_locked (node);
 	QUEUE_UNLOCK (cnc);
 
 	g_simple_async_result_set_error (
@@ -790,7 +1199,7 @@ e_ews_connection_queue_request (EEwsConnection *cnc,
 	node->simple = g_object_ref (simple);
 
 	QUEUE_LOCK (cnc);
-	cnc->priv->jobs = g_slist_insert_sorted (cnc->priv->jobs, (gpointer *) node, (GCompareFunc) comp_func);
+	ews_connection_push_job_locked (cnc, node, FALSE);
 	QUEUE_UNLOCK (cnc);
 
 	if (cancellable) {
@@ -837,6 +1246,117 @@ ews_connection_credentials_failed (EEwsConnection *connection,
 	return expired;
 }
 
+/* this is run in priv->soup_thread */
+static gboolean
+ews_connection_backoff_done_cb (gpointer user_data)
+{
+	EEwsConnection *cnc = user_data;
+
+	QUEUE_LOCK (cnc);
+
+	if (cnc->priv->backoff_source == g_main_current_source ()) {
+		g_source_unref (cnc->priv->backoff_source);
+		cnc->priv->backoff_source = NULL;
+		cnc->priv->backoff_until = 0;
+	}
+
+	QUEUE_UNLOCK (cnc);
+
+	ews_connection_unpark_messages (cnc);
+	ews_trigger_next_request (cnc);
+
+	return FALSE;
+}
+
+/* Stops sending any requests on the connection for the given time;
+   this is run in priv->soup_thread */
+static void
+ews_connection_backoff_locked (EEwsConnection *cnc,
+			       gint wait_ms)
+{
+	gint64 until;
+
+	until = g_get_monotonic_time () + (wait_ms * G_TIME_SPAN_MILLISECOND);
+
+	/* Another request had been told to wait longer */
+	if (cnc->priv->backoff_source && until <= cnc->priv->backoff_until)
+		return;
+
+	if (cnc->priv->backoff_source) {
+		g_source_destroy (cnc->priv->backoff_source);
+		g_source_unref (cnc->priv->backoff_source);
+	}
+
+	cnc->priv->backoff_until = until;
+	cnc->priv->backoff_source = g_timeout_source_new (wait_ms);
+
+	/* Let also the other connections of the account know */
+	if (cnc->priv->governor)
+		ews_governor_backoff (cnc->priv->governor, until);
+
+	g_source_set_callback (cnc->priv->backoff_source, ews_connection_backoff_done_cb, cnc, NULL);
+	g_source_attach (cnc->priv->backoff_source, cnc->priv->soup_context);
+}
+
+/* Marks the @msg as a request carrying @n_items items, while a full batch
+   of the request, as returned by e_ews_connection_get_batch_size() for
+   the caller's base size, has @batch_size items. Only such requests are
+   used to adapt the batch scale. */
+static void
+ews_message_set_batch_items (ESoapMessage *msg,
+			     guint n_items,
+			     guint batch_size)
+{
+	g_object_set_data (G_OBJECT (msg), EWS_BATCH_ITEMS_KEY, GUINT_TO_POINTER (n_items));
+	g_object_set_data (G_OBJECT (msg), EWS_BATCH_SIZE_KEY, GUINT_TO_POINTER (batch_size));
+}
+
+/* this is run in priv->soup_thread */
+static void
+ews_connection_update_batch_scale (EEwsConnection *cnc,
+				   SoupMessage *msg,
+				   gint64 sent_time,
+				   gboolean failed,
+				   gint wait_ms)
+{
+	gint64 now = g_get_monotonic_time ();
+	gint scale, new_scale;
+	guint n_items, batch_size;
+
+	n_items = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (msg), EWS_BATCH_ITEMS_KEY));
+	batch_size = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (msg), EWS_BATCH_SIZE_KEY));
+
+	scale = g_atomic_int_get (&cnc->priv->batch_scale);
+	new_scale = scale;
+
+	if (failed || wait_ms > 0) {
+		/* Halve on failures and do not grow again before the server
+		   is expected to be ready, possibly as told by the BackOffMilliseconds */
+		new_scale = scale / 2;
+		cnc->priv->batch_grow_after = now + (MAX (wait_ms, EWS_BATCH_SLOW_RESPONSE_MS) * G_TIME_SPAN_MILLISECOND);
+	} else if (sent_time > 0 && n_items > 0 && n_items * 2 >= batch_size) {
+		/* The fixed cost of a request outweighs the cost of the items
+		   in smaller batches, thus only at least half full are measured */
+		gint64 elapsed_ms = (now - sent_time) / G_TIME_SPAN_MILLISECOND;
+
+		elapsed_ms = elapsed_ms * batch_size / n_items;
+
+		if (elapsed_ms >= EWS_BATCH_SLOW_RESPONSE_MS)
+			new_scale = scale - EWS_BATCH_SCALE_STEP;
+		else if (elapsed_ms < EWS_BATCH_FAST_RESPONSE_MS && now >= cnc->priv->batch_grow_after)
+			new_scale = scale + EWS_BATCH_SCALE_STEP;
+	}
+
+	new_scale = CLAMP (new_scale, EWS_BATCH_SCALE_MIN, EWS_BATCH_SCALE_MAX);
+
+	if (new_scale != scale) {
+		g_atomic_int_set (&cnc->priv->batch_scale, new_scale);
+
+		if (e_ews_debug_get_log_level () >= 1)
+			printf ("EWS batch scale changed from %d%% to %d%%\n", scale, new_scale);
+	}
+}
+
 /* Response callbacks */
 
 static void
@@ -899,6 +1419,10 @@ ews_response_cb (SoupSession *session,
 		   msg->status_code == SOUP_STATUS_CANT_CONNECT ||
 		   msg->status_code == SOUP_STATUS_CANT_CONNECT_PROXY ||
 		   msg->status_code == SOUP_STATUS_IO_ERROR) {
+		/* Includes timeouts */
+		if (msg->status_code == SOUP_STATUS_IO_ERROR)
+			ews_connection_update_batch_scale (enode->cnc, msg, enode->sent_time, TRUE, 0);
+
 		g_simple_async_result_set_error (
 			enode->simple,
 			EWS_CONNECTION_ERROR,
@@ -958,61 +1482,21 @@ ews_response_cb (SoupSession *session,
 		g_free (value);
 	}
 
-	if (wait_ms > 0 && e_ews_connection_get_backoff_enabled (enode->cnc)) {
-		GCancellable *cancellable = enode->cancellable;
-		EFlag *flag;
-
-		if (cancellable)
-			g_object_ref (cancellable);
-		g_object_ref (msg);
-
-		flag = e_flag_new ();
-		while (wait_ms > 0 && !g_cancellable_is_cancelled (cancellable) && msg->status_code != SOUP_STATUS_CANCELLED) {
-			gint64 now = g_get_monotonic_time ();
-			gint left_minutes, left_seconds;
-
-			left_minutes = wait_ms / 60000;
-			left_seconds = (wait_ms / 1000) % 60;
-
-			if (left_minutes > 0) {
-				camel_operation_push_message (cancellable,
-					g_dngettext (GETTEXT_PACKAGE,
-						"Exchange server is busy, waiting to retry (%d:%02d minute)",
-						"Exchange server is busy, waiting to retry (%d:%02d minutes)", left_minutes),
-					left_minutes, left_seconds);
-			} else {
-				camel_operation_push_message (cancellable,
-					g_dngettext (GETTEXT_PACKAGE,
-						"Exchange server is busy, waiting to retry (%d second)",
-						"Exchange server is busy, waiting to retry (%d seconds)", left_seconds),
-					left_seconds);
-			}
-
-			e_flag_wait_until (flag, now + (G_TIME_SPAN_MILLISECOND * (wait_ms > 1000 ? 1000 : wait_ms)));
-
-			now = g_get_monotonic_time () - now;
-			now = now / G_TIME_SPAN_MILLISECOND;
-
-			if (now >= wait_ms)
-				wait_ms = 0;
-			wait_ms -= now;
-
-			camel_operation_pop_message (cancellable);
-		}
-
-		e_flag_free (flag);
+	ews_connection_update_batch_scale (enode->cnc, msg, enode->sent_time, FALSE, wait_ms);
 
+	if (wait_ms > 0 && e_ews_connection_get_backoff_enabled (enode->cnc)) {
 		g_object_unref (response);
 
-		if (g_cancellable_is_cancelled (cancellable) ||
-		    msg->status_code == SOUP_STATUS_CANCELLED) {
-			g_clear_object (&cancellable);
-			g_object_unref (msg);
-		} else {
+		/* Do not block the soup thread and the job slot while waiting;
+		 * instead put the request back to the queue and throttle whole
+		 * connection, then the pending requests are sent by their
+		 * priority when the server is expected to be ready again. */
+		if (!g_cancellable_is_cancelled (enode->cancellable) &&
+		    msg->status_code != SOUP_STATUS_CANCELLED) {
 			EwsNode *new_node;
 
 			new_node = ews_node_new ();
-			new_node->msg = E_SOAP_MESSAGE (msg); /* takes ownership */
+			new_node->msg = E_SOAP_MESSAGE (g_object_ref (msg));
 			new_node->pri = enode->pri;
 			new_node->cb = enode->cb;
 			new_node->cnc = enode->cnc;
@@ -1020,17 +1504,39 @@ ews_response_cb (SoupSession *session,
 
 			enode->simple = NULL;
 
+			if (enode->cancellable) {
+				gint left_minutes, left_seconds;
+
+				left_minutes = wait_ms / 60000;
+				left_seconds = (wait_ms / 1000) % 60;
+
+				if (left_minutes > 0) {
+					camel_operation_push_message (enode->cancellable,
+						g_dngettext (GETTEXT_PACKAGE,
+							"Exchange server is busy, waiting to retry (%d:%02d minute)",
+							"Exchange server is busy, waiting to retry (%d:%02d minutes)", left_minutes),
+						left_minutes, left_seconds);
+				} else {
+					camel_operation_push_message (enode->cancellable,
+						g_dngettext (GETTEXT_PACKAGE,
+							"Exchange server is busy, waiting to retry (%d second)",
+							"Exchange server is busy, waiting to retry (%d seconds)", left_seconds),
+						left_seconds);
+				}
+
+				new_node->backoff_message = TRUE;
+			}
+
 			QUEUE_LOCK (enode->cnc);
-			enode->cnc->priv->jobs = g_slist_prepend (enode->cnc->priv->jobs, new_node);
+			ews_connection_backoff_locked (enode->cnc, wait_ms);
+			ews_connection_push_job_locked (enode->cnc, new_node, TRUE);
 			QUEUE_UNLOCK (enode->cnc);
 
-			if (cancellable) {
-				new_node->cancellable = g_object_ref (cancellable);
+			if (enode->cancellable) {
+				new_node->cancellable = g_object_ref (enode->cancellable);
 				new_node->cancel_handler_id = g_cancellable_connect (
-					cancellable, G_CALLBACK (ews_cancel_request), new_node, NULL);
+					new_node->cancellable, G_CALLBACK (ews_cancel_request), new_node, NULL);
 			}
-
-			g_clear_object (&cancellable);
 		}
 
 		goto exit;
@@ -1121,13 +1627,117 @@ sync_xxx_response_cb (ESoapParameter *subparam,
 		}
 	}
 
-	async_data->items_created = items_created;
-	async_data->items_updated = items_updated;
-	async_data->items_deleted = items_deleted;
+	/* The items processed incrementally are stored in the reverse order */
+	async_data->items_created = g_slist_concat (g_slist_reverse (async_data->items_created), items_created);
+	async_data->items_updated = g_slist_concat (g_slist_reverse (async_data->items_updated), items_updated);
+	async_data->items_deleted = g_slist_concat (g_slist_reverse (async_data->items_deleted), items_deleted);
 	async_data->sync_state = new_sync_state;
 	async_data->includes_last_item = includes_last_item;
 }
 
+/* Whether the @param is a child of @parent_name, which is a child of @grandparent_name */
+static gboolean
+ews_incremental_node_is_in (ESoapParameter *param,
+			    const gchar *parent_name,
+			    const gchar *grandparent_name)
+{
+	xmlNodePtr parent = param ? param->parent : NULL;
+
+	return parent && parent->parent &&
+		g_strcmp0 ((const gchar *) parent->name, parent_name) == 0 &&
+		g_strcmp0 ((const gchar *) parent->parent->name, grandparent_name) == 0;
+}
+
+/* Processes <Changes> children of the SyncFolderItems response while it's
+   being received; the items are prepended, sync_xxx_response_cb() reverses them.
+   Returns whether the param had been processed. */
+static gboolean
+sync_folder_items_incremental_cb (ESoapParameter *param,
+				  gpointer user_data)
+{
+	EwsAsyncData *async_data = user_data;
+	const gchar *name;
+
+	if (!param) {
+		g_slist_free_full (async_data->items_created, g_object_unref);
+		g_slist_free_full (async_data->items_updated, g_object_unref);
+		g_slist_free_full (async_data->items_deleted, g_free);
+
+		async_data->items_created = NULL;
+		async_data->items_updated = NULL;
+		async_data->items_deleted = NULL;
+		return TRUE;
+	}
+
+	if (!ews_incremental_node_is_in (param, "Changes", "SyncFolderItemsResponseMessage"))
+		return FALSE;
+
+	name = (const gchar *) param->name;
+
+	if (g_strcmp0 (name, "Create") == 0) {
+		EEwsItem *item;
+
+		item = e_ews_item_new_from_soap_parameter (param);
+		if (item)
+			async_data->items_created = g_slist_prepend (async_data->items_created, item);
+	} else if (g_strcmp0 (name, "Update") == 0 ||
+		   g_strcmp0 (name, "ReadFlagChange") == 0) {
+		EEwsItem *item;
+
+		item = e_ews_item_new_from_soap_parameter (param);
+		if (item)
+			async_data->items_updated = g_slist_prepend (async_data->items_updated, item);
+	} else if (g_strcmp0 (name, "Delete") == 0) {
+		ESoapParameter *item_param;
+
+		item_param = e_soap_parameter_get_first_child_by_name (param, "ItemId");
+		async_data->items_deleted = g_slist_prepend (async_data->items_deleted,
+			e_soap_parameter_get_property (item_param, "Id"));
+	} else {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Processes <Items> children of the FindItem response while it's being received;
+   the items are prepended, find_folder_items_response_cb() reverses them.
+   Returns whether the param had been processed. */
+static gboolean
+find_folder_items_incremental_cb (ESoapParameter *param,
+				  gpointer user_data)
+{
+	EwsAsyncData *async_data = user_data;
+	EEwsItem *item;
+
+	if (!param) {
+		g_slist_free_full (async_data->items, g_object_unref);
+		async_data->items = NULL;
+		return TRUE;
+	}
+
+	if (!ews_incremental_node_is_in (param, "Items", "RootFolder"))
+		return FALSE;
+
+	item = e_ews_item_new_from_soap_parameter (param);
+	if (item)
+		async_data->items = g_slist_prepend (async_data->items, item);
+
+	return TRUE;
+}
+
+/* The dumped response would miss the incrementally processed parts,
+   thus do not use the incremental processing when debugging. */
+static void
+ews_message_set_incremental_fn (ESoapMessage *msg,
+				const gchar *parent_nodename,
+				ESoapNodeFn fn,
+				gpointer user_data)
+{
+	if (e_ews_debug_get_log_level () <= 0)
+		e_soap_message_set_incremental_fn (msg, parent_nodename, fn, user_data);
+}
+
 static void
 sync_hierarchy_response_cb (ESoapResponse *response,
                             GSimpleAsyncResult *simple)
@@ -1340,6 +1950,9 @@ find_folder_items_response_cb (ESoapResponse *response,
 
 	async_data = g_simple_async_result_get_op_res_gpointer (simple);
 
+	/* The items processed incrementally are stored in the reverse order */
+	async_data->items = g_slist_reverse (async_data->items);
+
 	param = e_soap_response_get_first_parameter_by_name (
 		response, "ResponseMessages", &error);
 
@@ -1811,6 +2424,12 @@ ews_connection_set_property (GObject *object,
 				E_EWS_CONNECTION (object),
 				g_value_get_object (value));
 			return;
+
+		case PROP_CONCURRENT_CONNECTIONS:
+			e_ews_connection_set_concurrent_connections (
+				E_EWS_CONNECTION (object),
+				g_value_get_uint (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -1850,6 +2469,20 @@ ews_connection_get_property (GObject *object,
 				e_ews_connection_get_source (
 				E_EWS_CONNECTION (object)));
 			return;
+
+		case PROP_CONCURRENT_CONNECTIONS:
+			g_value_set_uint (
+				value,
+				e_ews_connection_get_concurrent_connections (
+				E_EWS_CONNECTION (object)));
+			return;
+
+		case PROP_BATCH_SCALE:
+			g_value_set_uint (
+				value,
+				e_ews_connection_get_batch_scale (
+				E_EWS_CONNECTION (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -1868,6 +2501,8 @@ ews_connection_constructed (GObject *object)
 
 	cnc->priv->soup_session = soup_session_async_new_with_options (
 		SOUP_SESSION_ASYNC_CONTEXT, cnc->priv->soup_context,
+		SOUP_SESSION_MAX_CONNS, cnc->priv->concurrent_connections + 1,
+		SOUP_SESSION_MAX_CONNS_PER_HOST, cnc->priv->concurrent_connections + 1,
 		NULL);
 
 	/* Do not use G_BINDING_SYNC_CREATE because the property_lock is
@@ -1941,6 +2576,18 @@ ews_connection_dispose (GObject *object)
 		g_thread_join (priv->soup_thread);
 		priv->soup_thread = NULL;
 
+		if (priv->backoff_source) {
+			g_source_destroy (priv->backoff_source);
+			g_source_unref (priv->backoff_source);
+			priv->backoff_source = NULL;
+		}
+
+		/* Before the soup_context is freed */
+		if (priv->governor) {
+			ews_governor_unref (priv->governor);
+			priv->governor = NULL;
+		}
+
 		g_main_loop_unref (priv->soup_loop);
 		priv->soup_loop = NULL;
 		g_main_context_unref (priv->soup_context);
@@ -1953,14 +2600,10 @@ ews_connection_dispose (GObject *object)
 
 	e_ews_connection_set_password (E_EWS_CONNECTION (object), NULL);
 
-	g_slist_free (priv->jobs);
+	g_slist_free_full (priv->jobs, ews_job_bucket_free);
 	priv->jobs = NULL;
 
-	g_slist_free (priv->active_job_queue);
-	priv->active_job_queue = NULL;
-
-	g_slist_free_full (priv->subscribed_folders, g_free);
-	priv->subscribed_folders = NULL;
+	g_queue_clear (&priv->active_job_queue);
 
 	if (priv->subscriptions != NULL) {
 		g_hash_table_destroy (priv->subscriptions);
@@ -2054,6 +2697,33 @@ e_ews_connection_class_init (EEwsConnectionClass *class)
 			G_PARAM_CONSTRUCT_ONLY |
 			G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property (
+		object_class,
+		PROP_CONCURRENT_CONNECTIONS,
+		g_param_spec_uint (
+			"concurrent-connections",
+			"Concurrent Connections",
+			"Number of concurrent connections to use",
+			MIN_CONCURRENT_CONNECTIONS,
+			MAX_CONCURRENT_CONNECTIONS,
+			1,
+			G_PARAM_READWRITE |
+			G_PARAM_STATIC_STRINGS));
+
+	/* For debugging and tuning only; not notified on change */
+	g_object_class_install_property (
+		object_class,
+		PROP_BATCH_SCALE,
+		g_param_spec_uint (
+			"batch-scale",
+			"Batch Scale",
+			"Current size of the request batches, in percents of their default sizes",
+			EWS_BATCH_SCALE_MIN,
+			EWS_BATCH_SCALE_MAX,
+			100,
+			G_PARAM_READABLE |
+			G_PARAM_STATIC_STRINGS));
+
 	signals[SERVER_NOTIFICATION] = g_signal_new (
 		"server-notification",
 		G_OBJECT_CLASS_TYPE (object_class),
@@ -2089,6 +2759,10 @@ e_ews_connection_init (EEwsConnection *cnc)
 	cnc->priv->soup_loop = g_main_loop_new (cnc->priv->soup_context, FALSE);
 	cnc->priv->backoff_enabled = TRUE;
 	cnc->priv->disconnected_flag = FALSE;
+	cnc->priv->concurrent_connections = 1;
+	cnc->priv->batch_scale = 100;
+
+	g_queue_init (&cnc->priv->active_job_queue);
 
 	cnc->priv->subscriptions = g_hash_table_new_full (
 			g_direct_hash, g_direct_equal,
@@ -2458,6 +3132,7 @@ e_ews_connection_new_full (ESource *source,
 
 	cnc->priv->uri = g_strdup (uri);
 	cnc->priv->hash_key = hash_key;  /* takes ownership */
+	cnc->priv->governor = ews_governor_ref_for_account (settings, uri);
 
 	g_free (cnc->priv->impersonate_user);
 	if (camel_ews_settings_get_use_impersonation (settings)) {
@@ -2475,6 +3150,11 @@ e_ews_connection_new_full (ESource *source,
 		cnc->priv->soup_session, "timeout",
 		G_BINDING_SYNC_CREATE);
 
+	e_binding_bind_property (
+		settings, "concurrent-connections",
+		cnc, "concurrent-connections",
+		G_BINDING_SYNC_CREATE);
+
 	if (allow_connection_reuse) {
 		/* add the connection to the loaded_connections_permissions hash table */
 		if (loaded_connections_permissions == NULL)
@@ -2810,6 +3490,84 @@ e_ews_connection_set_backoff_enabled (EEwsConnection *cnc,
 	cnc->priv->backoff_enabled = enabled;
 }
 
+guint
+e_ews_connection_get_concurrent_connections (EEwsConnection *cnc)
+{
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), 1);
+
+	return cnc->priv->concurrent_connections;
+}
+
+void
+e_ews_connection_set_concurrent_connections (EEwsConnection *cnc,
+					     guint concurrent_connections)
+{
+	g_return_if_fail (E_IS_EWS_CONNECTION (cnc));
+
+	concurrent_connections = CLAMP (concurrent_connections, MIN_CONCURRENT_CONNECTIONS, MAX_CONCURRENT_CONNECTIONS);
+
+	if (cnc->priv->concurrent_connections == concurrent_connections)
+		return;
+
+	cnc->priv->concurrent_connections = concurrent_connections;
+
+	if (cnc->priv->soup_session) {
+		g_object_set (G_OBJECT (cnc->priv->soup_session),
+			SOUP_SESSION_MAX_CONNS, concurrent_connections + 1,
+			SOUP_SESSION_MAX_CONNS_PER_HOST, concurrent_connections + 1,
+			NULL);
+	}
+
+	g_object_notify (G_OBJECT (cnc), "concurrent-connections");
+
+	/* Occupy the newly available slots, if any; the ews_next_request()
+	   keeps rescheduling itself while there are free slots and jobs. */
+	ews_trigger_next_request (cnc);
+}
+
+/**
+ * e_ews_connection_get_batch_scale:
+ * @cnc: an #EEwsConnection
+ *
+ * Returns: Current size of the request batches, in percents
+ *    of their default sizes. See e_ews_connection_get_batch_size().
+ **/
+guint
+e_ews_connection_get_batch_scale (EEwsConnection *cnc)
+{
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), 100);
+
+	return g_atomic_int_get (&cnc->priv->batch_scale);
+}
+
+/**
+ * e_ews_connection_get_batch_size:
+ * @cnc: an #EEwsConnection
+ * @default_size: the default batch size of the caller
+ * @max_size: the largest batch size the server accepts for the request
+ *
+ * Returns the number of items to ask for in one request, like the page size
+ * of the SyncFolderItems request or the count of the item IDs for the GetItem
+ * request. The size grows while the server responds quickly to the requests
+ * of multiple items, relative to their count, and it shrinks
+ * on busy server or timeout errors.
+ *
+ * Returns: The @default_size adapted to the current server responsiveness
+ **/
+guint
+e_ews_connection_get_batch_size (EEwsConnection *cnc,
+				 guint default_size,
+				 guint max_size)
+{
+	guint size;
+
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), default_size);
+
+	size = default_size * e_ews_connection_get_batch_scale (cnc) / 100;
+
+	return CLAMP (size, 1, MAX (max_size, 1));
+}
+
 gboolean
 e_ews_connection_get_disconnected_flag (EEwsConnection *cnc)
 {
@@ -4031,7 +4789,8 @@ e_ews_connection_download_oal_file (EEwsConnection *cnc,
 		soup_message, "restarted",
 		G_CALLBACK (ews_soup_restarted), data);
 
-	ews_connection_schedule_queue_message (cnc, soup_message, oal_download_response_cb, simple);
+	/* Big downloads wait also for the back off of the account's other connections */
+	ews_connection_schedule_queue_message_full (cnc, soup_message, TRUE, oal_download_response_cb, simple);
 }
 
 gboolean
@@ -4255,6 +5014,9 @@ e_ews_connection_sync_folder_items (EEwsConnection *cnc,
 	g_simple_async_result_set_op_res_gpointer (
 		simple, async_data, (GDestroyNotify) async_data_free);
 
+	async_data->items_free_fn = sync_folder_items_incremental_cb;
+	ews_message_set_incremental_fn (msg, "Changes", sync_folder_items_incremental_cb, async_data);
+
 	e_ews_connection_queue_request (
 		cnc, msg, sync_folder_items_response_cb,
 		pri, cancellable, simple);
@@ -4293,6 +5055,11 @@ e_ews_connection_sync_folder_items_finish (EEwsConnection *cnc,
 	*items_updated = async_data->items_updated;
 	*items_deleted = async_data->items_deleted;
 
+	/* The caller owns them now */
+	async_data->items_created = NULL;
+	async_data->items_updated = NULL;
+	async_data->items_deleted = NULL;
+
 	return TRUE;
 }
 
@@ -4371,36 +5138,25 @@ ews_connection_write_only_ids_restriction (ESoapMessage *msg,
 	}
 }
 
-/**
- * e_ews_connection_find_folder_items:
- * @cnc: The EWS Connection
- * @pri: The priority associated with the request
- * @fid: The folder id to which the items belong
- * @default_props: Can take one of the values: IdOnly,Default or AllProperties
- * @add_props: Specify any additional properties to be fetched
- * @sort_order: Specific sorting order for items
- * @query: evo query based on which items will be fetched
- * @only_ids: (element-type utf8) (nullable): a gchar * with item IDs, to check with only; can be %NULL
- * @type: type of folder
- * @convert_query_cb: a callback method to convert query to ews restiction
- * @cancellable: a GCancellable to monitor cancelled operations
- * @callback: Responses are parsed and returned to this callback
- * @user_data: user data passed to callback
- **/
-void
-e_ews_connection_find_folder_items (EEwsConnection *cnc,
-                                    gint pri,
-                                    EwsFolderId *fid,
-                                    const gchar *default_props,
-                                    const EEwsAdditionalProps *add_props,
-                                    EwsSortOrder *sort_order,
-                                    const gchar *query,
-				    GPtrArray *only_ids, /* element-type utf8 */
-                                    EEwsFolderType type,
-                                    EwsConvertQueryCallback convert_query_cb,
-                                    GCancellable *cancellable,
-                                    GAsyncReadyCallback callback,
-                                    gpointer user_data)
+/* With zero page_size asks for all the items at once, otherwise for at most
+   page_size items starting at the offset. The result is finished with
+   e_ews_connection_find_folder_items_finish(). */
+static void
+ews_connection_find_folder_items_page (EEwsConnection *cnc,
+				       gint pri,
+				       EwsFolderId *fid,
+				       const gchar *default_props,
+				       const EEwsAdditionalProps *add_props,
+				       EwsSortOrder *sort_order,
+				       const gchar *query,
+				       GPtrArray *only_ids, /* element-type utf8 */
+				       EEwsFolderType type,
+				       EwsConvertQueryCallback convert_query_cb,
+				       guint page_size,
+				       guint offset,
+				       GCancellable *cancellable,
+				       GAsyncReadyCallback callback,
+				       gpointer user_data)
 {
 	ESoapMessage *msg;
 	GSimpleAsyncResult *simple;
@@ -4426,6 +5182,20 @@ e_ews_connection_find_folder_items (EEwsConnection *cnc,
 
 	e_soap_message_end_element (msg);
 
+	if (page_size > 0) {
+		gchar *tmp;
+
+		e_soap_message_start_element (msg, "IndexedPageItemView", "messages", NULL);
+		tmp = g_strdup_printf ("%u", page_size);
+		e_soap_message_add_attribute (msg, "MaxEntriesReturned", tmp, NULL, NULL);
+		g_free (tmp);
+		tmp = g_strdup_printf ("%u", offset);
+		e_soap_message_add_attribute (msg, "Offset", tmp, NULL, NULL);
+		g_free (tmp);
+		e_soap_message_add_attribute (msg, "BasePoint", "Beginning", NULL, NULL);
+		e_soap_message_end_element (msg); /* IndexedPageItemView */
+	}
+
 	/*write restriction message based on query*/
 	if (convert_query_cb) {
 		e_soap_message_start_element (msg, "Restriction", "messages", NULL);
@@ -4472,6 +5242,9 @@ e_ews_connection_find_folder_items (EEwsConnection *cnc,
 	g_simple_async_result_set_op_res_gpointer (
 		simple, async_data, (GDestroyNotify) async_data_free);
 
+	async_data->items_free_fn = find_folder_items_incremental_cb;
+	ews_message_set_incremental_fn (msg, "Items", find_folder_items_incremental_cb, async_data);
+
 	e_ews_connection_queue_request (
 		cnc, msg, find_folder_items_response_cb,
 		pri, cancellable, simple);
@@ -4479,6 +5252,44 @@ e_ews_connection_find_folder_items (EEwsConnection *cnc,
 	g_object_unref (simple);
 }
 
+/**
+ * e_ews_connection_find_folder_items:
+ * @cnc: The EWS Connection
+ * @pri: The priority associated with the request
+ * @fid: The folder id to which the items belong
+ * @default_props: Can take one of the values: IdOnly,Default or AllProperties
+ * @add_props: Specify any additional properties to be fetched
+ * @sort_order: Specific sorting order for items
+ * @query: evo query based on which items will be fetched
+ * @only_ids: (element-type utf8) (nullable): a gchar * with item IDs, to check with only; can be %NULL
+ * @type: type of folder
+ * @convert_query_cb: a callback method to convert query to ews restiction
+ * @cancellable: a GCancellable to monitor cancelled operations
+ * @callback: Responses are parsed and returned to this callback
+ * @user_data: user data passed to callback
+ **/
+void
+e_ews_connection_find_folder_items (EEwsConnection *cnc,
+                                    gint pri,
+                                    EwsFolderId *fid,
+                                    const gchar *default_props,
+                                    const EEwsAdditionalProps *add_props,
+                                    EwsSortOrder *sort_order,
+                                    const gchar *query,
+				    GPtrArray *only_ids, /* element-type utf8 */
+                                    EEwsFolderType type,
+                                    EwsConvertQueryCallback convert_query_cb,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+	ews_connection_find_folder_items_page (
+		cnc, pri, fid, default_props,
+		add_props, sort_order, query,
+		only_ids, type, convert_query_cb,
+		0, 0, cancellable, callback, user_data);
+}
+
 gboolean
 e_ews_connection_find_folder_items_finish (EEwsConnection *cnc,
                                            GAsyncResult *result,
@@ -4504,6 +5315,9 @@ e_ews_connection_find_folder_items_finish (EEwsConnection *cnc,
 	*includes_last_item = async_data->includes_last_item;
 	*items = async_data->items;
 
+	/* The caller owns them now */
+	async_data->items = NULL;
+
 	return TRUE;
 }
 
@@ -4542,7 +5356,99 @@ e_ews_connection_find_folder_items_sync (EEwsConnection *cnc,
 	success = e_ews_connection_find_folder_items_finish (
 		cnc, result, includes_last_item, items, error);
 
-	e_async_closure_free (closure);
+	e_async_closure_free (closure);
+
+	return success;
+}
+
+/**
+ * e_ews_connection_find_folder_items_paged_sync:
+ * @cnc: The EWS Connection
+ * @pri: The priority associated with the request
+ * @fid: The folder id to which the items belong
+ * @default_props: Can take one of the values: IdOnly,Default or AllProperties
+ * @add_props: Specify any additional properties to be fetched
+ * @sort_order: Specific sorting order for items
+ * @query: evo query based on which items will be fetched
+ * @only_ids: (element-type utf8) (nullable): a gchar * with item IDs, to check with only; can be %NULL
+ * @type: type of folder
+ * @convert_query_cb: a callback method to convert query to ews restiction
+ * @page_size: how many items to ask for at once, 0 to use the default size
+ * @func: called with each page of the found items
+ * @func_user_data: user data passed to @func
+ * @cancellable: a GCancellable to monitor cancelled operations
+ * @error: return location for a #GError, or %NULL
+ *
+ * Like e_ews_connection_find_folder_items_sync(), only the found items are
+ * read in pages and passed to @func, one page at a time, instead of being
+ * gathered in one list, thus the memory use does not depend on the count
+ * of the found items. The items passed to @func are freed when it returns.
+ * Returning %FALSE from @func stops the search without an error.
+ *
+ * Returns: Whether succeeded
+ **/
+gboolean
+e_ews_connection_find_folder_items_paged_sync (EEwsConnection *cnc,
+					       gint pri,
+					       EwsFolderId *fid,
+					       const gchar *default_props,
+					       const EEwsAdditionalProps *add_props,
+					       EwsSortOrder *sort_order,
+					       const gchar *query,
+					       GPtrArray *only_ids, /* element-type utf8 */
+					       EEwsFolderType type,
+					       EwsConvertQueryCallback convert_query_cb,
+					       guint page_size,
+					       EEwsFoundItemsFunc func,
+					       gpointer func_user_data,
+					       GCancellable *cancellable,
+					       GError **error)
+{
+	gboolean includes_last_item = FALSE;
+	gboolean success = TRUE;
+	guint offset = 0;
+
+	g_return_val_if_fail (cnc != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	while (success && !includes_last_item) {
+		EAsyncClosure *closure;
+		GAsyncResult *result;
+		GSList *items = NULL;
+		guint n_items;
+
+		closure = e_async_closure_new ();
+
+		ews_connection_find_folder_items_page (
+			cnc, pri, fid, default_props,
+			add_props, sort_order, query,
+			only_ids, type, convert_query_cb,
+			page_size ? page_size : e_ews_connection_get_batch_size (cnc, EWS_FIND_ITEMS_PAGE_SIZE, EWS_FIND_ITEMS_MAX_PAGE_SIZE),
+			offset, cancellable,
+			e_async_closure_callback, closure);
+
+		result = e_async_closure_wait (closure);
+
+		success = e_ews_connection_find_folder_items_finish (
+			cnc, result, &includes_last_item, &items, error);
+
+		e_async_closure_free (closure);
+
+		if (!success)
+			break;
+
+		n_items = g_slist_length (items);
+		offset += n_items;
+
+		/* Nothing more to read, even when the server claims otherwise */
+		if (!n_items)
+			includes_last_item = TRUE;
+
+		if (items && !func (items, func_user_data))
+			includes_last_item = TRUE;
+
+		g_slist_free_full (items, g_object_unref);
+	}
 
 	return success;
 }
@@ -4728,20 +5634,72 @@ e_ews_connection_satisfies_server_version (EEwsConnection *cnc,
 	return cnc->priv->version >= version;
 }
 
-void
-e_ews_connection_get_items (EEwsConnection *cnc,
-                            gint pri,
-                            const GSList *ids,
-                            const gchar *default_props,
-			    const EEwsAdditionalProps *add_props,
-                            gboolean include_mime,
-                            const gchar *mime_directory,
-			    EEwsBodyType body_type,
-                            ESoapProgressFn progress_fn,
-                            gpointer progress_data,
-                            GCancellable *cancellable,
-                            GAsyncReadyCallback callback,
-                            gpointer user_data)
+typedef struct _EwsItemStreamData {
+	GPtrArray *ids; /* gchar *, in the order of the request */
+	EEwsItemStreamFunc stream_func;
+	gpointer stream_func_data;
+} EwsItemStreamData;
+
+static void
+ews_item_stream_data_free (gpointer ptr)
+{
+	EwsItemStreamData *isd = ptr;
+
+	if (isd) {
+		g_ptr_array_unref (isd->ids);
+		g_free (isd);
+	}
+}
+
+static GOutputStream *
+ews_item_stream_cb (ESoapParameter *param,
+		    gpointer user_data)
+{
+	EwsItemStreamData *isd = user_data;
+	xmlNodePtr node, sibling;
+	guint index = 0;
+
+	/* The response messages are in the same order as the requested
+	   item IDs and the GetItem response is not processed incrementally,
+	   thus the preceding response messages are still in the tree */
+	for (node = param; node && node->parent; node = node->parent) {
+		if (node->parent->type == XML_ELEMENT_NODE &&
+		    g_strcmp0 ((const gchar *) node->parent->name, "ResponseMessages") == 0)
+			break;
+	}
+
+	if (!node || !node->parent)
+		return NULL;
+
+	for (sibling = node->prev; sibling; sibling = sibling->prev) {
+		if (sibling->type == XML_ELEMENT_NODE)
+			index++;
+	}
+
+	if (index >= isd->ids->len)
+		return NULL;
+
+	return isd->stream_func (g_ptr_array_index (isd->ids, index), isd->stream_func_data);
+}
+
+static void
+ews_connection_get_items_internal (EEwsConnection *cnc,
+				   gint pri,
+				   const GSList *ids,
+				   const gchar *default_props,
+				   const EEwsAdditionalProps *add_props,
+				   gboolean include_mime,
+				   const gchar *mime_directory,
+				   GOutputStream *mime_stream,
+				   EEwsItemStreamFunc stream_func,
+				   gpointer stream_func_data,
+				   guint batch_size,
+				   EEwsBodyType body_type,
+				   ESoapProgressFn progress_fn,
+				   gpointer progress_data,
+				   GCancellable *cancellable,
+				   GAsyncReadyCallback callback,
+				   gpointer user_data)
 {
 	ESoapMessage *msg;
 	GSimpleAsyncResult *simple;
@@ -4772,7 +5730,24 @@ e_ews_connection_get_items (EEwsConnection *cnc,
 		e_ews_message_write_string_parameter (msg, "IncludeMimeContent", NULL, "true");
 	else
 		e_ews_message_write_string_parameter (msg, "IncludeMimeContent", NULL, "false");
-	if (mime_directory)
+	if (stream_func) {
+		EwsItemStreamData *isd;
+
+		isd = g_new0 (EwsItemStreamData, 1);
+		isd->ids = g_ptr_array_new_with_free_func (g_free);
+		isd->stream_func = stream_func;
+		isd->stream_func_data = stream_func_data;
+
+		for (l = ids; l; l = g_slist_next (l))
+			g_ptr_array_add (isd->ids, g_strdup (l->data));
+
+		/* Lives as long as the message, which calls the function */
+		g_object_set_data_full (G_OBJECT (msg), "ews-item-stream-data", isd, ews_item_stream_data_free);
+
+		e_soap_message_store_node_data_to_stream_fn (msg, "MimeContent", ews_item_stream_cb, isd, TRUE);
+	} else if (mime_stream)
+		e_soap_message_store_node_data_to_stream (msg, "MimeContent", mime_stream, TRUE);
+	else if (mime_directory)
 		e_soap_message_store_node_data (msg, "MimeContent", mime_directory, TRUE);
 
 	switch (body_type) {
@@ -4802,6 +5777,15 @@ e_ews_connection_get_items (EEwsConnection *cnc,
 
 	e_ews_message_write_footer (msg);
 
+	if (ids && ids->next) {
+		/* The callers, which do not say by how many items they split the ids,
+		   are supposed to use about the default batch size */
+		if (!batch_size)
+			batch_size = e_ews_connection_get_batch_size (cnc, EWS_GET_ITEMS_BATCH_SIZE, EWS_GET_ITEMS_MAX_BATCH_SIZE);
+
+		ews_message_set_batch_items (msg, g_slist_length ((GSList *) ids), batch_size);
+	}
+
 	simple = g_simple_async_result_new (
 		G_OBJECT (cnc), callback, user_data,
 		e_ews_connection_get_items);
@@ -4817,6 +5801,30 @@ e_ews_connection_get_items (EEwsConnection *cnc,
 	g_object_unref (simple);
 }
 
+void
+e_ews_connection_get_items (EEwsConnection *cnc,
+                            gint pri,
+                            const GSList *ids,
+                            const gchar *default_props,
+			    const EEwsAdditionalProps *add_props,
+                            gboolean include_mime,
+                            const gchar *mime_directory,
+			    EEwsBodyType body_type,
+                            ESoapProgressFn progress_fn,
+                            gpointer progress_data,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+	g_return_if_fail (cnc != NULL);
+
+	ews_connection_get_items_internal (
+		cnc, pri, ids, default_props, add_props,
+		include_mime, mime_directory, NULL, NULL, NULL, 0, body_type,
+		progress_fn, progress_data, cancellable,
+		callback, user_data);
+}
+
 gboolean
 e_ews_connection_get_items_finish (EEwsConnection *cnc,
                                    GAsyncResult *result,
@@ -4888,6 +5896,123 @@ e_ews_connection_get_items_sync (EEwsConnection *cnc,
 	return success;
 }
 
+/**
+ * e_ews_connection_get_items_to_stream_sync:
+ * @cnc: an #EEwsConnection
+ * @pri: priority of the request
+ * @ids: (element-type utf8): item IDs to get
+ * @default_props: the BaseShape to ask for
+ * @add_props: (nullable): additional properties to ask for
+ * @mime_stream: a #GOutputStream to write the MIME content to
+ * @body_type: which body type to ask for
+ * @items: (out) (element-type EEwsItem): return location for the items
+ * @progress_fn: (nullable): a progress function
+ * @progress_data: user data for the @progress_fn
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Gets the items with included MIME content, which is decoded and written
+ * into the @mime_stream as it arrives from the server, without any temporary
+ * files. The returned items have no MIME content set. It is meant to be
+ * used with a single item in the @ids.
+ *
+ * Returns: Whether succeeded
+ **/
+gboolean
+e_ews_connection_get_items_to_stream_sync (EEwsConnection *cnc,
+					   gint pri,
+					   const GSList *ids,
+					   const gchar *default_props,
+					   const EEwsAdditionalProps *add_props,
+					   GOutputStream *mime_stream,
+					   EEwsBodyType body_type,
+					   GSList **items,
+					   ESoapProgressFn progress_fn,
+					   gpointer progress_data,
+					   GCancellable *cancellable,
+					   GError **error)
+{
+	EAsyncClosure *closure;
+	GAsyncResult *result;
+	gboolean success;
+
+	g_return_val_if_fail (cnc != NULL, FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (mime_stream), FALSE);
+
+	closure = e_async_closure_new ();
+
+	ews_connection_get_items_internal (
+		cnc, pri, ids, default_props,
+		add_props, TRUE, NULL, mime_stream,
+		NULL, NULL, 0, body_type, progress_fn, progress_data,
+		cancellable, e_async_closure_callback, closure);
+
+	result = e_async_closure_wait (closure);
+
+	success = e_ews_connection_get_items_finish (
+		cnc, result, items, error);
+
+	e_async_closure_free (closure);
+
+	return success;
+}
+
+/**
+ * e_ews_connection_get_items_to_streams:
+ * @cnc: an #EEwsConnection
+ * @pri: priority of the request
+ * @ids: (element-type utf8): item IDs to get
+ * @default_props: the BaseShape to ask for
+ * @add_props: (nullable): additional properties to ask for
+ * @stream_func: an #EEwsItemStreamFunc, which provides a stream for each item
+ * @stream_func_data: user data for the @stream_func
+ * @batch_size: the number of items the caller splits its item IDs by, as
+ *    returned by e_ews_connection_get_batch_size(), or 0 to use the default
+ * @body_type: which body type to ask for
+ * @progress_fn: (nullable): a progress function
+ * @progress_data: user data for the @progress_fn
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @callback: a callback to call when the request is finished
+ * @user_data: user data for the @callback
+ *
+ * Similar to e_ews_connection_get_items_to_stream_sync(), only it can get
+ * multiple items at once, each with its MIME content written into its own
+ * stream. The @stream_func is called from the thread, which processes
+ * the response, when the MIME content of the item starts, and it can be
+ * called again for the same item when the request is restarted. Finish
+ * the call with e_ews_connection_get_items_finish().
+ *
+ * The response time of the request adapts the batch scale, relative
+ * to the @batch_size, thus also batches of other sizes than the default
+ * GetItem batch size are measured.
+ **/
+void
+e_ews_connection_get_items_to_streams (EEwsConnection *cnc,
+				       gint pri,
+				       const GSList *ids,
+				       const gchar *default_props,
+				       const EEwsAdditionalProps *add_props,
+				       EEwsItemStreamFunc stream_func,
+				       gpointer stream_func_data,
+				       guint batch_size,
+				       EEwsBodyType body_type,
+				       ESoapProgressFn progress_fn,
+				       gpointer progress_data,
+				       GCancellable *cancellable,
+				       GAsyncReadyCallback callback,
+				       gpointer user_data)
+{
+	g_return_if_fail (cnc != NULL);
+	g_return_if_fail (stream_func != NULL);
+
+	ews_connection_get_items_internal (
+		cnc, pri, ids, default_props,
+		add_props, TRUE, NULL, NULL,
+		stream_func, stream_func_data, batch_size,
+		body_type, progress_fn, progress_data,
+		cancellable, callback, user_data);
+}
+
 static const gchar *
 ews_delete_type_to_str (EwsDeleteType delete_type)
 {
@@ -5012,6 +6137,9 @@ e_ews_connection_delete_items (EEwsConnection *cnc,
 
 	e_ews_message_write_footer (msg);
 
+	ews_message_set_batch_items (msg, g_slist_length ((GSList *) ids),
+		e_ews_connection_get_batch_size (cnc, EWS_MOVE_ITEMS_CHUNK_SIZE, EWS_MOVE_ITEMS_MAX_CHUNK_SIZE));
+
 	simple = g_simple_async_result_new (
 		G_OBJECT (cnc), callback, user_data,
 		e_ews_connection_delete_items);
@@ -5212,10 +6340,13 @@ e_ews_connection_delete_items_in_chunks_sync (EEwsConnection *cnc,
 	iter = ids;
 
 	while (success && iter) {
-		guint n_ids;
+		guint n_ids, chunk_size;
 		const GSList *tmp_iter;
 
-		for (tmp_iter = iter, n_ids = 0; tmp_iter && n_ids < EWS_MOVE_ITEMS_CHUNK_SIZE; tmp_iter = g_slist_next (tmp_iter), n_ids++) {
+		/* Re-read for each chunk, it follows the server responsiveness */
+		chunk_size = e_ews_connection_get_batch_size (cnc, EWS_MOVE_ITEMS_CHUNK_SIZE, EWS_MOVE_ITEMS_MAX_CHUNK_SIZE);
+
+		for (tmp_iter = iter, n_ids = 0; tmp_iter && n_ids < chunk_size; tmp_iter = g_slist_next (tmp_iter), n_ids++) {
 			/* Only check bounds first, to avoid unnecessary allocations */
 		}
 
@@ -5225,7 +6356,7 @@ e_ews_connection_delete_items_in_chunks_sync (EEwsConnection *cnc,
 			if (total_ids == 0)
 				total_ids = g_slist_length ((GSList *) ids);
 
-			for (n_ids = 0; iter && n_ids < EWS_MOVE_ITEMS_CHUNK_SIZE; iter = g_slist_next (iter), n_ids++) {
+			for (n_ids = 0; iter && n_ids < chunk_size; iter = g_slist_next (iter), n_ids++) {
 				shorter = g_slist_prepend (shorter, iter->data);
 			}
 
@@ -6726,6 +7857,9 @@ e_ews_connection_move_items (EEwsConnection *cnc,
 
 	e_ews_message_write_footer (msg);
 
+	ews_message_set_batch_items (msg, g_slist_length ((GSList *) ids),
+		e_ews_connection_get_batch_size (cnc, EWS_MOVE_ITEMS_CHUNK_SIZE, EWS_MOVE_ITEMS_MAX_CHUNK_SIZE));
+
 	simple = g_simple_async_result_new (
 		G_OBJECT (cnc), callback, user_data,
 		e_ews_connection_move_items);
@@ -6837,11 +7971,14 @@ e_ews_connection_move_items_in_chunks_sync (EEwsConnection *cnc,
 	iter = ids;
 
 	while (success && iter) {
-		guint n_ids;
+		guint n_ids, chunk_size;
 		const GSList *tmp_iter;
 		GSList *processed_items = NULL;
 
-		for (tmp_iter = iter, n_ids = 0; tmp_iter && n_ids < EWS_MOVE_ITEMS_CHUNK_SIZE; tmp_iter = g_slist_next (tmp_iter), n_ids++) {
+		/* Re-read for each chunk, it follows the server responsiveness */
+		chunk_size = e_ews_connection_get_batch_size (cnc, EWS_MOVE_ITEMS_CHUNK_SIZE, EWS_MOVE_ITEMS_MAX_CHUNK_SIZE);
+
+		for (tmp_iter = iter, n_ids = 0; tmp_iter && n_ids < chunk_size; tmp_iter = g_slist_next (tmp_iter), n_ids++) {
 			/* Only check bounds first, to avoid unnecessary allocations */
 		}
 
@@ -6851,7 +7988,7 @@ e_ews_connection_move_items_in_chunks_sync (EEwsConnection *cnc,
 			if (total_ids == 0)
 				total_ids = g_slist_length ((GSList *) ids);
 
-			for (n_ids = 0; iter && n_ids < EWS_MOVE_ITEMS_CHUNK_SIZE; iter = g_slist_next (iter), n_ids++) {
+			for (n_ids = 0; iter && n_ids < chunk_size; iter = g_slist_next (iter), n_ids++) {
 				shorter = g_slist_prepend (shorter, iter->data);
 			}
 
@@ -7215,6 +8352,169 @@ e_ews_connection_empty_folder_sync (EEwsConnection *cnc,
 	return success;
 }
 
+static void
+mark_all_items_as_read_response_cb (ESoapResponse *response,
+				    GSimpleAsyncResult *simple)
+{
+	ESoapParameter *param;
+	ESoapParameter *subparam;
+	GError *error = NULL;
+
+	param = e_soap_response_get_first_parameter_by_name (
+		response, "ResponseMessages", &error);
+
+	/* Sanity check */
+	g_return_if_fail (
+		(param != NULL && error == NULL) ||
+		(param == NULL && error != NULL));
+
+	if (error != NULL) {
+		g_simple_async_result_take_error (simple, error);
+		return;
+	}
+
+	subparam = e_soap_parameter_get_first_child (param);
+
+	while (subparam != NULL) {
+		if (!ews_get_response_status (subparam, &error)) {
+			g_simple_async_result_take_error (simple, error);
+			return;
+		}
+
+		subparam = e_soap_parameter_get_next_child (subparam);
+	}
+}
+
+/* Sets or clears the read flag of every item in the folder in one request;
+ * requires Exchange 2013 or later. */
+void
+e_ews_connection_mark_all_items_as_read (EEwsConnection *cnc,
+					 gint pri,
+					 const gchar *folder_id,
+					 gboolean is_distinguished_id,
+					 gboolean read_flag,
+					 gboolean suppress_read_receipts,
+					 GCancellable *cancellable,
+					 GAsyncReadyCallback callback,
+					 gpointer user_data)
+{
+	ESoapMessage *msg;
+	GSimpleAsyncResult *simple;
+	EwsAsyncData *async_data;
+
+	g_return_if_fail (cnc != NULL);
+	g_return_if_fail (folder_id != NULL);
+
+	msg = e_ews_message_new_with_header (
+			cnc->priv->settings,
+			cnc->priv->uri,
+			cnc->priv->impersonate_user,
+			"MarkAllItemsAsRead",
+			NULL,
+			NULL,
+			cnc->priv->version,
+			E_EWS_EXCHANGE_2013,
+			FALSE,
+			TRUE);
+
+	/* These are elements, which precede the FolderIds, not attributes */
+	e_ews_message_write_string_parameter (msg, "ReadFlag", "messages", read_flag ? "true" : "false");
+	e_ews_message_write_string_parameter (msg, "SuppressReadReceipts", "messages", suppress_read_receipts ? "true" : "false");
+
+	e_soap_message_start_element (msg, "FolderIds", "messages", NULL);
+
+	e_soap_message_start_element (
+			msg,
+			is_distinguished_id ? "DistinguishedFolderId" : "FolderId",
+			NULL,
+			NULL);
+	e_soap_message_add_attribute (msg, "Id", folder_id, NULL, NULL);
+
+	/* This element is required for delegate access */
+	if (is_distinguished_id && cnc->priv->email) {
+		e_soap_message_start_element (msg, "Mailbox", NULL, NULL);
+		e_ews_message_write_string_parameter(
+				msg, "EmailAddress", NULL, cnc->priv->email);
+		e_soap_message_end_element (msg);
+	}
+
+	e_soap_message_end_element (msg); /* </DistinguishedFolderId> || </FolderId> */
+
+	e_soap_message_end_element (msg); /* </FolderIds> */
+
+	e_ews_message_write_footer (msg);
+
+	simple = g_simple_async_result_new (
+		G_OBJECT (cnc), callback, user_data,
+		e_ews_connection_mark_all_items_as_read);
+
+	async_data = g_new0 (EwsAsyncData, 1);
+	g_simple_async_result_set_op_res_gpointer (
+		simple, async_data, (GDestroyNotify) async_data_free);
+
+	e_ews_connection_queue_request (
+		cnc, msg, mark_all_items_as_read_response_cb,
+		pri, cancellable, simple);
+
+	g_object_unref (simple);
+}
+
+gboolean
+e_ews_connection_mark_all_items_as_read_finish (EEwsConnection *cnc,
+						GAsyncResult *result,
+						GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (cnc != NULL, FALSE);
+	g_return_val_if_fail (
+		g_simple_async_result_is_valid (
+		result, G_OBJECT (cnc), e_ews_connection_mark_all_items_as_read),
+		FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	return TRUE;
+}
+
+gboolean
+e_ews_connection_mark_all_items_as_read_sync (EEwsConnection *cnc,
+					      gint pri,
+					      const gchar *folder_id,
+					      gboolean is_distinguished_id,
+					      gboolean read_flag,
+					      gboolean suppress_read_receipts,
+					      GCancellable *cancellable,
+					      GError **error)
+{
+	EAsyncClosure *closure;
+	GAsyncResult *result;
+	gboolean success;
+
+	g_return_val_if_fail (cnc != NULL, FALSE);
+
+	closure = e_async_closure_new ();
+
+	e_ews_connection_mark_all_items_as_read (
+		cnc, pri, folder_id,
+		is_distinguished_id,
+		read_flag,
+		suppress_read_receipts,
+		cancellable,
+		e_async_closure_callback, closure);
+
+	result = e_async_closure_wait (closure);
+
+	success = e_ews_connection_mark_all_items_as_read_finish (cnc, result, error);
+
+	e_async_closure_free (closure);
+
+	return success;
+}
+
 static void
 ews_handle_create_attachments_param (ESoapParameter *param,
                                      EwsAsyncData *async_data)
@@ -9959,39 +11259,22 @@ e_ews_connection_query_auth_methods_sync (EEwsConnection *cnc,
 	return success;
 }
 
-static void
-ews_connection_build_subscribed_folders_list (gpointer key,
-					      gpointer value,
-					      gpointer user_data)
-{
-	GSList *folders = value, *l;
-	EEwsConnection *cnc = user_data;
-
-	for (l = folders; l != NULL; l = l->next) {
-		if (g_slist_find_custom (cnc->priv->subscribed_folders, l->data, (GCompareFunc) g_strcmp0) == NULL) {
-			cnc->priv->subscribed_folders =
-				g_slist_prepend (cnc->priv->subscribed_folders, g_strdup (l->data));
-		}
-	}
-}
-
 /*
  * Enables server notification on a folder (or a set of folders).
  * The events we are listen for notifications are: Copied, Created, Deleted, Modified and Moved.
  *
- * As we have only one subscription per connection, for every enable_notifications_sync() call,
- * we do:
- * - Check if we already are subscribed
- * - If we are already subscribed:
- *  - Stop to send events regards to the already subscribed folders' list
- *  - Unsubscribe the already subscribed folders' list
- * - Add the user folders' lst to the hash table if subscribed folders
- * - Create a new list of the folders to subscribe for, based in the hash table of subscribed folders
- * - Subscribed to listen notifications for the folders
- * - Start to send events regards to the newly subscribed folders' list
+ * All the subscriptions of the connection are listened for with a single
+ * GetStreamingEvents request. Every enable_notifications_sync() call adds
+ * a new server subscription for the given folders only, without touching
+ * the other subscriptions; the streaming request is restarted to include it.
+ * The server keeps the events of the existing subscriptions meanwhile.
+ *
+ * When a subscription is lost (the server forgot it or the stream failed),
+ * it is subscribed again and a Modified event is emitted for each of its
+ * folders, because the events in between could have been missed.
  *
- * Pair function for this one is e_ews_connection_disable_notifications_sync() and we do
- * something really similar for every disable_notifications_sync() call.
+ * Pair function for this one is e_ews_connection_disable_notifications_sync(),
+ * which removes only the subscription identified by the subscription_key.
  *
  * The notification is received to the caller with the "server-notification" signal.
  * Note that the signal is used for each notification, without distinction on the
@@ -10016,15 +11299,6 @@ e_ews_connection_enable_notifications_sync (EEwsConnection *cnc,
 	if (subscriptions_size == G_MAXUINT - 1)
 		goto exit;
 
-	if (subscriptions_size > 0) {
-		e_ews_notification_stop_listening_sync (cnc->priv->notification);
-
-		g_clear_object (&cnc->priv->notification);
-
-		g_slist_free_full (cnc->priv->subscribed_folders, g_free);
-		cnc->priv->subscribed_folders = NULL;
-	}
-
 	while (g_hash_table_contains (cnc->priv->subscriptions, GINT_TO_POINTER (notification_key))) {
 		notification_key++;
 		if (notification_key == 0)
@@ -10035,13 +11309,14 @@ e_ews_connection_enable_notifications_sync (EEwsConnection *cnc,
 		new_folders = g_slist_prepend (new_folders, g_strdup (l->data));
 
 	g_hash_table_insert (cnc->priv->subscriptions, GINT_TO_POINTER (notification_key), new_folders);
-	new_folders = NULL;
 
-	g_hash_table_foreach (cnc->priv->subscriptions, ews_connection_build_subscribed_folders_list, cnc);
+	if (!cnc->priv->notification) {
+		cnc->priv->notification = e_ews_notification_new (cnc);
 
-	cnc->priv->notification = e_ews_notification_new (cnc);
+		e_ews_notification_start_listening_sync (cnc->priv->notification);
+	}
 
-	e_ews_notification_start_listening_sync (cnc->priv->notification, cnc->priv->subscribed_folders);
+	e_ews_notification_add_subscription (cnc->priv->notification, notification_key, new_folders);
 
 exit:
 	*subscription_key = notification_key;
@@ -10066,15 +11341,11 @@ e_ews_connection_disable_notifications_sync (EEwsConnection *cnc,
 	if (!g_hash_table_remove (cnc->priv->subscriptions, GINT_TO_POINTER (subscription_key)))
 		goto exit;
 
-	e_ews_notification_stop_listening_sync (cnc->priv->notification);
-
-	g_slist_free_full (cnc->priv->subscribed_folders, g_free);
-	cnc->priv->subscribed_folders = NULL;
+	e_ews_notification_remove_subscription (cnc->priv->notification, subscription_key);
 
-	g_hash_table_foreach (cnc->priv->subscriptions, ews_connection_build_subscribed_folders_list, cnc);
-	if (cnc->priv->subscribed_folders != NULL) {
-		e_ews_notification_start_listening_sync (cnc->priv->notification, cnc->priv->subscribed_folders);
-	} else {
+	if (g_hash_table_size (cnc->priv->subscriptions) == 0) {
+		/* The listening thread unsubscribes the removed subscription on its way out */
+		e_ews_notification_stop_listening_sync (cnc->priv->notification);
 		g_clear_object (&cnc->priv->notification);
 	}
 
@@ -55,6 +55,9 @@
 	(G_TYPE_INSTANCE_GET_CLASS \
 	((obj), E_TYPE_EWS_CONNECTION, EEwsConnectionClass))
 
+/* The largest MaxChangesReturned the SyncFolderItems request accepts */
+#define EWS_SYNC_FOLDER_ITEMS_MAX_CHANGES 512
+
 G_BEGIN_DECLS
 
 typedef struct _EEwsConnection EEwsConnection;
@@ -230,6 +233,8 @@ typedef struct {
 	gboolean is_item;
 	gchar *folder_id;
 	gchar *old_folder_id;
+	gchar *item_id; /* NULL for folder events */
+	gchar *old_item_id; /* set for moved items only */
 } EEwsNotificationEvent;
 
 /*
@@ -456,6 +461,17 @@ gboolean	e_ews_connection_get_backoff_enabled
 void		e_ews_connection_set_backoff_enabled
 						(EEwsConnection *cnc,
 						 gboolean enabled);
+guint		e_ews_connection_get_concurrent_connections
+						(EEwsConnection *cnc);
+void		e_ews_connection_set_concurrent_connections
+						(EEwsConnection *cnc,
+						 guint concurrent_connections);
+guint		e_ews_connection_get_batch_scale
+						(EEwsConnection *cnc);
+guint		e_ews_connection_get_batch_size
+						(EEwsConnection *cnc,
+						 guint default_size,
+						 guint max_size);
 gboolean	e_ews_connection_get_disconnected_flag
 						(EEwsConnection *cnc);
 void		e_ews_connection_set_disconnected_flag
@@ -534,6 +550,8 @@ gboolean	e_ews_connection_sync_folder_items_sync
 typedef void	(*EwsConvertQueryCallback)	(ESoapMessage *msg,
 						 const gchar *query,
 						 EEwsFolderType type);
+typedef gboolean (*EEwsFoundItemsFunc)		(const GSList *items, /* EEwsItem * */
+						 gpointer user_data);
 
 void		e_ews_connection_find_folder_items
 						(EEwsConnection *cnc,
@@ -570,6 +588,22 @@ gboolean	e_ews_connection_find_folder_items_sync
 						 EwsConvertQueryCallback convert_query_cb,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	e_ews_connection_find_folder_items_paged_sync
+						(EEwsConnection *cnc,
+						 gint pri,
+						 EwsFolderId *fid,
+						 const gchar *default_props,
+						 const EEwsAdditionalProps *add_props,
+						 EwsSortOrder *sort_order,
+						 const gchar *query,
+						 GPtrArray *only_ids, /* element-type utf8 */
+						 EEwsFolderType type,
+						 EwsConvertQueryCallback convert_query_cb,
+						 guint page_size,
+						 EEwsFoundItemsFunc func,
+						 gpointer func_user_data,
+						 GCancellable *cancellable,
+						 GError **error);
 
 EEwsServerVersion
 		e_ews_connection_get_server_version
@@ -615,6 +649,39 @@ gboolean	e_ews_connection_get_items_sync	(EEwsConnection *cnc,
 						 gpointer progress_data,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	e_ews_connection_get_items_to_stream_sync
+						(EEwsConnection *cnc,
+						 gint pri,
+						 const GSList *ids,
+						 const gchar *default_props,
+						 const EEwsAdditionalProps *add_props,
+						 GOutputStream *mime_stream,
+						 EEwsBodyType body_type,
+						 GSList **items,
+						 ESoapProgressFn progress_fn,
+						 gpointer progress_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
+/* Returns a new reference of the stream for the MIME content of the item */
+typedef GOutputStream * (*EEwsItemStreamFunc)	(const gchar *item_id,
+						 gpointer user_data);
+
+void		e_ews_connection_get_items_to_streams
+						(EEwsConnection *cnc,
+						 gint pri,
+						 const GSList *ids,
+						 const gchar *default_props,
+						 const EEwsAdditionalProps *add_props,
+						 EEwsItemStreamFunc stream_func,
+						 gpointer stream_func_data,
+						 guint batch_size,
+						 EEwsBodyType body_type,
+						 ESoapProgressFn progress_fn,
+						 gpointer progress_data,
+						 GCancellable *cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer user_data);
 
 void		e_ews_connection_delete_items	(EEwsConnection *cnc,
 						 gint pri,
@@ -879,6 +946,30 @@ gboolean	e_ews_connection_empty_folder_sync
 						 GCancellable *cancellable,
 						 GError **error);
 
+void		e_ews_connection_mark_all_items_as_read
+						(EEwsConnection *cnc,
+						 gint pri,
+						 const gchar *folder_id,
+						 gboolean is_distinguished_id,
+						 gboolean read_flag,
+						 gboolean suppress_read_receipts,
+						 GCancellable *cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer user_data);
+gboolean	e_ews_connection_mark_all_items_as_read_finish
+						(EEwsConnection *cnc,
+						 GAsyncResult *result,
+						 GError **error);
+gboolean	e_ews_connection_mark_all_items_as_read_sync
+						(EEwsConnection *cnc,
+						 gint pri,
+						 const gchar *folder_id,
+						 gboolean is_distinguished_id,
+						 gboolean read_flag,
+						 gboolean suppress_read_receipts,
+						 GCancellable *cancellable,
+						 GError **error);
+
 void		e_ews_connection_update_folder	(EEwsConnection *cnc,
 						 gint pri,
 						 EEwsRequestCreationCallback create_cb,
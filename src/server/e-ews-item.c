@@ -1499,6 +1499,13 @@ e_ews_item_set_from_soap_parameter (EEwsItem *item,
 			gsize data_len = 0;
 
 			value = e_soap_parameter_get_string_value (subparam);
+			if (!value || !*value) {
+				/* The content had been streamed elsewhere,
+				   see e_soap_message_store_node_data_to_stream() */
+				g_free (value);
+				continue;
+			}
+
 			data = g_base64_decode (value, &data_len);
 			if (!data || !data_len) {
 				g_free (value);
@@ -20,6 +20,8 @@
 
 #include <string.h>
 
+#include <libxml/parser.h>
+
 #include "e-ews-connection-utils.h"
 #include "e-ews-debug.h"
 #include "e-ews-notification.h"
@@ -34,10 +36,33 @@ G_DEFINE_TYPE (EEwsNotification, e_ews_notification, G_TYPE_OBJECT)
 struct _EEwsNotificationPrivate {
 	SoupSession *soup_session;
 	EEwsConnection *connection; /* not referred */
-	GByteArray *chunk;
 	GCancellable *cancellable;
+
+	/* The received, not yet processed, part of the streaming response;
+	   the bytes before the chunk_start are processed already and those
+	   before the chunk_scanned are known not to finish an envelope */
+	GByteArray *chunk;
+	guint chunk_start;
+	guint chunk_scanned;
+
+	/* All the subscriptions are listened for with one GetStreamingEvents
+	   request; a subscription change restarts only that request, thus
+	   the server keeps the events of the other subscriptions meanwhile */
+	GMutex subscriptions_lock;
+	GCond subscriptions_cond;
+	GHashTable *subscriptions; /* guint key ~> EwsNotificationSubscription * */
+	GSList *stale_subscription_ids; /* gchar *, to be unsubscribed */
+	GSList *failed_subscription_ids; /* gchar *, reported as failed by the server */
+	gboolean subscriptions_changed;
+	gboolean streaming;
 };
 
+typedef struct _EwsNotificationSubscription {
+	GSList *folders; /* gchar * */
+	gchar *subscription_id; /* NULL when not subscribed on the server yet */
+	gboolean resync; /* the events could have been missed, when set */
+} EwsNotificationSubscription;
+
 enum {
 	PROP_0,
 	PROP_CONNECTION
@@ -58,9 +83,20 @@ typedef struct _EEwsNotificationThreadData EEwsNotificationThreadData;
 struct _EEwsNotificationThreadData {
 	EEwsNotification *notification;
 	GCancellable *cancellable;
-	GSList *folders;
 };
 
+static void
+ews_notification_subscription_free (gpointer ptr)
+{
+	EwsNotificationSubscription *subscription = ptr;
+
+	if (subscription) {
+		g_slist_free_full (subscription->folders, g_free);
+		g_free (subscription->subscription_id);
+		g_free (subscription);
+	}
+}
+
 static void
 ews_notification_authenticate (SoupSession *session,
 			       SoupMessage *message,
@@ -183,6 +219,19 @@ ews_notification_dispose (GObject *object)
 	if (priv->cancellable != NULL)
 		g_clear_object (&priv->cancellable);
 
+	if (priv->chunk != NULL) {
+		g_byte_array_free (priv->chunk, TRUE);
+		priv->chunk = NULL;
+	}
+
+	g_mutex_lock (&priv->subscriptions_lock);
+	g_hash_table_remove_all (priv->subscriptions);
+	g_slist_free_full (priv->stale_subscription_ids, g_free);
+	priv->stale_subscription_ids = NULL;
+	g_slist_free_full (priv->failed_subscription_ids, g_free);
+	priv->failed_subscription_ids = NULL;
+	g_mutex_unlock (&priv->subscriptions_lock);
+
 	if (priv->connection != NULL) {
 		g_object_weak_unref (
 			G_OBJECT (priv->connection),
@@ -195,6 +244,21 @@ ews_notification_dispose (GObject *object)
 	G_OBJECT_CLASS (e_ews_notification_parent_class)->dispose (object);
 }
 
+static void
+ews_notification_finalize (GObject *object)
+{
+	EEwsNotificationPrivate *priv;
+
+	priv = E_EWS_NOTIFICATION_GET_PRIVATE (object);
+
+	g_hash_table_destroy (priv->subscriptions);
+	g_mutex_clear (&priv->subscriptions_lock);
+	g_cond_clear (&priv->subscriptions_cond);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_ews_notification_parent_class)->finalize (object);
+}
+
 static void
 e_ews_notification_class_init (EEwsNotificationClass *class)
 {
@@ -207,6 +271,7 @@ e_ews_notification_class_init (EEwsNotificationClass *class)
 	object_class->get_property = ews_notification_get_property;
 	object_class->constructed = ews_notification_constructed;
 	object_class->dispose = ews_notification_dispose;
+	object_class->finalize = ews_notification_finalize;
 
 	g_object_class_install_property (
 		object_class,
@@ -228,6 +293,10 @@ e_ews_notification_init (EEwsNotification *notification)
 
 	notification->priv = E_EWS_NOTIFICATION_GET_PRIVATE (notification);
 
+	g_mutex_init (&notification->priv->subscriptions_lock);
+	g_cond_init (&notification->priv->subscriptions_cond);
+	notification->priv->subscriptions = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, ews_notification_subscription_free);
+
 	notification->priv->soup_session = soup_session_sync_new ();
 
 	soup_session_add_feature_by_type (notification->priv->soup_session,
@@ -467,142 +536,332 @@ e_ews_notification_unsubscribe_folder_sync (EEwsNotification *notification,
 }
 
 
-static EEwsNotificationEvent *
-get_folder_event_info (ESoapParameter *param,
-		       EEwsNotificationEventType event_type)
-{
-	ESoapParameter *subparam;
-	EEwsNotificationEvent *event;
+/* State of the SAX parser of one <Envelope> of the streaming response;
+   the events are created directly, without building the response tree */
+typedef struct _EwsNotificationParser {
+	GSList *events; /* EEwsNotificationEvent *, in the reverse order */
+	guint depth;
 
-	event = e_ews_notification_event_new ();
+	guint notification_depth; /* 0 when not inside a <Notification> */
 
-	event->type = event_type;
-	event->is_item = FALSE;
+	/* The event being read, with the IDs of its children elements */
+	EEwsNotificationEvent *event;
+	guint event_depth;
+	gchar *folder_id;
+	gchar *old_folder_id;
+	gchar *parent_folder_id;
+	gchar *old_parent_folder_id;
+	gchar *item_id;
+	gchar *old_item_id;
+
+	gboolean failed;
+	gboolean in_response_code;
+	GString *response_code;
+
+	/* The subscriptions the server reports as failed */
+	guint error_ids_depth; /* 0 when not inside an <ErrorSubscriptionIds> */
+	gboolean in_error_id;
+	GString *error_id;
+	GSList *error_subscription_ids; /* gchar * */
+
+	gchar *parse_error; /* the first error reported by the parser */
+} EwsNotificationParser;
+
+static gchar *
+ews_notification_sax_dup_attribute (gint nb_attributes,
+				    const xmlChar **attributes,
+				    const gchar *name)
+{
+	gint ii;
 
-	subparam = e_soap_parameter_get_first_child_by_name (param, "FolderId");
-	event->folder_id = e_soap_parameter_get_property (subparam, "Id");
+	/* Each attribute is a localname/prefix/URI/value/end quintuple */
+	for (ii = 0; ii < nb_attributes; ii++) {
+		const xmlChar **attr = attributes + (ii * 5);
 
-	subparam = e_soap_parameter_get_first_child_by_name (param, "OldFolderId");
-	if (subparam != NULL) {
-		event->old_folder_id = e_soap_parameter_get_property (subparam, "Id");
+		if (g_strcmp0 ((const gchar *) attr[0], name) == 0)
+			return g_strndup ((const gchar *) attr[3], attr[4] - attr[3]);
 	}
 
-	return event;
+	return NULL;
 }
 
-static EEwsNotificationEvent *
-get_item_event_info (ESoapParameter *param,
-		     EEwsNotificationEventType event_type)
+static void
+ews_notification_sax_start_element (gpointer user_data,
+				    const xmlChar *xlocalname,
+				    const xmlChar *prefix,
+				    const xmlChar *uri,
+				    gint nb_namespaces,
+				    const xmlChar **namespaces,
+				    gint nb_attributes,
+				    gint nb_defaulted,
+				    const xmlChar **attributes)
 {
-	ESoapParameter *subparam;
-	EEwsNotificationEvent *event;
+	EwsNotificationParser *parser = user_data;
+	const gchar *localname = (const gchar *) xlocalname;
+
+	parser->depth++;
+
+	if (parser->event) {
+		gchar **pid = NULL;
+
+		if (g_strcmp0 (localname, "ItemId") == 0) {
+			parser->event->is_item = TRUE;
+			pid = &parser->item_id;
+		} else if (g_strcmp0 (localname, "OldItemId") == 0)
+			pid = &parser->old_item_id;
+		else if (g_strcmp0 (localname, "FolderId") == 0)
+			pid = &parser->folder_id;
+		else if (g_strcmp0 (localname, "OldFolderId") == 0)
+			pid = &parser->old_folder_id;
+		else if (g_strcmp0 (localname, "ParentFolderId") == 0)
+			pid = &parser->parent_folder_id;
+		else if (g_strcmp0 (localname, "OldParentFolderId") == 0)
+			pid = &parser->old_parent_folder_id;
+
+		if (pid && !*pid && parser->depth == parser->event_depth + 1)
+			*pid = ews_notification_sax_dup_attribute (nb_attributes, attributes, "Id");
+	} else if (parser->notification_depth) {
+		guint event_type;
 
-	event = e_ews_notification_event_new ();
+		for (event_type = 0; default_events_names[event_type] != NULL; event_type++) {
+			if (g_strcmp0 (localname, default_events_names[event_type]) == 0)
+				break;
+		}
 
-	event->type = event_type;
-	event->is_item = TRUE;
+		if (default_events_names[event_type] != NULL && event_type != E_EWS_NOTIFICATION_EVENT_STATUS) {
+			parser->event = e_ews_notification_event_new ();
+			parser->event->type = event_type;
+			parser->event->is_item = FALSE;
+			parser->event_depth = parser->depth;
+		}
+	} else if (g_strcmp0 (localname, "Notification") == 0) {
+		parser->notification_depth = parser->depth;
+	} else if (g_str_has_suffix (localname, "ResponseMessage")) {
+		gchar *response_class;
+
+		response_class = ews_notification_sax_dup_attribute (nb_attributes, attributes, "ResponseClass");
+		if (g_strcmp0 (response_class, "Error") == 0)
+			parser->failed = TRUE;
+		g_free (response_class);
+	} else if (g_strcmp0 (localname, "ResponseCode") == 0) {
+		parser->in_response_code = TRUE;
+		g_string_truncate (parser->response_code, 0);
+	} else if (g_strcmp0 (localname, "ErrorSubscriptionIds") == 0) {
+		parser->error_ids_depth = parser->depth;
+	} else if (parser->error_ids_depth && g_strcmp0 (localname, "SubscriptionId") == 0) {
+		parser->in_error_id = TRUE;
+		g_string_truncate (parser->error_id, 0);
+	}
+}
 
-	subparam = e_soap_parameter_get_first_child_by_name (param, "ParentFolderId");
-	event->folder_id = e_soap_parameter_get_property (subparam, "Id");
+static void
+ews_notification_sax_end_element (gpointer user_data,
+				  const xmlChar *localname,
+				  const xmlChar *prefix,
+				  const xmlChar *uri)
+{
+	EwsNotificationParser *parser = user_data;
+
+	if (parser->event && parser->depth == parser->event_depth) {
+		EEwsNotificationEvent *event = parser->event;
+
+		if (event->is_item) {
+			event->folder_id = parser->parent_folder_id;
+			event->old_folder_id = parser->old_parent_folder_id;
+			event->item_id = parser->item_id;
+			event->old_item_id = parser->old_item_id;
+			parser->parent_folder_id = NULL;
+			parser->old_parent_folder_id = NULL;
+			parser->item_id = NULL;
+			parser->old_item_id = NULL;
+		} else {
+			event->folder_id = parser->folder_id;
+			event->old_folder_id = parser->old_folder_id;
+			parser->folder_id = NULL;
+			parser->old_folder_id = NULL;
+		}
 
-	subparam = e_soap_parameter_get_first_child_by_name (param, "OldParentFolderId");
-	if (subparam != NULL) {
-		event->old_folder_id = e_soap_parameter_get_property (subparam, "Id");
+		g_clear_pointer (&parser->folder_id, g_free);
+		g_clear_pointer (&parser->old_folder_id, g_free);
+		g_clear_pointer (&parser->parent_folder_id, g_free);
+		g_clear_pointer (&parser->old_parent_folder_id, g_free);
+		g_clear_pointer (&parser->item_id, g_free);
+		g_clear_pointer (&parser->old_item_id, g_free);
+
+		parser->events = g_slist_prepend (parser->events, event);
+		parser->event = NULL;
+	} else if (parser->depth == parser->notification_depth) {
+		parser->notification_depth = 0;
+	} else if (parser->in_error_id) {
+		if (parser->error_id->len)
+			parser->error_subscription_ids = g_slist_prepend (parser->error_subscription_ids, g_strdup (parser->error_id->str));
+	} else if (parser->depth == parser->error_ids_depth) {
+		parser->error_ids_depth = 0;
 	}
 
-	return event;
+	parser->in_response_code = FALSE;
+	parser->in_error_id = FALSE;
+	parser->depth--;
 }
 
-static EEwsNotificationEvent *
-get_event_info (ESoapParameter *param,
-		EEwsNotificationEventType event_type)
+static void
+ews_notification_sax_characters (gpointer user_data,
+				 const xmlChar *ch,
+				 gint len)
 {
-	ESoapParameter *subparam;
+	EwsNotificationParser *parser = user_data;
 
-	subparam = e_soap_parameter_get_first_child_by_name (param, "ItemId");
-	return (subparam != NULL) ? get_item_event_info (param, event_type) : get_folder_event_info (param, event_type);
+	if (parser->in_response_code)
+		g_string_append_len (parser->response_code, (const gchar *) ch, len);
+	else if (parser->in_error_id)
+		g_string_append_len (parser->error_id, (const gchar *) ch, len);
 }
 
+/* Called by the parser for errors and fatal errors; only the first is kept */
 static void
-ews_notification_handle_events_param (ESoapParameter *node,
-				      GSList **events)
+ews_notification_sax_error (gpointer user_data,
+			    const gchar *msg,
+			    ...)
 {
-	ESoapParameter *param;
-	EEwsNotificationEvent *event;
-	guint event_type;
+	EwsNotificationParser *parser = user_data;
+	va_list args;
 
-	param = e_soap_parameter_get_first_child_by_name (node, "SubscriptionId");
+	if (parser->parse_error)
+		return;
 
-	for (param = e_soap_parameter_get_next_child (param); param != NULL; param = e_soap_parameter_get_next_child (param)) {
-		for (event_type = 0; default_events_names[event_type] != NULL; event_type++) {
-			if (g_strcmp0 ((const gchar *) param->name, default_events_names[event_type]) == 0)
-				break;
+	va_start (args, msg);
+	parser->parse_error = g_strdup_vprintf (msg, args);
+	va_end (args);
 
-			continue;
-		}
+	g_strchomp (parser->parse_error);
+}
 
-		if (default_events_names[event_type] == NULL)
-			continue;
+/**
+ * e_ews_notification_parse_envelope:
+ * @envelope: one SOAP Envelope of a GetStreamingEvents response
+ * @envelope_len: length of the @envelope, in bytes
+ * @out_events: (out) (transfer full) (element-type EEwsNotificationEvent):
+ *    return location for the events, in the order as received
+ * @out_failed_subscription_ids: (out) (transfer full) (element-type utf8):
+ *    return location for the subscription IDs, which the server reports as failed
+ * @error: return location for a #GError, or %NULL
+ *
+ * Parses one Envelope of the streaming notification response. When the server
+ * reports an error, the function fails and the @out_failed_subscription_ids
+ * contains the subscriptions it failed for, if it says so. Free the returned
+ * lists with g_slist_free_full(), using e_ews_notification_event_free()
+ * and g_free() respectively.
+ *
+ * Returns: Whether the @envelope was parsed and reported no error.
+ **/
+gboolean
+e_ews_notification_parse_envelope (const gchar *envelope,
+				   gsize envelope_len,
+				   GSList **out_events,
+				   GSList **out_failed_subscription_ids,
+				   GError **error)
+{
+	EwsNotificationParser parser;
+	xmlSAXHandler sax;
+	xmlParserCtxtPtr ctxt;
+	gboolean success;
+
+	g_return_val_if_fail (envelope != NULL, FALSE);
+	g_return_val_if_fail (out_events != NULL, FALSE);
+	g_return_val_if_fail (out_failed_subscription_ids != NULL, FALSE);
+
+	*out_events = NULL;
+	*out_failed_subscription_ids = NULL;
+
+	memset (&parser, 0, sizeof (EwsNotificationParser));
+	parser.response_code = g_string_new ("");
+	parser.error_id = g_string_new ("");
+
+	memset (&sax, 0, sizeof (xmlSAXHandler));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = ews_notification_sax_start_element;
+	sax.endElementNs = ews_notification_sax_end_element;
+	sax.characters = ews_notification_sax_characters;
+	sax.error = ews_notification_sax_error;
+	sax.fatalError = ews_notification_sax_error;
+
+	/* The whole envelope is known, thus it's parsed as the only chunk */
+	ctxt = xmlCreatePushParserCtxt (&sax, &parser, NULL, 0, NULL);
+	if (ctxt) {
+		xmlCtxtUseOptions (ctxt, XML_PARSE_NONET);
+		success = xmlParseChunk (ctxt, envelope, (gint) envelope_len, 1) == 0 && !parser.parse_error;
+		xmlFreeParserCtxt (ctxt);
+	} else {
+		success = FALSE;
+	}
 
-		if (event_type != E_EWS_NOTIFICATION_EVENT_STATUS) {
-			event = get_event_info (param, event_type);
-			*events = g_slist_prepend (*events, event);
-		}
+	if (!success) {
+		g_set_error (
+			error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_CORRUPTDATA,
+			"Failed to parse notification response: %s",
+			parser.parse_error ? parser.parse_error : "Unknown error");
+	} else if (parser.failed) {
+		const gchar *response_code = parser.response_code->len ? parser.response_code->str : NULL;
+
+		g_set_error_literal (
+			error, EWS_CONNECTION_ERROR,
+			response_code ? ews_get_error_code (response_code) : EWS_CONNECTION_ERROR_UNKNOWN,
+			response_code ? response_code : "Unknown error");
+		success = FALSE;
+
+		*out_failed_subscription_ids = g_slist_reverse (parser.error_subscription_ids);
+		parser.error_subscription_ids = NULL;
+	} else {
+		*out_events = g_slist_reverse (parser.events);
+		parser.events = NULL;
 	}
 
-	*events = g_slist_reverse (*events);
+	if (parser.event)
+		e_ews_notification_event_free (parser.event);
+	g_slist_free_full (parser.events, (GDestroyNotify) e_ews_notification_event_free);
+	g_free (parser.folder_id);
+	g_free (parser.old_folder_id);
+	g_free (parser.parent_folder_id);
+	g_free (parser.old_parent_folder_id);
+	g_free (parser.item_id);
+	g_free (parser.old_item_id);
+	g_free (parser.parse_error);
+	g_string_free (parser.response_code, TRUE);
+	g_string_free (parser.error_id, TRUE);
+	g_slist_free_full (parser.error_subscription_ids, g_free);
+
+	return success;
 }
 
+/* Parses one <Envelope> of the streaming response and emits
+   the "server-notification" signal with the events it contains */
 static gboolean
-ews_notification_fire_events_from_response (EEwsNotification *notification,
-					    ESoapResponse *response)
+ews_notification_fire_events_from_envelope (EEwsNotification *notification,
+					    const gchar *envelope,
+					    gsize envelope_len)
 {
-	ESoapParameter *param, *subparam;
-	GSList *events = NULL;
-	GError *error = NULL;
-
-	param = e_soap_response_get_first_parameter_by_name (response, "ResponseMessages", &error);
-
-	/* Sanity check */
-	g_warn_if_fail ((param != NULL && error == NULL) || (param == NULL && error != NULL));
+	GSList *events = NULL, *failed_ids = NULL;
+	GError *local_error = NULL;
+
+	if (!e_ews_notification_parse_envelope (envelope, envelope_len, &events, &failed_ids, &local_error)) {
+		g_warning (G_STRLOC ": %s", local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+
+		/* Only these are subscribed again, the others keep working */
+		if (failed_ids) {
+			g_mutex_lock (&notification->priv->subscriptions_lock);
+			notification->priv->failed_subscription_ids = g_slist_concat (
+				failed_ids, notification->priv->failed_subscription_ids);
+			g_mutex_unlock (&notification->priv->subscriptions_lock);
+		}
 
-	if (error != NULL) {
-		g_warning (G_STRLOC ": %s\n", error->message);
-		g_error_free (error);
 		return FALSE;
 	}
 
-	subparam = e_soap_parameter_get_first_child (param);
-
-	while (subparam != NULL) {
-		const gchar *name = (const gchar *) subparam->name;
-
-		if (!ews_get_response_status (subparam, &error)) {
-			g_warning (G_STRLOC ": %s\n", error->message);
-			g_error_free (error);
-			g_slist_free_full (events, (GDestroyNotify) e_ews_notification_event_free);
-			return FALSE;
-		}
-
-		if (E_EWS_CONNECTION_UTILS_CHECK_ELEMENT (name, "GetStreamingEventsResponseMessage")) {
-			ESoapParameter *node, *node2;
+	if (events && notification->priv->connection)
+		g_signal_emit_by_name (notification->priv->connection, "server-notification", events);
 
-			node = e_soap_parameter_get_first_child_by_name (subparam, "Notifications");
-			if (node) {
-				node2 = e_soap_parameter_get_first_child_by_name (node, "Notification");
-				if (node2)
-					ews_notification_handle_events_param (node2, &events);
-			}
-		}
-
-		subparam = e_soap_parameter_get_next_child (subparam);
-	}
-
-	if (events != NULL) {
-		if (notification->priv->connection)
-			g_signal_emit_by_name (notification->priv->connection, "server-notification", events);
-		g_slist_free_full (events, (GDestroyNotify) e_ews_notification_event_free);
-	}
+	g_slist_free_full (events, (GDestroyNotify) e_ews_notification_event_free);
 
 	return TRUE;
 }
@@ -633,10 +892,10 @@ ews_notification_soup_got_chunk (SoupMessage *msg,
 				 gpointer user_data)
 {
 	EEwsNotification *notification = user_data;
-	const gchar *chunk_str;
-	gsize chunk_len;
-	gboolean keep_parsing = TRUE;
+	EEwsNotificationPrivate *priv = notification->priv;
+	const gsize end_tag_len = strlen ("</Envelope>");
 	gint log_level = e_ews_debug_get_log_level ();
+	gboolean abort_scheduled = FALSE;
 
 	/*
 	 * Here we receive, in chunks, "well-formed" messages that contain:
@@ -648,84 +907,141 @@ ews_notification_soup_got_chunk (SoupMessage *msg,
 	 *
 	 * We are parsing those chunks in the following way:
 	 * 1. Append newly arrived chunk->data to notification->priv->chunk->data
-	 * 2. Search for </Envelope> in notification->priv->chunk->data
-	 * 3.1 </Envelope> is not found: Do nothing. Waiting for the next chunk
-	 * 3.2 </Envelope> is found: Get the pair <Envelope>...</Envelope> and handle it
-	 * 4. Update the notification->priv->chunk->{data,len}, removing the pair used in 3.2
+	 * 2. Search for </Envelope> from the chunk_scanned offset; the bytes
+	 *    before it had been searched already with the previous chunks
+	 * 3.1 </Envelope> is not found: Remember how far it was searched
+	 *     and wait for the next chunk
+	 * 3.2 </Envelope> is found: Parse the <Envelope>...</Envelope> pair
+	 *     from the chunk_start and handle it
+	 * 4. Move the chunk_start after the pair, without moving the data
 	 * 5. Repeat from 2, until that 3.1 happens
+	 *
+	 * The processed data is dropped when all the data is processed,
+	 * or moved away when it occupies most of the buffer, thus each byte
+	 * is scanned once and moved at most once.
 	 */
-	if (notification->priv->chunk == NULL)
-		notification->priv->chunk = g_byte_array_new ();
-
-	notification->priv->chunk =
-		g_byte_array_append (notification->priv->chunk, (guint8 *) chunk->data, chunk->length);
+	if (priv->chunk == NULL) {
+		priv->chunk = g_byte_array_new ();
+		priv->chunk_start = 0;
+		priv->chunk_scanned = 0;
+	}
 
-	chunk_str = (gchar *) notification->priv->chunk->data;
-	chunk_len = notification->priv->chunk->len;
+	g_byte_array_append (priv->chunk, (guint8 *) chunk->data, chunk->length);
 
-	do {
-		ESoapResponse *response;
+	while (priv->chunk_start < priv->chunk->len) {
+		const gchar *data = (const gchar *) priv->chunk->data;
 		const gchar *end;
 		gsize len;
-		gboolean cancelled = FALSE;
 
-		end = g_strstr_len (chunk_str, chunk_len, "</Envelope>");
+		end = g_strstr_len (data + priv->chunk_scanned, priv->chunk->len - priv->chunk_scanned, "</Envelope>");
 
-		if (end == NULL)
+		if (end == NULL) {
+			/* The end tag can be split between this and the next chunk */
+			if (priv->chunk->len - priv->chunk_start >= end_tag_len)
+				priv->chunk_scanned = MAX (priv->chunk_scanned, priv->chunk->len - end_tag_len + 1);
 			break;
+		}
 
-		len = end + strlen ("</Envelope>") - chunk_str;
-
-		response = e_soap_response_new_from_string (chunk_str, len);
-		if (response == NULL)
-			break;
+		len = end + end_tag_len - (data + priv->chunk_start);
 
 		if (log_level >= 1 && log_level < 3) {
+			ESoapResponse *response;
+
 			e_ews_debug_dump_raw_soup_response (msg);
-			e_soap_response_dump_response (response, stdout);
+
+			response = e_soap_response_new_from_string (data + priv->chunk_start, len);
+			if (response) {
+				e_soap_response_dump_response (response, stdout);
+				g_object_unref (response);
+			}
 		}
 
-		if (!ews_notification_fire_events_from_response (notification, response)) {
-			ews_notification_schedule_abort (notification->priv->soup_session);
+		/* The stream is restarted to subscribe the failed subscriptions again;
+		   the envelopes received meanwhile are still processed */
+		if (!ews_notification_fire_events_from_envelope (notification, data + priv->chunk_start, len) &&
+		    !abort_scheduled) {
+			ews_notification_schedule_abort (priv->soup_session);
+			abort_scheduled = TRUE;
+		}
 
-			g_object_unref (response);
+		priv->chunk_start += len;
+		priv->chunk_scanned = priv->chunk_start;
+
+		if (g_cancellable_is_cancelled (priv->cancellable)) {
+			/* Abort any pending operations, but not here, rather in another thread */
+			ews_notification_schedule_abort (priv->soup_session);
+
+			priv->chunk_start = priv->chunk->len;
 			break;
 		}
-		g_object_unref (response);
+	}
 
-		notification->priv->chunk = g_byte_array_remove_range (notification->priv->chunk, 0, len);
+	if (priv->chunk_start == priv->chunk->len) {
+		g_byte_array_set_size (priv->chunk, 0);
+		priv->chunk_start = 0;
+		priv->chunk_scanned = 0;
+	} else if (priv->chunk_start > priv->chunk->len / 2) {
+		g_byte_array_remove_range (priv->chunk, 0, priv->chunk_start);
+		priv->chunk_scanned -= priv->chunk_start;
+		priv->chunk_start = 0;
+	}
+}
 
-		chunk_str = (gchar *) notification->priv->chunk->data;
-		chunk_len = notification->priv->chunk->len;
+/* The request is running now, thus it can be aborted on a subscription change;
+   a change made before the request started is picked up here */
+static void
+ews_notification_soup_got_headers (SoupMessage *msg,
+				   gpointer user_data)
+{
+	EEwsNotification *notification = user_data;
+	EEwsNotificationPrivate *priv = notification->priv;
 
-		cancelled = g_cancellable_is_cancelled (notification->priv->cancellable);
-		if (chunk_len == 0 || cancelled) {
-			g_byte_array_free (notification->priv->chunk, TRUE);
-			notification->priv->chunk = NULL;
-			keep_parsing = FALSE;
+	g_mutex_lock (&priv->subscriptions_lock);
 
-			if (cancelled) {
-				/* Abort any pending operations, but not here, rather in another thread */
-				ews_notification_schedule_abort (notification->priv->soup_session);
-			}
-		}
-	} while (keep_parsing);
+	priv->streaming = TRUE;
+
+	if (priv->subscriptions_changed)
+		ews_notification_schedule_abort (priv->soup_session);
+
+	g_mutex_unlock (&priv->subscriptions_lock);
+}
+
+/* Whether a part of an envelope was received, but not processed */
+static gboolean
+ews_notification_has_unprocessed_data (EEwsNotification *notification)
+{
+	EEwsNotificationPrivate *priv = notification->priv;
+	guint ii;
+
+	if (!priv->chunk)
+		return FALSE;
+
+	for (ii = priv->chunk_start; ii < priv->chunk->len; ii++) {
+		if (!g_ascii_isspace (priv->chunk->data[ii]))
+			return TRUE;
+	}
+
+	return FALSE;
 }
 
 static gboolean
 e_ews_notification_get_events_sync (EEwsNotification *notification,
-				    const gchar *subscription_id,
-				    gboolean *out_fatal_error)
+				    const GSList *subscription_ids,
+				    gboolean *out_fatal_error,
+				    gboolean *out_cut_off)
 {
+	const GSList *link;
 	ESoapMessage *msg;
 	CamelEwsSettings *settings;
 	gboolean ret;
-	gulong handler_id;
+	gulong handler_id, headers_handler_id;
 	guint status_code;
 
 	g_return_val_if_fail (out_fatal_error != NULL, FALSE);
+	g_return_val_if_fail (out_cut_off != NULL, FALSE);
 
 	*out_fatal_error = TRUE;
+	*out_cut_off = FALSE;
 
 	g_return_val_if_fail (notification != NULL, FALSE);
 	g_return_val_if_fail (notification->priv != NULL, FALSE);
@@ -753,7 +1069,9 @@ e_ews_notification_get_events_sync (EEwsNotification *notification,
 	}
 
 	e_soap_message_start_element (msg, "SubscriptionIds", "messages", NULL);
-	e_ews_message_write_string_parameter_with_attribute (msg, "SubscriptionId", NULL, subscription_id, NULL, NULL);
+	for (link = subscription_ids; link; link = g_slist_next (link)) {
+		e_ews_message_write_string_parameter_with_attribute (msg, "SubscriptionId", NULL, link->data, NULL, NULL);
+	}
 	e_soap_message_end_element (msg); /* SubscriptionIds */
 
 	e_ews_message_write_string_parameter_with_attribute (msg, "ConnectionTimeout", "messages", "10", NULL, NULL);
@@ -763,6 +1081,16 @@ e_ews_notification_get_events_sync (EEwsNotification *notification,
 	if (e_ews_debug_get_log_level () <= 2)
 		soup_message_body_set_accumulate (SOUP_MESSAGE (msg)->response_body, FALSE);
 
+	/* Leftovers of a previous, interrupted, response */
+	if (notification->priv->chunk)
+		g_byte_array_set_size (notification->priv->chunk, 0);
+	notification->priv->chunk_start = 0;
+	notification->priv->chunk_scanned = 0;
+
+	headers_handler_id = g_signal_connect (
+		SOUP_MESSAGE (msg), "got-headers",
+		G_CALLBACK (ews_notification_soup_got_headers), notification);
+
 	handler_id = g_signal_connect (
 		SOUP_MESSAGE (msg), "got-chunk",
 		G_CALLBACK (ews_notification_soup_got_chunk), notification);
@@ -772,6 +1100,11 @@ e_ews_notification_get_events_sync (EEwsNotification *notification,
 	ret = SOUP_STATUS_IS_SUCCESSFUL (status_code);
 	*out_fatal_error = SOUP_STATUS_IS_CLIENT_ERROR (status_code) || SOUP_STATUS_IS_SERVER_ERROR (status_code);
 
+	/* The server considers the events written to the response as delivered,
+	   thus those in an interrupted envelope are lost */
+	*out_cut_off = !ret && ews_notification_has_unprocessed_data (notification);
+
+	g_signal_handler_disconnect (msg, headers_handler_id);
 	g_signal_handler_disconnect (msg, handler_id);
 	g_object_unref (msg);
 
@@ -785,59 +1118,303 @@ ews_notification_cancelled_cb (GCancellable *cancellable,
 	ews_notification_schedule_abort (session);
 }
 
+static void
+ews_notification_wake_cb (GCancellable *cancellable,
+			  EEwsNotification *notification)
+{
+	g_mutex_lock (&notification->priv->subscriptions_lock);
+	g_cond_broadcast (&notification->priv->subscriptions_cond);
+	g_mutex_unlock (&notification->priv->subscriptions_lock);
+}
+
+/* Lets the listening thread know about a new subscription, which can be
+   listened for only by restarting the GetStreamingEvents;
+   called with the subscriptions_lock held */
+static void
+ews_notification_subscriptions_changed_locked (EEwsNotification *notification)
+{
+	notification->priv->subscriptions_changed = TRUE;
+	g_cond_broadcast (&notification->priv->subscriptions_cond);
+
+	/* Restart the running GetStreamingEvents with the new subscription list */
+	if (notification->priv->streaming)
+		ews_notification_schedule_abort (notification->priv->soup_session);
+}
+
+/* Tells the subscribers to refresh the folders, for which the events
+   could be missed, because their subscription had been lost */
+static void
+ews_notification_emit_resync (EEwsNotification *notification,
+			      const GSList *folders)
+{
+	GSList *events = NULL;
+	const GSList *link;
+
+	for (link = folders; link; link = g_slist_next (link)) {
+		EEwsNotificationEvent *event;
+
+		event = e_ews_notification_event_new ();
+		event->type = E_EWS_NOTIFICATION_EVENT_MODIFIED;
+		event->is_item = TRUE;
+		event->folder_id = g_strdup (link->data);
+
+		events = g_slist_prepend (events, event);
+	}
+
+	events = g_slist_reverse (events);
+
+	if (events && notification->priv->connection)
+		g_signal_emit_by_name (notification->priv->connection, "server-notification", events);
+
+	g_slist_free_full (events, (GDestroyNotify) e_ews_notification_event_free);
+}
+
+/* Unsubscribes the removed subscriptions and subscribes the new ones
+   on the server, then returns the IDs of all the current subscriptions */
+static GSList *
+ews_notification_update_subscriptions_sync (EEwsNotification *notification,
+					    GCancellable *cancellable)
+{
+	EEwsNotificationPrivate *priv = notification->priv;
+	GHashTableIter iter;
+	gpointer key, value;
+	GSList *stale_ids, *link, *ids = NULL;
+	gboolean again;
+
+	g_mutex_lock (&priv->subscriptions_lock);
+	stale_ids = priv->stale_subscription_ids;
+	priv->stale_subscription_ids = NULL;
+	g_mutex_unlock (&priv->subscriptions_lock);
+
+	for (link = stale_ids; link; link = g_slist_next (link)) {
+		e_ews_notification_unsubscribe_folder_sync (notification, link->data);
+	}
+
+	g_slist_free_full (stale_ids, g_free);
+
+	do {
+		guint subscription_key = 0;
+		GSList *folders = NULL;
+		gchar *subscription_id = NULL;
+		gboolean resync = FALSE;
+
+		again = FALSE;
+
+		g_mutex_lock (&priv->subscriptions_lock);
+
+		g_hash_table_iter_init (&iter, priv->subscriptions);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			EwsNotificationSubscription *subscription = value;
+
+			if (!subscription->subscription_id) {
+				subscription_key = GPOINTER_TO_UINT (key);
+				for (link = subscription->folders; link; link = g_slist_next (link))
+					folders = g_slist_prepend (folders, g_strdup (link->data));
+				break;
+			}
+		}
+
+		g_mutex_unlock (&priv->subscriptions_lock);
+
+		/* Subscribed without the lock held, thus the subscription could be
+		   removed meanwhile; its ID is put between the stale IDs then */
+		if (folders && !g_cancellable_is_cancelled (cancellable) &&
+		    e_ews_notification_subscribe_folder_sync (notification, folders, &subscription_id, cancellable)) {
+			EwsNotificationSubscription *subscription;
+
+			g_mutex_lock (&priv->subscriptions_lock);
+
+			subscription = g_hash_table_lookup (priv->subscriptions, GUINT_TO_POINTER (subscription_key));
+			if (subscription && !subscription->subscription_id) {
+				subscription->subscription_id = subscription_id;
+				resync = subscription->resync;
+				subscription->resync = FALSE;
+				again = TRUE;
+			} else {
+				priv->stale_subscription_ids = g_slist_prepend (priv->stale_subscription_ids, subscription_id);
+			}
+
+			g_mutex_unlock (&priv->subscriptions_lock);
+		}
+
+		if (resync)
+			ews_notification_emit_resync (notification, folders);
+
+		g_slist_free_full (folders, g_free);
+	} while (again);
+
+	g_mutex_lock (&priv->subscriptions_lock);
+
+	g_hash_table_iter_init (&iter, priv->subscriptions);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		EwsNotificationSubscription *subscription = value;
+
+		if (subscription->subscription_id)
+			ids = g_slist_prepend (ids, g_strdup (subscription->subscription_id));
+	}
+
+	/* The streaming flag is set once the request runs, see
+	   ews_notification_soup_got_headers() */
+	priv->subscriptions_changed = FALSE;
+
+	g_mutex_unlock (&priv->subscriptions_lock);
+
+	return ids;
+}
+
+/* The server forgot the subscriptions with the failed_ids, or all of them
+   when it's NULL, like when the stream failed; subscribe them again and let
+   the subscribers know they could have missed events */
+static void
+ews_notification_reset_subscriptions (EEwsNotification *notification,
+				      const GSList *failed_ids)
+{
+	EEwsNotificationPrivate *priv = notification->priv;
+	GHashTableIter iter;
+	gpointer value;
+
+	g_mutex_lock (&priv->subscriptions_lock);
+
+	g_hash_table_iter_init (&iter, priv->subscriptions);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		EwsNotificationSubscription *subscription = value;
+
+		if (subscription->subscription_id && (!failed_ids ||
+		    g_slist_find_custom ((GSList *) failed_ids, subscription->subscription_id, (GCompareFunc) g_strcmp0))) {
+			priv->stale_subscription_ids = g_slist_prepend (priv->stale_subscription_ids, subscription->subscription_id);
+			subscription->subscription_id = NULL;
+			subscription->resync = TRUE;
+		}
+	}
+
+	g_mutex_unlock (&priv->subscriptions_lock);
+}
+
+/* The events of the subscriptions with the subscription_ids could be lost
+   with an interrupted response; let the subscribers know, unless those
+   subscriptions are being subscribed again, which does the same */
+static void
+ews_notification_resync_subscriptions (EEwsNotification *notification,
+				       const GSList *subscription_ids)
+{
+	EEwsNotificationPrivate *priv = notification->priv;
+	GHashTableIter iter;
+	gpointer value;
+	GSList *folders = NULL, *link;
+
+	g_mutex_lock (&priv->subscriptions_lock);
+
+	g_hash_table_iter_init (&iter, priv->subscriptions);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		EwsNotificationSubscription *subscription = value;
+
+		if (subscription->subscription_id && !subscription->resync &&
+		    g_slist_find_custom ((GSList *) subscription_ids, subscription->subscription_id, (GCompareFunc) g_strcmp0)) {
+			for (link = subscription->folders; link; link = g_slist_next (link))
+				folders = g_slist_prepend (folders, g_strdup (link->data));
+		}
+	}
+
+	g_mutex_unlock (&priv->subscriptions_lock);
+
+	folders = g_slist_reverse (folders);
+
+	ews_notification_emit_resync (notification, folders);
+
+	g_slist_free_full (folders, g_free);
+}
+
 static gpointer
 e_ews_notification_get_events_thread (gpointer user_data)
 {
 	EEwsNotificationThreadData *td = user_data;
-	gchar *subscription_id = NULL;
-	gboolean ret, fatal_error = FALSE;
+	EEwsNotificationPrivate *priv;
+	gulong wake_handler_id;
+	gboolean ret = TRUE, fatal_error = FALSE, cut_off = FALSE;
 
 	g_return_val_if_fail (td != NULL, NULL);
 	g_return_val_if_fail (td->notification != NULL, NULL);
-	g_return_val_if_fail (td->folders != NULL, NULL);
 
-	if (!e_ews_notification_subscribe_folder_sync (td->notification, td->folders, &subscription_id, td->cancellable))
-		goto exit;
+	priv = td->notification->priv;
 
-	do {
+	wake_handler_id = g_cancellable_connect (td->cancellable, G_CALLBACK (ews_notification_wake_cb), td->notification, NULL);
+
+	while (ret && !g_cancellable_is_cancelled (td->cancellable)) {
+		GSList *subscription_ids, *failed_ids;
+		gboolean changed;
 		gulong handler_id;
 
-		if (g_cancellable_is_cancelled (td->cancellable))
-			goto exit;
+		subscription_ids = ews_notification_update_subscriptions_sync (td->notification, td->cancellable);
+
+		if (!subscription_ids) {
+			/* Nothing to listen for; wait for a new subscription */
+			g_mutex_lock (&priv->subscriptions_lock);
+			while (!priv->subscriptions_changed && !g_cancellable_is_cancelled (td->cancellable))
+				g_cond_wait (&priv->subscriptions_cond, &priv->subscriptions_lock);
+			g_mutex_unlock (&priv->subscriptions_lock);
+			continue;
+		}
 
 		handler_id = g_cancellable_connect (td->cancellable, G_CALLBACK (ews_notification_cancelled_cb),
-			g_object_ref (td->notification->priv->soup_session), g_object_unref);
+			g_object_ref (priv->soup_session), g_object_unref);
 
-		ret = e_ews_notification_get_events_sync (td->notification, subscription_id, &fatal_error);
+		ret = e_ews_notification_get_events_sync (td->notification, subscription_ids, &fatal_error, &cut_off);
 
 		if (handler_id > 0)
 			g_cancellable_disconnect (td->cancellable, handler_id);
 
-		if (!ret && !g_cancellable_is_cancelled (td->cancellable)) {
-			g_debug ("%s: Failed to get notification events (SubscriptionId: '%s')", G_STRFUNC, subscription_id);
+		g_mutex_lock (&priv->subscriptions_lock);
+		priv->streaming = FALSE;
+		changed = priv->subscriptions_changed;
+		failed_ids = priv->failed_subscription_ids;
+		priv->failed_subscription_ids = NULL;
+		g_mutex_unlock (&priv->subscriptions_lock);
+
+		if (failed_ids) {
+			/* Aborted to subscribe again only those the server reported */
+			ews_notification_reset_subscriptions (td->notification, failed_ids);
+			ret = TRUE;
+		} else if (!ret && changed) {
+			/* Aborted to pick up the new subscriptions */
+			ret = TRUE;
+		} else if (!ret && !g_cancellable_is_cancelled (td->cancellable)) {
+			g_debug ("%s: Failed to get notification events", G_STRFUNC);
+
+			ews_notification_reset_subscriptions (td->notification, NULL);
+
+			/* Keep listening, unless the server refuses the requests */
+			ret = !fatal_error;
+		}
+
+		if (cut_off && !g_cancellable_is_cancelled (td->cancellable))
+			ews_notification_resync_subscriptions (td->notification, subscription_ids);
 
-			e_ews_notification_unsubscribe_folder_sync (td->notification, subscription_id);
-			g_free (subscription_id);
-			subscription_id = NULL;
+		g_slist_free_full (failed_ids, g_free);
+		g_slist_free_full (subscription_ids, g_free);
+	}
+
+	g_cancellable_disconnect (td->cancellable, wake_handler_id);
+
+	/* Nobody listens anymore, thus unsubscribe everything */
+	g_mutex_lock (&priv->subscriptions_lock);
+	{
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, priv->subscriptions);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			EwsNotificationSubscription *subscription = value;
 
-			if (!fatal_error) {
-				ret = e_ews_notification_subscribe_folder_sync (td->notification, td->folders, &subscription_id, td->cancellable);
-				if (ret) {
-					g_debug ("%s: Re-subscribed to get notifications events (SubscriptionId: '%s')", G_STRFUNC, subscription_id);
-				} else {
-					g_debug ("%s: Failed to re-subscribed to get notifications events", G_STRFUNC);
-				}
+			if (subscription->subscription_id) {
+				priv->stale_subscription_ids = g_slist_prepend (priv->stale_subscription_ids, subscription->subscription_id);
+				subscription->subscription_id = NULL;
 			}
 		}
-	} while (ret);
-
-exit:
-	if (subscription_id != NULL) {
-		e_ews_notification_unsubscribe_folder_sync (td->notification, subscription_id);
-		g_free (subscription_id);
 	}
+	g_mutex_unlock (&priv->subscriptions_lock);
+
+	ews_notification_update_subscriptions_sync (td->notification, td->cancellable);
 
-	g_slist_free_full (td->folders, g_free);
 	g_object_unref (td->cancellable);
 	g_object_unref (td->notification);
 	g_free (td);
@@ -846,16 +1423,13 @@ exit:
 }
 
 void
-e_ews_notification_start_listening_sync (EEwsNotification *notification,
-					 GSList *folders)
+e_ews_notification_start_listening_sync (EEwsNotification *notification)
 {
 	EEwsNotificationThreadData *td;
-	GSList *l;
 	GThread *thread;
 
 	g_return_if_fail (notification != NULL);
 	g_return_if_fail (notification->priv != NULL);
-	g_return_if_fail (folders != NULL);
 
 	if (notification->priv->cancellable != NULL)
 		e_ews_notification_stop_listening_sync (notification);
@@ -865,8 +1439,6 @@ e_ews_notification_start_listening_sync (EEwsNotification *notification,
 	td = g_new0 (EEwsNotificationThreadData, 1);
 	td->notification = g_object_ref (notification);
 	td->cancellable = g_object_ref (notification->priv->cancellable);
-	for (l = folders; l != NULL; l = l->next)
-		td->folders = g_slist_prepend(td->folders, g_strdup (l->data));
 
 	thread = g_thread_new (NULL, e_ews_notification_get_events_thread, td);
 	g_thread_unref (thread);
@@ -881,3 +1453,53 @@ e_ews_notification_stop_listening_sync (EEwsNotification *notification)
 	g_cancellable_cancel (notification->priv->cancellable);
 	g_clear_object (&notification->priv->cancellable);
 }
+
+/* Adds a subscription for the folders, identified by the key; the listening
+   thread subscribes it on the server without interrupting the others */
+void
+e_ews_notification_add_subscription (EEwsNotification *notification,
+				     guint subscription_key,
+				     const GSList *folders)
+{
+	EwsNotificationSubscription *subscription;
+	const GSList *link;
+
+	g_return_if_fail (E_IS_EWS_NOTIFICATION (notification));
+	g_return_if_fail (folders != NULL);
+
+	subscription = g_new0 (EwsNotificationSubscription, 1);
+	for (link = folders; link; link = g_slist_next (link))
+		subscription->folders = g_slist_prepend (subscription->folders, g_strdup (link->data));
+
+	g_mutex_lock (&notification->priv->subscriptions_lock);
+	g_hash_table_insert (notification->priv->subscriptions, GUINT_TO_POINTER (subscription_key), subscription);
+	ews_notification_subscriptions_changed_locked (notification);
+	g_mutex_unlock (&notification->priv->subscriptions_lock);
+}
+
+void
+e_ews_notification_remove_subscription (EEwsNotification *notification,
+					guint subscription_key)
+{
+	EwsNotificationSubscription *subscription;
+
+	g_return_if_fail (E_IS_EWS_NOTIFICATION (notification));
+
+	g_mutex_lock (&notification->priv->subscriptions_lock);
+
+	subscription = g_hash_table_lookup (notification->priv->subscriptions, GUINT_TO_POINTER (subscription_key));
+	if (subscription) {
+		if (subscription->subscription_id) {
+			notification->priv->stale_subscription_ids = g_slist_prepend (
+				notification->priv->stale_subscription_ids, subscription->subscription_id);
+			subscription->subscription_id = NULL;
+		}
+
+		/* The running GetStreamingEvents is not interrupted, to not lose
+		   the events of the other subscriptions; the removed subscription
+		   is unsubscribed on the server when the stream is restarted */
+		g_hash_table_remove (notification->priv->subscriptions, GUINT_TO_POINTER (subscription_key));
+	}
+
+	g_mutex_unlock (&notification->priv->subscriptions_lock);
+}
@@ -56,10 +56,22 @@ EEwsNotification *
 		e_ews_notification_new		(EEwsConnection *connection);
 
 void		e_ews_notification_start_listening_sync
-						(EEwsNotification *notification,
-						 GSList *folders);
+						(EEwsNotification *notification);
 void		e_ews_notification_stop_listening_sync
 						(EEwsNotification *notification);
+void		e_ews_notification_add_subscription
+						(EEwsNotification *notification,
+						 guint subscription_key,
+						 const GSList *folders);
+void		e_ews_notification_remove_subscription
+						(EEwsNotification *notification,
+						 guint subscription_key);
+gboolean	e_ews_notification_parse_envelope
+						(const gchar *envelope,
+						 gsize envelope_len,
+						 GSList **out_events,
+						 GSList **out_failed_subscription_ids,
+						 GError **error);
 
 G_END_DECLS
 
@@ -48,13 +48,24 @@ struct _ESoapMessagePrivate {
 	gchar *action;
 
 	/* Content stealing */
-	gchar *steal_node;
+	GHashTable *steal_nodes; /* gchar *nodename ~> NULL */
 	gchar *steal_dir;
 	gboolean steal_base64;
 
 	gint steal_b64_state;
 	guint steal_b64_save;
 	gint steal_fd;
+	guchar *steal_b64_buffer; /* reused for the decoded data */
+	gsize steal_b64_buffer_size;
+	GOutputStream *steal_stream; /* used instead of files in the steal_dir, when set */
+	gboolean steal_stream_active;
+	ESoapStreamFn steal_stream_fn; /* provides the steal_stream for each node, when set */
+	gpointer steal_stream_data;
+
+	/* Incremental response processing */
+	gchar *incremental_parent;
+	ESoapNodeFn incremental_fn;
+	gpointer incremental_data;
 
 	/* Progress callbacks */
 	gsize response_size;
@@ -90,8 +101,12 @@ soap_message_finalize (GObject *object)
 	if (priv->env_prefix != NULL)
 		xmlFree (priv->env_prefix);
 
-	g_free (priv->steal_node);
+	if (priv->steal_nodes)
+		g_hash_table_destroy (priv->steal_nodes);
 	g_free (priv->steal_dir);
+	g_free (priv->steal_b64_buffer);
+	g_clear_object (&priv->steal_stream);
+	g_free (priv->incremental_parent);
 
 	if (priv->steal_fd != -1)
 		close (priv->steal_fd);
@@ -185,6 +200,23 @@ soap_restarted (SoupMessage *msg,
 		xmlFreeParserCtxt (priv->ctxt);
 		priv->ctxt = NULL;
 	}
+
+	/* Drop also any data already streamed into the node data stream;
+	   the per-node streams are asked for again, when the nodes are received */
+	if (priv->steal_stream_fn) {
+		g_clear_object (&priv->steal_stream);
+		priv->steal_stream_active = FALSE;
+	} else if (priv->steal_stream && G_IS_SEEKABLE (priv->steal_stream)) {
+		GSeekable *seekable = G_SEEKABLE (priv->steal_stream);
+
+		if (g_seekable_can_truncate (seekable) &&
+		    g_seekable_seek (seekable, 0, G_SEEK_SET, NULL, NULL))
+			g_seekable_truncate (seekable, 0, NULL, NULL);
+	}
+
+	/* Let the incremental processor forget what it got so far */
+	if (priv->incremental_fn)
+		priv->incremental_fn (NULL, priv->incremental_data);
 }
 
 static void
@@ -207,24 +239,27 @@ soap_sax_startElementNs (gpointer _ctxt,
 		namespaces, nb_attributes, nb_defaulted,
 		attributes);
 
-	/* steal_node can contain multiple node name separated by " " */
-	if (priv->steal_node && *priv->steal_node) {
-		gchar **prop = g_strsplit (priv->steal_node, " ", 0);
-		gint i = 0;
-		gboolean isnode = FALSE;
-
-		while (prop[i]) {
-			if (strcmp ((const gchar *) localname, prop[i]) == 0) {
-				isnode = TRUE;
-				break;
-			}
-			i++;
-		}
-		g_strfreev (prop);
+	if (!priv->steal_nodes ||
+	    !g_hash_table_contains (priv->steal_nodes, localname))
+		return;
 
-		if (!isnode) return;
-	} else
+	priv->steal_b64_state = 0;
+	priv->steal_b64_save = 0;
+
+	if (priv->steal_stream_fn) {
+		/* The node will be left empty in the response; its data
+		   are dropped when there is no stream for it */
+		g_clear_object (&priv->steal_stream);
+		priv->steal_stream = priv->steal_stream_fn (ctxt->node, priv->steal_stream_data);
+		priv->steal_stream_active = TRUE;
 		return;
+	}
+
+	if (priv->steal_stream) {
+		/* The node will be left empty in the response */
+		priv->steal_stream_active = TRUE;
+		return;
+	}
 
 	fname = g_build_filename (priv->steal_dir, "XXXXXX", NULL);
 	priv->steal_fd = g_mkstemp (fname);
@@ -251,12 +286,51 @@ soap_sax_endElementNs (gpointer _ctxt,
 {
 	xmlParserCtxt *ctxt = _ctxt;
 	ESoapMessagePrivate *priv = ctxt->_private;
+	xmlNodePtr node = ctxt->node;
 
 	if (priv->steal_fd != -1) {
 		close (priv->steal_fd);
 		priv->steal_fd = -1;
 	}
+	if (priv->steal_stream_active && priv->steal_stream_fn)
+		g_clear_object (&priv->steal_stream);
+	priv->steal_stream_active = FALSE;
 	xmlSAX2EndElementNs (ctxt, localname, prefix, uri);
+
+	if (priv->incremental_fn && node && node->parent &&
+	    node->parent->type == XML_ELEMENT_NODE &&
+	    g_strcmp0 ((const gchar *) node->parent->name, priv->incremental_parent) == 0 &&
+	    priv->incremental_fn (node, priv->incremental_data)) {
+		/* The node had been processed, no need to keep it in the tree;
+		   the parser skips the blanks between the elements, thus the parent's
+		   last child is not a text node, to which the SAX2 handler would
+		   append the following text */
+		xmlUnlinkNode (node);
+		xmlFreeNode (node);
+	}
+}
+
+static gboolean
+soap_sax_write_stolen (ESoapMessagePrivate *priv,
+		       const gchar *data,
+		       gsize len)
+{
+	if (priv->steal_stream_active) {
+		GError *local_error = NULL;
+
+		if (!priv->steal_stream)
+			return TRUE;
+
+		if (!g_output_stream_write_all (priv->steal_stream, data, len, NULL, NULL, &local_error)) {
+			g_warning ("Failed to write streaming data to stream: %s", local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+			return FALSE;
+		}
+
+		return TRUE;
+	}
+
+	return write (priv->steal_fd, data, len) == len;
 }
 
 static void
@@ -267,27 +341,32 @@ soap_sax_characters (gpointer _ctxt,
 	xmlParserCtxt *ctxt = _ctxt;
 	ESoapMessagePrivate *priv = ctxt->_private;
 
-	if (priv->steal_fd == -1)
+	if (priv->steal_fd == -1 && !priv->steal_stream_active)
 		xmlSAX2Characters (ctxt, ch, len);
 	else if (!priv->steal_base64) {
-		if (write (priv->steal_fd, (const gchar *) ch, len) != len) {
+		if (!soap_sax_write_stolen (priv, (const gchar *) ch, len)) {
 		write_err:
 			/* Handle error better */
 			g_warning ("Failed to write streaming data to file");
 		}
 	} else {
-		guchar *bdata = g_malloc (len);
 		gsize blen;
 
+		/* The decoded data is at most 3 bytes per each 4 characters,
+		   plus what remained from the previous call in the state */
+		blen = (len / 4) * 3 + 3;
+		if (blen > priv->steal_b64_buffer_size) {
+			priv->steal_b64_buffer_size = MAX (blen, 4096);
+			g_free (priv->steal_b64_buffer);
+			priv->steal_b64_buffer = g_malloc (priv->steal_b64_buffer_size);
+		}
+
 		blen = g_base64_decode_step (
 			(const gchar *) ch, len,
-			bdata, &priv->steal_b64_state,
+			priv->steal_b64_buffer, &priv->steal_b64_state,
 			&priv->steal_b64_save);
-		if (write (priv->steal_fd, (const gchar *) bdata, blen) != blen) {
-			g_free (bdata);
+		if (!soap_sax_write_stolen (priv, (const gchar *) priv->steal_b64_buffer, blen))
 			goto write_err;
-		}
-		g_free (bdata);
 	}
 }
 
@@ -310,6 +389,9 @@ soap_got_chunk (SoupMessage *msg,
 			NULL, msg, chunk->data,
 			chunk->length, NULL);
 		priv->ctxt->_private = priv;
+		/* The blanks between the elements are not needed, the response
+		   readers skip anything but elements */
+		xmlCtxtUseOptions (priv->ctxt, XML_PARSE_NOBLANKS);
 		priv->ctxt->sax->startElementNs = soap_sax_startElementNs;
 		priv->ctxt->sax->endElementNs = soap_sax_endElementNs;
 		priv->ctxt->sax->characters = soap_sax_characters;
@@ -428,6 +510,8 @@ e_soap_message_new_from_uri (const gchar *method,
  * This requests that character data for certain XML nodes should
  * be streamed directly to a disk file as it arrives, rather than
  * being stored in memory in the soup response buffer.
+ *
+ * The @nodename can contain multiple node names separated by a space.
  */
 
 void
@@ -438,11 +522,138 @@ e_soap_message_store_node_data (ESoapMessage *msg,
 {
 	g_return_if_fail (E_IS_SOAP_MESSAGE (msg));
 
-	msg->priv->steal_node = g_strdup (nodename);
+	if (msg->priv->steal_nodes) {
+		g_hash_table_destroy (msg->priv->steal_nodes);
+		msg->priv->steal_nodes = NULL;
+	}
+
+	/* Split the names only once, not for each parsed element */
+	if (nodename && *nodename) {
+		gchar **names;
+		gint ii;
+
+		names = g_strsplit (nodename, " ", 0);
+
+		for (ii = 0; names[ii]; ii++) {
+			if (!*names[ii])
+				continue;
+
+			if (!msg->priv->steal_nodes)
+				msg->priv->steal_nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+			g_hash_table_add (msg->priv->steal_nodes, g_strdup (names[ii]));
+		}
+
+		g_strfreev (names);
+	}
+
+	g_free (msg->priv->steal_dir);
 	msg->priv->steal_dir = g_strdup (directory);
 	msg->priv->steal_base64 = base64;
 }
 
+/**
+ * e_soap_message_store_node_data_to_stream:
+ * @msg: the %ESoapMessage.
+ * @nodename: the name of the XML node from which to store data
+ * @stream: a #GOutputStream to write the data to
+ * @base64: flag to request base64 decoding of node content
+ *
+ * Similar to e_soap_message_store_node_data(), only the character data
+ * of the nodes is written into the @stream, as it arrives, instead
+ * of the temporary files. The nodes are left empty in the response.
+ * The @stream is rewound and truncated when the message is restarted,
+ * if it supports it.
+ */
+void
+e_soap_message_store_node_data_to_stream (ESoapMessage *msg,
+					  const gchar *nodename,
+					  GOutputStream *stream,
+					  gboolean base64)
+{
+	g_return_if_fail (E_IS_SOAP_MESSAGE (msg));
+	g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+
+	e_soap_message_store_node_data (msg, nodename, NULL, base64);
+
+	g_clear_object (&msg->priv->steal_stream);
+	msg->priv->steal_stream = g_object_ref (stream);
+	msg->priv->steal_stream_fn = NULL;
+	msg->priv->steal_stream_data = NULL;
+}
+
+/**
+ * e_soap_message_store_node_data_to_stream_fn:
+ * @msg: the %ESoapMessage.
+ * @nodename: the name of the XML node from which to store data
+ * @fn: an #ESoapStreamFn, which provides a stream for each node
+ * @user_data: user data for the @fn
+ * @base64: flag to request base64 decoding of node content
+ *
+ * Similar to e_soap_message_store_node_data_to_stream(), only each of
+ * the nodes can be written into a different stream. The @fn is called
+ * when a node starts, with the node itself, which has not any content
+ * yet, but its ancestors are already part of the response. It returns
+ * a new reference of the stream for the node data, or %NULL, to drop
+ * them. When the message is restarted, the @fn is called again for
+ * the nodes as they are received; it's up to the @fn to truncate
+ * the streams it returns.
+ */
+void
+e_soap_message_store_node_data_to_stream_fn (ESoapMessage *msg,
+					     const gchar *nodename,
+					     ESoapStreamFn fn,
+					     gpointer user_data,
+					     gboolean base64)
+{
+	g_return_if_fail (E_IS_SOAP_MESSAGE (msg));
+	g_return_if_fail (fn != NULL);
+
+	e_soap_message_store_node_data (msg, nodename, NULL, base64);
+
+	g_clear_object (&msg->priv->steal_stream);
+	msg->priv->steal_stream_fn = fn;
+	msg->priv->steal_stream_data = user_data;
+}
+
+/**
+ * e_soap_message_set_incremental_fn:
+ * @msg: the %ESoapMessage.
+ * @parent_nodename: the name of the XML node whose children should be processed
+ * @fn: (nullable): callback function to process the children with
+ * @user_data: user data passed to @fn
+ *
+ * Requests incremental processing of the response. The @fn is called
+ * for each child element of any @parent_nodename element as soon as
+ * the child is fully read, while the response is still being received.
+ * When the @fn returns %TRUE, the child had been processed and it is
+ * removed from the response tree and freed, thus it will not be part
+ * of the #ESoapResponse returned by e_soap_message_parse_response().
+ * The @fn returns %FALSE for children it is not interested in, like
+ * when the @parent_nodename element is not at the expected place;
+ * such children are left in the response tree.
+ *
+ * The @fn is called with a %NULL parameter when the message is restarted,
+ * in which case it should discard anything it got from this message so far.
+ *
+ * Pass %NULL @fn to unset the processing.
+ */
+void
+e_soap_message_set_incremental_fn (ESoapMessage *msg,
+				   const gchar *parent_nodename,
+				   ESoapNodeFn fn,
+				   gpointer user_data)
+{
+	g_return_if_fail (E_IS_SOAP_MESSAGE (msg));
+	if (fn)
+		g_return_if_fail (parent_nodename != NULL);
+
+	g_free (msg->priv->incremental_parent);
+	msg->priv->incremental_parent = fn ? g_strdup (parent_nodename) : NULL;
+	msg->priv->incremental_fn = fn;
+	msg->priv->incremental_data = fn ? user_data : NULL;
+}
+
 /**
  * e_soap_message_set_progress_fn:
  * @msg: the %ESoapMessage.
@@ -131,6 +131,21 @@ void		e_soap_message_store_node_data	(ESoapMessage *msg,
 						 const gchar *nodename,
 						 const gchar *directory,
 						 gboolean base64);
+void		e_soap_message_store_node_data_to_stream
+						(ESoapMessage *msg,
+						 const gchar *nodename,
+						 GOutputStream *stream,
+						 gboolean base64);
+
+/* Returns a new reference of the stream for the data of the node */
+typedef GOutputStream * (*ESoapStreamFn) (ESoapParameter *param, gpointer user_data);
+
+void		e_soap_message_store_node_data_to_stream_fn
+						(ESoapMessage *msg,
+						 const gchar *nodename,
+						 ESoapStreamFn fn,
+						 gpointer user_data,
+						 gboolean base64);
 ESoapResponse *	e_soap_message_parse_response	(ESoapMessage *msg);
 
 /* By an amazing coincidence, this looks a lot like camel_progress() */
@@ -140,6 +155,15 @@ void		e_soap_message_set_progress_fn	(ESoapMessage *msg,
 						 ESoapProgressFn fn,
 						 gpointer object);
 
+/* Called with NULL param when the message restarted */
+typedef gboolean (*ESoapNodeFn) (ESoapParameter *param, gpointer user_data);
+
+void		e_soap_message_set_incremental_fn
+						(ESoapMessage *msg,
+						 const gchar *parent_nodename,
+						 ESoapNodeFn fn,
+						 gpointer user_data);
+
 G_END_DECLS
 
 #endif /* E_SOAP_MESSAGE_H */
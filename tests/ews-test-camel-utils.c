@@ -0,0 +1,313 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "evolution-ews-config.h"
+
+#include "camel/camel-ews-utils.h"
+
+#include "ews-test-common.h"
+
+static void
+assert_mailbox_string (const gchar *name,
+		       const gchar *email,
+		       const gchar *routing_type,
+		       const gchar *expected)
+{
+	EwsMailbox mb = { 0 };
+	const gchar *str;
+
+	mb.name = (gchar *) name;
+	mb.email = (gchar *) email;
+	mb.routing_type = (gchar *) routing_type;
+
+	str = camel_ews_utils_ref_mailbox_string (&mb);
+	g_assert_cmpstr (str, ==, expected);
+	g_assert (camel_ews_utils_mailbox_string_is_cached (&mb));
+	camel_pstring_free (str);
+}
+
+static void
+test_mailbox_string (void)
+{
+	g_assert (camel_ews_utils_ref_mailbox_string (NULL) == NULL);
+
+	assert_mailbox_string ("John Doe", "john@example.com", "SMTP", "John Doe <john@example.com>");
+	assert_mailbox_string (NULL, "john@example.com", "SMTP", "<john@example.com>");
+	assert_mailbox_string ("", "john@example.com", "SMTP", "<john@example.com>");
+	assert_mailbox_string ("John Doe", "/o=Org/ou=Group/cn=Recipients/cn=jdoe", "EX", "John Doe <jdoe>");
+
+	/* The same address with another name or routing type is another entry */
+	assert_mailbox_string ("Johnny", "john@example.com", "SMTP", "Johnny <john@example.com>");
+	assert_mailbox_string ("John Doe", "/o=Org/ou=Group/cn=Recipients/cn=jdoe", "SMTP",
+		"John Doe </o=Org/ou=Group/cn=Recipients/cn=jdoe>");
+	assert_mailbox_string ("John Doe", "john@example.com", "SMTP", "John Doe <john@example.com>");
+}
+
+static void
+ref_numbered_mailbox (guint index)
+{
+	EwsMailbox mb = { 0 };
+	const gchar *str;
+	gchar *expected;
+
+	mb.name = g_strdup_printf ("User %u", index);
+	mb.email = g_strdup_printf ("user%u@lru.example.com", index);
+	mb.routing_type = (gchar *) "SMTP";
+
+	expected = g_strdup_printf ("%s <%s>", mb.name, mb.email);
+
+	str = camel_ews_utils_ref_mailbox_string (&mb);
+	g_assert_cmpstr (str, ==, expected);
+	camel_pstring_free (str);
+
+	g_free (expected);
+	g_free (mb.name);
+	g_free (mb.email);
+}
+
+static gboolean
+numbered_mailbox_is_cached (guint index)
+{
+	EwsMailbox mb = { 0 };
+	gboolean is_cached;
+
+	mb.name = g_strdup_printf ("User %u", index);
+	mb.email = g_strdup_printf ("user%u@lru.example.com", index);
+	mb.routing_type = (gchar *) "SMTP";
+
+	is_cached = camel_ews_utils_mailbox_string_is_cached (&mb);
+
+	g_free (mb.name);
+	g_free (mb.email);
+
+	return is_cached;
+}
+
+static void
+test_mailbox_string_lru (void)
+{
+	guint ii;
+
+	/* The entry 0 is the first, the oldest, when the cache gets full */
+	for (ii = 0; ii < CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE; ii++) {
+		ref_numbered_mailbox (ii);
+	}
+
+	for (ii = 0; ii < CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE; ii++) {
+		g_assert (numbered_mailbox_is_cached (ii));
+	}
+
+	/* Using an entry makes it the most recently used one... */
+	ref_numbered_mailbox (0);
+
+	/* ...thus a new entry drops the oldest of the others */
+	ref_numbered_mailbox (CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE);
+
+	g_assert (numbered_mailbox_is_cached (0));
+	g_assert (!numbered_mailbox_is_cached (1));
+	g_assert (numbered_mailbox_is_cached (2));
+	g_assert (numbered_mailbox_is_cached (CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE));
+
+	/* The entry 0 is the oldest again after CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE - 2
+	   other entries, which drop the entries 2 to CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE - 1 */
+	for (ii = 1; ii < CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE - 1; ii++) {
+		ref_numbered_mailbox (CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE + ii);
+	}
+
+	g_assert (numbered_mailbox_is_cached (0));
+	g_assert (!numbered_mailbox_is_cached (CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE - 1));
+	g_assert (numbered_mailbox_is_cached (CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE));
+
+	ref_numbered_mailbox (2 * CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE);
+
+	g_assert (!numbered_mailbox_is_cached (0));
+	g_assert (numbered_mailbox_is_cached (CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE));
+	g_assert (numbered_mailbox_is_cached (2 * CAMEL_EWS_UTILS_MAILBOX_CACHE_SIZE));
+}
+
+static void
+assert_header (const CamelNameValueArray *headers,
+	       guint index,
+	       const gchar *expected_name,
+	       const gchar *expected_value)
+{
+	const gchar *name = NULL, *value = NULL;
+
+	g_assert (camel_name_value_array_get (headers, index, &name, &value));
+	g_assert_cmpstr (name, ==, expected_name);
+	g_assert_cmpstr (value, ==, expected_value);
+}
+
+static void
+test_parse_headers (void)
+{
+	CamelNameValueArray *headers;
+
+	headers = camel_ews_utils_parse_headers (
+		"Received: from one\r\n"
+		"Received: from two\r\n"
+		"From: John Doe <john@example.com>\r\n"
+		"X-Time: 10:20:30\r\n"
+		"X-Empty:\r\n"
+		"Subject:   Hello  \r\n"
+		"\r\n"
+		"Not-A-Header: in the body\r\n");
+
+	g_assert (headers != NULL);
+	g_assert_cmpuint (camel_name_value_array_get_length (headers), ==, 6);
+
+	assert_header (headers, 0, "Received", "from one");
+	assert_header (headers, 1, "Received", "from two");
+	assert_header (headers, 2, "From", "John Doe <john@example.com>");
+	assert_header (headers, 3, "X-Time", "10:20:30");
+	assert_header (headers, 4, "X-Empty", "");
+	assert_header (headers, 5, "Subject", "Hello");
+
+	camel_name_value_array_free (headers);
+
+	/* Only the new lines, without a trailing one */
+	headers = camel_ews_utils_parse_headers (
+		"To: jane@example.com\n"
+		"Cc: joe@example.com");
+
+	g_assert (headers != NULL);
+	g_assert_cmpuint (camel_name_value_array_get_length (headers), ==, 2);
+
+	assert_header (headers, 0, "To", "jane@example.com");
+	assert_header (headers, 1, "Cc", "joe@example.com");
+
+	camel_name_value_array_free (headers);
+}
+
+static void
+test_parse_headers_folded (void)
+{
+	CamelNameValueArray *headers;
+
+	headers = camel_ews_utils_parse_headers (
+		"Subject: part one\r\n"
+		" part two\r\n"
+		"\tpart three\r\n"
+		"To: jane@example.com,\r\n"
+		"  joe@example.com\r\n"
+		" \r\n"
+		"X-Last: value\r\n");
+
+	g_assert (headers != NULL);
+	g_assert_cmpuint (camel_name_value_array_get_length (headers), ==, 3);
+
+	/* The folding is kept, like the MIME parser does */
+	assert_header (headers, 0, "Subject", "part one\n part two\n\tpart three");
+	/* The white-space only continuation is not the end of the headers */
+	assert_header (headers, 1, "To", "jane@example.com,\n  joe@example.com");
+	assert_header (headers, 2, "X-Last", "value");
+
+	camel_name_value_array_free (headers);
+}
+
+static void
+test_parse_headers_encoded (void)
+{
+	CamelNameValueArray *headers;
+	const gchar *value = NULL;
+	gchar *unfolded, *decoded;
+
+	headers = camel_ews_utils_parse_headers (
+		"Subject: =?UTF-8?B?xb5sdcWlb3XEjWvDvSBrxa/FiA==?=\r\n"
+		"X-Folded: =?UTF-8?Q?caf=C3=A9?=\r\n"
+		" =?UTF-8?Q?_au_lait?=\r\n"
+		"From: =?ISO-8859-1?Q?J=F6rg?= <jorg@example.com>\r\n");
+
+	g_assert (headers != NULL);
+	g_assert_cmpuint (camel_name_value_array_get_length (headers), ==, 3);
+
+	/* The values are kept encoded, they are decoded by the summary */
+	assert_header (headers, 0, "Subject", "=?UTF-8?B?xb5sdcWlb3XEjWvDvSBrxa/FiA==?=");
+	assert_header (headers, 1, "X-Folded", "=?UTF-8?Q?caf=C3=A9?=\n =?UTF-8?Q?_au_lait?=");
+	assert_header (headers, 2, "From", "=?ISO-8859-1?Q?J=F6rg?= <jorg@example.com>");
+
+	value = camel_name_value_array_get_named (headers, CAMEL_COMPARE_CASE_INSENSITIVE, "subject");
+	decoded = camel_header_decode_string (value, NULL);
+	g_assert_cmpstr (decoded, ==, "žluťoučký kůň");
+	g_free (decoded);
+
+	value = camel_name_value_array_get_named (headers, CAMEL_COMPARE_CASE_INSENSITIVE, "x-folded");
+	unfolded = camel_header_unfold (value);
+	decoded = camel_header_decode_string (unfolded, NULL);
+	g_assert_cmpstr (decoded, ==, "café au lait");
+	g_free (decoded);
+	g_free (unfolded);
+
+	camel_name_value_array_free (headers);
+}
+
+static void
+test_parse_headers_malformed (void)
+{
+	CamelNameValueArray *headers;
+
+	g_assert (camel_ews_utils_parse_headers (NULL) == NULL);
+	g_assert (camel_ews_utils_parse_headers ("") == NULL);
+	g_assert (camel_ews_utils_parse_headers ("\r\nSubject: in the body\r\n") == NULL);
+	g_assert (camel_ews_utils_parse_headers ("no colon here\r\n: no name\r\n") == NULL);
+
+	headers = camel_ews_utils_parse_headers (
+		" a continuation without a header\r\n"
+		"X-First: one\r\n"
+		"a line without a colon\r\n"
+		" its continuation\r\n"
+		": a value without a name\r\n"
+		"X-Spaced \t: two\r\n"
+		"X-Bare-CR: three\r\r\n"
+		"X-Last: four");
+
+	g_assert (headers != NULL);
+	g_assert_cmpuint (camel_name_value_array_get_length (headers), ==, 4);
+
+	/* The broken lines are skipped, with their continuations */
+	assert_header (headers, 0, "X-First", "one");
+	assert_header (headers, 1, "X-Spaced", "two");
+	assert_header (headers, 2, "X-Bare-CR", "three");
+	assert_header (headers, 3, "X-Last", "four");
+
+	camel_name_value_array_free (headers);
+}
+
+int main (int argc,
+	  char **argv)
+{
+	gint retval;
+
+	retval = ews_test_init (argc, argv);
+
+	if (retval < 0) {
+		g_printerr ("Failed to initialize test\n");
+		goto exit;
+	}
+
+	g_test_add_func ("/camel/utils/mailbox_string", test_mailbox_string);
+	g_test_add_func ("/camel/utils/mailbox_string_lru", test_mailbox_string_lru);
+	g_test_add_func ("/camel/utils/parse_headers", test_parse_headers);
+	g_test_add_func ("/camel/utils/parse_headers_folded", test_parse_headers_folded);
+	g_test_add_func ("/camel/utils/parse_headers_encoded", test_parse_headers_encoded);
+	g_test_add_func ("/camel/utils/parse_headers_malformed", test_parse_headers_malformed);
+
+	retval = g_test_run ();
+
+ exit:
+	ews_test_cleanup ();
+	return retval;
+}
@@ -0,0 +1,187 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "evolution-ews-config.h"
+
+#include "server/e-ews-connection.h"
+#include "server/e-ews-folder.h"
+
+#include "ews-test-common.h"
+
+/* How many jobs are queued; the full count runs with "-m perf" */
+#define N_JOBS_PERF 100000
+#define N_JOBS_QUICK 5000
+
+typedef struct _QueueStressData {
+	guint n_completed;
+	guint n_cancelled;
+} QueueStressData;
+
+static void
+server_notify_resolver_cb (GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+	UhmServer *local_server;
+	UhmResolver *resolver;
+	EwsTestData *etd;
+	const gchar *hostname;
+
+	local_server = UHM_SERVER (object);
+	etd = user_data;
+	hostname = etd->hostname;
+
+	resolver = uhm_server_get_resolver (local_server);
+
+	if (resolver != NULL) {
+		const gchar *ip_address = uhm_server_get_address (local_server);
+
+		uhm_resolver_add_A (resolver, hostname, ip_address);
+	}
+}
+
+static void
+queued_job_done_cb (GObject *source_object,
+		    GAsyncResult *result,
+		    gpointer user_data)
+{
+	QueueStressData *qsd = user_data;
+	GSList *folders = NULL;
+	GError *error = NULL;
+
+	/* The jobs sent before their cancellation fail, the trace has no response for them */
+	g_assert (!e_ews_connection_get_folder_finish (E_EWS_CONNECTION (source_object), result, &folders, &error));
+	g_assert (error != NULL);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		qsd->n_cancelled++;
+
+	qsd->n_completed++;
+
+	g_slist_free_full (folders, g_object_unref);
+	g_clear_error (&error);
+}
+
+static void
+test_queue_and_cancel_jobs (gconstpointer user_data)
+{
+	UhmServer *local_server;
+	QueueStressData qsd = { 0, 0 };
+	GCancellable **cancellables;
+	GSList *folder_ids;
+	GTimer *timer;
+	GError *error = NULL;
+	guint n_jobs, ii;
+	EwsTestData *etd = (gpointer) user_data;
+
+	n_jobs = g_test_perf () ? N_JOBS_PERF : N_JOBS_QUICK;
+
+	local_server = ews_test_get_mock_server ();
+
+	ews_test_server_set_trace_directory (local_server, etd->version, "server/connection");
+	ews_test_server_start_trace (local_server, etd, "queue_and_cancel_jobs", &error);
+	g_assert_no_error (error);
+
+	folder_ids = g_slist_prepend (NULL, e_ews_folder_id_new ("inbox", NULL, TRUE));
+	cancellables = g_new0 (GCancellable *, n_jobs);
+
+	timer = g_timer_new ();
+
+	/* All the priorities are used, each of them gets its own bucket */
+	for (ii = 0; ii < n_jobs; ii++) {
+		cancellables[ii] = g_cancellable_new ();
+
+		e_ews_connection_get_folder (
+			etd->connection, EWS_PRIORITY_LOW + (ii % 3), "IdOnly",
+			NULL, folder_ids, cancellables[ii],
+			queued_job_done_cb, &qsd);
+	}
+
+	g_test_message ("Queued %u jobs in %.3f s", n_jobs, g_timer_elapsed (timer, NULL));
+	g_timer_start (timer);
+
+	/* Cancel every other job from the tail of the queue, then the rest from its head,
+	   thus the jobs are removed from the middle of their buckets too */
+	for (ii = n_jobs; ii > 0; ii--) {
+		if (ii % 2 == 0)
+			g_cancellable_cancel (cancellables[ii - 1]);
+	}
+
+	for (ii = 0; ii < n_jobs; ii += 2) {
+		g_cancellable_cancel (cancellables[ii]);
+	}
+
+	g_test_message ("Cancelled %u jobs in %.3f s", n_jobs, g_timer_elapsed (timer, NULL));
+	g_timer_start (timer);
+
+	while (qsd.n_completed < n_jobs) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_test_message ("Finished %u jobs in %.3f s, %u of them cancelled", n_jobs, g_timer_elapsed (timer, NULL), qsd.n_cancelled);
+
+	/* Only the jobs, which got a free slot before being cancelled, were sent */
+	g_assert_cmpuint (qsd.n_cancelled, >, 0);
+	g_assert_cmpuint (qsd.n_completed, ==, n_jobs);
+
+	for (ii = 0; ii < n_jobs; ii++) {
+		g_object_unref (cancellables[ii]);
+	}
+
+	g_timer_destroy (timer);
+	g_free (cancellables);
+	g_slist_free_full (folder_ids, (GDestroyNotify) e_ews_folder_id_free);
+
+	uhm_server_end_trace (local_server);
+}
+
+int main (int argc,
+	  char **argv)
+{
+	gint retval;
+	GList *etds, *l;
+	UhmServer *server;
+
+	retval = ews_test_init (argc, argv);
+
+	if (retval < 0) {
+		g_printerr ("Failed to initialize test\n");
+		goto exit;
+	}
+
+	server = ews_test_get_mock_server ();
+	etds = ews_test_get_test_data_list ();
+
+	for (l = etds; l != NULL; l = l->next) {
+		EwsTestData *etd = l->data;
+		gchar *message;
+
+		if (!uhm_server_get_enable_online (server))
+			g_signal_connect (server, "notify::resolver", (GCallback) server_notify_resolver_cb, etd);
+
+		message = g_strdup_printf ("/%s/server/connection/queue_and_cancel_jobs", etd->version);
+		g_test_add_data_func (message, etd, test_queue_and_cancel_jobs);
+		g_free (message);
+	}
+
+	retval = g_test_run ();
+
+	if (!uhm_server_get_enable_online (server))
+		for (l = etds; l != NULL; l = l->next)
+			g_signal_handlers_disconnect_by_func (server, server_notify_resolver_cb, l->data);
+
+ exit:
+	ews_test_cleanup ();
+	return retval;
+}
@@ -0,0 +1,289 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+
+#include "server/e-ews-connection.h"
+#include "server/e-ews-notification.h"
+
+#include "ews-test-common.h"
+
+#define ENVELOPE_START \
+	"<?xml version=\"1.0\" encoding=\"utf-8\"?>" \
+	"<soap11:Envelope xmlns:soap11=\"http://schemas.xmlsoap.org/soap/envelope/\">" \
+	"<soap11:Header>" \
+	"<ServerVersionInfo xmlns=\"http://schemas.microsoft.com/exchange/services/2006/types\"" \
+	" MajorVersion=\"14\" MinorVersion=\"2\" MajorBuildNumber=\"247\" MinorBuildNumber=\"5\" Version=\"Exchange2010_SP2\"/>" \
+	"</soap11:Header>" \
+	"<soap11:Body>" \
+	"<m:GetStreamingEventsResponse" \
+	" xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\"" \
+	" xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">" \
+	"<m:ResponseMessages>"
+
+#define ENVELOPE_END \
+	"</m:ResponseMessages>" \
+	"</m:GetStreamingEventsResponse>" \
+	"</soap11:Body>" \
+	"</soap11:Envelope>"
+
+static const gchar *events_envelope =
+	ENVELOPE_START
+	"<m:GetStreamingEventsResponseMessage ResponseClass=\"Success\">"
+	"<m:ResponseCode>NoError</m:ResponseCode>"
+	"<m:Notifications>"
+	"<m:Notification>"
+	"<t:SubscriptionId>subscription-1</t:SubscriptionId>"
+	"<t:CopiedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:26Z</t:TimeStamp>"
+	"<t:ItemId Id=\"copy-item\" ChangeKey=\"ck-1\"/>"
+	"<t:ParentFolderId Id=\"copy-folder\" ChangeKey=\"ck-2\"/>"
+	"<t:OldItemId Id=\"copy-old-item\" ChangeKey=\"ck-3\"/>"
+	"<t:OldParentFolderId Id=\"copy-old-folder\" ChangeKey=\"ck-4\"/>"
+	"</t:CopiedEvent>"
+	"<t:CreatedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:27Z</t:TimeStamp>"
+	"<t:ItemId Id=\"created-item\" ChangeKey=\"ck-5\"/>"
+	"<t:ParentFolderId Id=\"created-item-folder\" ChangeKey=\"ck-6\"/>"
+	"</t:CreatedEvent>"
+	"<t:CreatedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:28Z</t:TimeStamp>"
+	"<t:FolderId Id=\"created-folder\" ChangeKey=\"ck-7\"/>"
+	"<t:ParentFolderId Id=\"created-folder-parent\" ChangeKey=\"ck-8\"/>"
+	"</t:CreatedEvent>"
+	"<t:NewMailEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:29Z</t:TimeStamp>"
+	"<t:ItemId Id=\"new-mail-item\" ChangeKey=\"ck-9\"/>"
+	"<t:ParentFolderId Id=\"new-mail-folder\" ChangeKey=\"ck-10\"/>"
+	"</t:NewMailEvent>"
+	"</m:Notification>"
+	"<m:Notification>"
+	"<t:SubscriptionId>subscription-2</t:SubscriptionId>"
+	"<t:DeletedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:30Z</t:TimeStamp>"
+	"<t:ItemId Id=\"deleted-item\" ChangeKey=\"ck-11\"/>"
+	"<t:ParentFolderId Id=\"deleted-item-folder\" ChangeKey=\"ck-12\"/>"
+	"</t:DeletedEvent>"
+	"<t:ModifiedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:31Z</t:TimeStamp>"
+	"<t:ItemId Id=\"modified-item\" ChangeKey=\"ck-13\"/>"
+	"<t:ParentFolderId Id=\"modified-item-folder\" ChangeKey=\"ck-14\"/>"
+	"</t:ModifiedEvent>"
+	"<t:ModifiedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:32Z</t:TimeStamp>"
+	"<t:FolderId Id=\"modified-folder\" ChangeKey=\"ck-15\"/>"
+	"<t:ParentFolderId Id=\"modified-folder-parent\" ChangeKey=\"ck-16\"/>"
+	"<t:UnreadCount>3</t:UnreadCount>"
+	"</t:ModifiedEvent>"
+	"<t:MovedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:33Z</t:TimeStamp>"
+	"<t:ItemId Id=\"moved-item\" ChangeKey=\"ck-17\"/>"
+	"<t:ParentFolderId Id=\"moved-item-folder\" ChangeKey=\"ck-18\"/>"
+	"<t:OldItemId Id=\"moved-old-item\" ChangeKey=\"ck-19\"/>"
+	"<t:OldParentFolderId Id=\"moved-old-item-folder\" ChangeKey=\"ck-20\"/>"
+	"</t:MovedEvent>"
+	"<t:MovedEvent>"
+	"<t:TimeStamp>2014-01-14T17:26:34Z</t:TimeStamp>"
+	"<t:FolderId Id=\"moved-folder\" ChangeKey=\"ck-21\"/>"
+	"<t:ParentFolderId Id=\"moved-folder-parent\" ChangeKey=\"ck-22\"/>"
+	"<t:OldFolderId Id=\"moved-old-folder\" ChangeKey=\"ck-23\"/>"
+	"<t:OldParentFolderId Id=\"moved-old-folder-parent\" ChangeKey=\"ck-24\"/>"
+	"</t:MovedEvent>"
+	"</m:Notification>"
+	"</m:Notifications>"
+	"</m:GetStreamingEventsResponseMessage>"
+	ENVELOPE_END;
+
+static const gchar *status_envelope =
+	ENVELOPE_START
+	"<m:GetStreamingEventsResponseMessage ResponseClass=\"Success\">"
+	"<m:ResponseCode>NoError</m:ResponseCode>"
+	"<m:Notifications>"
+	"<m:Notification>"
+	"<t:SubscriptionId>subscription-1</t:SubscriptionId>"
+	"<t:StatusEvent>"
+	"<t:Watermark>AQAAAA==</t:Watermark>"
+	"</t:StatusEvent>"
+	"</m:Notification>"
+	"</m:Notifications>"
+	"</m:GetStreamingEventsResponseMessage>"
+	"<m:GetStreamingEventsResponseMessage ResponseClass=\"Success\">"
+	"<m:ResponseCode>NoError</m:ResponseCode>"
+	"<m:ConnectionStatus>OK</m:ConnectionStatus>"
+	"</m:GetStreamingEventsResponseMessage>"
+	ENVELOPE_END;
+
+static const gchar *error_envelope =
+	ENVELOPE_START
+	"<m:GetStreamingEventsResponseMessage ResponseClass=\"Error\">"
+	"<m:MessageText>Subscription not found.</m:MessageText>"
+	"<m:ResponseCode>ErrorSubscriptionNotFound</m:ResponseCode>"
+	"<m:DescriptiveLinkKey>0</m:DescriptiveLinkKey>"
+	"<m:ErrorSubscriptionIds>"
+	"<m:SubscriptionId>subscription-1</m:SubscriptionId>"
+	"<m:SubscriptionId>subscription-3</m:SubscriptionId>"
+	"</m:ErrorSubscriptionIds>"
+	"</m:GetStreamingEventsResponseMessage>"
+	ENVELOPE_END;
+
+static void
+assert_event (GSList *link,
+	      EEwsNotificationEventType type,
+	      gboolean is_item,
+	      const gchar *folder_id,
+	      const gchar *old_folder_id,
+	      const gchar *item_id,
+	      const gchar *old_item_id)
+{
+	EEwsNotificationEvent *event;
+
+	g_assert (link != NULL);
+
+	event = link->data;
+
+	g_assert_cmpint (event->type, ==, type);
+	g_assert_cmpint (event->is_item, ==, is_item);
+	g_assert_cmpstr (event->folder_id, ==, folder_id);
+	g_assert_cmpstr (event->old_folder_id, ==, old_folder_id);
+	g_assert_cmpstr (event->item_id, ==, item_id);
+	g_assert_cmpstr (event->old_item_id, ==, old_item_id);
+}
+
+static void
+test_parse_events (void)
+{
+	GSList *events = NULL, *failed_ids = NULL, *link;
+	GError *error = NULL;
+
+	g_assert (e_ews_notification_parse_envelope (events_envelope, strlen (events_envelope), &events, &failed_ids, &error));
+	g_assert_no_error (error);
+	g_assert (failed_ids == NULL);
+
+	/* The NewMailEvent is not subscribed for, the CreatedEvent covers it */
+	g_assert_cmpuint (g_slist_length (events), ==, 8);
+
+	link = events;
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_COPIED, TRUE,
+		"copy-folder", "copy-old-folder", "copy-item", "copy-old-item");
+
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_CREATED, TRUE,
+		"created-item-folder", NULL, "created-item", NULL);
+
+	/* The folder events carry the folder itself, not its parent */
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_CREATED, FALSE,
+		"created-folder", NULL, NULL, NULL);
+
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_DELETED, TRUE,
+		"deleted-item-folder", NULL, "deleted-item", NULL);
+
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_MODIFIED, TRUE,
+		"modified-item-folder", NULL, "modified-item", NULL);
+
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_MODIFIED, FALSE,
+		"modified-folder", NULL, NULL, NULL);
+
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_MOVED, TRUE,
+		"moved-item-folder", "moved-old-item-folder", "moved-item", "moved-old-item");
+
+	link = g_slist_next (link);
+	assert_event (link, E_EWS_NOTIFICATION_EVENT_MOVED, FALSE,
+		"moved-folder", "moved-old-folder", NULL, NULL);
+
+	g_slist_free_full (events, (GDestroyNotify) e_ews_notification_event_free);
+}
+
+static void
+test_parse_status (void)
+{
+	GSList *events = NULL, *failed_ids = NULL;
+	GError *error = NULL;
+
+	/* The keep-alive status and the connection status carry no events */
+	g_assert (e_ews_notification_parse_envelope (status_envelope, strlen (status_envelope), &events, &failed_ids, &error));
+	g_assert_no_error (error);
+	g_assert (events == NULL);
+	g_assert (failed_ids == NULL);
+}
+
+static void
+test_parse_error (void)
+{
+	GSList *events = NULL, *failed_ids = NULL;
+	GError *error = NULL;
+
+	g_assert (!e_ews_notification_parse_envelope (error_envelope, strlen (error_envelope), &events, &failed_ids, &error));
+	g_assert_error (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_SUBSCRIPTIONNOTFOUND);
+	g_assert (events == NULL);
+
+	g_assert_cmpuint (g_slist_length (failed_ids), ==, 2);
+	g_assert_cmpstr (g_slist_nth_data (failed_ids, 0), ==, "subscription-1");
+	g_assert_cmpstr (g_slist_nth_data (failed_ids, 1), ==, "subscription-3");
+
+	g_slist_free_full (failed_ids, g_free);
+	g_clear_error (&error);
+}
+
+static void
+test_parse_malformed (void)
+{
+	GSList *events = NULL, *failed_ids = NULL;
+	GError *error = NULL;
+
+	/* Cut in the middle of an event */
+	g_assert (!e_ews_notification_parse_envelope (events_envelope, strlen (events_envelope) / 2, &events, &failed_ids, &error));
+	g_assert_error (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_CORRUPTDATA);
+	g_assert (events == NULL);
+	g_assert (failed_ids == NULL);
+	g_clear_error (&error);
+
+	g_assert (!e_ews_notification_parse_envelope ("<Envelope><Body></Envelope>", 27, &events, &failed_ids, &error));
+	g_assert_error (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_CORRUPTDATA);
+	g_assert (events == NULL);
+	g_assert (failed_ids == NULL);
+	g_clear_error (&error);
+}
+
+int main (int argc,
+	  char **argv)
+{
+	gint retval;
+
+	retval = ews_test_init (argc, argv);
+
+	if (retval < 0) {
+		g_printerr ("Failed to initialize test\n");
+		goto exit;
+	}
+
+	g_test_add_func ("/server/notification/parse_events", test_parse_events);
+	g_test_add_func ("/server/notification/parse_status", test_parse_status);
+	g_test_add_func ("/server/notification/parse_error", test_parse_error);
+	g_test_add_func ("/server/notification/parse_malformed", test_parse_malformed);
+
+	retval = g_test_run ();
+
+ exit:
+	ews_test_cleanup ();
+	return retval;
+}
@@ -0,0 +1,334 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "server/e-soap-message.h"
+
+#include "ews-test-common.h"
+
+/* Size of the decoded MimeContent; the full size runs with "-m perf" */
+#define MIME_CONTENT_SIZE_PERF (50 * 1024 * 1024)
+#define MIME_CONTENT_SIZE_QUICK (2 * 1024 * 1024)
+
+/* How many items are in the FindItem response; the full count runs with "-m perf" */
+#define N_ITEMS_PERF 200000
+#define N_ITEMS_QUICK 10000
+
+/* libsoup delivers the response body in chunks of about this size */
+#define CHUNK_SIZE (16 * 1024)
+
+#define ENVELOPE_START \
+	"<?xml version=\"1.0\" encoding=\"utf-8\"?>" \
+	"<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">" \
+	"<s:Header>" \
+	"<h:ServerVersionInfo xmlns:h=\"http://schemas.microsoft.com/exchange/services/2006/types\"" \
+	" MajorVersion=\"14\" MinorVersion=\"2\" MajorBuildNumber=\"247\" MinorBuildNumber=\"5\" Version=\"Exchange2010_SP2\"/>" \
+	"</s:Header>" \
+	"<s:Body>"
+
+#define ENVELOPE_END \
+	"</s:Body>" \
+	"</s:Envelope>"
+
+static GByte *
+test_create_mime_content (gsize size)
+{
+	GByte *data;
+	gsize ii;
+
+	data = g_malloc (size);
+
+	/* Printable text with line breaks, like a real message source */
+	for (ii = 0; ii < size; ii++) {
+		if (ii % 78 == 77)
+			data[ii] = '\n';
+		else
+			data[ii] = ' ' + ((ii * 7 + ii / 78) % 95);
+	}
+
+	return data;
+}
+
+static GString *
+test_create_get_item_response (const GByte *mime_content,
+			       gsize mime_content_size)
+{
+	GString *response;
+	gchar *base64;
+
+	base64 = g_base64_encode (mime_content, mime_content_size);
+
+	response = g_string_sized_new (strlen (base64) + 1024);
+	g_string_append (response,
+		ENVELOPE_START
+		"<m:GetItemResponse"
+		" xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\""
+		" xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+		"<m:ResponseMessages>"
+		"<m:GetItemResponseMessage ResponseClass=\"Success\">"
+		"<m:ResponseCode>NoError</m:ResponseCode>"
+		"<m:Items>"
+		"<t:Message>"
+		"<t:MimeContent CharacterSet=\"UTF-8\">");
+	g_string_append (response, base64);
+	g_string_append (response,
+		"</t:MimeContent>"
+		"<t:ItemId Id=\"item-1\" ChangeKey=\"change-1\"/>"
+		"</t:Message>"
+		"</m:Items>"
+		"</m:GetItemResponseMessage>"
+		"</m:ResponseMessages>"
+		"</m:GetItemResponse>"
+		ENVELOPE_END);
+
+	g_free (base64);
+
+	return response;
+}
+
+static GString *
+test_create_find_item_response (guint n_items)
+{
+	GString *response;
+	guint ii;
+
+	response = g_string_new (
+		ENVELOPE_START
+		"<m:FindItemResponse"
+		" xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\""
+		" xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+		"<m:ResponseMessages>"
+		"<m:FindItemResponseMessage ResponseClass=\"Success\">"
+		"<m:ResponseCode>NoError</m:ResponseCode>");
+	g_string_append_printf (response,
+		"<m:RootFolder TotalItemsInView=\"%u\" IncludesLastItemInRange=\"true\">"
+		"<t:Items>", n_items);
+
+	for (ii = 0; ii < n_items; ii++) {
+		g_string_append_printf (response,
+			"<t:Message>"
+			"<t:ItemId Id=\"item-%u\" ChangeKey=\"change-%u\"/>"
+			"<t:Subject>Subject %u</t:Subject>"
+			"<t:Size>%u</t:Size>"
+			"<t:IsRead>%s</t:IsRead>"
+			"</t:Message>",
+			ii, ii, ii, 1024 + ii, (ii % 2) ? "true" : "false");
+	}
+
+	g_string_append (response,
+		"</t:Items>"
+		"</m:RootFolder>"
+		"</m:FindItemResponseMessage>"
+		"</m:ResponseMessages>"
+		"</m:FindItemResponse>"
+		ENVELOPE_END);
+
+	return response;
+}
+
+/* Feeds the response to the message the same way libsoup does when reading it */
+static ESoapResponse *
+test_feed_response (ESoapMessage *msg,
+		    const GString *response)
+{
+	gsize offset;
+
+	soup_message_set_status (SOUP_MESSAGE (msg), SOUP_STATUS_OK);
+	soup_message_got_headers (SOUP_MESSAGE (msg));
+
+	for (offset = 0; offset < response->len; offset += CHUNK_SIZE) {
+		SoupBuffer *buffer;
+
+		buffer = soup_buffer_new (
+			SOUP_MEMORY_TEMPORARY, response->str + offset,
+			MIN (CHUNK_SIZE, response->len - offset));
+		soup_message_got_chunk (SOUP_MESSAGE (msg), buffer);
+		soup_buffer_free (buffer);
+	}
+
+	return e_soap_message_parse_response (msg);
+}
+
+static void
+test_report_throughput (const gchar *what,
+			gsize n_bytes,
+			gdouble seconds)
+{
+	g_test_message ("%s: %.1f MB in %.3f s, %.1f MB/s",
+		what, n_bytes / (1024.0 * 1024.0), seconds,
+		seconds > 0.0 ? n_bytes / (1024.0 * 1024.0) / seconds : 0.0);
+
+	if (g_test_perf ())
+		g_test_minimized_result (seconds, "%s: %.3f s", what, seconds);
+}
+
+static void
+test_stream_mime_content (void)
+{
+	ESoapMessage *msg;
+	ESoapResponse *response;
+	ESoapParameter *param;
+	GString *body;
+	GByte *mime_content;
+	guchar *decoded;
+	GTimer *timer;
+	gchar *directory, *value, *filename, *contents = NULL;
+	gsize mime_content_size, decoded_len = 0, contents_size = 0;
+	GError *error = NULL;
+
+	mime_content_size = g_test_perf () ? MIME_CONTENT_SIZE_PERF : MIME_CONTENT_SIZE_QUICK;
+	mime_content = test_create_mime_content (mime_content_size);
+	body = test_create_get_item_response (mime_content, mime_content_size);
+
+	directory = g_dir_make_tmp ("ews-test-soap-message-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	msg = e_soap_message_new ("POST", "https://localhost/EWS/Exchange.asmx", FALSE, NULL, NULL, NULL, TRUE);
+	g_assert (msg != NULL);
+
+	e_soap_message_store_node_data (msg, "MimeContent", directory, TRUE);
+
+	timer = g_timer_new ();
+	response = test_feed_response (msg, body);
+	g_timer_stop (timer);
+
+	g_assert (response != NULL);
+
+	param = e_soap_response_get_first_parameter_by_name (response, "ResponseMessages", NULL);
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child (param);
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child_by_name (param, "Items");
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child (param);
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child_by_name (param, "MimeContent");
+	g_assert (param != NULL);
+
+	/* The node holds the base64-encoded name of the file with the decoded data */
+	value = e_soap_parameter_get_string_value (param);
+	g_assert (value != NULL);
+	decoded = g_base64_decode (value, &decoded_len);
+	g_assert (decoded != NULL);
+	filename = g_strndup ((const gchar *) decoded, decoded_len);
+	g_free (decoded);
+	g_assert (g_str_has_prefix (filename, directory));
+
+	g_assert (g_file_get_contents (filename, &contents, &contents_size, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (contents_size, ==, mime_content_size);
+	g_assert (memcmp (contents, mime_content, mime_content_size) == 0);
+
+	test_report_throughput ("GetItem MimeContent", body->len, g_timer_elapsed (timer, NULL));
+
+	g_unlink (filename);
+	g_rmdir (directory);
+
+	g_timer_destroy (timer);
+	g_object_unref (response);
+	g_object_unref (msg);
+	g_string_free (body, TRUE);
+	g_free (contents);
+	g_free (filename);
+	g_free (value);
+	g_free (directory);
+	g_free (mime_content);
+}
+
+static void
+test_stream_many_elements (void)
+{
+	ESoapMessage *msg;
+	ESoapResponse *response;
+	ESoapParameter *param;
+	GString *body;
+	GTimer *timer;
+	gchar *directory;
+	guint n_items, n_found = 0;
+	GError *error = NULL;
+
+	n_items = g_test_perf () ? N_ITEMS_PERF : N_ITEMS_QUICK;
+	body = test_create_find_item_response (n_items);
+
+	msg = e_soap_message_new ("POST", "https://localhost/EWS/Exchange.asmx", FALSE, NULL, NULL, NULL, TRUE);
+	g_assert (msg != NULL);
+
+	directory = g_dir_make_tmp ("ews-test-soap-message-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	/* Nothing in the response matches, each start element only looks the names up */
+	e_soap_message_store_node_data (msg, "MimeContent Content", directory, TRUE);
+
+	timer = g_timer_new ();
+	response = test_feed_response (msg, body);
+	g_timer_stop (timer);
+
+	g_assert (response != NULL);
+
+	param = e_soap_response_get_first_parameter_by_name (response, "ResponseMessages", NULL);
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child (param);
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child_by_name (param, "RootFolder");
+	g_assert (param != NULL);
+	param = e_soap_parameter_get_first_child_by_name (param, "Items");
+	g_assert (param != NULL);
+
+	for (param = e_soap_parameter_get_first_child (param);
+	     param != NULL;
+	     param = e_soap_parameter_get_next_child (param)) {
+		n_found++;
+	}
+
+	g_assert_cmpuint (n_found, ==, n_items);
+
+	test_report_throughput ("FindItem elements", body->len, g_timer_elapsed (timer, NULL));
+
+	/* Fails when any file was stored in the directory */
+	g_assert_cmpint (g_rmdir (directory), ==, 0);
+
+	g_timer_destroy (timer);
+	g_object_unref (response);
+	g_object_unref (msg);
+	g_string_free (body, TRUE);
+	g_free (directory);
+}
+
+int main (int argc,
+	  char **argv)
+{
+	gint retval;
+
+	retval = ews_test_init (argc, argv);
+
+	if (retval < 0) {
+		g_printerr ("Failed to initialize test\n");
+		goto exit;
+	}
+
+	g_test_add_func ("/server/soap-message/stream_mime_content", test_stream_mime_content);
+	g_test_add_func ("/server/soap-message/stream_many_elements", test_stream_many_elements);
+
+	retval = g_test_run ();
+
+ exit:
+	ews_test_cleanup ();
+	return retval;
+}
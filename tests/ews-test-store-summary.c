@@ -0,0 +1,402 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "camel/camel-ews-store-summary.h"
+
+#include "ews-test-common.h"
+
+typedef struct _SummaryFixture {
+	gchar *dir;
+	gchar *path;
+	gchar *journal_path;
+} SummaryFixture;
+
+static void
+summary_fixture_setup (SummaryFixture *fixture,
+		       gconstpointer user_data)
+{
+	GError *error = NULL;
+
+	fixture->dir = g_dir_make_tmp ("ews-test-store-summary-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	fixture->path = g_build_filename (fixture->dir, "folder-tree", NULL);
+	fixture->journal_path = g_strconcat (fixture->path, ".journal", NULL);
+}
+
+static void
+summary_fixture_teardown (SummaryFixture *fixture,
+			  gconstpointer user_data)
+{
+	g_unlink (fixture->journal_path);
+	g_unlink (fixture->path);
+	g_rmdir (fixture->dir);
+
+	g_free (fixture->journal_path);
+	g_free (fixture->path);
+	g_free (fixture->dir);
+}
+
+/* Saves a summary with the Inbox and its Sub subfolder */
+static void
+create_summary (SummaryFixture *fixture)
+{
+	CamelEwsStoreSummary *ews_summary;
+	GError *error = NULL;
+
+	ews_summary = camel_ews_store_summary_new (fixture->path);
+
+	/* There is no file yet */
+	g_assert (!camel_ews_store_summary_load (ews_summary, NULL));
+
+	camel_ews_store_summary_new_folder (
+		ews_summary, "inbox-id", NULL, "inbox-ck", "Inbox",
+		E_EWS_FOLDER_TYPE_MAILBOX, 0, 5, FALSE, FALSE);
+	camel_ews_store_summary_new_folder (
+		ews_summary, "sub-id", "inbox-id", "sub-ck", "Sub",
+		E_EWS_FOLDER_TYPE_MAILBOX, 0, 2, FALSE, FALSE);
+	camel_ews_store_summary_set_folder_unread (ews_summary, "inbox-id", 3);
+	camel_ews_store_summary_set_sync_state (ews_summary, "inbox-id", "sync-state");
+	camel_ews_store_summary_rebuild_hashes (ews_summary);
+
+	g_assert (camel_ews_store_summary_save (ews_summary, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (ews_summary);
+}
+
+static CamelEwsStoreSummary *
+load_summary (SummaryFixture *fixture,
+	      gboolean expect_success)
+{
+	CamelEwsStoreSummary *ews_summary;
+	GError *error = NULL;
+
+	ews_summary = camel_ews_store_summary_new (fixture->path);
+
+	if (expect_success) {
+		g_assert (camel_ews_store_summary_load (ews_summary, &error));
+		g_assert_no_error (error);
+	} else {
+		g_assert (!camel_ews_store_summary_load (ews_summary, &error));
+		g_assert (error != NULL);
+		g_clear_error (&error);
+	}
+
+	return ews_summary;
+}
+
+static void
+assert_folder_counts (CamelEwsStoreSummary *ews_summary,
+		      const gchar *folder_id,
+		      guint64 total,
+		      guint64 unread)
+{
+	g_assert_cmpuint (camel_ews_store_summary_get_folder_total (ews_summary, folder_id, NULL), ==, total);
+	g_assert_cmpuint (camel_ews_store_summary_get_folder_unread (ews_summary, folder_id, NULL), ==, unread);
+}
+
+static void
+assert_file_has_magic (const gchar *path,
+		       gboolean has_magic)
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	g_assert (g_file_get_contents (path, &contents, &length, NULL));
+	g_assert_cmpint (length >= 8 && memcmp (contents, "EWSSTSUM", 8) == 0, ==, has_magic);
+
+	g_free (contents);
+}
+
+static void
+test_round_trip (SummaryFixture *fixture,
+		 gconstpointer user_data)
+{
+	CamelEwsStoreSummary *ews_summary;
+	GSList *folders;
+	gchar *str;
+
+	create_summary (fixture);
+	assert_file_has_magic (fixture->path, TRUE);
+
+	ews_summary = load_summary (fixture, TRUE);
+
+	folders = camel_ews_store_summary_get_folders (ews_summary, NULL);
+	g_assert_cmpint (g_slist_length (folders), ==, 2);
+	g_slist_free_full (folders, g_free);
+
+	str = camel_ews_store_summary_get_folder_full_name (ews_summary, "sub-id", NULL);
+	g_assert_cmpstr (str, ==, "Inbox/Sub");
+	g_free (str);
+
+	str = camel_ews_store_summary_get_folder_id_from_name (ews_summary, "Inbox/Sub");
+	g_assert_cmpstr (str, ==, "sub-id");
+	g_free (str);
+
+	str = camel_ews_store_summary_get_parent_folder_id (ews_summary, "sub-id", NULL);
+	g_assert_cmpstr (str, ==, "inbox-id");
+	g_free (str);
+
+	str = camel_ews_store_summary_get_change_key (ews_summary, "inbox-id", NULL);
+	g_assert_cmpstr (str, ==, "inbox-ck");
+	g_free (str);
+
+	str = camel_ews_store_summary_get_sync_state (ews_summary, "inbox-id", NULL);
+	g_assert_cmpstr (str, ==, "sync-state");
+	g_free (str);
+
+	g_assert_cmpint (camel_ews_store_summary_get_folder_type (ews_summary, "sub-id", NULL), ==, E_EWS_FOLDER_TYPE_MAILBOX);
+	assert_folder_counts (ews_summary, "inbox-id", 5, 3);
+	assert_folder_counts (ews_summary, "sub-id", 2, 0);
+
+	g_object_unref (ews_summary);
+}
+
+static void
+test_truncated_file (SummaryFixture *fixture,
+		     gconstpointer user_data)
+{
+	CamelEwsStoreSummary *ews_summary;
+	GSList *folders;
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	create_summary (fixture);
+
+	g_assert (g_file_get_contents (fixture->path, &contents, &length, NULL));
+
+	/* Cut in the middle of the last folder, thus after the version */
+	g_assert (g_file_set_contents (fixture->path, contents, length - 1, NULL));
+	g_free (contents);
+
+	ews_summary = load_summary (fixture, FALSE);
+
+	/* No part of the summary is kept, the folders are fetched again */
+	folders = camel_ews_store_summary_get_folders (ews_summary, NULL);
+	g_assert (folders == NULL);
+	g_assert (!camel_ews_store_summary_has_folder (ews_summary, "inbox-id"));
+
+	/* The cleared summary is saved as a valid file */
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	g_object_unref (ews_summary);
+
+	ews_summary = load_summary (fixture, TRUE);
+	folders = camel_ews_store_summary_get_folders (ews_summary, NULL);
+	g_assert (folders == NULL);
+	g_object_unref (ews_summary);
+}
+
+static void
+test_migration (SummaryFixture *fixture,
+		gconstpointer user_data)
+{
+	CamelEwsStoreSummary *ews_summary;
+	gchar *str;
+	const gchar *key_file =
+		"[##storepriv]\n"
+		"Version=3\n"
+		"\n"
+		"[inbox-id]\n"
+		"DisplayName=Inbox\n"
+		"FolderType=mailbox\n"
+		"Total=7\n"
+		"UnRead=1\n"
+		"\n"
+		"[sub-id]\n"
+		"ParentFolderId=inbox-id\n"
+		"DisplayName=Sub\n"
+		"FolderType=mailbox\n"
+		"Total=4\n";
+
+	g_assert (g_file_set_contents (fixture->path, key_file, -1, NULL));
+
+	ews_summary = load_summary (fixture, TRUE);
+
+	str = camel_ews_store_summary_get_folder_full_name (ews_summary, "sub-id", NULL);
+	g_assert_cmpstr (str, ==, "Inbox/Sub");
+	g_free (str);
+
+	/* The key file is converted into the binary format on save */
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	g_object_unref (ews_summary);
+
+	assert_file_has_magic (fixture->path, TRUE);
+
+	ews_summary = load_summary (fixture, TRUE);
+
+	str = camel_ews_store_summary_get_folder_full_name (ews_summary, "sub-id", NULL);
+	g_assert_cmpstr (str, ==, "Inbox/Sub");
+	g_free (str);
+
+	assert_folder_counts (ews_summary, "inbox-id", 7, 1);
+	assert_folder_counts (ews_summary, "sub-id", 4, 0);
+
+	g_object_unref (ews_summary);
+}
+
+static void
+test_old_version (SummaryFixture *fixture,
+		  gconstpointer user_data)
+{
+	CamelEwsStoreSummary *ews_summary;
+	GSList *folders;
+	const gchar *key_file =
+		"[##storepriv]\n"
+		"Version=2\n"
+		"\n"
+		"[inbox-id]\n"
+		"DisplayName=Inbox\n"
+		"FolderType=mailbox\n";
+
+	g_assert (g_file_set_contents (fixture->path, key_file, -1, NULL));
+
+	ews_summary = load_summary (fixture, TRUE);
+
+	/* Another version of the summary means the folders are fetched again */
+	folders = camel_ews_store_summary_get_folders (ews_summary, NULL);
+	g_assert (folders == NULL);
+
+	g_object_unref (ews_summary);
+}
+
+static void
+test_counter_journal (SummaryFixture *fixture,
+		      gconstpointer user_data)
+{
+	CamelEwsStoreSummary *ews_summary;
+	gchar *contents = NULL, *saved = NULL;
+	gsize length = 0, saved_length = 0;
+
+	create_summary (fixture);
+	g_assert (!g_file_test (fixture->journal_path, G_FILE_TEST_EXISTS));
+
+	g_assert (g_file_get_contents (fixture->path, &saved, &saved_length, NULL));
+
+	ews_summary = load_summary (fixture, TRUE);
+	camel_ews_store_summary_set_folder_total (ews_summary, "inbox-id", 10);
+	camel_ews_store_summary_set_folder_unread (ews_summary, "inbox-id", 4);
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	camel_ews_store_summary_set_folder_total (ews_summary, "sub-id", 20);
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	g_object_unref (ews_summary);
+
+	/* Only the journal was written, the summary file stays the same */
+	g_assert (g_file_test (fixture->journal_path, G_FILE_TEST_EXISTS));
+	g_assert (g_file_get_contents (fixture->path, &contents, &length, NULL));
+	g_assert_cmpuint (length, ==, saved_length);
+	g_assert (memcmp (contents, saved, length) == 0);
+	g_free (contents);
+	g_free (saved);
+
+	ews_summary = load_summary (fixture, TRUE);
+	assert_folder_counts (ews_summary, "inbox-id", 10, 4);
+	assert_folder_counts (ews_summary, "sub-id", 20, 0);
+	g_object_unref (ews_summary);
+
+	/* An interrupted write leaves a broken last record, which is skipped */
+	g_assert (g_file_get_contents (fixture->journal_path, &contents, &length, NULL));
+	g_assert (g_file_set_contents (fixture->journal_path, contents, length - 1, NULL));
+	g_free (contents);
+
+	ews_summary = load_summary (fixture, TRUE);
+	assert_folder_counts (ews_summary, "inbox-id", 10, 4);
+	assert_folder_counts (ews_summary, "sub-id", 2, 0);
+
+	/* The broken journal is not appended to, the summary is rewritten */
+	camel_ews_store_summary_set_folder_unread (ews_summary, "sub-id", 1);
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	g_object_unref (ews_summary);
+
+	g_assert (!g_file_test (fixture->journal_path, G_FILE_TEST_EXISTS));
+
+	ews_summary = load_summary (fixture, TRUE);
+	assert_folder_counts (ews_summary, "inbox-id", 10, 4);
+	assert_folder_counts (ews_summary, "sub-id", 2, 1);
+	g_object_unref (ews_summary);
+}
+
+static void
+test_stale_journal (SummaryFixture *fixture,
+		    gconstpointer user_data)
+{
+	CamelEwsStoreSummary *ews_summary;
+	gchar *journal = NULL;
+	gsize length = 0;
+
+	create_summary (fixture);
+
+	ews_summary = load_summary (fixture, TRUE);
+	camel_ews_store_summary_set_folder_total (ews_summary, "inbox-id", 10);
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	g_object_unref (ews_summary);
+
+	g_assert (g_file_get_contents (fixture->journal_path, &journal, &length, NULL));
+
+	/* Rewrite the summary, which starts a new generation */
+	ews_summary = load_summary (fixture, TRUE);
+	camel_ews_store_summary_set_folder_total (ews_summary, "inbox-id", 6);
+	camel_ews_store_summary_set_folder_name (ews_summary, "sub-id", "Renamed");
+	g_assert (camel_ews_store_summary_save (ews_summary, NULL));
+	g_object_unref (ews_summary);
+
+	g_assert (!g_file_test (fixture->journal_path, G_FILE_TEST_EXISTS));
+
+	/* A journal left from the previous generation is ignored */
+	g_assert (g_file_set_contents (fixture->journal_path, journal, length, NULL));
+	g_free (journal);
+
+	ews_summary = load_summary (fixture, TRUE);
+	assert_folder_counts (ews_summary, "inbox-id", 6, 3);
+	g_object_unref (ews_summary);
+}
+
+int main (int argc,
+	  char **argv)
+{
+	gint retval;
+
+	retval = ews_test_init (argc, argv);
+
+	if (retval < 0) {
+		g_printerr ("Failed to initialize test\n");
+		goto exit;
+	}
+
+	g_test_add ("/camel/store-summary/round_trip", SummaryFixture, NULL,
+		summary_fixture_setup, test_round_trip, summary_fixture_teardown);
+	g_test_add ("/camel/store-summary/truncated_file", SummaryFixture, NULL,
+		summary_fixture_setup, test_truncated_file, summary_fixture_teardown);
+	g_test_add ("/camel/store-summary/migration", SummaryFixture, NULL,
+		summary_fixture_setup, test_migration, summary_fixture_teardown);
+	g_test_add ("/camel/store-summary/old_version", SummaryFixture, NULL,
+		summary_fixture_setup, test_old_version, summary_fixture_teardown);
+	g_test_add ("/camel/store-summary/counter_journal", SummaryFixture, NULL,
+		summary_fixture_setup, test_counter_journal, summary_fixture_teardown);
+	g_test_add ("/camel/store-summary/stale_journal", SummaryFixture, NULL,
+		summary_fixture_setup, test_stale_journal, summary_fixture_teardown);
+
+	retval = g_test_run ();
+
+ exit:
+	ews_test_cleanup ();
+	return retval;
+}